@@ -53,6 +53,15 @@ static inline BOOL GSIntAABBPointInBox(GSIntAABB b, vector_long3 p)
     return intersects;
 }
 
+static inline GSIntAABB GSIntAABBUnion(GSIntAABB a, GSIntAABB b)
+{
+    GSIntAABB u = {
+        .mins = vector_min(a.mins, b.mins),
+        .maxs = vector_max(a.maxs, b.maxs)
+    };
+    return u;
+}
+
 static inline NSString * _Nonnull GSIntAABBDescription(GSIntAABB box)
 {
     return [NSString stringWithFormat:@"[%@,%@]",
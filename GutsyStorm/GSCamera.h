@@ -22,6 +22,14 @@
 @property (readonly, nonatomic) matrix_float4x4 projectionMatrix;
 @property (strong, nonatomic, nullable) GSFrustum * frustum;
 
+/* Recent linear velocity of the camera, in world units per second, smoothed over the last several updates. */
+@property (readonly, nonatomic) vector_float3 velocity;
+
+/* Recent rate of turning of the camera about the vertical axis, in radians per second, smoothed over the last several
+ * updates. Positive values turn to the left.
+ */
+@property (readonly, nonatomic) float yawRate;
+
 - (void)updateCameraLookVectors;
 - (void)resetCamera;
 - (unsigned)handleUserInputForFlyingCameraWithDeltaTime:(float)dt
@@ -30,6 +38,11 @@
                                             mouseDeltaY:(int)mouseDeltaY
                                        mouseSensitivity:(float)mouseSensitivity;
 - (void)moveToPosition:(vector_float3)p;
+
+/* Sets the frustum to where the camera will be looking after the specified interval, in seconds, assuming it continues
+ * to move and turn at its current velocity and yaw rate.
+ */
+- (void)predictFrustum:(nonnull GSFrustum *)frustum afterInterval:(float)seconds;
 - (void)setCameraRot:(vector_float4)rot;
 - (void)reshapeWithSize:(CGSize)size
                     fov:(float)fov
@@ -14,11 +14,25 @@
 #import "GSVectorUtils.h"
 #import "GSVoxel.h" // for CHUNK_SIZE_Y
 
+/* Time constant, in seconds, of the exponential moving average used to smooth the velocity and yaw rate. */
+static const float GSCameraVelocitySmoothing = 0.25f;
+
+
+/* Returns the heading of the look direction about the vertical axis, in radians. */
+static float headingOfLookDirection(vector_float3 look)
+{
+    return atan2f(-look.x, -look.z);
+}
+
+
 @implementation GSCamera
 {
     float _ceilingHeight;
     float _cameraSpeed;
     float _cameraRotSpeed;
+
+    // Frustum internals, kept so that predicted frustums can be made the same shape.
+    float _fovyRadians, _aspectRatio, _nearD, _farD;
 }
 
 - (nonnull instancetype)init
@@ -28,8 +42,13 @@
         // Initialization code here.
         [self resetCamera];
         
+        _fovyRadians = 60.0*M_PI/180.0; // TODO: Set for real later on.
+        _aspectRatio = 640.0/480.0;
+        _nearD = 0.1;
+        _farD = 1000.0;
+
         _frustum = [[GSFrustum alloc] init];
-        [_frustum setCamInternalsWithAngle:(60.0*M_PI/180.0) ratio:640.0/480.0 nearD:0.1 farD:1000.0]; // TODO: Set for real later on.
+        [_frustum setCamInternalsWithAngle:_fovyRadians ratio:_aspectRatio nearD:_nearD farD:_farD];
         [_frustum setCamDefWithCameraEye:_cameraEye cameraCenter:_cameraCenter cameraUp:_cameraUp];
     }
     
@@ -69,9 +88,28 @@
     _cameraCenter = vector_make(0.0f, 0.0f, -1.0f);
     _cameraUp = vector_make(0.0f, 1.0f, 0.0f);
     _cameraRot = quaternion_make_with_angle_and_axis(0, 0, 1, 0);
+    _velocity = vector_make(0.0f, 0.0f, 0.0f);
+    _yawRate = 0.0f;
     [self updateCameraLookVectors];
 }
 
+// Blend the motion since the last update into the smoothed velocity and yaw rate.
+- (void)updateVelocityWithDeltaTime:(float)dt
+                        previousEye:(vector_float3)previousEye
+                    previousHeading:(float)previousHeading
+{
+    if (dt <= 0) {
+        return;
+    }
+
+    float turn = headingOfLookDirection(_cameraCenter - _cameraEye) - previousHeading;
+    turn = remainderf(turn, 2*M_PI); // Take the short way around.
+
+    float alpha = 1.0f - expf(-dt / GSCameraVelocitySmoothing);
+    _velocity = _velocity + alpha * ((_cameraEye - previousEye) / dt - _velocity);
+    _yawRate = _yawRate + alpha * (turn / dt - _yawRate);
+}
+
 // Handles user input to control a flying camera.
 - (unsigned)handleUserInputForFlyingCameraWithDeltaTime:(float)dt
                                                keysDown:(NSDictionary<NSNumber *, NSNumber *> *)keysDown
@@ -80,6 +118,8 @@
                                        mouseSensitivity:(float)mouseSensitivity
 {
     unsigned cameraModifiedFlags = 0;
+    vector_float3 previousEye = _cameraEye;
+    float previousHeading = headingOfLookDirection(_cameraCenter - _cameraEye);
 
     if([keysDown[@('w')] boolValue]) {
         vector_float3 velocity = quaternion_rotate_vector(_cameraRot, vector_make(0, 0, -_cameraSpeed*dt));
@@ -144,6 +184,9 @@
         [self updateCameraLookVectors];
         [_frustum setCamDefWithCameraEye:_cameraEye cameraCenter:_cameraCenter cameraUp:_cameraUp];
     }
+
+    // Update even when the camera is still, so the velocity decays.
+    [self updateVelocityWithDeltaTime:dt previousEye:previousEye previousHeading:previousHeading];
     
     return cameraModifiedFlags;
 }
@@ -155,9 +198,30 @@
     [_frustum setCamDefWithCameraEye:_cameraEye cameraCenter:_cameraCenter cameraUp:_cameraUp];
 }
 
+- (void)predictFrustum:(nonnull GSFrustum *)frustum afterInterval:(float)seconds
+{
+    NSParameterAssert(frustum);
+
+    vector_float3 eye = _cameraEye + _velocity * seconds;
+    eye.y = MIN(eye.y, _ceilingHeight);
+    eye.y = MAX(eye.y, 0.0);
+
+    vector_float4 deltaRot = quaternion_make_with_angle_and_axis(_yawRate * seconds, 0, 1, 0);
+    vector_float4 rot = quaternion_multiply(deltaRot, _cameraRot);
+    vector_float3 center = eye + vector_normalize(quaternion_rotate_vector(rot, (vector_float3){0,0,-1}));
+    vector_float3 up = vector_normalize(quaternion_rotate_vector(rot, (vector_float3){0,1,0}));
+
+    [frustum setCamInternalsWithAngle:_fovyRadians ratio:_aspectRatio nearD:_nearD farD:_farD];
+    [frustum setCamDefWithCameraEye:eye cameraCenter:center cameraUp:up];
+}
+
 - (void)reshapeWithSize:(CGSize)size fov:(float)fovyRadians nearD:(float)nearZ farD:(float)farZ
 {
     const float ratio = size.width / size.height;
+    _fovyRadians = fovyRadians;
+    _aspectRatio = ratio;
+    _nearD = nearZ;
+    _farD = farZ;
     [_frustum setCamInternalsWithAngle:fovyRadians ratio:ratio nearD:nearZ farD:farZ];
     [_frustum setCamDefWithCameraEye:_cameraEye cameraCenter:_cameraCenter cameraUp:_cameraUp];
 
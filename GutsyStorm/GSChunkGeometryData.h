@@ -20,14 +20,15 @@
 @interface GSChunkGeometryData : NSObject <GSGridItem>
 {
 @private
-    GSTerrainGeometry * _Nullable _vertices[GSNumGeometrySubChunks];
-
     NSData *_data;
     NSURL *_folder;
     dispatch_group_t _groupForSaving;
     dispatch_queue_t _queueForSaving;
 }
 
+/* Level of detail at which the chunk was meshed. Zero is full detail. See GSNumLevelsOfDetail. */
+@property (nonatomic, readonly) NSUInteger levelOfDetail;
+
 + (nonnull NSString *)fileNameForGeometryDataFromMinP:(vector_float3)minP;
 
 - (nonnull instancetype)initWithMinP:(vector_float3)minCorner
@@ -37,19 +38,26 @@
                       queueForSaving:(nonnull dispatch_queue_t)queueForSaving
                         allowLoading:(BOOL)allowLoading;
 
+/* Generates geometry for the chunk at a coarse level of detail, for drawing at a distance. This geometry is quick to
+ * regenerate so it's never saved to, or loaded from, the cache folder.
+ */
 - (nonnull instancetype)initWithMinP:(vector_float3)minCorner
-                              folder:(nullable NSURL *)folder
                             sunlight:(nonnull GSChunkSunlightData *)sunlight
-                            vertices:(GSTerrainGeometry * _Nonnull [GSNumGeometrySubChunks])vertices
-                      groupForSaving:(nonnull dispatch_group_t)groupForSaving
-                      queueForSaving:(nonnull dispatch_queue_t)queueForSaving;
+                       levelOfDetail:(NSUInteger)levelOfDetail;
 
 - (nonnull instancetype)copyWithSunlight:(nonnull GSChunkSunlightData *)sunlight
                        invalidatedRegion:(GSIntAABB)invalidatedRegion;
 
-/* Copy the chunk vertex buffer to a new buffer and return it.
- * Return the number of vertices in the buffer in `count'
+/* Return the immutable buffer which holds the chunk's geometry, without copying it.
+ * Return pointers into that buffer for the vertices and the indices, and their counts. Every three indices make one
+ * triangle. The pointers are valid only for as long as the caller holds a reference to the returned buffer.
+ * The indices of the skirts come last, one side after another in the order of GSChunkSide. `skirtIndexCounts' must
+ * have room for GSNumChunkSides counts, and receives the number of indices in the skirt along each side.
  */
-- (nonnull GSTerrainVertex *)copyVertsReturningCount:(nonnull GLsizei *)count;
+- (nonnull NSData *)geometryBufferReturningVertices:(const GSTerrainVertex * _Nonnull * _Nonnull)vertices
+                                        vertexCount:(nonnull GLsizei *)vertexCount
+                                            indices:(const GSTerrainIndex * _Nonnull * _Nonnull)indices
+                                         indexCount:(nonnull GLsizei *)indexCount
+                                   skirtIndexCounts:(GLsizei * _Nonnull)skirtIndexCounts;
 
 @end
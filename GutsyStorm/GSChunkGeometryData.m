@@ -10,6 +10,7 @@
 #import "GSChunkGeometryData.h"
 #import "GSChunkSunlightData.h"
 #import "GSTerrainBuffer.h"
+#import "GSTerrainLightBuffer.h"
 #import "GSVoxelNeighborhood.h"
 #import "SyscallWrappers.h"
 #import "GSActivity.h"
@@ -18,7 +19,14 @@
 
 
 #define GEO_MAGIC ('moeg')
-#define GEO_VERSION (0)
+#define GEO_VERSION (6)
+
+
+/* Reserved space for a sub-chunk whose geometry has never been generated before. Enough for a typical stretch of
+ * rolling terrain surface.
+ */
+#define GEO_SUBCHUNK_VERTS_ESTIMATE (1024)
+#define GEO_SUBCHUNK_INDICES_ESTIMATE (4096)
 
 
 struct GSChunkGeometryHeader
@@ -27,13 +35,260 @@ struct GSChunkGeometryHeader
     uint32_t version;
     uint32_t w, h, d;
     GLsizei numChunkVerts;
-    uint32_t len;
+    GLsizei numChunkIndices;
+
+    // Sub-chunks are stored one after the other, so these counts locate each one's vertices and indices.
+    GLsizei numSubchunkVerts[GSNumGeometrySubChunks];
+    GLsizei numSubchunkIndices[GSNumGeometrySubChunks];
+
+    // The indices are grouped into ranges which are drawn separately. See GSIndexRangeCount().
+    GLsizei numChunkSkirtIndices[GSNumChunkSides];
+    GLsizei numSubchunkSkirtIndices[GSNumGeometrySubChunks][GSNumChunkSides];
+
+    uint32_t len; // The vertices are followed immediately by the indices.
 };
 
+// Vertices are placed directly after the header, so the header must preserve their alignment.
+_Static_assert(sizeof(struct GSChunkGeometryHeader) % sizeof(GLuint) == 0, "Header must keep vertices aligned.");
+
+
+static inline uint32_t GSChunkGeometryPayloadLength(GLsizei numChunkVerts, GLsizei numChunkIndices)
+{
+    return (uint32_t)(numChunkVerts * sizeof(GSTerrainVertex) + numChunkIndices * sizeof(GSTerrainIndex));
+}
+
+
+/* The chunk's indices are grouped into ranges: first the surface, then the skirt along each side of the chunk in the
+ * order of GSChunkSide. Each range holds that part of every sub-chunk in turn, so the skirts along one side can be
+ * drawn or left out with a single draw call.
+ */
+#define GEO_NUM_INDEX_RANGES (1 + GSNumChunkSides)
+
+
+/* Returns the number of a sub-chunk's indices which fall in the specified range. */
+static inline GLsizei GSIndexRangeCount(GLsizei numIndices,
+                                        const GLsizei * _Nonnull numSkirtIndices,
+                                        NSUInteger range)
+{
+    if (range > 0) {
+        return numSkirtIndices[range - 1];
+    }
+
+    GLsizei numSurfaceIndices = numIndices;
+    for(NSUInteger side = 0; side < GSNumChunkSides; ++side)
+    {
+        numSurfaceIndices -= numSkirtIndices[side];
+    }
+    return numSurfaceIndices;
+}
+
+
+/* Decides which sub-chunks of the neighborhood's center chunk would produce no geometry, using only the occupancy
+ * summaries of the voxel chunks. Returns the number of sub-chunks which can be skipped.
+ */
+static NSUInteger GSFindSubchunksToSkip(GSVoxelNeighborhood * _Nonnull neighborhood,
+                                        BOOL skip[_Nonnull GSNumGeometrySubChunks])
+{
+    const GSSubchunkOccupancy *occupancy[GSNumMeshingNeighbors] = {
+        [GSMeshingNeighborCenter] = [neighborhood neighborAtIndex:CHUNK_NEIGHBOR_CENTER].occupancy,
+        [GSMeshingNeighborPosX] = [neighborhood neighborAtIndex:CHUNK_NEIGHBOR_POS_X_ZER_Z].occupancy,
+        [GSMeshingNeighborPosZ] = [neighborhood neighborAtIndex:CHUNK_NEIGHBOR_ZER_X_POS_Z].occupancy,
+        [GSMeshingNeighborPosXPosZ] = [neighborhood neighborAtIndex:CHUNK_NEIGHBOR_POS_X_POS_Z].occupancy
+    };
+
+    NSUInteger count = 0;
+    for(NSUInteger i=0; i<GSNumGeometrySubChunks; ++i)
+    {
+        skip[i] = GSTerrainGeometryCanSkipSubchunk(occupancy, i);
+        count += skip[i] ? 1 : 0;
+    }
+
+    return count;
+}
+
+
+/* Generates geometry for each sub-chunk which has `regenerate' set, fanning the sub-chunks out across worker threads.
+ * Sub-chunks are independent given the immutable voxels and light, and each one writes only its own slot of
+ * `geometry', so the result is the same regardless of the order in which the work completes.
+ */
+static void GSGenerateSubchunks(GSTerrainGeometry * _Nullable * _Nonnull geometry,
+                                const BOOL * _Nonnull regenerate,
+                                const BOOL * _Nonnull skip,
+                                const struct GSChunkGeometryHeader * _Nullable previous,
+                                GSVoxel * _Nullable voxels,
+                                GSIntAABB voxelBox,
+                                const uint8_t * _Nonnull const * _Nonnull light,
+                                GSIntAABB * _Nonnull lightBox,
+                                vector_float3 minP,
+                                NSUInteger levelOfDetail)
+{
+    dispatch_queue_t queue = dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0);
+
+    dispatch_apply(GSNumGeometrySubChunks, queue, ^(size_t i) {
+        if (regenerate[i]) {
+            // Reserve room up front. An edit rarely changes a sub-chunk's size by much, so the previous geometry
+            // gives the best estimate when there is one.
+            size_t vertexEstimate = 0, indexEstimate = 0;
+            if (skip[i]) {
+                // Leave it empty.
+            } else if (previous) {
+                vertexEstimate = previous->numSubchunkVerts[i] + previous->numSubchunkVerts[i] / 4;
+                indexEstimate = previous->numSubchunkIndices[i] + previous->numSubchunkIndices[i] / 4;
+            } else {
+                // Each coarser level of detail has about a quarter of the triangles.
+                vertexEstimate = GEO_SUBCHUNK_VERTS_ESTIMATE >> (2*levelOfDetail);
+                indexEstimate = GEO_SUBCHUNK_INDICES_ESTIMATE >> (2*levelOfDetail);
+            }
+
+            GSTerrainGeometry *subchunkGeometry = GSTerrainGeometryCreateWithCapacity(vertexEstimate, indexEstimate);
+            if (!skip[i]) {
+                assert(voxels);
+                GSTerrainGeometryGenerate(subchunkGeometry, voxels, voxelBox, light, lightBox, minP, i, levelOfDetail);
+            }
+            geometry[i] = subchunkGeometry;
+        }
+    });
+}
+
+
+/* Builds the chunk's geometry buffer: a header followed by the vertices and indices of every sub-chunk. Sub-chunks
+ * with geometry in `subchunks' take it from there, and the remainder are copied from the same sub-chunk of
+ * `previous'. The buffer is allocated once at its final size and is never copied again afterward. It is written to
+ * disk and handed to the VAO by reference.
+ */
+static NSData * _Nonnull GSNewGeometryBuffer(GSTerrainGeometry * _Nullable const * _Nonnull subchunks,
+                                             NSData * _Nullable previous)
+{
+    const struct GSChunkGeometryHeader *oldHeader = [previous bytes];
+    const GSTerrainVertex *oldVerts = oldHeader ? ((void *)oldHeader + sizeof(struct GSChunkGeometryHeader)) : NULL;
+    const GSTerrainIndex *oldIndices = oldHeader ? (const GSTerrainIndex *)(oldVerts + oldHeader->numChunkVerts) : NULL;
+
+    GLsizei numSubchunkVerts[GSNumGeometrySubChunks], numSubchunkIndices[GSNumGeometrySubChunks];
+    GLsizei numSubchunkSkirtIndices[GSNumGeometrySubChunks][GSNumChunkSides];
+    GLsizei numChunkVerts = 0, numChunkIndices = 0;
+    GLsizei numChunkSkirtIndices[GSNumChunkSides] = {0};
+    for(NSUInteger i=0; i<GSNumGeometrySubChunks; ++i)
+    {
+        if (subchunks[i]) {
+            numSubchunkVerts[i] = (GLsizei)subchunks[i]->count;
+            numSubchunkIndices[i] = (GLsizei)subchunks[i]->indexCount;
+            for(NSUInteger side = 0; side < GSNumChunkSides; ++side)
+            {
+                numSubchunkSkirtIndices[i][side] = (GLsizei)subchunks[i]->skirtIndexCount[side];
+            }
+        } else {
+            assert(oldHeader);
+            numSubchunkVerts[i] = oldHeader->numSubchunkVerts[i];
+            numSubchunkIndices[i] = oldHeader->numSubchunkIndices[i];
+            memcpy(numSubchunkSkirtIndices[i], oldHeader->numSubchunkSkirtIndices[i],
+                   sizeof(numSubchunkSkirtIndices[i]));
+        }
+
+        numChunkVerts += numSubchunkVerts[i];
+        numChunkIndices += numSubchunkIndices[i];
+        for(NSUInteger side = 0; side < GSNumChunkSides; ++side)
+        {
+            numChunkSkirtIndices[side] += numSubchunkSkirtIndices[i][side];
+        }
+    }
+
+    const uint32_t len = GSChunkGeometryPayloadLength(numChunkVerts, numChunkIndices);
+    const size_t capacity = sizeof(struct GSChunkGeometryHeader) + len;
+    void *bytes = malloc(capacity);
+    if(!bytes) {
+        [NSException raise:NSMallocException format:@"Out of memory allocating the chunk geometry buffer."];
+    }
+
+    struct GSChunkGeometryHeader *header = bytes;
+    GSTerrainVertex *vertsBuffer = bytes + sizeof(struct GSChunkGeometryHeader);
+    GSTerrainIndex *indexBuffer = (GSTerrainIndex *)(vertsBuffer + numChunkVerts);
+
+    header->magic = GEO_MAGIC;
+    header->version = GEO_VERSION;
+    header->w = CHUNK_SIZE_X;
+    header->h = CHUNK_SIZE_Y;
+    header->d = CHUNK_SIZE_Z;
+    header->numChunkVerts = numChunkVerts;
+    header->numChunkIndices = numChunkIndices;
+    memcpy(header->numSubchunkVerts, numSubchunkVerts, sizeof(numSubchunkVerts));
+    memcpy(header->numSubchunkIndices, numSubchunkIndices, sizeof(numSubchunkIndices));
+    memcpy(header->numChunkSkirtIndices, numChunkSkirtIndices, sizeof(numChunkSkirtIndices));
+    memcpy(header->numSubchunkSkirtIndices, numSubchunkSkirtIndices, sizeof(numSubchunkSkirtIndices));
+    header->len = len;
+
+    // Vertices are concatenated one sub-chunk after another. Note where each sub-chunk's vertices begin in the new
+    // buffer and in the old one.
+    GLsizei vertBase[GSNumGeometrySubChunks], oldVertBase[GSNumGeometrySubChunks];
+    GLsizei vertIdx = 0, oldVertIdx = 0;
+    for(NSUInteger i=0; i<GSNumGeometrySubChunks; ++i)
+    {
+        vertBase[i] = vertIdx;
+        oldVertBase[i] = oldVertIdx;
+
+        const GSTerrainVertex *srcVerts = subchunks[i] ? subchunks[i]->vertices : (oldVerts + oldVertIdx);
+        if (numSubchunkVerts[i] > 0) {
+            memcpy(&vertsBuffer[vertIdx], srcVerts, sizeof(GSTerrainVertex) * numSubchunkVerts[i]);
+        }
+
+        vertIdx += numSubchunkVerts[i];
+        if (oldHeader) {
+            oldVertIdx += oldHeader->numSubchunkVerts[i];
+        }
+    }
+
+    // Indices are concatenated one range after another, and within each range one sub-chunk after another. The old
+    // buffer has the same layout. Each sub-chunk's indices are relative to its own vertices so offset them as they are
+    // concatenated.
+    GLsizei indexIdx = 0, oldIndexIdx = 0;
+    for(NSUInteger range = 0; range < GEO_NUM_INDEX_RANGES; ++range)
+    {
+        for(NSUInteger i=0; i<GSNumGeometrySubChunks; ++i)
+        {
+            const GLsizei count = GSIndexRangeCount(numSubchunkIndices[i], numSubchunkSkirtIndices[i], range);
+            const GSTerrainIndex *srcIndices;
+            GLsizei srcBase;
+
+            if (subchunks[i]) {
+                // Within a sub-chunk's own geometry the ranges are stored in the same order.
+                srcIndices = subchunks[i]->indices;
+                for(NSUInteger r = 0; r < range; ++r)
+                {
+                    srcIndices += GSIndexRangeCount(numSubchunkIndices[i], numSubchunkSkirtIndices[i], r);
+                }
+                srcBase = 0;
+            } else {
+                srcIndices = oldIndices + oldIndexIdx;
+                srcBase = oldVertBase[i];
+            }
+
+            for(GLsizei j = 0; j < count; ++j)
+            {
+                assert(indexIdx < numChunkIndices);
+                indexBuffer[indexIdx++] = srcIndices[j] - srcBase + vertBase[i];
+            }
+
+            if (oldHeader) {
+                oldIndexIdx += GSIndexRangeCount(oldHeader->numSubchunkIndices[i],
+                                                 oldHeader->numSubchunkSkirtIndices[i],
+                                                 range);
+            }
+        }
+    }
+
+    return [[NSData alloc] initWithBytesNoCopy:bytes length:capacity freeWhenDone:YES];
+}
+
 
 @interface GSChunkGeometryData ()
 
-- (void)generateDataWithSunlight:(nonnull GSChunkSunlightData *)sunlight minP:(vector_float3)minCorner;
+- (nonnull instancetype)initWithMinP:(vector_float3)minCorner
+                              folder:(nullable NSURL *)folder
+                                data:(nonnull NSData *)data
+                       levelOfDetail:(NSUInteger)levelOfDetail
+                      groupForSaving:(nullable dispatch_group_t)groupForSaving
+                      queueForSaving:(nullable dispatch_queue_t)queueForSaving;
+
+- (nonnull NSData *)newDataWithSunlight:(nonnull GSChunkSunlightData *)sunlight;
 
 @end
 
@@ -62,6 +317,7 @@ struct GSChunkGeometryHeader
         GSStopwatchTraceStep(@"Initializing geometry chunk %@", [GSBoxedVector boxedVectorWithVector:minCorner]);
 
         minP = minCorner;
+        _levelOfDetail = 0;
 
         _groupForSaving = groupForSaving; // dispatch group used for tasks related to saving chunks to disk
         _queueForSaving = queueForSaving; // dispatch queue used for saving changes to chunks
@@ -94,26 +350,8 @@ struct GSChunkGeometryHeader
         }
 
         if (failedToLoadFromFile) {
-            GSVoxel *voxels = [sunlight.neighborhood newVoxelBufferReturningCount:NULL];
-            GSIntAABB voxelBox = { .mins = GSCombinedMinP, .maxs = GSCombinedMaxP };
-            
-            GSTerrainBufferElement *light = [sunlight.sunlight data];
-            GSIntAABB lightBox = {
-                .mins = GSZeroIntVec3 - GSMakeIntegerVector3(1, 0, 1),
-                .maxs = GSChunkSizeIntVec3 + GSMakeIntegerVector3(1, 0, 1)
-            };
-
-            for(NSUInteger i=0; i<GSNumGeometrySubChunks; ++i)
-            {
-                GSTerrainGeometry *geometry = GSTerrainGeometryCreate();
-                GSTerrainGeometryGenerate(geometry, voxels, voxelBox, light, &lightBox, minCorner, i);
-                _vertices[i] = geometry;
-            }
+            _data = [self newDataWithSunlight:sunlight];
 
-            free(voxels);
-            GSStopwatchTraceStep(@"Done generating triangles.");
-
-            [self generateDataWithSunlight:sunlight minP:minP];
             if (url) {
                 [self saveData:_data url:url queue:queueForSaving group:groupForSaving];
             }
@@ -131,44 +369,54 @@ struct GSChunkGeometryHeader
 }
 
 - (nonnull instancetype)initWithMinP:(vector_float3)minCorner
-                              folder:(nullable NSURL *)folder
                             sunlight:(nonnull GSChunkSunlightData *)sunlight
-                            vertices:(GSTerrainGeometry * _Nonnull [GSNumGeometrySubChunks])vertices
-                      groupForSaving:(nonnull dispatch_group_t)groupForSaving
-                      queueForSaving:(nonnull dispatch_queue_t)queueForSaving
+                       levelOfDetail:(NSUInteger)levelOfDetail
 {
     NSParameterAssert(sunlight);
-    NSParameterAssert(queueForSaving);
-    NSParameterAssert(groupForSaving);
+    NSParameterAssert(levelOfDetail < GSNumLevelsOfDetail);
+
+    if (self = [super init]) {
+        GSStopwatchTraceStep(@"Initializing geometry chunk %@ at level of detail %lu",
+                             [GSBoxedVector boxedVectorWithVector:minCorner], (unsigned long)levelOfDetail);
+
+        minP = minCorner;
+        _levelOfDetail = levelOfDetail;
+        _data = [self newDataWithSunlight:sunlight];
+
+        GSStopwatchTraceStep(@"Done initializing geometry chunk %@", [GSBoxedVector boxedVectorWithVector:minCorner]);
+    }
+
+    return self;
+}
+
+- (nonnull instancetype)initWithMinP:(vector_float3)minCorner
+                              folder:(nullable NSURL *)folder
+                                data:(nonnull NSData *)data
+                       levelOfDetail:(NSUInteger)levelOfDetail
+                      groupForSaving:(nullable dispatch_group_t)groupForSaving
+                      queueForSaving:(nullable dispatch_queue_t)queueForSaving
+{
+    NSParameterAssert(data);
+    NSParameterAssert(!folder || (queueForSaving && groupForSaving));
     
     if (self = [super init]) {
         GSStopwatchTraceStep(@"Initializing geometry chunk %@", [GSBoxedVector boxedVectorWithVector:minCorner]);
         
         minP = minCorner;
+        _levelOfDetail = levelOfDetail;
         
         _groupForSaving = groupForSaving; // dispatch group used for tasks related to saving chunks to disk
         _queueForSaving = queueForSaving; // dispatch queue used for saving changes to chunks
         _folder = folder;
-        
-        for(NSUInteger i=0; i<GSNumGeometrySubChunks; ++i)
-        {
-            _vertices[i] = vertices[i];
-        }
+        _data = data;
         
         NSString *fileName = [[self class] fileNameForGeometryDataFromMinP:minCorner];
         NSURL *url = folder ? [NSURL URLWithString:fileName relativeToURL:folder] : nil;
-        
-        [self generateDataWithSunlight:sunlight minP:minP];
 
         if (url) {
             [self saveData:_data url:url queue:queueForSaving group:groupForSaving];
         }
         
-        if (!_data) {
-            [NSException raise:NSGenericException
-                        format:@"Failed to fetch or generate the geometry chunk at \"%@\"", fileName];
-        }
-        
         GSStopwatchTraceStep(@"Done initializing geometry chunk %@", [GSBoxedVector boxedVectorWithVector:minCorner]);
     }
     
@@ -180,28 +428,11 @@ struct GSChunkGeometryHeader
     return self; // all geometry objects are immutable, so return self instead of deep copying
 }
 
-- (void)dealloc
-{
-    for(NSUInteger i=0; i<GSNumGeometrySubChunks; ++i)
-    {
-        GSTerrainGeometryDestroy(_vertices[i]);
-    }
-}
-
 - (nonnull instancetype)copyWithSunlight:(nonnull GSChunkSunlightData *)sunlight
                        invalidatedRegion:(GSIntAABB)invalidatedRegion
 {
     NSParameterAssert(sunlight);
 
-    if (!_vertices) {
-        return [[[self class] alloc] initWithMinP:minP
-                                           folder:_folder
-                                         sunlight:sunlight
-                                   groupForSaving:_groupForSaving
-                                   queueForSaving:_queueForSaving
-                                     allowLoading:NO];
-    }
-
     BOOL invalidatedSubChunk[GSNumGeometrySubChunks];
     {
         GSFloatAABB a = {
@@ -216,46 +447,102 @@ struct GSChunkGeometryHeader
         }
     }
 
-    GSVoxel *voxels = [sunlight.neighborhood newVoxelBufferReturningCount:NULL];
+    BOOL skip[GSNumGeometrySubChunks];
+    GSFindSubchunksToSkip(sunlight.neighborhood, skip);
+
+    // Regenerate vertices for the sub-chunk if we determined they have been invalidated. The rest are carried over
+    // from the existing buffer. Don't bother gathering voxels when there's nothing to generate.
+    BOOL regenerate[GSNumGeometrySubChunks];
+    BOOL needVoxels = NO;
+    for(NSUInteger i=0; i<GSNumGeometrySubChunks; ++i)
+    {
+        regenerate[i] = invalidatedSubChunk[i];
+        needVoxels |= regenerate[i] && !skip[i];
+    }
+
+    GSVoxel *voxels = needVoxels ? [sunlight.neighborhood newVoxelBufferReturningCount:NULL] : NULL;
     GSIntAABB voxelBox = { .mins = GSCombinedMinP, .maxs = GSCombinedMaxP };
     
-    GSTerrainBufferElement *light = [sunlight.sunlight data];
+    const uint8_t *light[NUM_LIGHT_CHANNELS] = {
+        [LIGHT_CHANNEL_SUN] = [sunlight.sunlight packedData],
+        [LIGHT_CHANNEL_TORCH] = [sunlight.torchlight packedData]
+    };
     GSIntAABB lightBox = {
         .mins = GSZeroIntVec3 - GSMakeIntegerVector3(1, 0, 1),
         .maxs = GSChunkSizeIntVec3 + GSMakeIntegerVector3(1, 0, 1)
     };
     
-    GSTerrainGeometry *updatedVertices[GSNumGeometrySubChunks] = {NULL};
+    // The regenerated sub-chunks are scratch space which lives only until it is merged into the new buffer.
+    GSTerrainGeometry *updatedSubchunks[GSNumGeometrySubChunks] = {NULL};
+
+    GSGenerateSubchunks(updatedSubchunks, regenerate, skip, [self checkedHeader],
+                        voxels, voxelBox, light, &lightBox, minP, _levelOfDetail);
+
+    free(voxels);
+
+    NSData *data = GSNewGeometryBuffer(updatedSubchunks, _data);
 
     for(NSUInteger i=0; i<GSNumGeometrySubChunks; ++i)
     {
-        GSTerrainGeometry *vertices;
-
-        // Regenerate vertices for the sub-chunk if we determined they have been invalidated, and also if we don't have
-        // any vertices recorded for the sub-chunk at all.
-        if (invalidatedSubChunk[i] || (!_vertices[i])) {
-            GSTerrainGeometry *geometry = GSTerrainGeometryCreate();
-            GSTerrainGeometryGenerate(geometry, voxels, voxelBox, light, &lightBox, minP, i);
-            vertices = geometry;
-        } else {
-            // Ownership passes to the new chunk object.
-            vertices = _vertices[i];
-            _vertices[i] = NULL;
-        }
-
-        updatedVertices[i] = vertices;
+        GSTerrainGeometryDestroy(updatedSubchunks[i]);
     }
 
-    free(voxels);
-
     return [[[self class] alloc] initWithMinP:minP
                                        folder:_folder
-                                     sunlight:sunlight
-                                     vertices:updatedVertices
+                                         data:data
+                                levelOfDetail:_levelOfDetail
                                groupForSaving:_groupForSaving
                                queueForSaving:_queueForSaving];
 }
 
+/* Generates geometry for every sub-chunk of the chunk at the chunk's level of detail. */
+- (nonnull NSData *)newDataWithSunlight:(nonnull GSChunkSunlightData *)sunlight
+{
+    NSParameterAssert(sunlight);
+
+    BOOL skip[GSNumGeometrySubChunks];
+    NSUInteger numSkipped = GSFindSubchunksToSkip(sunlight.neighborhood, skip);
+
+    // Don't bother gathering voxels when there's nothing to generate.
+    GSVoxel *voxels = NULL;
+    if (numSkipped < GSNumGeometrySubChunks) {
+        voxels = [sunlight.neighborhood newVoxelBufferReturningCount:NULL];
+    }
+
+    GSIntAABB voxelBox = { .mins = GSCombinedMinP, .maxs = GSCombinedMaxP };
+    
+    const uint8_t *light[NUM_LIGHT_CHANNELS] = {
+        [LIGHT_CHANNEL_SUN] = [sunlight.sunlight packedData],
+        [LIGHT_CHANNEL_TORCH] = [sunlight.torchlight packedData]
+    };
+    GSIntAABB lightBox = {
+        .mins = GSZeroIntVec3 - GSMakeIntegerVector3(1, 0, 1),
+        .maxs = GSChunkSizeIntVec3 + GSMakeIntegerVector3(1, 0, 1)
+    };
+
+    BOOL regenerate[GSNumGeometrySubChunks];
+    for(NSUInteger i=0; i<GSNumGeometrySubChunks; ++i)
+    {
+        regenerate[i] = YES;
+    }
+
+    GSTerrainGeometry *subchunks[GSNumGeometrySubChunks] = {NULL};
+    GSGenerateSubchunks(subchunks, regenerate, skip, NULL, voxels, voxelBox, light, &lightBox, minP, _levelOfDetail);
+
+    free(voxels);
+    GSStopwatchTraceStep(@"Done generating triangles. Skipped %lu of %d sub-chunks.",
+                         (unsigned long)numSkipped, GSNumGeometrySubChunks);
+
+    NSData *data = GSNewGeometryBuffer(subchunks, nil);
+
+    for(NSUInteger i=0; i<GSNumGeometrySubChunks; ++i)
+    {
+        GSTerrainGeometryDestroy(subchunks[i]);
+    }
+
+    return data;
+}
+
 - (BOOL)validateGeometryData:(nonnull NSData *)data error:(NSError **)error
 {
     NSParameterAssert(data);
@@ -308,7 +595,9 @@ struct GSChunkGeometryHeader
         return NO;
     }
     
-    if (header->len != (header->numChunkVerts * sizeof(GSTerrainVertex))) {
+    if ([data length] < sizeof(struct GSChunkGeometryHeader) ||
+        header->len != GSChunkGeometryPayloadLength(header->numChunkVerts, header->numChunkIndices) ||
+        [data length] != (sizeof(struct GSChunkGeometryHeader) + header->len)) {
         if (error) {
             NSString *desc = @"Unexpected number of bytes used in geometry data file";
             *error = [NSError errorWithDomain:GSErrorDomain
@@ -317,17 +606,44 @@ struct GSChunkGeometryHeader
         }
         return NO;
     }
+
+    GLsizei sumVerts = 0, sumIndices = 0;
+    GLsizei sumSkirtIndices[GSNumChunkSides] = {0};
+    BOOL skirtsFit = YES;
+    for(NSUInteger i=0; i<GSNumGeometrySubChunks; ++i)
+    {
+        sumVerts += header->numSubchunkVerts[i];
+        sumIndices += header->numSubchunkIndices[i];
+        for(NSUInteger side = 0; side < GSNumChunkSides; ++side)
+        {
+            sumSkirtIndices[side] += header->numSubchunkSkirtIndices[i][side];
+        }
+        skirtsFit &= GSIndexRangeCount(header->numSubchunkIndices[i], header->numSubchunkSkirtIndices[i], 0) >= 0;
+    }
+
+    BOOL skirtsAddUp = YES;
+    for(NSUInteger side = 0; side < GSNumChunkSides; ++side)
+    {
+        skirtsAddUp &= (sumSkirtIndices[side] == header->numChunkSkirtIndices[side]);
+    }
+
+    if (sumVerts != header->numChunkVerts || sumIndices != header->numChunkIndices || !skirtsFit || !skirtsAddUp) {
+        if (error) {
+            NSString *desc = @"Sub-chunk counts in geometry data file do not add up to the chunk totals";
+            *error = [NSError errorWithDomain:GSErrorDomain
+                                         code:GSUnexpectedDataSizeError
+                                     userInfo:@{NSLocalizedDescriptionKey : desc}];
+        }
+        return NO;
+    }
     
     return YES;
 }
 
-- (nonnull GSTerrainVertex *)copyVertsReturningCount:(nonnull GLsizei *)outCount
+/* Returns the header of the geometry data after checking that it is consistent with the data. */
+- (nonnull const struct GSChunkGeometryHeader *)checkedHeader
 {
-    NSParameterAssert(outCount);
-
     const struct GSChunkGeometryHeader * restrict header = [_data bytes];
-    const GSTerrainVertex * restrict vertsBuffer = ((void *)header) + sizeof(struct GSChunkGeometryHeader);
-    GLsizei count = header->numChunkVerts;
 
     BOOL acceptableChunkSize = (header->w==CHUNK_SIZE_X) && (header->h==CHUNK_SIZE_Y) && (header->d==CHUNK_SIZE_Z);
     
@@ -335,62 +651,35 @@ struct GSChunkGeometryHeader
         [NSException raise:NSGenericException format:@"Unacceptable chunk size for geometry chunk."];
     }
 
-    if (header->len != (header->numChunkVerts * sizeof(GSTerrainVertex))) {
+    if (header->len != GSChunkGeometryPayloadLength(header->numChunkVerts, header->numChunkIndices)) {
         [NSException raise:NSGenericException format:@"Unexpected length for geometry data."];
     }
 
-    GSTerrainVertex *vertsCopy = malloc(count * sizeof(GSTerrainVertex));
-    if(!vertsCopy) {
-        [NSException raise:NSMallocException format:@"Out of memory allocating vertsCopy in -copyVertsToBuffer:."];
-    }
-    
-    memcpy(vertsCopy, vertsBuffer, count * sizeof(GSTerrainVertex));
-
-    *outCount = count;
-    return vertsCopy;
+    return header;
 }
 
-- (void)generateDataWithSunlight:(nonnull GSChunkSunlightData *)sunlight minP:(vector_float3)minCorner
+- (nonnull NSData *)geometryBufferReturningVertices:(const GSTerrainVertex * _Nonnull * _Nonnull)outVertices
+                                        vertexCount:(nonnull GLsizei *)outVertexCount
+                                            indices:(const GSTerrainIndex * _Nonnull * _Nonnull)outIndices
+                                         indexCount:(nonnull GLsizei *)outIndexCount
+                                   skirtIndexCounts:(GLsizei * _Nonnull)outSkirtIndexCounts
 {
-    NSParameterAssert(sunlight);
-    
-    GLsizei numChunkVerts = 0;
-    for(NSUInteger i=0; i<GSNumGeometrySubChunks; ++i)
-    {
-        numChunkVerts += _vertices[i]->count;
-    }
-
-    const uint32_t len = numChunkVerts * sizeof(GSTerrainVertex);
-    const size_t capacity = sizeof(struct GSChunkGeometryHeader) + len;
-    NSMutableData *data = [[NSMutableData alloc] initWithBytesNoCopy:malloc(capacity) length:capacity freeWhenDone:YES];
-    if(!data) {
-        [NSException raise:NSMallocException format:@"Out of memory allocating `data' in -dataWithSunlight:minP:."];
-    }
-
-    struct GSChunkGeometryHeader * header = [data mutableBytes];
-    GSTerrainVertex * vertsBuffer = (void *)header + sizeof(struct GSChunkGeometryHeader);
-
-    header->magic = GEO_MAGIC;
-    header->version = GEO_VERSION;
-    header->w = CHUNK_SIZE_X;
-    header->h = CHUNK_SIZE_Y;
-    header->d = CHUNK_SIZE_Z;
-    header->numChunkVerts = numChunkVerts;
-    header->len = len;
+    NSParameterAssert(outVertices);
+    NSParameterAssert(outVertexCount);
+    NSParameterAssert(outIndices);
+    NSParameterAssert(outIndexCount);
+    NSParameterAssert(outSkirtIndexCounts);
 
-    // Take the vertices array and generate raw buffers for OpenGL to consume.
-    GLsizei vertIdx = 0;
-    for(NSUInteger i=0; i<GSNumGeometrySubChunks; ++i)
-    {
-        size_t count = _vertices[i]->count;
-        if (count > 0) {
-            assert(vertIdx < numChunkVerts);
-            memcpy(&vertsBuffer[vertIdx], _vertices[i]->vertices, sizeof(GSTerrainVertex) * count);
-            vertIdx += count;
-        }
-    }
-    
-    _data = data;
+    const struct GSChunkGeometryHeader * restrict header = [self checkedHeader];
+    const GSTerrainVertex * restrict vertsBuffer = ((void *)header) + sizeof(struct GSChunkGeometryHeader);
+    const GSTerrainIndex * restrict indexBuffer = (const GSTerrainIndex *)(vertsBuffer + header->numChunkVerts);
+
+    *outVertices = vertsBuffer;
+    *outVertexCount = header->numChunkVerts;
+    *outIndices = indexBuffer;
+    *outIndexCount = header->numChunkIndices;
+    memcpy(outSkirtIndexCounts, header->numChunkSkirtIndices, sizeof(header->numChunkSkirtIndices));
+    return _data;
 }
 
 - (void)saveData:(nonnull NSData *)data
@@ -405,9 +694,10 @@ struct GSChunkGeometryHeader
 
     dispatch_group_enter(group);
     
+    // Write the chunk's own buffer instead of a copy of it. The block keeps `data' alive until the write is done.
     dispatch_data_t dd = dispatch_data_create([data bytes], [data length],
                                               dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0),
-                                              DISPATCH_DATA_DESTRUCTOR_DEFAULT);
+                                              ^{ [data self]; });
 
     dispatch_async(queue, ^{
         int fd = Open(url, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP);
@@ -426,6 +716,10 @@ struct GSChunkGeometryHeader
 
 - (void)invalidate
 {
+    if (!_folder) {
+        return;
+    }
+
     NSString *fileName = [[self class] fileNameForGeometryDataFromMinP:minP];
     NSURL *url = [NSURL URLWithString:fileName relativeToURL:_folder];
     const char *path = [[url path] cStringUsingEncoding:NSMacOSRomanStringEncoding];
@@ -8,19 +8,27 @@
 
 #import <Foundation/Foundation.h>
 #import "GSGridItem.h"
+#import "GSVoxel.h"
 
 
 @class GSTerrainBuffer;
+@class GSTerrainLightBuffer;
 @class GSVoxelNeighborhood;
 
 
 @interface GSChunkSunlightData : NSObject <GSGridItem>
 
-@property (readonly, nonatomic, nonnull) GSTerrainBuffer *sunlight;
+@property (readonly, nonatomic, nonnull) GSTerrainLightBuffer *sunlight;
+@property (readonly, nonatomic, nonnull) GSTerrainLightBuffer *torchlight;
 @property (readonly, nonatomic, nonnull) GSVoxelNeighborhood *neighborhood;
 
 + (nonnull NSString *)fileNameForSunlightDataFromMinP:(vector_float3)minP;
 
+/* Returns YES if the file at `url' exists and has a header which this build is able to load. Files written by an older
+ * version, such as those which predate torchlight, are rejected.
+ */
++ (BOOL)canLoadSunlightDataFromURL:(nonnull NSURL *)url;
+
 - (nonnull instancetype)initWithMinP:(vector_float3)minCorner
                               folder:(nullable NSURL *)folder
                       groupForSaving:(nonnull dispatch_group_t)groupForSaving
@@ -32,10 +40,20 @@
                               folder:(nullable NSURL *)folder
                       groupForSaving:(nonnull dispatch_group_t)groupForSaving
                       queueForSaving:(nonnull dispatch_queue_t)queueForSaving
-                        sunlightData:(nonnull GSTerrainBuffer *)updatedSunlightData
+                            sunlight:(nonnull GSTerrainLightBuffer *)sunlight
+                          torchlight:(nonnull GSTerrainLightBuffer *)torchlight
                         neighborhood:(nonnull GSVoxelNeighborhood *)neighborhood;
 
+/* Returns the light buffer for the specified light channel. */
+- (nonnull GSTerrainLightBuffer *)lightBufferForChannel:(GSLightChannel)channel;
+
+/* Returns a copy of this chunk with updated sunlight. Torchlight is left unchanged. */
 - (nonnull instancetype)copyReplacingSunlightData:(nonnull GSTerrainBuffer *)updatedSunlightData
                                      neighborhood:(nonnull GSVoxelNeighborhood *)neighborhood;
 
+/* Returns a copy of this chunk with updated light. Pass nil for a channel to leave it unchanged. */
+- (nonnull instancetype)copyReplacingSunlightData:(nullable GSTerrainBuffer *)updatedSunlightData
+                                   torchlightData:(nullable GSTerrainBuffer *)updatedTorchlightData
+                                     neighborhood:(nonnull GSVoxelNeighborhood *)neighborhood;
+
 @end
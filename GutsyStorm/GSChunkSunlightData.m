@@ -10,14 +10,16 @@
 #import "GSChunkVoxelData.h"
 #import "GSVoxelNeighborhood.h"
 #import "GSMutableBuffer.h"
+#import "GSTerrainLightBuffer.h"
 #import "GSActivity.h"
 #import "GSErrorCodes.h"
 
 
 #define SUNLIGHT_MAGIC ('etil')
-#define SUNLIGHT_VERSION (0)
+#define SUNLIGHT_VERSION (2)
 
 
+/* The header is followed by the packed sunlight and then the packed torchlight. */
 struct GSChunkSunlightHeader
 {
     uint32_t magic;
@@ -31,6 +33,12 @@ struct GSChunkSunlightHeader
 static const vector_long3 sunlightDim = {CHUNK_SIZE_X+2, CHUNK_SIZE_Y, CHUNK_SIZE_Z+2};
 
 
+static inline size_t SUNLIGHT_FILE_PAYLOAD_LEN(void)
+{
+    return NUM_LIGHT_CHANNELS * LIGHT_BUFFER_SIZE_IN_BYTES(sunlightDim);
+}
+
+
 @implementation GSChunkSunlightData
 {
     NSURL *_folder;
@@ -45,6 +53,18 @@ static const vector_long3 sunlightDim = {CHUNK_SIZE_X+2, CHUNK_SIZE_Y, CHUNK_SIZ
     return [NSString stringWithFormat:@"%.0f_%.0f_%.0f.sunlight.dat", minP.x, minP.y, minP.z];
 }
 
++ (BOOL)canLoadSunlightDataFromURL:(nonnull NSURL *)url
+{
+    NSParameterAssert(url);
+
+    // Only the header is needed to decide, so avoid reading the whole file.
+    NSFileHandle *file = [NSFileHandle fileHandleForReadingFromURL:url error:nil];
+    NSData *header = [file readDataOfLength:sizeof(struct GSChunkSunlightHeader)];
+    [file closeFile];
+
+    return (header.length == sizeof(struct GSChunkSunlightHeader)) && [self validateSunlightData:header error:nil];
+}
+
 - (nonnull instancetype)initWithMinP:(vector_float3)minCorner
                               folder:(nullable NSURL *)folder
                       groupForSaving:(nonnull dispatch_group_t)groupForSaving
@@ -63,7 +83,7 @@ static const vector_long3 sunlightDim = {CHUNK_SIZE_X+2, CHUNK_SIZE_Y, CHUNK_SIZ
         _groupForSaving = groupForSaving; // dispatch group used for tasks related to saving chunks to disk
         _queueForSaving = queueForSaving; // dispatch queue used for saving changes to chunks
         _neighborhood = neighborhood;
-        _sunlight = [self newSunlightBufferWithNeighborhood:neighborhood folder:folder allowLoading:allowLoading];
+        [self loadOrGenerateLightWithNeighborhood:neighborhood folder:folder allowLoading:allowLoading];
     }
     return self;
 }
@@ -72,18 +92,25 @@ static const vector_long3 sunlightDim = {CHUNK_SIZE_X+2, CHUNK_SIZE_Y, CHUNK_SIZ
                               folder:(nullable NSURL *)folder
                       groupForSaving:(nonnull dispatch_group_t)groupForSaving
                       queueForSaving:(nonnull dispatch_queue_t)queueForSaving
-                        sunlightData:(nonnull GSTerrainBuffer *)updatedSunlightData
+                            sunlight:(nonnull GSTerrainLightBuffer *)sunlight
+                          torchlight:(nonnull GSTerrainLightBuffer *)torchlight
                         neighborhood:(nonnull GSVoxelNeighborhood *)neighborhood
 {
     NSParameterAssert(groupForSaving);
     NSParameterAssert(queueForSaving);
     NSParameterAssert(neighborhood);
-    NSParameterAssert(updatedSunlightData.dimensions.x == sunlightDim.x);
-    NSParameterAssert(updatedSunlightData.dimensions.y == sunlightDim.y);
-    NSParameterAssert(updatedSunlightData.dimensions.z == sunlightDim.z);
-    NSParameterAssert(updatedSunlightData.offsetFromChunkLocalSpace.x == 1);
-    NSParameterAssert(updatedSunlightData.offsetFromChunkLocalSpace.y == 0);
-    NSParameterAssert(updatedSunlightData.offsetFromChunkLocalSpace.z == 1);
+    NSParameterAssert(sunlight && torchlight);
+
+    for(GSTerrainLightBuffer *buffer in @[sunlight, torchlight])
+    {
+        NSParameterAssert(buffer.dimensions.x == sunlightDim.x);
+        NSParameterAssert(buffer.dimensions.y == sunlightDim.y);
+        NSParameterAssert(buffer.dimensions.z == sunlightDim.z);
+        NSParameterAssert(buffer.offsetFromChunkLocalSpace.x == 1);
+        NSParameterAssert(buffer.offsetFromChunkLocalSpace.y == 0);
+        NSParameterAssert(buffer.offsetFromChunkLocalSpace.z == 1);
+    }
+
     assert(CHUNK_LIGHTING_MAX < MIN(CHUNK_SIZE_X, CHUNK_SIZE_Z));
 
     if(self = [super init]) {
@@ -92,12 +119,13 @@ static const vector_long3 sunlightDim = {CHUNK_SIZE_X+2, CHUNK_SIZE_Y, CHUNK_SIZ
         _groupForSaving = groupForSaving; // dispatch group used for tasks related to saving chunks to disk
         _queueForSaving = queueForSaving; // dispatch queue used for saving changes to chunks
         _neighborhood = neighborhood;
-        _sunlight = updatedSunlightData;
+        _sunlight = sunlight;
+        _torchlight = torchlight;
 
         if (folder) {
             NSString *fileName = [[self class] fileNameForSunlightDataFromMinP:self.minP];
             NSURL *url = [NSURL URLWithString:fileName relativeToURL:folder];
-            [self saveSunlightBuffer:_sunlight toURL:url];
+            [self saveToURL:url];
         }
     }
     return self;
@@ -108,22 +136,57 @@ static const vector_long3 sunlightDim = {CHUNK_SIZE_X+2, CHUNK_SIZE_Y, CHUNK_SIZ
     return self; // GSChunkSunlightData is immutable, so return self instead of deep copying
 }
 
+- (nonnull GSTerrainLightBuffer *)lightBufferForChannel:(GSLightChannel)channel
+{
+    switch(channel)
+    {
+        case LIGHT_CHANNEL_SUN:
+            return _sunlight;
+
+        case LIGHT_CHANNEL_TORCH:
+            return _torchlight;
+
+        default:
+            [NSException raise:NSInvalidArgumentException format:@"Unknown light channel %d", (int)channel];
+            return _sunlight;
+    }
+}
+
 - (nonnull instancetype)copyReplacingSunlightData:(nonnull GSTerrainBuffer *)updatedSunlightData
                                      neighborhood:(nonnull GSVoxelNeighborhood *)neighborhood
 {
     NSParameterAssert(updatedSunlightData);
+    return [self copyReplacingSunlightData:updatedSunlightData torchlightData:nil neighborhood:neighborhood];
+}
+
+- (nonnull instancetype)copyReplacingSunlightData:(nullable GSTerrainBuffer *)updatedSunlightData
+                                   torchlightData:(nullable GSTerrainBuffer *)updatedTorchlightData
+                                     neighborhood:(nonnull GSVoxelNeighborhood *)neighborhood
+{
     NSParameterAssert(neighborhood);
+
+    // Light buffers are immutable so an unchanged channel can be shared with the copy.
+    GSTerrainLightBuffer *sunlight = _sunlight, *torchlight = _torchlight;
+
+    if (updatedSunlightData) {
+        sunlight = [[GSTerrainLightBuffer alloc] initWithTerrainBuffer:updatedSunlightData];
+    }
+
+    if (updatedTorchlightData) {
+        torchlight = [[GSTerrainLightBuffer alloc] initWithTerrainBuffer:updatedTorchlightData];
+    }
+
     return [[[self class] alloc] initWithMinP:self.minP
                                        folder:_folder
                                groupForSaving:_groupForSaving
                                queueForSaving:_queueForSaving
-                                 sunlightData:updatedSunlightData
+                                     sunlight:sunlight
+                                   torchlight:torchlight
                                  neighborhood:neighborhood];
 }
 
-- (void)saveSunlightBuffer:(nonnull GSTerrainBuffer *)buffer toURL:(nonnull NSURL *)url
+- (void)saveToURL:(nonnull NSURL *)url
 {
-    NSParameterAssert(buffer);
     NSParameterAssert(url);
     NSParameterAssert([url isFileURL]);
 
@@ -134,24 +197,32 @@ static const vector_long3 sunlightDim = {CHUNK_SIZE_X+2, CHUNK_SIZE_Y, CHUNK_SIZ
         .h = (uint32_t)sunlightDim.y,
         .d = (uint32_t)sunlightDim.z,
         .lightMax = CHUNK_LIGHTING_MAX,
-        .len = (uint64_t)BUFFER_SIZE_IN_BYTES(sunlightDim)
+        .len = (uint64_t)SUNLIGHT_FILE_PAYLOAD_LEN()
     };
+
+    size_t channelLen = LIGHT_BUFFER_SIZE_IN_BYTES(sunlightDim);
+    NSMutableData *payload = [[NSMutableData alloc] initWithCapacity:SUNLIGHT_FILE_PAYLOAD_LEN()];
+    [payload appendBytes:[_sunlight packedData] length:channelLen];
+    [payload appendBytes:[_torchlight packedData] length:channelLen];
     
-    [buffer saveToFile:url
-                 queue:_queueForSaving
-                 group:_groupForSaving
-                header:[NSData dataWithBytes:&header length:sizeof(header)]];
+    [GSTerrainBuffer saveBytes:[payload bytes]
+                        length:[payload length]
+                        toFile:url
+                         queue:_queueForSaving
+                         group:_groupForSaving
+                        header:[NSData dataWithBytes:&header length:sizeof(header)]];
 }
 
-- (nonnull GSTerrainBuffer *)newSunlightBufferWithNeighborhood:(nonnull GSVoxelNeighborhood *)neighborhood
-                                                        folder:(nullable NSURL *)folder
-                                                  allowLoading:(BOOL)allowLoading
+/* Loads both light channels from file, if possible. Otherwise, generates them from the voxel neighborhood and saves
+ * the result. Sets the `sunlight' and `torchlight' ivars.
+ */
+- (void)loadOrGenerateLightWithNeighborhood:(nonnull GSVoxelNeighborhood *)neighborhood
+                                     folder:(nullable NSURL *)folder
+                               allowLoading:(BOOL)allowLoading
 {
     NSParameterAssert(neighborhood);
 
-    GSStopwatchTraceStep(@"newSunlightBufferWithNeighborhood enter");
-
-    GSTerrainBuffer *buffer = nil;
+    GSStopwatchTraceStep(@"loadOrGenerateLightWithNeighborhood enter");
 
     BOOL failedToLoadFromFile = YES;
     NSString *fileName = [[self class] fileNameForSunlightDataFromMinP:self.minP];
@@ -166,14 +237,16 @@ static const vector_long3 sunlightDim = {CHUNK_SIZE_X+2, CHUNK_SIZE_Y, CHUNK_SIZ
     }
 
     if(data) {
-        if (![self validateSunlightData:data error:&error]) {
+        if (![[self class] validateSunlightData:data error:&error]) {
             NSLog(@"ERROR: Failed to validate the sunlight data file at \"%@\": %@", fileName, error);
         } else {
             const struct GSChunkSunlightHeader * restrict header = [data bytes];
-            const void * restrict sunlightBytes = ((void *)header) + sizeof(struct GSChunkSunlightHeader);
-            buffer = [[GSTerrainBuffer alloc] initWithDimensions:sunlightDim copyUnalignedData:sunlightBytes];
+            const uint8_t * restrict sunlightBytes = ((void *)header) + sizeof(struct GSChunkSunlightHeader);
+            const uint8_t * restrict torchlightBytes = sunlightBytes + LIGHT_BUFFER_SIZE_IN_BYTES(sunlightDim);
+            _sunlight = [[GSTerrainLightBuffer alloc] initWithDimensions:sunlightDim copyPackedData:sunlightBytes];
+            _torchlight = [[GSTerrainLightBuffer alloc] initWithDimensions:sunlightDim copyPackedData:torchlightBytes];
             failedToLoadFromFile = NO;
-            GSStopwatchTraceStep(@"Loaded sunlight data for chunk from file.");
+            GSStopwatchTraceStep(@"Loaded light data for chunk from file.");
         }
     } else if ([error.domain isEqualToString:NSCocoaErrorDomain] && (error.code == 260)) {
         // File not found. We don't have to log this one because it's common and we know how to recover.
@@ -185,31 +258,33 @@ static const vector_long3 sunlightDim = {CHUNK_SIZE_X+2, CHUNK_SIZE_Y, CHUNK_SIZ
     }
 
     if (failedToLoadFromFile) {
-        buffer = [neighborhood newSunlightBuffer];
-
-        assert(buffer.dimensions.x == sunlightDim.x);
-        assert(buffer.dimensions.y == sunlightDim.y);
-        assert(buffer.dimensions.z == sunlightDim.z);
-        assert(buffer.offsetFromChunkLocalSpace.x == 1);
-        assert(buffer.offsetFromChunkLocalSpace.y == 0);
-        assert(buffer.offsetFromChunkLocalSpace.z == 1);
+        GSTerrainBuffer *sunlight = [neighborhood newLightBufferForChannel:LIGHT_CHANNEL_SUN];
+        GSTerrainBuffer *torchlight = [neighborhood newLightBufferForChannel:LIGHT_CHANNEL_TORCH];
+        _sunlight = [[GSTerrainLightBuffer alloc] initWithTerrainBuffer:sunlight];
+        _torchlight = [[GSTerrainLightBuffer alloc] initWithTerrainBuffer:torchlight];
+
+        assert(_sunlight.dimensions.x == sunlightDim.x);
+        assert(_sunlight.dimensions.y == sunlightDim.y);
+        assert(_sunlight.dimensions.z == sunlightDim.z);
+        assert(_sunlight.offsetFromChunkLocalSpace.x == 1);
+        assert(_sunlight.offsetFromChunkLocalSpace.y == 0);
+        assert(_sunlight.offsetFromChunkLocalSpace.z == 1);
 
         if (url) {
-            [self saveSunlightBuffer:buffer toURL:url];
+            [self saveToURL:url];
         }
-        GSStopwatchTraceStep(@"Generated sunlight data for chunk.");
+        GSStopwatchTraceStep(@"Generated light data for chunk.");
     }
 
-    if (!buffer) {
+    if (!(_sunlight && _torchlight)) {
         [NSException raise:NSGenericException
                     format:@"Failed to fetch or generate the sunlight chunk \"%@\"", fileName];
     }
     
-    GSStopwatchTraceStep(@"newSunlightBufferWithNeighborhood exit");
-    return buffer;
+    GSStopwatchTraceStep(@"loadOrGenerateLightWithNeighborhood exit");
 }
 
-- (BOOL)validateSunlightData:(nonnull NSData *)data error:(NSError **)error
++ (BOOL)validateSunlightData:(nonnull NSData *)data error:(NSError **)error
 {
     NSParameterAssert(data);
     
@@ -270,10 +345,10 @@ static const vector_long3 sunlightDim = {CHUNK_SIZE_X+2, CHUNK_SIZE_Y, CHUNK_SIZ
         return NO;
     }
     
-    if (header->len != BUFFER_SIZE_IN_BYTES(sunlightDim)) {
+    if (header->len != SUNLIGHT_FILE_PAYLOAD_LEN()) {
         if (error) {
             NSString *desc = [NSString stringWithFormat:@"Unexpected number of bytes in sunlight data: found %llu " \
-                              @"but expected %zu bytes", header->len, BUFFER_SIZE_IN_BYTES(sunlightDim)];
+                              @"but expected %zu bytes", header->len, SUNLIGHT_FILE_PAYLOAD_LEN()];
             *error = [NSError errorWithDomain:GSErrorDomain
                                          code:GSUnexpectedDataSizeError
                                      userInfo:@{NSLocalizedDescriptionKey : desc}];
@@ -12,10 +12,16 @@
 
 @property (nonatomic, nonnull, readonly) NSOpenGLContext *glContext;
 
+/* Level of detail of the geometry in the VAO. */
+@property (nonatomic, readonly) NSUInteger levelOfDetail;
+
 - (nonnull instancetype)initWithChunkGeometry:(nonnull GSChunkGeometryData *)geometry
                                     glContext:(nonnull NSOpenGLContext *)glContext;
 
-/* Assumes the caller has already locked the context on the current thread. */
-- (void)draw;
+/* Draws the chunk along with the skirts on the sides in `sides', a mask with bit `1 << side' set for each GSChunkSide.
+ * Skirts are only needed along sides which border a chunk drawn at another level of detail.
+ * Assumes the caller has already locked the context on the current thread.
+ */
+- (void)drawWithSkirts:(unsigned)sides;
 
 @end
@@ -13,7 +13,6 @@
 #import "GSChunkVAO.h"
 #import "GSIntegerVector3.h"
 #import "GSChunkGeometryData.h"
-#import "GSVBOHolder.h"
 #import "GSVAOHolder.h"
 #import "GSActivity.h"
 #import "GSBoxedVector.h"
@@ -25,55 +24,22 @@
 extern int checkGLErrors(void);
 
 
-// Make sure the number of indices can be stored in the type used for the shared index buffer.
-// NOTE: use a different value when index_t is GLushort.
-static const GLsizei SHARED_INDEX_BUFFER_LEN = CHUNK_SIZE_X * CHUNK_SIZE_Y * CHUNK_SIZE_Z * 36;
-typedef GLuint index_t;
-
-
 @implementation GSChunkVAO
 {
     GLsizei _numIndicesForDrawing;
-    GSVBOHolder *_ibo;
+    GLsizei _numSurfaceIndices;
+    GLsizei _numSkirtIndices[GSNumChunkSides];
     GSVAOHolder *_vao;
-    GSTerrainVertex *_vertsBuffer;
+    NSData *_geometryBuffer; // Shared with the geometry chunk. Holds the memory behind the pointers below.
+    const GSTerrainVertex *_vertsBuffer;
     GLsizeiptr _bufferSize;
+    const GSTerrainIndex *_indexBuffer;
+    GLsizeiptr _indexBufferSize;
     BOOL _initializedYet;
 }
 
 @synthesize minP;
 
-+ (nonnull GSVBOHolder *)sharedIndexBufferObject
-{
-    static dispatch_once_t onceToken;
-    static GSVBOHolder *iboHolder;
-
-    dispatch_once(&onceToken, ^{
-        // Take the indices array and generate a raw index buffer that OpenGL can consume.
-        index_t *buffer = malloc(sizeof(index_t) * SHARED_INDEX_BUFFER_LEN);
-        if(!buffer) {
-            [NSException raise:NSMallocException format:@"Out of memory allocating index buffer."];
-        }
-
-        for(GLsizei i = 0; i < SHARED_INDEX_BUFFER_LEN; ++i)
-        {
-            buffer[i] = i; // a simple linear walk
-        }
-        
-        GLuint ibo = 0;
-        
-        glGenBuffers(1, &ibo);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, SHARED_INDEX_BUFFER_LEN * sizeof(index_t), buffer, GL_STATIC_DRAW);
-        glBindBuffer(GL_ARRAY_BUFFER, 0);
-        assert(checkGLErrors() == 0);
-        
-        iboHolder = [[GSVBOHolder alloc] initWithHandle:ibo context:[NSOpenGLContext currentContext]];
-    });
-
-    return iboHolder;
-}
-
 - (nonnull instancetype)initWithChunkGeometry:(nonnull GSChunkGeometryData *)geometry
                                     glContext:(nonnull NSOpenGLContext *)context
 {
@@ -84,8 +50,20 @@ typedef GLuint index_t;
         _initializedYet = NO;
         _glContext = context;
         minP = geometry.minP;
-        _vertsBuffer = [geometry copyVertsReturningCount:&_numIndicesForDrawing];
-        _bufferSize = _numIndicesForDrawing * sizeof(GSTerrainVertex);
+        _levelOfDetail = geometry.levelOfDetail;
+        GLsizei numVerts = 0;
+        _geometryBuffer = [geometry geometryBufferReturningVertices:&_vertsBuffer
+                                                        vertexCount:&numVerts
+                                                            indices:&_indexBuffer
+                                                         indexCount:&_numIndicesForDrawing
+                                                   skirtIndexCounts:_numSkirtIndices];
+        _numSurfaceIndices = _numIndicesForDrawing;
+        for(NSUInteger side = 0; side < GSNumChunkSides; ++side)
+        {
+            _numSurfaceIndices -= _numSkirtIndices[side];
+        }
+        _bufferSize = numVerts * sizeof(GSTerrainVertex);
+        _indexBufferSize = _numIndicesForDrawing * sizeof(GSTerrainIndex);
     }
 
     return self;
@@ -96,29 +74,23 @@ typedef GLuint index_t;
     return self; // All GSChunkVAO objects are immutable, so return self instead of deep copying.
 }
 
-- (void)dealloc
-{
-    free(_vertsBuffer);
-    _vertsBuffer = NULL;
-}
-
-- (void)draw
+- (void)drawWithSkirts:(unsigned)sides
 {
     assert(checkGLErrors() == 0);
-    assert(_numIndicesForDrawing < SHARED_INDEX_BUFFER_LEN);
     
     if (!_initializedYet) {
-        _ibo = [[self class] sharedIndexBufferObject];
-        
         GLuint vao = 0;
         glGenVertexArraysAPPLE(1, &vao);
         glBindVertexArrayAPPLE(vao);
         
         glEnableClientState(GL_VERTEX_ARRAY);
-        glEnableClientState(GL_TEXTURE_COORD_ARRAY);
-        glEnableClientState(GL_COLOR_ARRAY);
+        glEnableVertexAttribArray(GSTerrainVertexAttribTexCoord);
+        glEnableVertexAttribArray(GSTerrainVertexAttribLuminance);
         
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _ibo.handle);
+        GLuint ibo = 0;
+        glGenBuffers(1, &ibo);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, _indexBufferSize, _indexBuffer, GL_STATIC_DRAW);
         
         GLuint vbo = 0;
         glGenBuffers(1, &vbo);
@@ -127,22 +99,27 @@ typedef GLuint index_t;
         
         if (glGetError() == GL_OUT_OF_MEMORY) {
             NSLog(@"GSChunkVAO failed to acquire GPU resources.");
+            glDeleteBuffers(1, &ibo);
             glDeleteBuffers(1, &vbo);
             glDeleteVertexArraysAPPLE(1, &vao);
         } else {
-            const GLvoid *offsetVertex   = (const GLvoid *)offsetof(GSTerrainVertex, position);
-            const GLvoid *offsetTexCoord = (const GLvoid *)offsetof(GSTerrainVertex, texCoord);
-            const GLvoid *offsetColor    = (const GLvoid *)offsetof(GSTerrainVertex, color);
+            const GLvoid *offsetVertex    = (const GLvoid *)offsetof(GSTerrainVertex, position);
+            const GLvoid *offsetTexCoord  = (const GLvoid *)offsetof(GSTerrainVertex, texCoord);
+            const GLvoid *offsetLuminance = (const GLvoid *)offsetof(GSTerrainVertex, luminance);
             
+            // The fixed-function texture coordinate and color arrays cannot take the unsigned byte formats used
+            // here, so those are passed to the shader through generic attributes instead.
             const GLsizei stride = sizeof(GSTerrainVertex);
-            glVertexPointer(  3, GL_FLOAT,         stride, offsetVertex);
-            glTexCoordPointer(3, GL_FLOAT,         stride, offsetTexCoord);
-            glColorPointer(   4, GL_UNSIGNED_BYTE, stride, offsetColor);
+            glVertexPointer(3, GL_SHORT, stride, offsetVertex);
+            glVertexAttribPointer(GSTerrainVertexAttribTexCoord,  3, GL_UNSIGNED_BYTE, GL_FALSE, stride, offsetTexCoord);
+            glVertexAttribPointer(GSTerrainVertexAttribLuminance, 1, GL_UNSIGNED_BYTE, GL_TRUE,  stride, offsetLuminance);
 
             glBindVertexArrayAPPLE(0);
             
             _vao = [[GSVAOHolder alloc] initWithHandle:vao context:_glContext];
             
+            // The VAO keeps references to the buffers so they are released along with it.
+            glDeleteBuffers(1, &ibo);
             glDeleteBuffers(1, &vbo);
             
             assert(checkGLErrors() == 0);
@@ -151,21 +128,44 @@ typedef GLuint index_t;
         _initializedYet = YES;
         
         // don't need this anymore
-        free(_vertsBuffer);
         _vertsBuffer = NULL;
+        _indexBuffer = NULL;
+        _geometryBuffer = nil;
     }
 
     GLenum indexEnum;
-    if(2 == sizeof(index_t)) {
+    if(2 == sizeof(GSTerrainIndex)) {
         indexEnum = GL_UNSIGNED_SHORT;
-    } else if(4 == sizeof(index_t)) {
+    } else if(4 == sizeof(GSTerrainIndex)) {
         indexEnum = GL_UNSIGNED_INT;
     } else {
-        assert(!"I don't know the GLenum to use with index_t.");
+        assert(!"I don't know the GLenum to use with GSTerrainIndex.");
     }
 
+    // Vertex positions are chunk-relative. The chunk offset is a constant attribute and is not part of VAO state.
+    glVertexAttrib3f(GSTerrainVertexAttribChunkOffset, minP.x, minP.y, minP.z);
+
     glBindVertexArrayAPPLE(_vao.handle);
-    glDrawElements(GL_TRIANGLES, _numIndicesForDrawing, indexEnum, NULL);
+    glDrawElements(GL_TRIANGLES, _numSurfaceIndices, indexEnum, NULL);
+
+    // The skirts follow the surface, one side after another. Adjacent sides are merged into one draw call.
+    GLsizei first = _numSurfaceIndices, count = 0;
+    for(NSUInteger side = 0; side < GSNumChunkSides; ++side)
+    {
+        if (sides & (1u << side)) {
+            count += _numSkirtIndices[side];
+        } else {
+            if (count > 0) {
+                glDrawElements(GL_TRIANGLES, count, indexEnum, (const GLvoid *)(first * sizeof(GSTerrainIndex)));
+            }
+            first += count + _numSkirtIndices[side];
+            count = 0;
+        }
+    }
+    if (count > 0) {
+        glDrawElements(GL_TRIANGLES, count, indexEnum, (const GLvoid *)(first * sizeof(GSTerrainIndex)));
+    }
+
     glBindVertexArrayAPPLE(0);
     assert(checkGLErrors() == 0);
 }
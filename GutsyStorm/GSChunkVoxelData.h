@@ -10,19 +10,27 @@
 #import "GSGridItem.h"
 #import "GSIntegerVector3.h"
 #import "GSVoxel.h"
+#import "GSTerrainGeometryGenerator.h" // for GSSubchunkOccupancy
 
 
 @class GSTerrainJournal;
 @class GSTerrainBuffer;
 @class GSTerrainGenerator;
+@class GSTerrainTile;
 
 
 @interface GSChunkVoxelData : NSObject <GSGridItem>
 
 @property (nonatomic, readonly, nonnull) GSTerrainBuffer * voxels;
 
+/* Summary of the contents of each geometry sub-chunk, indexed by sub-chunk. */
+@property (nonatomic, readonly, nonnull) const GSSubchunkOccupancy * occupancy;
+
 + (nonnull NSString *)fileNameForVoxelDataFromMinP:(vector_float3)minP;
 
+/* Returns YES if the file at `url' exists and has a header which this build is able to load. */
++ (BOOL)canLoadVoxelDataFromURL:(nonnull NSURL *)url;
+
 - (nonnull instancetype)initWithMinP:(vector_float3)minP
                               folder:(nullable NSURL *)folder
                       groupForSaving:(nonnull dispatch_group_t)groupForSaving
@@ -31,6 +39,17 @@
                            generator:(nonnull GSTerrainGenerator *)generator
                         allowLoading:(BOOL)allowLoading;
 
+/* Like the above, except that if the chunk must be generated then its voxels are sliced out of `tile', which must
+ * contain the chunk.
+ */
+- (nonnull instancetype)initWithMinP:(vector_float3)minP
+                              folder:(nullable NSURL *)folder
+                      groupForSaving:(nonnull dispatch_group_t)groupForSaving
+                      queueForSaving:(nonnull dispatch_queue_t)queueForSaving
+                             journal:(nullable GSTerrainJournal *)journal
+                                tile:(nonnull GSTerrainTile *)tile
+                        allowLoading:(BOOL)allowLoading;
+
 - (nonnull instancetype)initWithMinP:(vector_float3)minP
                               folder:(nullable NSURL *)folder
                       groupForSaving:(nonnull dispatch_group_t)groupForSaving
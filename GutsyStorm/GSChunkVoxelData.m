@@ -18,6 +18,7 @@
 #import "GSTerrainJournal.h"
 #import "GSTerrainJournalEntry.h"
 #import "GSTerrainGenerator.h"
+#import "GSTerrainTile.h"
 #import "GSBox.h"
 #import "GSVectorUtils.h"
 
@@ -41,7 +42,7 @@ static void markOutsideVoxelsInColumn(GSVoxel * _Nonnull voxels, GSIntAABB voxel
 
 @interface GSChunkVoxelData ()
 
-- (BOOL)validateVoxelData:(nonnull NSData *)data error:(NSError **)error;
++ (BOOL)validateVoxelData:(nonnull NSData *)data error:(NSError **)error;
 
 - (void)markOutsideVoxels:(nonnull GSMutableBuffer *)data;
 
@@ -49,8 +50,19 @@ static void markOutsideVoxelsInColumn(GSVoxel * _Nonnull voxels, GSIntAABB voxel
                   editPos:(vector_float3)editPos
                  oldBlock:(GSVoxel)oldBlock;
 
-- (nonnull GSTerrainBuffer *)newTerrainBufferWithGenerator:(nonnull GSTerrainGenerator *)generator
-                                                   journal:(nonnull GSTerrainJournal *)journal;
+- (nonnull instancetype)initWithMinP:(vector_float3)minP
+                              folder:(nullable NSURL *)folder
+                      groupForSaving:(nonnull dispatch_group_t)groupForSaving
+                      queueForSaving:(nonnull dispatch_queue_t)queueForSaving
+                             journal:(nullable GSTerrainJournal *)journal
+                                tile:(nullable GSTerrainTile *)tile
+                           generator:(nullable GSTerrainGenerator *)generator
+                        allowLoading:(BOOL)allowLoading;
+
+- (nonnull GSTerrainBuffer *)newTerrainBufferWithTile:(nonnull GSTerrainTile *)tile
+                                              journal:(nonnull GSTerrainJournal *)journal;
+
+- (void)summarizeOccupancy;
 
 @end
 
@@ -60,6 +72,7 @@ static void markOutsideVoxelsInColumn(GSVoxel * _Nonnull voxels, GSIntAABB voxel
     NSURL *_folder;
     dispatch_group_t _groupForSaving;
     dispatch_queue_t _queueForSaving;
+    GSSubchunkOccupancy _occupancy[GSNumGeometrySubChunks];
 }
 
 @synthesize minP;
@@ -69,6 +82,18 @@ static void markOutsideVoxelsInColumn(GSVoxel * _Nonnull voxels, GSIntAABB voxel
     return [NSString stringWithFormat:@"%.0f_%.0f_%.0f.voxels.dat", minP.x, minP.y, minP.z];
 }
 
++ (BOOL)canLoadVoxelDataFromURL:(nonnull NSURL *)url
+{
+    NSParameterAssert(url);
+
+    // Only the header is needed to decide, so avoid reading the whole file.
+    NSFileHandle *file = [NSFileHandle fileHandleForReadingFromURL:url error:nil];
+    NSData *header = [file readDataOfLength:sizeof(struct GSChunkVoxelHeader)];
+    [file closeFile];
+
+    return (header.length == sizeof(struct GSChunkVoxelHeader)) && [self validateVoxelData:header error:nil];
+}
+
 - (nonnull instancetype)initWithMinP:(vector_float3)mp
                               folder:(nullable NSURL *)folder
                       groupForSaving:(nonnull dispatch_group_t)groupForSaving
@@ -76,10 +101,48 @@ static void markOutsideVoxelsInColumn(GSVoxel * _Nonnull voxels, GSIntAABB voxel
                              journal:(nullable GSTerrainJournal *)journal
                            generator:(nonnull GSTerrainGenerator *)generator
                         allowLoading:(BOOL)allowLoading
+{
+    return [self initWithMinP:mp
+                       folder:folder
+               groupForSaving:groupForSaving
+               queueForSaving:queueForSaving
+                      journal:journal
+                         tile:nil
+                    generator:generator
+                 allowLoading:allowLoading];
+}
+
+- (nonnull instancetype)initWithMinP:(vector_float3)mp
+                              folder:(nullable NSURL *)folder
+                      groupForSaving:(nonnull dispatch_group_t)groupForSaving
+                      queueForSaving:(nonnull dispatch_queue_t)queueForSaving
+                             journal:(nullable GSTerrainJournal *)journal
+                                tile:(nonnull GSTerrainTile *)tile
+                        allowLoading:(BOOL)allowLoading
+{
+    return [self initWithMinP:mp
+                       folder:folder
+               groupForSaving:groupForSaving
+               queueForSaving:queueForSaving
+                      journal:journal
+                         tile:tile
+                    generator:nil
+                 allowLoading:allowLoading];
+}
+
+- (nonnull instancetype)initWithMinP:(vector_float3)mp
+                              folder:(nullable NSURL *)folder
+                      groupForSaving:(nonnull dispatch_group_t)groupForSaving
+                      queueForSaving:(nonnull dispatch_queue_t)queueForSaving
+                             journal:(nullable GSTerrainJournal *)journal
+                                tile:(nullable GSTerrainTile *)tile
+                           generator:(nullable GSTerrainGenerator *)generator
+                        allowLoading:(BOOL)allowLoading
 {
     NSParameterAssert(groupForSaving);
     NSParameterAssert(queueForSaving);
-    NSParameterAssert(generator);
+    NSParameterAssert(tile || generator);
+    NSParameterAssert(!tile || [tile containsPoint:mp]);
     NSParameterAssert(CHUNK_LIGHTING_MAX < MIN(CHUNK_SIZE_X, CHUNK_SIZE_Z));
 
     if (self = [super init]) {
@@ -120,7 +183,7 @@ static void markOutsideVoxelsInColumn(GSVoxel * _Nonnull voxels, GSIntAABB voxel
                     NSLog(@"ERROR: Failed to load voxel data for chunk at \"%@\": %@", fileName, error);
                 }
             }
-        } else if (![self validateVoxelData:data error:&error]) {
+        } else if (![[self class] validateVoxelData:data error:&error]) {
              NSLog(@"ERROR: Failed to validate the voxel data file at \"%@\": %@", fileName, error);
         } else {
             const struct GSChunkVoxelHeader * restrict header = [data bytes];
@@ -131,7 +194,12 @@ static void markOutsideVoxelsInColumn(GSVoxel * _Nonnull voxels, GSIntAABB voxel
         }
 
         if (failedToLoadFromFile) {
-            buffer = [self newTerrainBufferWithGenerator:generator journal:effectiveJournal];
+            // Without a tile, generate a tile of just this one chunk.
+            if (!tile) {
+                tile = [[GSTerrainTile alloc] initWithMinP:minP chunksX:1 chunksZ:1 generator:generator];
+            }
+
+            buffer = [self newTerrainBufferWithTile:tile journal:effectiveJournal];
             struct GSChunkVoxelHeader header = {
                 .magic = VOXEL_MAGIC,
                 .version = VOXEL_VERSION,
@@ -156,6 +224,7 @@ static void markOutsideVoxelsInColumn(GSVoxel * _Nonnull voxels, GSIntAABB voxel
         }
 
         _voxels = buffer;
+        [self summarizeOccupancy];
 
         GSStopwatchTraceStep(@"Done initializing voxel chunk %@", [GSBoxedVector boxedVectorWithVector:mp]);
     }
@@ -182,6 +251,7 @@ static void markOutsideVoxelsInColumn(GSVoxel * _Nonnull voxels, GSIntAABB voxel
                         editPos:editPos
                        oldBlock:oldBlock];
         _voxels = dataWithUpdatedOutside;
+        [self summarizeOccupancy];
     }
     
     return self;
@@ -192,7 +262,7 @@ static void markOutsideVoxelsInColumn(GSVoxel * _Nonnull voxels, GSIntAABB voxel
     return self; // all voxel data objects are immutable, so return self instead of deep copying
 }
 
-- (BOOL)validateVoxelData:(nonnull NSData *)data error:(NSError **)error
++ (BOOL)validateVoxelData:(nonnull NSData *)data error:(NSError **)error
 {
     NSParameterAssert(data);
     
@@ -257,6 +327,17 @@ static void markOutsideVoxelsInColumn(GSVoxel * _Nonnull voxels, GSIntAABB voxel
     return YES;
 }
 
+- (nonnull const GSSubchunkOccupancy *)occupancy
+{
+    return _occupancy;
+}
+
+- (void)summarizeOccupancy
+{
+    GSIntAABB chunkBox = { GSZeroIntVec3, GSChunkSizeIntVec3 };
+    GSTerrainGeometryComputeOccupancy((const GSVoxel *)[_voxels data], chunkBox, GSZeroIntVec3, _occupancy);
+}
+
 - (GSVoxel)voxelAtLocalPosition:(vector_long3)p
 {
     assert(p.x >= 0 && p.x < CHUNK_SIZE_X);
@@ -304,39 +385,21 @@ static void markOutsideVoxelsInColumn(GSVoxel * _Nonnull voxels, GSIntAABB voxel
 /* Computes voxelData which represents the voxel terrain values for the points between minP and maxP. The chunk is
  * translated so that voxelData[0,0,0] corresponds to (minX, minY, minZ). The size of the chunk is unscaled so that,
  * for example, the width of the chunk is equal to maxP-minP. Ditto for the other major axii.
+ * The voxels are sliced out of `tile', which has already been generated.
  */
-- (nonnull GSTerrainBuffer *)newTerrainBufferWithGenerator:(nonnull GSTerrainGenerator *)generator
-                                                   journal:(nonnull GSTerrainJournal *)journal
+- (nonnull GSTerrainBuffer *)newTerrainBufferWithTile:(nonnull GSTerrainTile *)tile
+                                              journal:(nonnull GSTerrainJournal *)journal
 {
     vector_float3 thisMinP = self.minP;
-    vector_long3 p;
-    vector_long3 border = (vector_long3){2, 0, 2};
     GSIntAABB chunkBox = { .mins = GSZeroIntVec3, .maxs = GSChunkSizeIntVec3};
-    GSIntAABB box = { .mins = chunkBox.mins - border, .maxs = chunkBox.maxs + border};
-
-    const size_t count = (box.maxs.x-box.mins.x) * (box.maxs.y-box.mins.y) * (box.maxs.z-box.mins.z);
-    GSVoxel *voxels = malloc(count * sizeof(GSVoxel));
-
-    if (!voxels) {
-        [NSException raise:NSMallocException format:@"Out of memory allocating voxels in -newTerrainBufferWithGenerator:."];
-    }
-
-    // Generate voxels for the region of the chunk, plus a 1 block wide border.
-    // Note that whether the block is outside or not is calculated later.
-    [generator generateWithDestination:voxels count:count region:&box offsetToWorld:thisMinP];
 
     GSMutableBuffer *data;
     
     // Copy the voxels for the chunk to their final destination.
+    // Note that whether the block is outside or not is calculated later.
     data = [[GSMutableBuffer alloc] initWithDimensions:GSChunkSizeIntVec3];
     GSVoxel *buf = (GSVoxel *)[data mutableData];
-
-    FOR_Y_COLUMN_IN_BOX(p, chunkBox)
-    {
-        memcpy(&buf[INDEX_BOX(p, chunkBox)], &voxels[INDEX_BOX(p, box)], chunkBox.maxs.y * sizeof(GSVoxel));
-    }
-
-    free(voxels);
+    [tile copyVoxelsForChunkAtPoint:thisMinP destination:buf];
     
     // Scan the journal and apply any changes found which affect this chunk.
     if (journal) {
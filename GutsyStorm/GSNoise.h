@@ -9,6 +9,13 @@
 #import <Foundation/Foundation.h>
 #include <simd/simd.h>
 
+/* Bounds on a single octave of noise. Each of the four corners of a simplex contributes at most
+ * 16 * max((0.6 - r^2)^4 * sqrt(2) * r) = 0.4727 to the noise, in either direction, about a midpoint of 0.5.
+ * Actual values are rarely far outside the range [0, 1], but these bounds are guaranteed.
+ */
+#define GSNoiseMinValue (0.5f - 1.891f)
+#define GSNoiseMaxValue (0.5f + 1.891f)
+
 @interface GSNoise : NSObject
 
 - (nonnull instancetype)initWithSeed:(NSUInteger)seed;
@@ -16,4 +23,18 @@
 - (float)noiseAtPoint:(vector_float3)p numOctaves:(NSUInteger)numOctaves;
 - (float)noiseAtPointWithFourOctaves:(vector_float3)p;
 
+/* Batch versions of the above, which evaluate noise at `count' points and write one result per point. These are much
+ * faster than calling the single point methods in a loop, so generate a whole column of points at a time.
+ */
+- (void)noiseAtPoints:(nonnull const vector_float3 *)points
+              results:(nonnull float *)results
+                count:(NSUInteger)count;
+- (void)noiseAtPoints:(nonnull const vector_float3 *)points
+           numOctaves:(NSUInteger)numOctaves
+              results:(nonnull float *)results
+                count:(NSUInteger)count;
+- (void)noiseWithFourOctavesAtPoints:(nonnull const vector_float3 *)points
+                             results:(nonnull float *)results
+                               count:(NSUInteger)count;
+
 @end
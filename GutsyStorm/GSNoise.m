@@ -68,4 +68,27 @@
     return noise;
 }
 
+- (void)noiseAtPoints:(nonnull const vector_float3 *)points
+              results:(nonnull float *)results
+                count:(NSUInteger)count
+{
+    FeepingCreature_noise3_batch(points, results, count, _context);
+}
+
+- (void)noiseAtPoints:(nonnull const vector_float3 *)points
+           numOctaves:(NSUInteger)numOctaves
+              results:(nonnull float *)results
+                count:(NSUInteger)count
+{
+    assert(numOctaves < UINT_MAX);
+    FeepingCreature_noise3_octaves_batch(points, results, count, (unsigned)numOctaves, 0.5f, _context);
+}
+
+- (void)noiseWithFourOctavesAtPoints:(nonnull const vector_float3 *)points
+                             results:(nonnull float *)results
+                               count:(NSUInteger)count
+{
+    FeepingCreature_noise3_octaves_batch(points, results, count, 4, 0.5f, _context);
+}
+
 @end
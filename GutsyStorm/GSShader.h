@@ -13,6 +13,14 @@
 
 - (nonnull instancetype)initWithVertexShaderSource:(nonnull NSString *)vert
                                fragmentShaderSource:(nonnull NSString *)frag;
+
+/* Creates a shader program, binding the named vertex attributes to the given generic attribute indices before the
+ * program is linked.
+ */
+- (nonnull instancetype)initWithVertexShaderSource:(nonnull NSString *)vert
+                               fragmentShaderSource:(nonnull NSString *)frag
+                                 attributeLocations:(nullable NSDictionary<NSString *, NSNumber *> *)attributeLocations;
+
 - (void)bind;
 - (void)unbind;
 - (void)bindUniformWithInt:(int)value name:(nonnull NSString *)name;
@@ -37,7 +37,14 @@ extern int checkGLErrors(void);
 }
 
 - (nonnull instancetype)initWithVertexShaderSource:(nonnull NSString *)vert
-                               fragmentShaderSource:(nonnull NSString *)frag;
+                               fragmentShaderSource:(nonnull NSString *)frag
+{
+    return [self initWithVertexShaderSource:vert fragmentShaderSource:frag attributeLocations:nil];
+}
+
+- (nonnull instancetype)initWithVertexShaderSource:(nonnull NSString *)vert
+                               fragmentShaderSource:(nonnull NSString *)frag
+                                 attributeLocations:(nullable NSDictionary<NSString *, NSNumber *> *)attributeLocations
 {
     self = [super init];
     if (self) {
@@ -47,6 +54,12 @@ extern int checkGLErrors(void);
         
         [self createShaderWithSource:vert type:GL_VERTEX_SHADER];
         [self createShaderWithSource:frag type:GL_FRAGMENT_SHADER];
+
+        // Attribute locations only take effect at the next link, so these must be bound first.
+        [attributeLocations enumerateKeysAndObjectsUsingBlock:^(NSString *name, NSNumber *index, BOOL *stop) {
+            glBindAttribLocation(_handle, [index unsignedIntValue], [name cStringUsingEncoding:NSASCIIStringEncoding]);
+        }];
+
         [self link];
         assert(checkGLErrors() == 0);
     }
@@ -18,12 +18,13 @@
  */
 @property (nonatomic, nullable, retain) GSVoxelNeighborhood *voxelNeighborhood;
 
-/* Generate and return sunlight data for the entire voxel neighborhood, taking into account a modification made at the
- * specified point. Leverages existing sunlight values in neighboring sunlight chunks to ensure that chunk sunlight is
- * correct for the entire neighborhood.
+/* Generate and return light data for the specified channel for the entire voxel neighborhood, taking into account a
+ * modification made at the specified point. Leverages existing light values in neighboring sunlight chunks to ensure
+ * that chunk light is correct for the entire neighborhood.
  */
-- (nonnull GSTerrainBuffer *)newSunlightBufferWithEditAtPoint:(vector_float3)editPos
-                                                removingLight:(BOOL)mode
-                                               affectedRegion:(GSIntAABB * _Nullable)affectedRegion;
+- (nonnull GSTerrainBuffer *)newLightBufferForChannel:(GSLightChannel)channel
+                                      withEditAtPoint:(vector_float3)editPos
+                                        removingLight:(BOOL)mode
+                                       affectedRegion:(GSIntAABB * _Nullable)affectedRegion;
 
 @end
@@ -8,12 +8,14 @@
 
 #import "GSSunlightNeighborhood.h"
 #import "GSSunlightUtils.h"
+#import "GSTerrainLightBuffer.h"
 #import "GSAABB.h"
 #import "GSBox.h"
 
 @implementation GSSunlightNeighborhood
 
-- (nonnull GSTerrainBufferElement *)newSunlightBufferReturningCount:(size_t *)outCount
+- (nonnull GSTerrainBufferElement *)newLightBufferForChannel:(GSLightChannel)channel
+                                             returningCount:(size_t *)outCount
 {
     vector_long3 border = {1, 0, 1};
     GSIntAABB nSunBox;
@@ -24,9 +26,9 @@
     size_t count = nSunDim.x * nSunDim.y * nSunDim.z;
 
     // Allocate a buffer large enough to hold a copy of the entire neighborhood's voxels
-    GSTerrainBufferElement *combinedSunlightData = malloc(count*sizeof(GSTerrainBufferElement));
-    if(!combinedSunlightData) {
-        [NSException raise:NSMallocException format:@"Failed to allocate memory for combinedSunlightData."];
+    GSTerrainBufferElement *combinedLightData = malloc(count*sizeof(GSTerrainBufferElement));
+    if(!combinedLightData) {
+        [NSException raise:NSMallocException format:@"Failed to allocate memory for combinedLightData."];
     }
     
     static long offsetsX[CHUNK_NUM_NEIGHBORS];
@@ -45,13 +47,14 @@
     for(GSVoxelNeighborIndex i = 0; i < CHUNK_NUM_NEIGHBORS; ++i)
     {
         GSChunkSunlightData *neighbor = (GSChunkSunlightData *)[self neighborAtIndex:i];
-        GSTerrainBufferElement *srcData = [neighbor.sunlight data];
-        vector_long3 srcDim = neighbor.sunlight.dimensions;
+        GSTerrainLightBuffer *light = [neighbor lightBufferForChannel:channel];
+        const uint8_t *srcData = [light packedData];
+        vector_long3 srcDim = light.dimensions;
 
         vector_long3 offset = { offsetsX[i], 0, offsetsZ[i] };
 
         GSIntAABB neighborBox;
-        neighborBox.mins = -(neighbor.sunlight.offsetFromChunkLocalSpace);
+        neighborBox.mins = -(light.offsetFromChunkLocalSpace);
         neighborBox.maxs = neighborBox.mins + srcDim;
         
         vector_long3 p;
@@ -63,7 +66,7 @@
             assert(dstIdx < count);
             assert(srcIdx < (srcDim.x * srcDim.y * srcDim.z));
 
-            memcpy(&combinedSunlightData[dstIdx], &srcData[srcIdx], srcDim.y * sizeof(combinedSunlightData[0]));
+            GSLightBufferUnpack(&combinedLightData[dstIdx], srcData, srcIdx, srcDim.y);
         }
     }
     
@@ -71,12 +74,13 @@
         *outCount = count;
     }
     
-    return combinedSunlightData;
+    return combinedLightData;
 }
 
-- (nonnull GSTerrainBuffer *)newSunlightBufferWithEditAtPoint:(vector_float3)editPos
-                                                removingLight:(BOOL)removingLight
-                                               affectedRegion:(GSIntAABB * _Nullable)outAffectedBox
+- (nonnull GSTerrainBuffer *)newLightBufferForChannel:(GSLightChannel)channel
+                                      withEditAtPoint:(vector_float3)editPos
+                                        removingLight:(BOOL)removingLight
+                                       affectedRegion:(GSIntAABB * _Nullable)outAffectedBox
 {
     static const int blurSize = CHUNK_LIGHTING_MAX + 1;
     static const vector_long3 border = (vector_long3){1, 0, 1};
@@ -88,20 +92,19 @@
     nSunBox.maxs = voxelBox.maxs + border;
 
     vector_long3 nSunDim = nSunBox.maxs - nSunBox.mins;
-    vector_long3 p; // loop counter
     
     size_t voxelCount = 0;
     GSVoxel *voxels = [self.voxelNeighborhood newVoxelBufferReturningCount:&voxelCount];
     
-    // Populate the sunlight buffer with existing sunlight values from all the neighboring chunks.
+    // Populate the light buffer with existing light values from all the neighboring chunks.
     size_t nSunCount;
-    GSTerrainBufferElement *sunlight = [self newSunlightBufferReturningCount:&nSunCount];
+    GSTerrainBufferElement *light = [self newLightBufferForChannel:channel returningCount:&nSunCount];
 
-    // Clear sunlight values in the region affected by the edit.
     GSChunkSunlightData *center = [self neighborAtIndex:CHUNK_NEIGHBOR_CENTER];
     assert(center);
     vector_long3 editPosClp = vector_long(editPos - center.minP);
     
+    // Light can change no further from the edit than the distance light travels.
     GSIntAABB workBox;
     workBox.mins = editPosClp - GSMakeIntegerVector3(blurSize, 0, blurSize);
     workBox.mins.y = 0;
@@ -109,37 +112,14 @@
     workBox.maxs = editPosClp + GSMakeIntegerVector3(blurSize, blurSize, blurSize);
     workBox.maxs.y = MIN(workBox.maxs.y, GSChunkSizeIntVec3.y);
 
-    // If we're removing light then we need to zero out the blur region first.
-    if (removingLight) {
-        GSIntAABB adjustedWorkBox = { .mins = workBox.mins + border, .maxs = workBox.maxs - border };
-        FOR_BOX(p, adjustedWorkBox)
-        {
-            size_t srcIdx = INDEX_BOX(p, nSunBox);
-            assert(srcIdx < (nSunDim.x * nSunDim.y * nSunDim.z));
-            sunlight[srcIdx] = 0;
-        }
-    }
-
-    GSSunlightSeed(voxels, voxelCount, voxelBox,
-                   sunlight, nSunCount, nSunBox,
-                   workBox);
-
     GSIntAABB affectedBox;
-    GSSunlightBlur(voxels, voxelCount, voxelBox,
-                   sunlight, nSunCount, nSunBox,
-                   workBox,
-                   editPosClp,
-                   &affectedBox);
-    
-    // If sunlight was already in equilibrium state when we performed the sunlight blur then set the
-    // affected area to a 3x3x3 cube surrounding the edit point. This will ensure geometry gets updated later.
-    if((affectedBox.maxs.x <= affectedBox.mins.x) || (affectedBox.maxs.y <= affectedBox.mins.y) || (affectedBox.maxs.z <= affectedBox.mins.z)) {
-        affectedBox.mins = editPosClp - GSMakeIntegerVector3(1, 1, 1);
-        affectedBox.mins.y = MAX(affectedBox.mins.y, 0);
-        
-        affectedBox.maxs = editPosClp + GSMakeIntegerVector3(1, 1, 1);
-        affectedBox.maxs.y = MIN(affectedBox.maxs.y, GSChunkSizeIntVec3.y);
-    }
+    GSSunlightUpdateForEdit(channel,
+                            voxels, voxelCount, voxelBox,
+                            light, nSunCount, nSunBox,
+                            workBox,
+                            editPosClp,
+                            removingLight,
+                            &affectedBox);
 
     assert(GSIntAABBPointInBox(affectedBox, editPosClp));
 
@@ -149,9 +129,9 @@
 
     free(voxels);
     
-    GSTerrainBuffer *result = [[GSTerrainBuffer alloc] initWithDimensions:nSunDim copyUnalignedData:sunlight];
+    GSTerrainBuffer *result = [[GSTerrainBuffer alloc] initWithDimensions:nSunDim copyUnalignedData:light];
     
-    free(sunlight);
+    free(light);
     
     return result;
 }
@@ -0,0 +1,52 @@
+//
+//  GSSunlightRegion.h
+//  GutsyStorm
+//
+//  Created by agent on 10/18/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <simd/vector.h>
+#import "GSVoxel.h"
+
+
+@class GSChunkVoxelData;
+@class GSVoxelNeighborhood;
+@class GSTerrainLightBuffer;
+
+
+/* Lights a rectangular tile of adjacent chunk columns in a single pass.
+ *
+ * Lighting one chunk requires lighting a box which extends CHUNK_LIGHTING_MAX+1 voxels past the chunk on each side.
+ * When chunks are lit one at a time, each voxel ends up being lit about nine times by the overlapping solves of the
+ * surrounding chunks. A region lights each voxel once and then slices out the light for each chunk. The light for a
+ * chunk is identical to the light produced by -[GSVoxelNeighborhood newLightBufferForChannel:] for that chunk.
+ */
+@interface GSSunlightRegion : NSObject
+
+/* The min corner of the chunk at the min corner of the region. */
+@property (nonatomic, readonly) vector_float3 minP;
+
+/* The size of the region in chunks. */
+@property (nonatomic, readonly) long chunksX;
+@property (nonatomic, readonly) long chunksZ;
+
+/* Initialize and light the region. The block is used to fetch voxels for each chunk in the region as well as for
+ * each chunk which borders the region.
+ */
+- (nonnull instancetype)initWithMinP:(vector_float3)minP
+                             chunksX:(long)chunksX
+                             chunksZ:(long)chunksZ
+                       voxelsAtPoint:(GSChunkVoxelData * _Nonnull (^ _Nonnull)(vector_float3 p))voxelsAtPoint;
+
+/* Returns YES if the chunk which contains the specified point lies within the region. */
+- (BOOL)containsPoint:(vector_float3)p;
+
+/* Returns the voxel neighborhood of the chunk which contains the specified point. */
+- (nonnull GSVoxelNeighborhood *)neighborhoodForChunkAtPoint:(vector_float3)p;
+
+/* Returns light in the specified channel for the chunk which contains the specified point. */
+- (nonnull GSTerrainLightBuffer *)lightBufferForChannel:(GSLightChannel)channel chunkAtPoint:(vector_float3)p;
+
+@end
@@ -0,0 +1,247 @@
+//
+//  GSSunlightRegion.m
+//  GutsyStorm
+//
+//  Created by agent on 10/18/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#import "GSSunlightRegion.h"
+#import "GSChunkVoxelData.h"
+#import "GSVoxelNeighborhood.h"
+#import "GSTerrainLightBuffer.h"
+#import "GSSunlightUtils.h"
+#import "GSActivity.h"
+#import "GSBox.h"
+
+
+@implementation GSSunlightRegion
+{
+    /* Voxels for each chunk in the region plus a border of one chunk all the way around.
+     * Chunks are ordered by x and then by z.
+     */
+    NSArray<GSChunkVoxelData *> *_voxelChunks;
+
+    /* Light for each chunk in the region, for each light channel. Chunks are ordered by x and then by z. */
+    NSArray<GSTerrainLightBuffer *> *_light[NUM_LIGHT_CHANNELS];
+}
+
+- (nonnull instancetype)init NS_UNAVAILABLE
+{
+    @throw nil;
+}
+
+- (nonnull instancetype)initWithMinP:(vector_float3)minP
+                             chunksX:(long)chunksX
+                             chunksZ:(long)chunksZ
+                       voxelsAtPoint:(GSChunkVoxelData * _Nonnull (^ _Nonnull)(vector_float3 p))voxelsAtPoint
+{
+    NSParameterAssert(chunksX > 0 && chunksZ > 0);
+    NSParameterAssert(voxelsAtPoint);
+    NSParameterAssert(vector_equal(GSMinCornerForChunkAtPoint(minP), minP));
+
+    if (self = [super init]) {
+        _minP = minP;
+        _chunksX = chunksX;
+        _chunksZ = chunksZ;
+
+        NSMutableArray<GSChunkVoxelData *> *voxelChunks = [NSMutableArray new];
+        for(long x = -1; x <= chunksX; ++x)
+        {
+            for(long z = -1; z <= chunksZ; ++z)
+            {
+                vector_float3 p = minP + (vector_float3){x * CHUNK_SIZE_X, 0, z * CHUNK_SIZE_Z};
+                [voxelChunks addObject:voxelsAtPoint(p)];
+            }
+        }
+        _voxelChunks = voxelChunks;
+
+        [self generateLight];
+    }
+
+    return self;
+}
+
+/* Returns the voxels of the chunk at the specified chunk coordinates, relative to the min corner of the region.
+ * Coordinates may refer to the chunks which border the region.
+ */
+- (nonnull GSChunkVoxelData *)voxelChunkAtX:(long)x z:(long)z
+{
+    assert(x >= -1 && x <= _chunksX);
+    assert(z >= -1 && z <= _chunksZ);
+    return _voxelChunks[(x + 1) * (_chunksZ + 2) + (z + 1)];
+}
+
+/* Returns the coordinates of the chunk which contains the specified point, relative to the min corner of the region. */
+- (vector_long3)chunkCoordinatesForPoint:(vector_float3)p
+{
+    vector_float3 offset = GSMinCornerForChunkAtPoint(p) - _minP;
+    return (vector_long3){ offset.x / CHUNK_SIZE_X, 0, offset.z / CHUNK_SIZE_Z };
+}
+
+- (BOOL)containsPoint:(vector_float3)p
+{
+    vector_long3 c = [self chunkCoordinatesForPoint:p];
+    return c.x >= 0 && c.x < _chunksX && c.z >= 0 && c.z < _chunksZ;
+}
+
+- (nonnull GSVoxelNeighborhood *)neighborhoodForChunkAtPoint:(vector_float3)p
+{
+    NSParameterAssert([self containsPoint:p]);
+
+    vector_long3 c = [self chunkCoordinatesForPoint:p];
+    GSVoxelNeighborhood *neighborhood = [[GSVoxelNeighborhood alloc] init];
+
+    for(GSVoxelNeighborIndex i = 0; i < CHUNK_NUM_NEIGHBORS; ++i)
+    {
+        vector_float3 offset = [GSNeighborhood offsetForNeighborIndex:i];
+        long x = c.x + (long)offset.x / CHUNK_SIZE_X;
+        long z = c.z + (long)offset.z / CHUNK_SIZE_Z;
+        [neighborhood setNeighborAtIndex:i neighbor:[self voxelChunkAtX:x z:z]];
+    }
+
+    return neighborhood;
+}
+
+- (nonnull GSTerrainLightBuffer *)lightBufferForChannel:(GSLightChannel)channel chunkAtPoint:(vector_float3)p
+{
+    NSParameterAssert(channel < NUM_LIGHT_CHANNELS);
+    NSParameterAssert([self containsPoint:p]);
+
+    vector_long3 c = [self chunkCoordinatesForPoint:p];
+    return _light[channel][c.x * _chunksZ + c.z];
+}
+
+/* Return a buffer containing the voxels for the region and its border, for the specified box.
+ * It is the responsibility of the caller to free this memory.
+ */
+- (nonnull GSVoxel *)newVoxelBufferWithBox:(GSIntAABB)voxelBox count:(nonnull size_t *)outCount
+{
+    assert(outCount);
+
+    vector_long3 dim = voxelBox.maxs - voxelBox.mins;
+    size_t count = dim.x * dim.y * dim.z;
+    GSIntAABB chunkBox = {GSZeroIntVec3, GSChunkSizeIntVec3};
+
+    GSVoxel *combinedVoxelData = malloc(count * sizeof(GSVoxel));
+    if(!combinedVoxelData) {
+        [NSException raise:NSMallocException format:@"Failed to allocate memory for combinedVoxelData."];
+    }
+
+    for(long x = -1; x <= _chunksX; ++x)
+    {
+        for(long z = -1; z <= _chunksZ; ++z)
+        {
+            GSChunkVoxelData *chunk = [self voxelChunkAtX:x z:z];
+            const GSVoxel *data = (const GSVoxel *)[chunk.voxels data];
+            vector_long3 offset = {x * CHUNK_SIZE_X, 0, z * CHUNK_SIZE_Z};
+
+            vector_long3 p;
+            FOR_Y_COLUMN_IN_BOX(p, chunkBox)
+            {
+                size_t dstIdx = INDEX_BOX(p + offset, voxelBox);
+                size_t srcIdx = INDEX_BOX(p, chunkBox);
+
+                assert(dstIdx < count);
+                assert(srcIdx < (CHUNK_SIZE_X*CHUNK_SIZE_Y*CHUNK_SIZE_Z));
+
+                memcpy(&combinedVoxelData[dstIdx], &data[srcIdx], CHUNK_SIZE_Y*sizeof(combinedVoxelData[0]));
+            }
+        }
+    }
+
+    *outCount = count;
+    return combinedVoxelData;
+}
+
+- (void)generateLight
+{
+    GSStopwatchTraceStep(@"GSSunlightRegion generateLight enter");
+
+    vector_long3 regionSize = {_chunksX * CHUNK_SIZE_X, CHUNK_SIZE_Y, _chunksZ * CHUNK_SIZE_Z};
+    vector_long3 chunkBorder = {CHUNK_SIZE_X, 0, CHUNK_SIZE_Z};
+    vector_long3 oneBorder = {1, 0, 1};
+    vector_long3 lightBorder = (vector_long3){CHUNK_LIGHTING_MAX, 0, CHUNK_LIGHTING_MAX} + oneBorder;
+
+    // Positions are relative to the min corner of the region. Light is computed over the same margin around the
+    // region as the per-chunk calculation uses around a single chunk, so the results match exactly.
+    GSIntAABB voxelBox = { .mins = -chunkBorder, .maxs = regionSize + chunkBorder };
+    GSIntAABB lightBox = { .mins = -lightBorder, .maxs = regionSize + lightBorder };
+
+    size_t voxelCount = 0;
+    GSVoxel *voxels = [self newVoxelBufferWithBox:voxelBox count:&voxelCount];
+
+    vector_long3 lightDim = lightBox.maxs - lightBox.mins;
+    size_t lightCount = lightDim.x * lightDim.y * lightDim.z;
+    GSTerrainBufferElement *light = malloc(lightCount * sizeof(GSTerrainBufferElement));
+    if (!light) {
+        [NSException raise:NSMallocException format:@"Failed to allocate memory for the region's light."];
+    }
+
+    // Each chunk's light buffer includes a one voxel border, just like GSChunkSunlightData expects.
+    vector_long3 chunkLightDim = GSChunkSizeIntVec3 + 2*oneBorder;
+    GSIntAABB chunkLightBox = { GSZeroIntVec3, chunkLightDim };
+    GSTerrainBufferElement *chunkLight = malloc(BUFFER_SIZE_IN_BYTES(chunkLightDim));
+    if (!chunkLight) {
+        [NSException raise:NSMallocException format:@"Failed to allocate memory for a chunk's light."];
+    }
+
+    for(GSLightChannel channel = 0; channel < NUM_LIGHT_CHANNELS; ++channel)
+    {
+        bzero(light, lightCount * sizeof(GSTerrainBufferElement));
+
+        size_t numSources = GSSunlightSeed(channel,
+                                           voxels, voxelCount, voxelBox,
+                                           light, lightCount, lightBox,
+                                           lightBox);
+
+        GSIntAABB blurBox = lightBox;
+
+        if (channel == LIGHT_CHANNEL_SUN) {
+            blurBox.maxs.y = GSFindElevationOfHighestOpaqueBlock(voxels, voxelCount, voxelBox);
+        }
+
+        if (numSources > 0) {
+            GSSunlightBlur(channel,
+                           voxels, voxelCount, voxelBox,
+                           light, lightCount, lightBox,
+                           blurBox,
+                           GSZeroIntVec3, // Pass zero because we don't care.
+                           NULL);
+        }
+
+        NSMutableArray<GSTerrainLightBuffer *> *buffers = [NSMutableArray new];
+
+        for(long x = 0; x < _chunksX; ++x)
+        {
+            for(long z = 0; z < _chunksZ; ++z)
+            {
+                vector_long3 srcMins = (vector_long3){x * CHUNK_SIZE_X, 0, z * CHUNK_SIZE_Z} - oneBorder;
+
+                vector_long3 p;
+                FOR_Y_COLUMN_IN_BOX(p, chunkLightBox)
+                {
+                    size_t srcIdx = INDEX_BOX(p + srcMins, lightBox);
+                    size_t dstIdx = INDEX_BOX(p, chunkLightBox);
+
+                    assert(srcIdx < lightCount);
+
+                    memcpy(&chunkLight[dstIdx], &light[srcIdx], chunkLightDim.y * sizeof(GSTerrainBufferElement));
+                }
+
+                [buffers addObject:[[GSTerrainLightBuffer alloc] initWithDimensions:chunkLightDim
+                                                                        packingData:chunkLight]];
+            }
+        }
+
+        _light[channel] = buffers;
+    }
+
+    free(chunkLight);
+    free(light);
+    free(voxels);
+
+    GSStopwatchTraceStep(@"GSSunlightRegion generateLight exit");
+}
+
+@end
@@ -12,18 +12,41 @@
 
 long GSFindElevationOfHighestOpaqueBlock(GSVoxel * _Nonnull voxels, size_t voxelCount, GSIntAABB voxelBox);
 
-void GSSunlightSeed(GSVoxel * _Nonnull voxels, size_t voxelCount, GSIntAABB voxelBox,
-                    GSTerrainBufferElement * _Nonnull sunlight, size_t sunCount, GSIntAABB sunlightBox,
-                    GSIntAABB seedBox);
+/* Returns YES if the voxel emits light at CHUNK_LIGHTING_MAX in the specified light channel. */
+static inline BOOL GSLightIsSource(GSVoxel voxel, GSLightChannel channel)
+{
+    if (voxel.opaque) {
+        return NO;
+    }
+
+    return (channel == LIGHT_CHANNEL_SUN) ? voxel.outside : voxel.torch;
+}
+
+/* Sets light to the maximum level for light sources in the seed box. Returns the number of light sources found.
+ * These functions all work on a single light channel; the name is historical.
+ */
+size_t GSSunlightSeed(GSLightChannel channel,
+                      GSVoxel * _Nonnull voxels, size_t voxelCount, GSIntAABB voxelBox,
+                      GSTerrainBufferElement * _Nonnull sunlight, size_t sunCount, GSIntAABB sunlightBox,
+                      GSIntAABB seedBox);
 
-void GSSunlightBlur(GSVoxel * _Nonnull voxels, size_t voxelCount, GSIntAABB voxelBox,
+void GSSunlightBlur(GSLightChannel channel,
+                    GSVoxel * _Nonnull voxels, size_t voxelCount, GSIntAABB voxelBox,
                     GSTerrainBufferElement * _Nonnull sunlight, size_t sunCount, GSIntAABB sunlightBox,
                     GSIntAABB blurBox,
                     vector_long3 editPosClp,
                     GSIntAABB * _Nullable outAffectedRegion);
 
-BOOL GSSunlightAdjacent(vector_long3 p, int lightLevel,
-                        GSVoxel * _Nonnull voxels, size_t voxCount,
-                        GSIntAABB voxelBox,
-                        GSTerrainBufferElement * _Nonnull sunlight, size_t sunCount,
-                        GSIntAABB sunlightBox);
+/* Incrementally update sunlight after an edit at `editPosClp'. The sunlight buffer must hold light which was in
+ * equilibrium with the voxels before the edit, and `voxels' must hold voxels after the edit. Light which depended on
+ * voxels that are no longer lit is removed, then light is refilled from the surrounding voxels. Only voxels in the
+ * work box may have their light changed. Returns a region bounding the voxels whose light changed, grown by one
+ * voxel in each direction, in `outAffectedRegion'.
+ */
+void GSSunlightUpdateForEdit(GSLightChannel channel,
+                             GSVoxel * _Nonnull voxels, size_t voxelCount, GSIntAABB voxelBox,
+                             GSTerrainBufferElement * _Nonnull sunlight, size_t sunCount, GSIntAABB sunlightBox,
+                             GSIntAABB workBox,
+                             vector_long3 editPosClp,
+                             BOOL removingLight,
+                             GSIntAABB * _Nullable outAffectedRegion);
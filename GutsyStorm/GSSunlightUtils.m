@@ -34,9 +34,10 @@ long GSFindElevationOfHighestOpaqueBlock(GSVoxel * _Nonnull voxels, size_t voxel
     return highest;
 }
 
-void GSSunlightSeed(GSVoxel * _Nonnull voxels, size_t voxelCount, GSIntAABB voxelBox,
-                    GSTerrainBufferElement * _Nonnull sunlight, size_t sunCount, GSIntAABB sunlightBox,
-                    GSIntAABB seedBox)
+size_t GSSunlightSeed(GSLightChannel channel,
+                      GSVoxel * _Nonnull voxels, size_t voxelCount, GSIntAABB voxelBox,
+                      GSTerrainBufferElement * _Nonnull sunlight, size_t sunCount, GSIntAABB sunlightBox,
+                      GSIntAABB seedBox)
 {
     assert(voxels);
     assert(voxelCount);
@@ -44,28 +45,135 @@ void GSSunlightSeed(GSVoxel * _Nonnull voxels, size_t voxelCount, GSIntAABB voxe
     assert(sunCount);
     
     vector_long3 p;
+    size_t numSeeded = 0;
     
     // Seed phase.
-    // Seed the sunlight buffer with light at outside non-opaque blocks.
-    // Also, find the elevation of the highest opaque block.
+    // Seed the light buffer with light at non-opaque blocks which are light sources for the channel.
     FOR_BOX(p, seedBox)
     {
         size_t voxelIdx = INDEX_BOX(p, voxelBox);
 
         if (voxelIdx < voxelCount) {
-            GSVoxel voxel = voxels[voxelIdx];
-            BOOL directlyLit = (!voxel.opaque) && (voxel.outside || voxel.torch);
-
-            if (directlyLit) {
+            if (GSLightIsSource(voxels[voxelIdx], channel)) {
                 size_t sunlightIdx = INDEX_BOX(p, sunlightBox);
                 assert(sunlightIdx < sunCount);
                 sunlight[sunlightIdx] = CHUNK_LIGHTING_MAX;
+                numSeeded++;
             }
         }
     }
+
+    return numSeeded;
+}
+
+/* An entry in the light propagation queue. Records the light level a voxel was set to when it was enqueued so that
+ * stale entries can be recognized and skipped after the voxel has been raised again.
+ */
+typedef struct
+{
+    int16_t x, y, z;
+    GSTerrainBufferElement level;
+} GSSunlightQueueEntry;
+
+
+/* A flat FIFO ring buffer of voxels whose light has yet to be propagated to their neighbors. Capacity is always a
+ * power of two and the buffer doubles in size whenever it fills up.
+ */
+typedef struct
+{
+    GSSunlightQueueEntry * _Nonnull entries;
+    size_t capacity;
+    size_t head;
+    size_t count;
+} GSSunlightQueue;
+
+
+static void GSSunlightQueueInit(GSSunlightQueue * _Nonnull queue, size_t capacity)
+{
+    assert(queue);
+    assert(capacity && !(capacity & (capacity - 1)));
+
+    queue->entries = malloc(capacity * sizeof(GSSunlightQueueEntry));
+    if (!queue->entries) {
+        [NSException raise:NSMallocException format:@"Out of memory allocating the sunlight propagation queue."];
+    }
+    queue->capacity = capacity;
+    queue->head = 0;
+    queue->count = 0;
 }
 
-void GSSunlightBlur(GSVoxel * _Nonnull voxels, size_t voxelCount, GSIntAABB voxelBox,
+static void GSSunlightQueueDestroy(GSSunlightQueue * _Nonnull queue)
+{
+    assert(queue);
+    free(queue->entries);
+    queue->entries = NULL;
+}
+
+static void GSSunlightQueuePush(GSSunlightQueue * _Nonnull queue, vector_long3 p, GSTerrainBufferElement level)
+{
+    assert(queue);
+
+    if (queue->count == queue->capacity) {
+        // Grow the buffer and unwrap the contents so the queue starts at the beginning of the new buffer.
+        size_t newCapacity = queue->capacity * 2;
+        GSSunlightQueueEntry *newEntries = malloc(newCapacity * sizeof(GSSunlightQueueEntry));
+        if (!newEntries) {
+            [NSException raise:NSMallocException format:@"Out of memory allocating the sunlight propagation queue."];
+        }
+
+        size_t firstPart = queue->capacity - queue->head;
+        memcpy(newEntries, queue->entries + queue->head, firstPart * sizeof(GSSunlightQueueEntry));
+        memcpy(newEntries + firstPart, queue->entries, queue->head * sizeof(GSSunlightQueueEntry));
+
+        free(queue->entries);
+        queue->entries = newEntries;
+        queue->capacity = newCapacity;
+        queue->head = 0;
+    }
+
+    size_t tail = (queue->head + queue->count) & (queue->capacity - 1);
+    queue->entries[tail] = (GSSunlightQueueEntry){
+        .x = (int16_t)p.x,
+        .y = (int16_t)p.y,
+        .z = (int16_t)p.z,
+        .level = level
+    };
+    queue->count++;
+}
+
+static GSSunlightQueueEntry GSSunlightQueuePop(GSSunlightQueue * _Nonnull queue)
+{
+    assert(queue);
+    assert(queue->count > 0);
+
+    GSSunlightQueueEntry entry = queue->entries[queue->head];
+    queue->head = (queue->head + 1) & (queue->capacity - 1);
+    queue->count--;
+    return entry;
+}
+
+/* Returns YES if light may propagate into the voxel at `p'. Voxels that are out of bounds are assumed to be zero. */
+static inline BOOL GSSunlightCanReceive(GSLightChannel channel,
+                                        vector_long3 p, GSVoxel * _Nonnull voxels, size_t voxelCount,
+                                        GSIntAABB voxelBox, GSIntAABB blurBox)
+{
+    if(p.x < blurBox.mins.x || p.x >= blurBox.maxs.x ||
+       p.z < blurBox.mins.z || p.z >= blurBox.maxs.z ||
+       p.y < blurBox.mins.y || p.y >= blurBox.maxs.y) {
+        return NO;
+    }
+
+    GSVoxel voxel = {0};
+    size_t voxelIdx = INDEX_BOX(p, voxelBox);
+    if (voxelIdx < voxelCount) {
+        voxel = voxels[voxelIdx];
+    }
+
+    return !(voxel.opaque || GSLightIsSource(voxel, channel));
+}
+
+void GSSunlightBlur(GSLightChannel channel,
+                    GSVoxel * _Nonnull voxels, size_t voxelCount, GSIntAABB voxelBox,
                     GSTerrainBufferElement * _Nonnull sunlight, size_t sunCount, GSIntAABB sunlightBox,
                     GSIntAABB blurBox,
                     vector_long3 editPosClp,
@@ -77,80 +185,328 @@ void GSSunlightBlur(GSVoxel * _Nonnull voxels, size_t voxelCount, GSIntAABB voxe
     assert(sunCount);
     
     GSIntAABB actualAffectedRegion = { .mins = editPosClp, .maxs = editPosClp };
+    
+    GSSunlightQueue queue;
+    GSSunlightQueueInit(&queue, 1 << 12);
 
     // Blur phase.
-    // Find blocks that have not had light propagated to them yet and are directly adjacent to blocks at X light.
-    // Repeat for all light levels from CHUNK_LIGHTING_MAX down to 1.
-    // Set the blocks we find to the next lower light level.
-    for(int lightLevel = CHUNK_LIGHTING_MAX; lightLevel >= 1; --lightLevel)
+    // Light spreads from each non-opaque voxel to its six neighbors, dropping by one level with each step. It only
+    // spreads into non-opaque voxels in the blur box which are not themselves light sources. The result is the same
+    // as sweeping the blur box once for each light level, from CHUNK_LIGHTING_MAX down to 1, but each voxel is
+    // visited far fewer times.
+    //
+    // First, pull light into each receiving voxel from its neighbors. This accounts for all of the light which was
+    // present before the blur began. Most voxels are either opaque or directly lit and are skipped immediately.
+    vector_long3 p;
+    FOR_BOX(p, blurBox)
     {
-        vector_long3 p;
-        FOR_BOX(p, blurBox)
+        if (!GSSunlightCanReceive(channel, p, voxels, voxelCount, voxelBox, blurBox)) {
+            continue;
+        }
+
+        int brightest = 0;
+
+        for(GSVoxelFace i=0; i<FACE_NUM_FACES; ++i)
         {
-            GSVoxel voxel = {0};
-            size_t voxelIdx = INDEX_BOX(p, voxelBox);
-            if (voxelIdx < voxelCount) { // Voxels that are out of bounds are assumed to be set to zero.
-                voxel = voxels[voxelIdx];
+            vector_long3 a = p + GSOffsetForVoxelFace[i];
+            
+            if(a.x < sunlightBox.mins.x || a.x >= sunlightBox.maxs.x ||
+               a.z < sunlightBox.mins.z || a.z >= sunlightBox.maxs.z ||
+               a.y < sunlightBox.mins.y || a.y >= sunlightBox.maxs.y) {
+                continue; // The point is out of bounds, so skip it.
             }
             
-            if(voxel.opaque || voxel.outside) {
+            size_t voxelIdx = INDEX_BOX(a, voxelBox);
+            assert(voxelIdx < voxelCount);
+            
+            size_t sunlightIdx = INDEX_BOX(a, sunlightBox);
+            assert(sunlightIdx < sunCount);
+
+            int lightLevel = sunlight[sunlightIdx];
+            if (!(voxels[voxelIdx].opaque) && (lightLevel <= CHUNK_LIGHTING_MAX)) {
+                brightest = MAX(brightest, lightLevel);
+            }
+        }
+
+        size_t sunlightIdx = INDEX_BOX(p, sunlightBox);
+        assert(sunlightIdx < sunCount);
+        GSTerrainBufferElement *value = &sunlight[sunlightIdx];
+
+        if ((brightest - 1) > (*value)) {
+            *value = brightest - 1;
+
+            actualAffectedRegion.mins = vector_min(actualAffectedRegion.mins, p);
+            actualAffectedRegion.maxs = vector_max(actualAffectedRegion.maxs, p);
+
+            if (*value > 1) {
+                GSSunlightQueuePush(&queue, p, *value);
+            }
+        }
+    }
+
+    // Second, push light outward from every voxel which was raised, until nothing changes.
+    while(queue.count > 0)
+    {
+        GSSunlightQueueEntry entry = GSSunlightQueuePop(&queue);
+        vector_long3 q = {entry.x, entry.y, entry.z};
+        
+        if (sunlight[INDEX_BOX(q, sunlightBox)] != entry.level) {
+            continue; // The voxel was raised again after this entry was enqueued, so a newer entry supersedes it.
+        }
+
+        GSTerrainBufferElement nextLevel = entry.level - 1;
+
+        for(GSVoxelFace i=0; i<FACE_NUM_FACES; ++i)
+        {
+            vector_long3 a = q + GSOffsetForVoxelFace[i];
+
+            if (!GSSunlightCanReceive(channel, a, voxels, voxelCount, voxelBox, blurBox)) {
                 continue;
             }
-            
-            BOOL adj = GSSunlightAdjacent(p, lightLevel,
-                                          voxels, voxelCount, voxelBox,
-                                          sunlight, sunCount, sunlightBox);
 
-            if(adj) {
-                size_t sunlightIdx = INDEX_BOX(p, sunlightBox);
-                assert(sunlightIdx < sunCount);
-                GSTerrainBufferElement *value = &sunlight[sunlightIdx];
+            size_t sunlightIdx = INDEX_BOX(a, sunlightBox);
+            assert(sunlightIdx < sunCount);
+            GSTerrainBufferElement *value = &sunlight[sunlightIdx];
 
-                if ((lightLevel - 1) > (*value)) {
-                    *value = lightLevel - 1;
-                    
-                    actualAffectedRegion.mins = vector_min(actualAffectedRegion.mins, p);
-                    actualAffectedRegion.maxs = vector_max(actualAffectedRegion.maxs, p);
+            if (nextLevel > (*value)) {
+                *value = nextLevel;
+
+                actualAffectedRegion.mins = vector_min(actualAffectedRegion.mins, a);
+                actualAffectedRegion.maxs = vector_max(actualAffectedRegion.maxs, a);
+
+                if (nextLevel > 1) {
+                    GSSunlightQueuePush(&queue, a, nextLevel);
                 }
             }
         }
     }
+
+    GSSunlightQueueDestroy(&queue);
     
     if (outAffectedRegion) {
         *outAffectedRegion = actualAffectedRegion;
     }
 }
 
-BOOL GSSunlightAdjacent(vector_long3 p, int lightLevel,
-                        GSVoxel * _Nonnull voxels, size_t voxCount,
-                        GSIntAABB voxelBox,
-                        GSTerrainBufferElement * _Nonnull sunlight, size_t sunCount,
-                        GSIntAABB sunlightBox)
+/* Marks voxels whose light was removed during GSSunlightUpdateForEdit. The light level is kept in the low bits. */
+#define SUNLIGHT_REMOVED_FLAG ((GSTerrainBufferElement)0x8000)
+#define SUNLIGHT_LEVEL(value) ((GSTerrainBufferElement)((value) & ~SUNLIGHT_REMOVED_FLAG))
+
+static inline BOOL GSSunlightPointInBox(vector_long3 p, GSIntAABB box)
+{
+    return p.x >= box.mins.x && p.x < box.maxs.x &&
+           p.y >= box.mins.y && p.y < box.maxs.y &&
+           p.z >= box.mins.z && p.z < box.maxs.z;
+}
+
+static inline void GSSunlightExpandRegion(GSIntAABB * _Nonnull region, vector_long3 p)
+{
+    region->mins = vector_min(region->mins, p);
+    region->maxs = vector_max(region->maxs, p);
+}
+
+void GSSunlightUpdateForEdit(GSLightChannel channel,
+                             GSVoxel * _Nonnull voxels, size_t voxelCount, GSIntAABB voxelBox,
+                             GSTerrainBufferElement * _Nonnull sunlight, size_t sunCount, GSIntAABB sunlightBox,
+                             GSIntAABB workBox,
+                             vector_long3 editPosClp,
+                             BOOL removingLight,
+                             GSIntAABB * _Nullable outAffectedRegion)
 {
     assert(voxels);
-    assert(voxCount);
+    assert(voxelCount);
     assert(sunlight);
     assert(sunCount);
+    assert(GSSunlightPointInBox(editPosClp, workBox));
+
+    GSIntAABB changed = { .mins = editPosClp, .maxs = editPosClp }; // The edited voxel itself always counts.
+    
+    GSSunlightQueue removalQueue, refillQueue, removedVoxels;
+    GSSunlightQueueInit(&removalQueue, 1 << 10);
+    GSSunlightQueueInit(&refillQueue, 1 << 10);
+    GSSunlightQueueInit(&removedVoxels, 1 << 10);
+
+    // An edit can only change which voxels are light sources in the column beneath the edit point, as that is where
+    // the `outside' flag changes. Torches are unaffected by that flag so only the edited voxel itself matters for them.
+    GSIntAABB column = {
+        .mins = {editPosClp.x, editPosClp.y, editPosClp.z},
+        .maxs = {editPosClp.x + 1, editPosClp.y + 1, editPosClp.z + 1}
+    };
+    if (channel == LIGHT_CHANNEL_SUN) {
+        column.mins.y = workBox.mins.y;
+    }
+
+    // Removal phase.
+    // Clear light from voxels which are no longer lit. Then walk outward, clearing light from each neighbor which is
+    // dimmer than the voxel it was reached from, as that neighbor's light may have come from the cleared voxel. When a
+    // neighbor is at least as bright, it was lit some other way and is saved to seed the refill phase.
+    if (removingLight) {
+        vector_long3 p;
+        FOR_BOX(p, column)
+        {
+            size_t voxelIdx = INDEX_BOX(p, voxelBox);
+            assert(voxelIdx < voxelCount);
+            GSVoxel voxel = voxels[voxelIdx];
+            BOOL directlyLit = GSLightIsSource(voxel, channel);
+
+            size_t sunlightIdx = INDEX_BOX(p, sunlightBox);
+            assert(sunlightIdx < sunCount);
+            GSTerrainBufferElement level = sunlight[sunlightIdx];
+
+            if ((voxel.opaque && level > 0) || (!directlyLit && level == CHUNK_LIGHTING_MAX)) {
+                GSSunlightQueuePush(&removedVoxels, p, level);
+                GSSunlightQueuePush(&removalQueue, p, level);
+                sunlight[sunlightIdx] = SUNLIGHT_REMOVED_FLAG;
+            }
+        }
+
+        while(removalQueue.count > 0)
+        {
+            GSSunlightQueueEntry entry = GSSunlightQueuePop(&removalQueue);
+            vector_long3 q = {entry.x, entry.y, entry.z};
+
+            for(GSVoxelFace i=0; i<FACE_NUM_FACES; ++i)
+            {
+                vector_long3 a = q + GSOffsetForVoxelFace[i];
+
+                if (!GSSunlightPointInBox(a, sunlightBox)) {
+                    continue;
+                }
+
+                size_t sunlightIdx = INDEX_BOX(a, sunlightBox);
+                assert(sunlightIdx < sunCount);
+                GSTerrainBufferElement level = sunlight[sunlightIdx];
+
+                if ((level & SUNLIGHT_REMOVED_FLAG) || (level == 0)) {
+                    continue;
+                }
+
+                BOOL canReceive = GSSunlightCanReceive(channel, a, voxels, voxelCount, voxelBox, workBox);
+
+                if ((level < entry.level) && canReceive) {
+                    GSSunlightQueuePush(&removedVoxels, a, level);
+                    GSSunlightQueuePush(&removalQueue, a, level);
+                    sunlight[sunlightIdx] = SUNLIGHT_REMOVED_FLAG;
+                } else if (level > 1) {
+                    size_t voxelIdx = INDEX_BOX(a, voxelBox);
+                    assert(voxelIdx < voxelCount);
+                    if (!voxels[voxelIdx].opaque) {
+                        GSSunlightQueuePush(&refillQueue, a, level);
+                    }
+                }
+            }
+        }
+    }
+
+    // Seed the refill phase with voxels in the column which have become light sources.
+    {
+        vector_long3 p;
+        FOR_BOX(p, column)
+        {
+            size_t voxelIdx = INDEX_BOX(p, voxelBox);
+            assert(voxelIdx < voxelCount);
+            GSVoxel voxel = voxels[voxelIdx];
+            BOOL directlyLit = GSLightIsSource(voxel, channel);
+
+            size_t sunlightIdx = INDEX_BOX(p, sunlightBox);
+            assert(sunlightIdx < sunCount);
+            GSTerrainBufferElement value = sunlight[sunlightIdx];
+
+            if (directlyLit && SUNLIGHT_LEVEL(value) < CHUNK_LIGHTING_MAX) {
+                sunlight[sunlightIdx] = CHUNK_LIGHTING_MAX | (value & SUNLIGHT_REMOVED_FLAG);
+                if (!(value & SUNLIGHT_REMOVED_FLAG)) {
+                    GSSunlightExpandRegion(&changed, p);
+                }
+                GSSunlightQueuePush(&refillQueue, p, CHUNK_LIGHTING_MAX);
+            }
+        }
+    }
 
+    // If the edited voxel is now able to receive light then its neighbors must have a chance to light it.
     for(GSVoxelFace i=0; i<FACE_NUM_FACES; ++i)
     {
-        vector_long3 a = p + GSOffsetForVoxelFace[i];
-        
-        if(a.x < sunlightBox.mins.x || a.x >= sunlightBox.maxs.x ||
-           a.z < sunlightBox.mins.z || a.z >= sunlightBox.maxs.z ||
-           a.y < sunlightBox.mins.y || a.y >= sunlightBox.maxs.y) {
-            continue; // The point is out of bounds, so bail out.
+        vector_long3 a = editPosClp + GSOffsetForVoxelFace[i];
+
+        if (!GSSunlightPointInBox(a, sunlightBox)) {
+            continue;
         }
-        
+
         size_t voxelIdx = INDEX_BOX(a, voxelBox);
-        assert(voxelIdx < voxCount);
-        
-        size_t sunlightIdx = INDEX_BOX(a, sunlightBox);
-        assert(sunlightIdx < sunCount);
-        if (!(voxels[voxelIdx].opaque) && (sunlight[sunlightIdx] == lightLevel)) {
-            return YES;
+        assert(voxelIdx < voxelCount);
+        GSTerrainBufferElement level = SUNLIGHT_LEVEL(sunlight[INDEX_BOX(a, sunlightBox)]);
+
+        if (!voxels[voxelIdx].opaque && level > 1) {
+            GSSunlightQueuePush(&refillQueue, a, level);
         }
     }
-    
-    return NO;
+
+    // Refill phase.
+    // Propagate light from the seeds exactly as GSSunlightBlur does. Voxels which were not cleared above can only get
+    // brighter here, so those are certainly changed. Cleared voxels are checked against their original values below.
+    while(refillQueue.count > 0)
+    {
+        GSSunlightQueueEntry entry = GSSunlightQueuePop(&refillQueue);
+        vector_long3 q = {entry.x, entry.y, entry.z};
+
+        if (SUNLIGHT_LEVEL(sunlight[INDEX_BOX(q, sunlightBox)]) != entry.level) {
+            continue; // The voxel was raised again after this entry was enqueued, so a newer entry supersedes it.
+        }
+
+        GSTerrainBufferElement nextLevel = entry.level - 1;
+
+        for(GSVoxelFace i=0; i<FACE_NUM_FACES; ++i)
+        {
+            vector_long3 a = q + GSOffsetForVoxelFace[i];
+
+            if (!GSSunlightCanReceive(channel, a, voxels, voxelCount, voxelBox, workBox)) {
+                continue;
+            }
+
+            size_t sunlightIdx = INDEX_BOX(a, sunlightBox);
+            assert(sunlightIdx < sunCount);
+            GSTerrainBufferElement value = sunlight[sunlightIdx];
+
+            if (nextLevel > SUNLIGHT_LEVEL(value)) {
+                sunlight[sunlightIdx] = nextLevel | (value & SUNLIGHT_REMOVED_FLAG);
+
+                if (!(value & SUNLIGHT_REMOVED_FLAG)) {
+                    GSSunlightExpandRegion(&changed, a);
+                }
+
+                if (nextLevel > 1) {
+                    GSSunlightQueuePush(&refillQueue, a, nextLevel);
+                }
+            }
+        }
+    }
+
+    // Clear the flags on voxels which were cleared in the removal phase. Many of these will have been restored to
+    // their original light level by the refill phase and so have not actually changed.
+    while(removedVoxels.count > 0)
+    {
+        GSSunlightQueueEntry entry = GSSunlightQueuePop(&removedVoxels);
+        vector_long3 q = {entry.x, entry.y, entry.z};
+        size_t sunlightIdx = INDEX_BOX(q, sunlightBox);
+        GSTerrainBufferElement level = SUNLIGHT_LEVEL(sunlight[sunlightIdx]);
+        sunlight[sunlightIdx] = level;
+
+        if (level != entry.level) {
+            GSSunlightExpandRegion(&changed, q);
+        }
+    }
+
+    GSSunlightQueueDestroy(&removalQueue);
+    GSSunlightQueueDestroy(&refillQueue);
+    GSSunlightQueueDestroy(&removedVoxels);
+
+    if (outAffectedRegion) {
+        // Geometry samples the light of voxels adjacent to each vertex, so grow the region by one voxel.
+        GSIntAABB affected = {
+            .mins = changed.mins - GSMakeIntegerVector3(1, 1, 1),
+            .maxs = changed.maxs + GSMakeIntegerVector3(1, 1, 1)
+        };
+        affected.mins.y = MAX(affected.mins.y, 0);
+        affected.maxs.y = MIN(affected.maxs.y, GSChunkSizeIntVec3.y);
+        *outAffectedRegion = affected;
+    }
 }
@@ -26,6 +26,7 @@
 #import "GSTerrainModifyBlockOperation.h"
 #import "GSTerrainApplyJournalOperation.h"
 #import "GSActivity.h"
+#import "GSTerrainVertex.h"
 
 #import <OpenGL/gl.h>
 
@@ -93,7 +94,15 @@ _Static_assert(sizeof(GSVoxel) == sizeof(GSTerrainBufferElement),
     NSString *vertSrc = [self newShaderSourceStringFromFileAt:vertFn];
     NSString *fragSrc = [self newShaderSourceStringFromFileAt:fragFn];
     
-    GSShader *terrainShader = [[GSShader alloc] initWithVertexShaderSource:vertSrc fragmentShaderSource:fragSrc];
+    NSDictionary<NSString *, NSNumber *> *attribs = @{
+        @"texCoordAttrib" : @(GSTerrainVertexAttribTexCoord),
+        @"luminanceAttrib" : @(GSTerrainVertexAttribLuminance),
+        @"chunkOffsetAttrib" : @(GSTerrainVertexAttribChunkOffset)
+    };
+    
+    GSShader *terrainShader = [[GSShader alloc] initWithVertexShaderSource:vertSrc
+                                                      fragmentShaderSource:fragSrc
+                                                        attributeLocations:attribs];
     
     [terrainShader bind];
     [terrainShader bindUniformWithInt:0 name:@"tex"]; // texture unit 0
@@ -164,11 +173,17 @@ _Static_assert(sizeof(GSVoxel) == sizeof(GSTerrainBufferElement),
                                                     tileSize:NSMakeSize(12,12)
                                                   tileBorder:1];
 
+        BOOL interpolated = [[NSUserDefaults standardUserDefaults] boolForKey:@"InterpolatedTerrainGeneration"];
+        GSTerrainGenerator *generator = [[GSTerrainGenerator alloc]
+                                         initWithRandomSeed:journal.randomSeed
+                                         quality:(interpolated ? GSTerrainGenerationQualityInterpolated
+                                                               : GSTerrainGenerationQualityExact)];
+
         _chunkStore = [[GSTerrainChunkStore alloc] initWithJournal:journal
                                                        cacheFolder:cacheFolder
                                                             camera:cam
                                                          glContext:context
-                                                         generator:[[GSTerrainGenerator alloc] initWithRandomSeed:journal.randomSeed]];
+                                                         generator:generator];
 
         _chunkStoreRayMarcher = [[GSTerrainRayMarcher alloc] initWithChunkStore:_chunkStore];
 
@@ -180,10 +195,13 @@ _Static_assert(sizeof(GSVoxel) == sizeof(GSTerrainBufferElement),
         // If the cache folder is empty then apply the journal to rebuild it.
         // Since rebuilding from the journal is expensive, we avoid doing unless we have no choice.
         // Also, this provides a pretty easy way for the user to force a rebuild when they need it.
+        // Each generation quality has its own folder within the cache folder, so look in the one which will be used.
         NSArray *cacheContents = nil;
-        if (cacheFolder) {
+        NSURL *qualityFolder = _chunkStore.cacheFolder;
+        if (qualityFolder) {
             NSError *error = nil;
-            cacheContents = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:[cacheFolder path] error:&error];
+            cacheContents = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:[qualityFolder path]
+                                                                                error:&error];
             if (!cacheContents) {
                 NSLog(@"Error while examining terrain cache folder: %@", error);
             }
@@ -255,6 +273,7 @@ _Static_assert(sizeof(GSVoxel) == sizeof(GSTerrainBufferElement),
 - (void)printInfo
 {
     [_chunkStore printInfo];
+    [_activeRegion printInfo];
 }
 
 - (void)placeBlockUnderCrosshairs
@@ -11,7 +11,6 @@
 @class GSCamera;
 @class GSChunkVAO;
 @class GSGridVAO;
-@class GSBoxedVector;
 @class GSTerrainChunkStore;
 
 
@@ -36,14 +35,15 @@
 
 - (void)draw;
 
-- (nonnull NSArray<GSBoxedVector *> *)pointsInCameraFrustum;
-
 /* Call this to notify the active region that a VAO in the active region needs to be generated or regenerated.
  * To ensure that updates to the world will are made visible in a timely manner, call this immediately when a VAO, or
  * it's underlying terrain data, changes.
  */
 - (void)needsChunkGeneration;
 
+/* Log the state of the chunk generation pipeline, such as the depth of the queue for each stage. */
+- (void)printInfo;
+
 /* Drain the internal async queue and shut it down.
  * Give up all stored references to active region VAOs.
  */
@@ -15,28 +15,150 @@
 #import "GSActivity.h"
 #import "GSReaderWriterLock.h"
 #import "GSBox.h"
+#import "GSTerrainGeometryGenerator.h"
+#import "GSTerrainChunkPipeline.h"
+#import "GSTerrainPrefetchTracker.h"
+#import "GSStopwatch.h"
 
 
-static const uint64_t GSChunkCreationBudget = 10 * NSEC_PER_MSEC; // chosen arbitrarily
+/* How far ahead, in seconds, to predict which chunks will come into view. */
+static const float GSPrefetchLookahead = 1.0f;
 
+/* The number of predicted camera frustums to sample within the lookahead. */
+#define GSPrefetchSamples (3)
 
-static int chunkInFrustum(GSFrustum *frustum, vector_float3 p)
+/* The camera must move or turn at least this fast for prefetching to begin. */
+static const float GSPrefetchMinSpeed = 0.5f; // world units per second
+static const float GSPrefetchMinYawRate = 0.05f; // radians per second
+
+/* How often, in seconds, to sample the active set for the prefetch statistics. */
+static const double GSPrefetchTrackerInterval = 0.25;
+
+/* The set of chunks in the camera frustum is built with chunks enlarged by this much on every side, so that it
+ * remains correct until the camera moves this far away from where the set was built.
+ */
+static const float GSActiveSetSlop = CHUNK_SIZE_X / 2;
+
+/* A missing chunk is requested again after this many frames, in case its request was dropped along the way. */
+static const uint32_t GSRequestRetryFrames = 30;
+
+
+/* Flags for the state of each slot in the active region. The "was" flags hold the state from the previous build. */
+typedef enum
+{
+    GSActiveSlotVisible = 1,
+    GSActiveSlotPredicted = 2,
+    GSActiveSlotWasVisible = 4,
+    GSActiveSlotWasPredicted = 8
+} GSActiveSlotState;
+
+
+static int chunkInFrustum(GSFrustum *frustum, vector_float3 p, float margin)
 {
     vector_float3 corners[8];
-    
-    corners[0] = GSMinCornerForChunkAtPoint(p);
-    corners[1] = corners[0] + (vector_float3){CHUNK_SIZE_X, 0,            0};
-    corners[2] = corners[0] + (vector_float3){CHUNK_SIZE_X, 0,            CHUNK_SIZE_Z};
-    corners[3] = corners[0] + (vector_float3){0,            0,            CHUNK_SIZE_Z};
-    corners[4] = corners[0] + (vector_float3){0,            CHUNK_SIZE_Y, CHUNK_SIZE_Z};
-    corners[5] = corners[0] + (vector_float3){CHUNK_SIZE_X, CHUNK_SIZE_Y, CHUNK_SIZE_Z};
-    corners[6] = corners[0] + (vector_float3){CHUNK_SIZE_X, CHUNK_SIZE_Y, 0};
-    corners[7] = corners[0] + (vector_float3){0,            CHUNK_SIZE_Y, 0};
-    
+    vector_float3 mins = GSMinCornerForChunkAtPoint(p) - margin;
+    vector_float3 size = (vector_float3){CHUNK_SIZE_X, CHUNK_SIZE_Y, CHUNK_SIZE_Z} + 2*margin;
+
+    corners[0] = mins;
+    corners[1] = corners[0] + (vector_float3){size.x, 0,      0};
+    corners[2] = corners[0] + (vector_float3){size.x, 0,      size.z};
+    corners[3] = corners[0] + (vector_float3){0,      0,      size.z};
+    corners[4] = corners[0] + (vector_float3){0,      size.y, size.z};
+    corners[5] = corners[0] + (vector_float3){size.x, size.y, size.z};
+    corners[6] = corners[0] + (vector_float3){size.x, size.y, 0};
+    corners[7] = corners[0] + (vector_float3){0,      size.y, 0};
+
     return [frustum boxInFrustumWithBoxVertices:corners];
 }
 
 
+/* Returns the horizontal distance from `center' to the chunk at `p'. */
+static float distanceToChunk(vector_float3 p, vector_float3 center)
+{
+    vector_float2 offset = {p.x - center.x, p.z - center.z};
+    return vector_length(offset);
+}
+
+
+/* Returns the level of detail at which to draw the chunk at `p' when the camera is at `center'. */
+static NSUInteger levelOfDetailForChunk(vector_float3 p, vector_float3 center)
+{
+    return GSTerrainGeometryLevelOfDetailForDistance(distanceToChunk(p, center));
+}
+
+
+/* Returns the mask of sides of the chunk at `p', drawn at the specified level of detail, which need skirts. Those are
+ * the sides which border a chunk drawn at another level of detail. See -[GSChunkVAO drawWithSkirts:].
+ */
+static unsigned skirtSidesForChunk(vector_float3 p, NSUInteger levelOfDetail, vector_float3 center)
+{
+    const vector_float3 neighborOffset[GSNumChunkSides] = {
+        [GSChunkSideNegX] = {-CHUNK_SIZE_X, 0, 0},
+        [GSChunkSidePosX] = {+CHUNK_SIZE_X, 0, 0},
+        [GSChunkSideNegZ] = {0, 0, -CHUNK_SIZE_Z},
+        [GSChunkSidePosZ] = {0, 0, +CHUNK_SIZE_Z}
+    };
+
+    unsigned sides = 0;
+    for(NSUInteger side = 0; side < GSNumChunkSides; ++side)
+    {
+        if (levelOfDetailForChunk(p + neighborOffset[side], center) != levelOfDetail) {
+            sides |= 1u << side;
+        }
+    }
+    return sides;
+}
+
+
+/* Returns the chunk coordinates of the chunk containing `p'. */
+static inline vector_long3 chunkIndexForPoint(vector_float3 p)
+{
+    return (vector_long3){(long)floorf(p.x / CHUNK_SIZE_X),
+                          (long)floorf(p.y / CHUNK_SIZE_Y),
+                          (long)floorf(p.z / CHUNK_SIZE_Z)};
+}
+
+
+/* Returns the center of the chunk with the specified chunk coordinates. */
+static inline vector_float3 centerOfChunk(vector_long3 chunk)
+{
+    return (vector_float3){chunk.x * CHUNK_SIZE_X + CHUNK_SIZE_X/2,
+                           chunk.y * CHUNK_SIZE_Y + CHUNK_SIZE_Y/2,
+                           chunk.z * CHUNK_SIZE_Z + CHUNK_SIZE_Z/2};
+}
+
+
+/* Returns the index of the slot for the chunk with the specified chunk coordinates. Chunk coordinates wrap around the
+ * size of the active region, so any two chunks which are in the active region at the same time have different slots.
+ */
+static inline long slotIndexForChunk(vector_long3 chunk, GSIntAABB slotBox)
+{
+    long sizeX = slotBox.maxs.x, sizeZ = slotBox.maxs.z;
+    vector_long3 wrapped = {((chunk.x % sizeX) + sizeX) % sizeX, chunk.y, ((chunk.z % sizeZ) + sizeZ) % sizeZ};
+    return INDEX_BOX(wrapped, slotBox);
+}
+
+
+// Orders chunk offsets by distance from the origin, and then by angle, so they spiral outward ring by ring.
+static int compareSpiralOffsets(const void *a, const void *b)
+{
+    vector_int3 p = *(const vector_int3 *)a, q = *(const vector_int3 *)b;
+    int dp = p.x*p.x + p.z*p.z, dq = q.x*q.x + q.z*q.z;
+
+    if (dp != dq) {
+        return (dp < dq) ? -1 : 1;
+    }
+
+    float ap = atan2f(p.z, p.x), aq = atan2f(q.z, q.x);
+
+    if (ap != aq) {
+        return (ap < aq) ? -1 : 1;
+    }
+
+    return p.y - q.y;
+}
+
+
 @interface GSTerrainActiveRegion ()
 
 /* Flag indicates that the queue should shutdown. */
@@ -58,19 +180,57 @@ static int chunkInFrustum(GSFrustum *frustum, vector_float3 p)
     /* Used to generate and retrieve Vertex Array Objects. */
     GSTerrainChunkStore *_chunkStore;
 
-    /* Dispatch Queue used for generating chunks asynchronously. */
-    dispatch_queue_t _generationQueue;
-    
-    /* Semaphore used to prevent the generation queue from having too many outstanding chunks. */
-    dispatch_semaphore_t _generationSema;
-    
-    /* List of VAOs the display link thread will draw. */
-    NSMutableSet<GSChunkVAO *> *_drawList;
+    /* Generates chunks asynchronously, nearest first. */
+    GSTerrainChunkPipeline *_pipeline;
+
+    /* Measures how many of the chunks prefetched ahead of the camera actually come into view. */
+    GSTerrainPrefetchTracker *_prefetchTracker;
+    uint64_t _startTime;
+    double _lastPrefetchTrackerUpdate;
+
+    /* Each chunk in the active region has a slot. The slots form a box the size of the active region, in chunks, and
+     * chunk coordinates wrap around it. So, a chunk keeps its slot for as long as it stays in the active region.
+     */
+    GSIntAABB _slotBox;
+    NSUInteger _numSlots;
+
+    /* Offsets of the chunks in the active region from the chunk column containing the camera, nearest first. */
+    vector_int3 *_spiral;
+
+    /* State of each slot, as of the last build of the active set. Used only on the update thread. */
+    uint8_t *_slotState;
+
+    /* Frustums used to predict which chunks will come into view. Used only on the update thread. */
+    GSFrustum *_predictedFrustums[GSPrefetchSamples];
+
+    /* The chunk column containing the camera, and the camera position, when the active set was last built. */
+    vector_long3 _builtColumn;
+    vector_float3 _builtEye;
+    BOOL _hasActiveSet;
+
+    /* The active set is the centers of the chunks in the camera frustum, nearest first. It is double buffered. The
+     * update thread builds the back buffer, and then swaps it to the front under the lock. Along with it are the camera
+     * position it was built for, and a generation count which changes with each build.
+     */
+    vector_float3 *_activeSet[2];
+    NSUInteger _activeSetCount[2];
+    NSUInteger _front;
+    vector_float3 _activeSetCenter;
+    NSUInteger _activeSetGeneration;
+    GSReaderWriterLock *_lockActiveSet;
+
+    /* The display link thread's copy of the active set, and its state for each slot. */
+    vector_float3 *_drawPoints;
+    NSUInteger _drawCount;
+    vector_float3 _drawCenter;
+    NSUInteger _drawGeneration;
+    uint32_t _frame;
+    uint32_t *_slotDrawnFrame;
+    uint32_t *_slotRequestFrame;
+
+    /* The VAO drawn in each slot. */
+    __strong GSChunkVAO **_drawList;
     NSLock *_lockDrawList;
-    
-    /* The calculated set of chunk points in the camera frustum. */
-    NSArray<GSBoxedVector *> *_cachedPointsInCameraFrustum;
-    GSReaderWriterLock *_lockCachedPointsInCameraFrustum;
 }
 
 - (nonnull instancetype)initWithActiveRegionExtent:(vector_float3)activeRegionExtent
@@ -79,218 +239,413 @@ static int chunkInFrustum(GSFrustum *frustum, vector_float3 p)
 {
     NSParameterAssert(camera);
     NSParameterAssert(chunkStore);
-    NSParameterAssert(fmodf(_activeRegionExtent.x, CHUNK_SIZE_X) == 0);
-    NSParameterAssert(fmodf(_activeRegionExtent.y, CHUNK_SIZE_Y) == 0);
-    NSParameterAssert(fmodf(_activeRegionExtent.z, CHUNK_SIZE_Z) == 0);
+    NSParameterAssert(fmodf(activeRegionExtent.x, CHUNK_SIZE_X) == 0);
+    NSParameterAssert(fmodf(activeRegionExtent.y, CHUNK_SIZE_Y) == 0);
+    NSParameterAssert(fmodf(activeRegionExtent.z, CHUNK_SIZE_Z) == 0);
 
     if (self = [super init]) {
         _shouldShutdown = NO;
         _camera = camera;
         _activeRegionExtent = activeRegionExtent;
         _chunkStore = chunkStore;
-        _generationQueue = dispatch_queue_create("GSTerrainActiveRegion.generationQueue", DISPATCH_QUEUE_CONCURRENT);
-        
-        long n = [[NSProcessInfo processInfo] processorCount];
-        _generationSema = dispatch_semaphore_create(n);
+        _pipeline = [[GSTerrainChunkPipeline alloc] initWithChunkStore:chunkStore
+                                                     maxConcurrentJobs:[[NSProcessInfo processInfo] processorCount]];
+        _prefetchTracker = [[GSTerrainPrefetchTracker alloc] initWithHorizon:2.0 * GSPrefetchLookahead];
+        _startTime = GSStopwatchStart();
+        _lastPrefetchTrackerUpdate = 0;
+
+        long activeRegionExtentX = activeRegionExtent.x/CHUNK_SIZE_X;
+        long activeRegionExtentZ = activeRegionExtent.z/CHUNK_SIZE_Z;
+        long activeRegionSizeY = activeRegionExtent.y/CHUNK_SIZE_Y;
+        _slotBox = (GSIntAABB){
+            .mins = { 0, 0, 0 },
+            .maxs = { 2*activeRegionExtentX, activeRegionSizeY, 2*activeRegionExtentZ }
+        };
+        _numSlots = 4 * activeRegionExtentX * activeRegionSizeY * activeRegionExtentZ;
+
+        _spiral = malloc(_numSlots * sizeof(vector_int3));
+        _slotState = calloc(_numSlots, sizeof(uint8_t));
+        _activeSet[0] = malloc(_numSlots * sizeof(vector_float3));
+        _activeSet[1] = malloc(_numSlots * sizeof(vector_float3));
+        _drawPoints = malloc(_numSlots * sizeof(vector_float3));
+        _slotDrawnFrame = calloc(_numSlots, sizeof(uint32_t));
+        _slotRequestFrame = calloc(_numSlots, sizeof(uint32_t));
+        _drawList = (__strong GSChunkVAO **)calloc(_numSlots, sizeof(GSChunkVAO *));
+
+        if (!(_spiral && _slotState && _activeSet[0] && _activeSet[1] && _drawPoints && _slotDrawnFrame &&
+              _slotRequestFrame && _drawList)) {
+            [NSException raise:NSMallocException format:@"Out of memory allocating the active region."];
+        }
+
+        NSUInteger i = 0;
+        for(long x = -activeRegionExtentX; x < activeRegionExtentX; ++x)
+        {
+            for(long z = -activeRegionExtentZ; z < activeRegionExtentZ; ++z)
+            {
+                for(long y = 0; y < activeRegionSizeY; ++y)
+                {
+                    _spiral[i++] = (vector_int3){(int)x, (int)y, (int)z};
+                }
+            }
+        }
+        qsort(_spiral, _numSlots, sizeof(vector_int3), compareSpiralOffsets);
 
-        _drawList = [NSMutableSet new];
+        for(int j = 0; j < GSPrefetchSamples; ++j)
+        {
+            _predictedFrustums[j] = [[GSFrustum alloc] init];
+        }
+
+        _hasActiveSet = NO;
+        _front = 0;
+        _activeSetCount[0] = _activeSetCount[1] = 0;
+        _activeSetGeneration = 0;
+        _lockActiveSet = [GSReaderWriterLock new];
+        _lockActiveSet.name = @"GSTerrainActiveRegion.lockActiveSet";
+
+        _drawCount = 0;
+        _drawGeneration = 0;
+        _frame = 0;
         _lockDrawList = [NSLock new];
         _lockDrawList.name = @"GSTerrainActiveRegion.lockDrawList";
-        
-        _cachedPointsInCameraFrustum = nil;
-        _lockCachedPointsInCameraFrustum = [GSReaderWriterLock new];
-        _lockCachedPointsInCameraFrustum.name = @"GSTerrainActiveRegion.lockCachedPointsInCameraFrustum";
     }
-    
+
     return self;
 }
 
+- (void)dealloc
+{
+    for(NSUInteger i = 0; i < _numSlots; ++i)
+    {
+        _drawList[i] = nil;
+    }
+
+    free(_drawList);
+    free(_slotRequestFrame);
+    free(_slotDrawnFrame);
+    free(_drawPoints);
+    free(_activeSet[1]);
+    free(_activeSet[0]);
+    free(_slotState);
+    free(_spiral);
+}
+
+/* Drop the references to all VAOs in the draw list. Expects the caller to hold `_lockDrawList'. */
+- (void)removeAllFromDrawList
+{
+    for(NSUInteger i = 0; i < _numSlots; ++i)
+    {
+        _drawList[i] = nil;
+    }
+}
+
 - (void)clearDrawList
 {
     [_lockDrawList lock];
-    [_drawList removeAllObjects];
+    [self removeAllFromDrawList];
     [_lockDrawList unlock];
 }
 
 - (void)draw
 {
-    BOOL chunkGenerationNeeded = NO;
-
     if (self.shouldShutdown) {
         return;
     }
-    
+
     //GSStopwatchTraceBegin(@"GSTerrainActiveRegion.draw");
 
     [_lockDrawList lock];
 
-    NSMutableArray<GSChunkVAO *> *vaosToRemove = [NSMutableArray new];
+    // Take a copy of the active set whenever it changes. The buffers are preallocated, so this doesn't allocate.
+    BOOL activeSetChanged = NO;
+    [_lockActiveSet lockForReading];
+    if (_drawGeneration != _activeSetGeneration) {
+        activeSetChanged = YES;
+        _drawCount = _activeSetCount[_front];
+        memcpy(_drawPoints, _activeSet[_front], _drawCount * sizeof(vector_float3));
+        _drawCenter = _activeSetCenter;
+        _drawGeneration = _activeSetGeneration;
+    }
+    [_lockActiveSet unlockForReading];
 
-    // Mark the VAOs which are no longer in the camera frustum for removal.
-    for(GSChunkVAO *vao in _drawList)
-    {
-        if(GSFrustumOutside == chunkInFrustum(_camera.frustum, vao.minP)) {
-            [vaosToRemove addObject:vao];
-        }
+    if (activeSetChanged) {
+        // Levels of detail depend on the camera position, so every chunk needs another look.
+        memset(_slotRequestFrame, 0, _numSlots * sizeof(uint32_t));
     }
-    GSStopwatchTraceStep(@"Finished checking VAOs against camera frustum.");
-    
-    // Keep a dictionary to map from minP to VAO in constant-time.
-    NSMutableDictionary *pointToChunk = [NSMutableDictionary new];
-    for(GSChunkVAO *vao in _drawList)
-    {
-        GSBoxedVector *point = [GSBoxedVector boxedVectorWithVector:vao.minP];
-        pointToChunk[point] = vao;
+
+    if (++_frame == 0) {
+        _frame = 1; // Zero means "never".
     }
-    
-    // Iterate over points in the camera frustum. If we can get a new VAO for a point then use the new VAO and remove
-    // the reference to the old VAO. If we can't get a new one then keep using the old VAO.
-    [_lockCachedPointsInCameraFrustum lockForReading];
-    NSObject<NSFastEnumeration> *points = [_cachedPointsInCameraFrustum copy];
-    [_lockCachedPointsInCameraFrustum unlockForReading];
-
-    for(GSBoxedVector *boxedPosition in points)
+
+    // If we can get a new VAO for a chunk then use the new VAO and drop the reference to the old VAO. If we can't get a
+    // new one then keep using the old VAO.
+    for(NSUInteger i = 0; i < _drawCount; ++i)
     {
-        vector_float3 pos = [boxedPosition vectorValue];
-        GSBoxedVector *corner = [GSBoxedVector boxedVectorWithVector:GSMinCornerForChunkAtPoint(pos)];
-        GSChunkVAO *oldVao = [pointToChunk objectForKey:corner];
+        vector_float3 pos = _drawPoints[i];
+        vector_float3 minP = GSMinCornerForChunkAtPoint(pos);
+        long slot = slotIndexForChunk(chunkIndexForPoint(pos), _slotBox);
         GSChunkVAO *vao = [_chunkStore tryToGetVaoAtPoint:pos];
+        GSChunkVAO *oldVao = _drawList[slot];
+
+        if (oldVao && !vector_equal(oldVao.minP, minP)) {
+            oldVao = nil; // The slot held a chunk which has since left the active region.
+        }
+
+        // Keep drawing a VAO at the wrong level of detail until its replacement is ready.
+        if (!vao || vao.levelOfDetail != levelOfDetailForChunk(pos, _drawCenter)) {
+            uint32_t requested = _slotRequestFrame[slot];
+            if (requested == 0 || (_frame - requested) >= GSRequestRetryFrames) {
+                _slotRequestFrame[slot] = _frame;
+                [self scheduleChunkAtPoint:pos center:_drawCenter];
+            }
+        }
 
         if (vao) {
-            if (oldVao != vao) {
-                [_drawList addObject:vao];
-                
-                if (oldVao) {
-                    [vaosToRemove addObject:oldVao];
-                }
+            oldVao = vao;
+        }
+
+        _drawList[slot] = oldVao;
+        _slotDrawnFrame[slot] = _frame;
+
+        // Chunks are drawn nearest first.
+        [oldVao drawWithSkirts:skirtSidesForChunk(pos, oldVao.levelOfDetail, _drawCenter)];
+    }
+    GSStopwatchTraceStep(@"Finished drawing VAOs.");
+
+    // Drop VAOs which are no longer in the camera frustum.
+    if (activeSetChanged) {
+        for(NSUInteger slot = 0; slot < _numSlots; ++slot)
+        {
+            if (_slotDrawnFrame[slot] != _frame) {
+                _drawList[slot] = nil;
             }
-        } else {
-            chunkGenerationNeeded = YES;
         }
     }
-    
-    // Now remove those chunks which were marked for removal earlier.
-    for(GSChunkVAO *vao in vaosToRemove)
-    {
-        [_drawList removeObject:vao];
+
+    [_lockDrawList unlock];
+
+    //GSStopwatchTraceEnd(@"GSTerrainActiveRegion.draw");
+}
+
+/* Request the VAO for the chunk at `p' at the level of detail appropriate for the camera at `center'. Chunks which
+ * are already on their way through the pipeline are not requested again.
+ */
+- (void)scheduleChunkAtPoint:(vector_float3)p center:(vector_float3)center
+{
+    [_pipeline requestChunkAtPoint:p
+                     levelOfDetail:levelOfDetailForChunk(p, center)
+                           visible:YES
+                          distance:distanceToChunk(p, center)];
+}
+
+- (void)needsChunkGeneration
+{
+    if (self.shouldShutdown) {
+        return;
     }
-    GSStopwatchTraceStep(@"Finished building draw list.");
 
-    // Draw them all.
-    for(GSChunkVAO *vao in _drawList)
+    [_lockActiveSet lockForReading];
+    const vector_float3 *points = _activeSet[_front];
+    NSUInteger count = _activeSetCount[_front];
+    vector_float3 center = _activeSetCenter;
+
+    for(NSUInteger i = 0; i < count; ++i)
     {
-        [vao draw];
+        vector_float3 p = points[i];
+        GSChunkVAO *vao = [_chunkStore tryToGetVaoAtPoint:p];
+
+        if (!vao || (vao.levelOfDetail != levelOfDetailForChunk(p, center))) {
+            [self scheduleChunkAtPoint:p center:center];
+        }
     }
-    GSStopwatchTraceStep(@"Finished drawing VAOs.");
-    
-    [_lockDrawList unlock];
-    
-    if (chunkGenerationNeeded) {
-        [self needsChunkGeneration];
+
+    [_lockActiveSet unlockForReading];
+}
+
+- (void)updateWithCameraModifiedFlags:(unsigned)flags
+{
+    vector_float3 eye = _camera.cameraEye;
+    vector_long3 column = chunkIndexForPoint(eye);
+    column.y = 0;
+
+    // The active set only needs to be built again when the view has changed enough to matter.
+    BOOL stale = !_hasActiveSet
+              || (flags & CAMERA_TURNED)
+              || (column.x != _builtColumn.x) || (column.z != _builtColumn.z)
+              || (vector_distance(eye, _builtEye) > GSActiveSetSlop);
+
+    if (stale) {
+        [self buildActiveSetWithEye:eye column:column];
     }
-    
-    //GSStopwatchTraceEnd(@"GSTerrainActiveRegion.draw");
 }
 
-- (nonnull NSArray<GSBoxedVector *> *)pointsInCameraFrustum
+/* Finds the chunks in the camera frustum, and those predicted to come into view, and swaps the new set of visible
+ * chunks in for the display link thread. Chunks are visited in spiral order, so the set comes out nearest first
+ * without needing to be sorted.
+ */
+- (void)buildActiveSetWithEye:(vector_float3)eye column:(vector_long3)column
 {
-    NSMutableArray<GSBoxedVector *> *points = [NSMutableArray<GSBoxedVector *> new];
-    
+    BOOL columnChanged = !_hasActiveSet || (column.x != _builtColumn.x) || (column.z != _builtColumn.z);
+
+    if (columnChanged) {
+        // Slots now hold different chunks, so their previous state means nothing.
+        memset(_slotState, 0, _numSlots * sizeof(uint8_t));
+    } else {
+        for(NSUInteger i = 0; i < _numSlots; ++i)
+        {
+            _slotState[i] = (_slotState[i] & (GSActiveSlotVisible | GSActiveSlotPredicted)) << 2;
+        }
+    }
+
+    // Only the update thread touches the back buffer.
+    NSUInteger back = 1 - _front;
+    vector_float3 *points = _activeSet[back];
+    NSUInteger count = 0;
     GSFrustum *frustum = _camera.frustum;
-    vector_float3 center = _camera.cameraEye;
-    long activeRegionExtentX = _activeRegionExtent.x/CHUNK_SIZE_X;
-    long activeRegionExtentZ = _activeRegionExtent.z/CHUNK_SIZE_Z;
-    long activeRegionSizeY = _activeRegionExtent.y/CHUNK_SIZE_Y;
-    GSIntAABB activeRegion = {
-        .mins = { -activeRegionExtentX, 0, -activeRegionExtentZ },
-        .maxs = { activeRegionExtentX, activeRegionSizeY, activeRegionExtentZ }
-    };
 
-    vector_long3 p;
-    FOR_BOX(p, activeRegion)
+    for(NSUInteger i = 0; i < _numSlots; ++i)
     {
-        vector_float3 p1 = (vector_float3){center.x + p.x*CHUNK_SIZE_X, p.y*CHUNK_SIZE_Y, center.z + p.z*CHUNK_SIZE_Z};
-        vector_float3 centerP = (vector_float3){floorf(p1.x / CHUNK_SIZE_X) * CHUNK_SIZE_X + CHUNK_SIZE_X/2,
-                                                floorf(p1.y / CHUNK_SIZE_Y) * CHUNK_SIZE_Y + CHUNK_SIZE_Y/2,
-                                                floorf(p1.z / CHUNK_SIZE_Z) * CHUNK_SIZE_Z + CHUNK_SIZE_Z/2};
-        int result = chunkInFrustum(frustum, centerP);
-        if(GSFrustumOutside != result) {
-            [points addObject:[GSBoxedVector boxedVectorWithVector:centerP]];
+        vector_int3 offset = _spiral[i];
+        vector_long3 chunk = {column.x + offset.x, offset.y, column.z + offset.z};
+        vector_float3 p = centerOfChunk(chunk);
+
+        if (GSFrustumOutside != chunkInFrustum(frustum, p, GSActiveSetSlop)) {
+            points[count++] = p;
+            _slotState[slotIndexForChunk(chunk, _slotBox)] |= GSActiveSlotVisible;
         }
     }
-    
-    [points sortUsingComparator:^NSComparisonResult(GSBoxedVector *p1, GSBoxedVector *p2) {
-        float d1 = vector_distance([p1 vectorValue], center);
-        float d2 = vector_distance([p2 vectorValue], center);
-        
-        if (d1 > d2) {
-            return NSOrderedDescending;
-        } else if (d1 > d2) {
-            return NSOrderedAscending;
-        } else {
-            return NSOrderedSame;
-        }
-    }];
-    
-    return points;
+
+    [self predictChunksWithEye:eye column:column];
+
+    [_lockActiveSet lockForWriting];
+    _activeSetCount[back] = count;
+    _activeSetCenter = eye;
+    _front = back;
+    ++_activeSetGeneration;
+    [_lockActiveSet unlockForWriting];
+
+    _builtColumn = column;
+    _builtEye = eye;
+    _hasActiveSet = YES;
+
+    // Chunks which have left the camera frustum, and aren't about to come back, are no longer worth generating.
+    BOOL anyDropped = columnChanged;
+    for(NSUInteger i = 0; !anyDropped && i < _numSlots; ++i)
+    {
+        uint8_t state = _slotState[i];
+        anyDropped = (state & (GSActiveSlotWasVisible | GSActiveSlotWasPredicted)) &&
+                     !(state & (GSActiveSlotVisible | GSActiveSlotPredicted));
+    }
+
+    if (anyDropped) {
+        [_pipeline cancelRequestsPassingTest:^BOOL(vector_float3 minP) {
+            vector_long3 chunk = chunkIndexForPoint(minP);
+            vector_long3 offset = {chunk.x - column.x, chunk.y, chunk.z - column.z};
+
+            if (offset.x < -_slotBox.maxs.x/2 || offset.x >= _slotBox.maxs.x/2 ||
+                offset.z < -_slotBox.maxs.z/2 || offset.z >= _slotBox.maxs.z/2 ||
+                offset.y < 0 || offset.y >= _slotBox.maxs.y) {
+                return YES; // outside the active region
+            }
+
+            return !(_slotState[slotIndexForChunk(chunk, _slotBox)] & (GSActiveSlotVisible | GSActiveSlotPredicted));
+        }];
+    }
+
+    double now = GSStopwatchEnd(_startTime) / (double)NSEC_PER_SEC;
+    if (now - _lastPrefetchTrackerUpdate >= GSPrefetchTrackerInterval) {
+        _lastPrefetchTrackerUpdate = now;
+        [self updatePrefetchTrackerWithColumn:column time:now];
+    }
 }
 
-- (void)needsChunkGeneration
+/* Marks the chunks in the active region which the camera is predicted to see soon, assuming it keeps moving and
+ * turning as it has been, and prefetches those which were not predicted before. Does nothing when the camera is still.
+ */
+- (void)predictChunksWithEye:(vector_float3)eye column:(vector_long3)column
 {
-    if (self.shouldShutdown) {
+    if (vector_length(_camera.velocity) < GSPrefetchMinSpeed && fabsf(_camera.yawRate) < GSPrefetchMinYawRate) {
         return;
     }
-    
-    if (dispatch_semaphore_wait(_generationSema, DISPATCH_TIME_NOW)) {
-        // Drop the request on the floor because we don't want the queue to have too many outstanding chunks.
-        return;
+
+    for(int j = 0; j < GSPrefetchSamples; ++j)
+    {
+        [_camera predictFrustum:_predictedFrustums[j] afterInterval:GSPrefetchLookahead * (j+1) / GSPrefetchSamples];
     }
 
-    dispatch_async(_generationQueue, ^{
-        BOOL anyChunksMissing = NO;
-        uint64_t startAbs = GSStopwatchStart();
+    for(NSUInteger i = 0; i < _numSlots; ++i)
+    {
+        vector_int3 offset = _spiral[i];
+        vector_long3 chunk = {column.x + offset.x, offset.y, column.z + offset.z};
+        uint8_t *state = &_slotState[slotIndexForChunk(chunk, _slotBox)];
 
-        [_lockCachedPointsInCameraFrustum lockForReading];
-        NSObject<NSFastEnumeration> *points = [_cachedPointsInCameraFrustum copy];
-        [_lockCachedPointsInCameraFrustum unlockForReading];
+        if (*state & GSActiveSlotVisible) {
+            continue;
+        }
 
-        for(GSBoxedVector *position in points)
-        {
-            // Ensure VAO gets created, if it was missing.
-            (void)[_chunkStore nonBlockingVaoAtPoint:position createIfMissing:YES];
+        vector_float3 p = centerOfChunk(chunk);
 
-            uint64_t elapsedNs = GSStopwatchEnd(startAbs);
-            
-            if (elapsedNs > GSChunkCreationBudget) {
-                anyChunksMissing = YES;
+        for(int j = 0; j < GSPrefetchSamples; ++j)
+        {
+            if (GSFrustumOutside != chunkInFrustum(_predictedFrustums[j], p, GSActiveSetSlop)) {
+                *state |= GSActiveSlotPredicted;
+
+                // These come after all the visible chunks.
+                if (!(*state & GSActiveSlotWasPredicted)) {
+                    [_pipeline prefetchChunkAtPoint:p
+                                      levelOfDetail:levelOfDetailForChunk(p, eye)
+                                           distance:distanceToChunk(p, eye)];
+                }
                 break;
             }
         }
+    }
+}
 
-        if (anyChunksMissing) {
-            [self needsChunkGeneration]; // Pick this up again later.
+/* Reports the visible and predicted chunks to the prefetch tracker. This is sampled, rather than done on every build,
+ * as it must box each chunk.
+ */
+- (void)updatePrefetchTrackerWithColumn:(vector_long3)column time:(double)time
+{
+    NSMutableSet<GSBoxedVector *> *visible = [NSMutableSet new];
+    NSMutableSet<GSBoxedVector *> *predicted = [NSMutableSet new];
+
+    for(NSUInteger i = 0; i < _numSlots; ++i)
+    {
+        vector_int3 offset = _spiral[i];
+        vector_long3 chunk = {column.x + offset.x, offset.y, column.z + offset.z};
+        uint8_t state = _slotState[slotIndexForChunk(chunk, _slotBox)];
+
+        if (state & (GSActiveSlotVisible | GSActiveSlotPredicted)) {
+            vector_float3 minP = GSMinCornerForChunkAtPoint(centerOfChunk(chunk));
+            GSBoxedVector *corner = [GSBoxedVector boxedVectorWithVector:minP];
+            if (state & GSActiveSlotVisible) {
+                [visible addObject:corner];
+            } else {
+                [predicted addObject:corner];
+            }
         }
-        
-        dispatch_semaphore_signal(_generationSema);
-    });
+    }
+
+    [_prefetchTracker updateWithVisibleChunks:visible predictedChunks:predicted time:time];
 }
 
-- (void)updateWithCameraModifiedFlags:(unsigned)flags
+- (void)printInfo
 {
-    NSArray<GSBoxedVector *> *points = [self pointsInCameraFrustum];
-    [_lockCachedPointsInCameraFrustum lockForWriting];
-    _cachedPointsInCameraFrustum = points;
-    [_lockCachedPointsInCameraFrustum unlockForWriting];
+    [_lockActiveSet lockForReading];
+    NSUInteger count = _activeSetCount[_front];
+    [_lockActiveSet unlockForReading];
+
+    NSLog(@"Active Region: %lu chunks in view\n\t%@\n\t%@", (unsigned long)count, _pipeline, _prefetchTracker);
 }
 
 - (void)shutdown
 {
     self.shouldShutdown = YES;
 
-    dispatch_barrier_sync(_generationQueue, ^{}); // flush
+    [_pipeline shutdown];
 
     [_lockDrawList lock];
-    [_drawList removeAllObjects];
+    [self removeAllFromDrawList];
     [_lockDrawList unlock];
 }
 
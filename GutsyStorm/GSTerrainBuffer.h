@@ -57,6 +57,16 @@ static inline size_t BUFFER_SIZE_IN_BYTES(vector_long3 dimensions)
  */
 + (void)deallocateBuffer:(nullable GSTerrainBufferElement *)buffer len:(NSUInteger)len;
 
+/* Saves `length' bytes at `bytes' to file asynchronously on the specified dispatch queue and group.
+ * The bytes are copied before this method returns. Sticks the header to the front of the file, if one is provided.
+ */
++ (void)saveBytes:(nonnull const void *)bytes
+           length:(size_t)length
+           toFile:(nonnull NSURL *)url
+            queue:(nonnull dispatch_queue_t)queue
+            group:(nonnull dispatch_group_t)group
+           header:(nullable NSData *)header;
+
 @property (nonatomic, readonly) vector_long3 offsetFromChunkLocalSpace;
 @property (nonatomic, readonly) vector_long3 dimensions;
 
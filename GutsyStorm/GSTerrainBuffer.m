@@ -143,11 +143,14 @@ static const long OPEN_FILE_LIMIT = 100; // Don't open more than this many file
     }
 }
 
-- (void)saveToFile:(nonnull NSURL *)url
-             queue:(nonnull dispatch_queue_t)queue
-             group:(nonnull dispatch_group_t)group
-            header:(nullable NSData *)headerData
++ (void)saveBytes:(nonnull const void *)bytes
+           length:(size_t)length
+           toFile:(nonnull NSURL *)url
+            queue:(nonnull dispatch_queue_t)queue
+            group:(nonnull dispatch_group_t)group
+           header:(nullable NSData *)headerData
 {
+    NSParameterAssert(bytes);
     NSParameterAssert(url);
     NSParameterAssert([url isFileURL]);
     
@@ -170,14 +173,14 @@ static const long OPEN_FILE_LIMIT = 100; // Don't open more than this many file
     dispatch_data_t dd;
     
     if ([headerData length] == 0) {
-        dd = dispatch_data_create(_data, BUFFER_SIZE_IN_BYTES(self.dimensions),
+        dd = dispatch_data_create(bytes, length,
                                   dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0),
                                   DISPATCH_DATA_DESTRUCTOR_DEFAULT);
     } else {
         dispatch_data_t header = dispatch_data_create([headerData bytes], [headerData length],
                                       dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0),
                                       DISPATCH_DATA_DESTRUCTOR_DEFAULT);
-        dispatch_data_t terrain = dispatch_data_create(_data, BUFFER_SIZE_IN_BYTES(self.dimensions),
+        dispatch_data_t terrain = dispatch_data_create(bytes, length,
                                                        dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0),
                                                        DISPATCH_DATA_DESTRUCTOR_DEFAULT);
         dd = dispatch_data_create_concat(header, terrain);
@@ -199,6 +202,19 @@ static const long OPEN_FILE_LIMIT = 100; // Don't open more than this many file
     });
 }
 
+- (void)saveToFile:(nonnull NSURL *)url
+             queue:(nonnull dispatch_queue_t)queue
+             group:(nonnull dispatch_group_t)group
+            header:(nullable NSData *)headerData
+{
+    [[self class] saveBytes:_data
+                     length:BUFFER_SIZE_IN_BYTES(self.dimensions)
+                     toFile:url
+                      queue:queue
+                      group:group
+                     header:headerData];
+}
+
 - (nonnull instancetype)copySubBufferFromSubrange:(GSIntAABB * _Nonnull)srcBox
 {
     NSParameterAssert(srcBox && (srcBox->maxs.y - srcBox->mins.y == CHUNK_SIZE_Y));
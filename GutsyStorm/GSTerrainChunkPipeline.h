@@ -0,0 +1,71 @@
+//
+//  GSTerrainChunkPipeline.h
+//  GutsyStorm
+//
+//  Created by agent on 10/18/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <simd/vector.h>
+#import "GSTerrainChunkScheduler.h" // for GSTerrainChunkStage
+
+
+@class GSTerrainChunkStore;
+
+
+/* Produces VAOs for chunks in separately scheduled stages: voxels, sunlight, geometry, and upload. Voxels are
+ * scheduled for whole tiles of chunk columns, as that is how they are generated.
+ *
+ * A stage is scheduled only once its inputs are present in the chunk store, so no job generates the inputs of another
+ * stage itself, and jobs don't wait on each other's locks. Sunlight for a chunk is ready once the voxels it reads are
+ * present, geometry once the sunlight is present, and the upload once the geometry is present. Chunks at coarse levels
+ * of detail are meshed during the upload, as their geometry is not kept in the chunk store.
+ *
+ * All stages share one pool of worker threads, so throughput scales with the number of cores.
+ */
+@interface GSTerrainChunkPipeline : NSObject
+
+- (nonnull instancetype)init NS_UNAVAILABLE;
+
+- (nonnull instancetype)initWithChunkStore:(nonnull GSTerrainChunkStore *)chunkStore
+                         maxConcurrentJobs:(NSUInteger)maxConcurrentJobs NS_DESIGNATED_INITIALIZER;
+
+/* Request the VAO for the chunk which contains the specified point, at the specified level of detail. Requesting a
+ * chunk which is already on its way through the pipeline only updates the priority of its pending jobs, unless the
+ * level of detail differs, the chunk has become visible, or the chunk was only being prefetched.
+ *
+ * Parameters:
+ * visible -- Whether the chunk is in the camera frustum. Visible chunks are produced first.
+ * distance -- Distance from the camera to the chunk. Nearer chunks are produced first.
+ */
+- (void)requestChunkAtPoint:(vector_float3)p
+              levelOfDetail:(NSUInteger)levelOfDetail
+                    visible:(BOOL)visible
+                   distance:(float)distance;
+
+/* Generate the voxels, sunlight, and geometry for the chunk which contains the specified point, but don't upload it.
+ * Prefetched chunks come after all visible chunks. Prefetching a chunk which has already been requested has no effect.
+ *
+ * Parameters:
+ * levelOfDetail -- The level of detail at which the chunk is expected to be drawn. Only sunlight is needed at coarse
+ *                  levels of detail.
+ * distance -- Distance from the camera to the chunk. Nearer chunks are produced first.
+ */
+- (void)prefetchChunkAtPoint:(vector_float3)p
+               levelOfDetail:(NSUInteger)levelOfDetail
+                    distance:(float)distance;
+
+/* Cancel each request for which the predicate returns YES, along with any pending jobs needed only by those. */
+- (void)cancelRequestsPassingTest:(BOOL (^ _Nonnull)(vector_float3 minP))predicate;
+
+/* The number of jobs for the specified stage which are waiting to run. */
+- (NSUInteger)queueDepthForStage:(GSTerrainChunkStage)stage;
+
+/* Block until the pipeline has no more work to do. */
+- (void)waitUntilIdle;
+
+/* Cancel all requests and wait for running jobs to complete. */
+- (void)shutdown;
+
+@end
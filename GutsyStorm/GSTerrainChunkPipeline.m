@@ -0,0 +1,427 @@
+//
+//  GSTerrainChunkPipeline.m
+//  GutsyStorm
+//
+//  Created by agent on 10/18/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#import "GSTerrainChunkPipeline.h"
+#import "GSTerrainChunkStore.h"
+#import "GSBoxedVector.h"
+#import "GSChunkVAO.h"
+#import "GSVoxel.h" // for GSMinCornerForChunkAtPoint
+
+
+/* How long to wait before looking again at a chunk whose data someone else holds the lock on. */
+static const int64_t GSTerrainChunkPipelineRetryDelay = NSEC_PER_SEC / 100;
+
+
+/* A VAO which has been requested from the pipeline, and which it has not finished producing. */
+@interface GSTerrainChunkPipelineRequest : NSObject
+
+@property (nonatomic) vector_float3 minP;
+@property (nonatomic) NSUInteger levelOfDetail;
+@property (nonatomic) BOOL visible;
+@property (nonatomic) float distance;
+
+/* If YES then the request is finished once the chunk is ready to upload. */
+@property (nonatomic) BOOL prefetch;
+
+/* The stage of the jobs which were last scheduled for the request, and the chunks they were scheduled for. These are
+ * reprioritized when the request's distance or visibility changes.
+ */
+@property (nonatomic) GSTerrainChunkStage scheduledStage;
+@property (nonatomic, nullable) NSArray<GSBoxedVector *> *scheduledPoints;
+
+@end
+
+@implementation GSTerrainChunkPipelineRequest
+@end
+
+
+@implementation GSTerrainChunkPipeline
+{
+    GSTerrainChunkStore *_chunkStore;
+    GSTerrainChunkScheduler *_scheduler;
+
+    /* Holds a request's retry for as long as it is waiting to run. See -retryRequestForKey: */
+    dispatch_group_t _groupForRetries;
+
+    /* Protects all of the following. */
+    NSLock *_lock;
+
+    /* Maps the min corner of a chunk to the outstanding request for it. */
+    NSMutableDictionary<GSBoxedVector *, GSTerrainChunkPipelineRequest *> *_requests;
+
+    /* Maps the min corner of a voxel tile to the requested chunks whose sunlight is waiting on it. */
+    NSMutableDictionary<GSBoxedVector *, NSMutableSet<GSBoxedVector *> *> *_waitingForVoxels;
+}
+
+- (nonnull instancetype)initWithChunkStore:(nonnull GSTerrainChunkStore *)chunkStore
+                         maxConcurrentJobs:(NSUInteger)maxConcurrentJobs
+{
+    NSParameterAssert(chunkStore);
+    NSParameterAssert(maxConcurrentJobs > 0);
+
+    if (self = [super init]) {
+        _chunkStore = chunkStore;
+        _lock = [NSLock new];
+        _lock.name = @"GSTerrainChunkPipeline.lock";
+        _requests = [NSMutableDictionary new];
+        _waitingForVoxels = [NSMutableDictionary new];
+        _groupForRetries = dispatch_group_create();
+
+        __weak GSTerrainChunkPipeline *weakSelf = self;
+        _scheduler = [[GSTerrainChunkScheduler alloc] initWithName:@"GSTerrainChunkPipeline.scheduler"
+                                                  maxConcurrentJobs:maxConcurrentJobs
+                                                                job:^(vector_float3 minP,
+                                                                      GSTerrainChunkStage stage,
+                                                                      NSUInteger levelOfDetail) {
+            [weakSelf runStage:stage atPoint:minP levelOfDetail:levelOfDetail];
+        }];
+    }
+
+    return self;
+}
+
+- (nonnull NSString *)description
+{
+    return [NSString stringWithFormat:@"%@: queue depths voxels=%lu sunlight=%lu geometry=%lu upload=%lu, "
+                                      @"running=%lu",
+            [super description],
+            (unsigned long)[self queueDepthForStage:GSTerrainChunkStageVoxels],
+            (unsigned long)[self queueDepthForStage:GSTerrainChunkStageSunlight],
+            (unsigned long)[self queueDepthForStage:GSTerrainChunkStageGeometry],
+            (unsigned long)[self queueDepthForStage:GSTerrainChunkStageUpload],
+            (unsigned long)_scheduler.numberOfRunningJobs];
+}
+
+- (NSUInteger)queueDepthForStage:(GSTerrainChunkStage)stage
+{
+    return [_scheduler numberOfPendingJobsForStage:stage];
+}
+
+- (void)requestChunkAtPoint:(vector_float3)p
+              levelOfDetail:(NSUInteger)levelOfDetail
+                    visible:(BOOL)visible
+                   distance:(float)distance
+{
+    vector_float3 minP = GSMinCornerForChunkAtPoint(p);
+    GSBoxedVector *key = [GSBoxedVector boxedVectorWithVector:minP];
+
+    [_lock lock];
+    GSTerrainChunkPipelineRequest *request = _requests[key];
+    // A chunk which has become visible must have its pending jobs moved ahead of the invisible ones.
+    BOOL alreadyRequested = request && (request.levelOfDetail == levelOfDetail) && !request.prefetch
+                         && (request.visible || !visible);
+    // Otherwise, the jobs already scheduled for it must move to reflect where the camera is now.
+    BOOL reprioritize = alreadyRequested && (request.visible != visible || request.distance != distance);
+    GSTerrainChunkStage scheduledStage = request.scheduledStage;
+    NSArray<GSBoxedVector *> *scheduledPoints = request.scheduledPoints;
+    if (!request) {
+        request = [GSTerrainChunkPipelineRequest new];
+        request.minP = minP;
+        _requests[key] = request;
+    }
+    request.levelOfDetail = levelOfDetail;
+    request.visible = visible;
+    request.distance = distance;
+    request.prefetch = NO;
+    [_lock unlock];
+
+    if (!alreadyRequested) {
+        [self advanceRequestForKey:key];
+    } else if (reprioritize) {
+        for(GSBoxedVector *scheduledKey in scheduledPoints)
+        {
+            [_scheduler reprioritizeChunkAtPoint:[scheduledKey vectorValue]
+                                           stage:scheduledStage
+                                         visible:visible
+                                        distance:distance];
+        }
+    }
+}
+
+- (void)prefetchChunkAtPoint:(vector_float3)p
+               levelOfDetail:(NSUInteger)levelOfDetail
+                    distance:(float)distance
+{
+    vector_float3 minP = GSMinCornerForChunkAtPoint(p);
+    GSBoxedVector *key = [GSBoxedVector boxedVectorWithVector:minP];
+
+    [_lock lock];
+    GSTerrainChunkPipelineRequest *request = _requests[key];
+    BOOL alreadyRequested = (request != nil);
+    if (!request) {
+        request = [GSTerrainChunkPipelineRequest new];
+        request.minP = minP;
+        request.levelOfDetail = levelOfDetail;
+        request.visible = NO;
+        request.distance = distance;
+        request.prefetch = YES;
+        _requests[key] = request;
+    } else if (request.prefetch) {
+        request.distance = distance;
+    }
+    [_lock unlock];
+
+    if (!alreadyRequested) {
+        [self advanceRequestForKey:key];
+    }
+}
+
+- (void)cancelRequestsPassingTest:(BOOL (^ _Nonnull)(vector_float3 minP))predicate
+{
+    NSParameterAssert(predicate);
+
+    NSMutableSet<GSBoxedVector *> *orphanedVoxels = [NSMutableSet new];
+
+    [_lock lock];
+
+    NSMutableArray<GSBoxedVector *> *cancelled = [NSMutableArray new];
+    for(GSBoxedVector *key in _requests)
+    {
+        if (predicate([key vectorValue])) {
+            [cancelled addObject:key];
+        }
+    }
+    [_requests removeObjectsForKeys:cancelled];
+
+    // Voxels which are no longer needed by any outstanding request need not be generated.
+    for(GSBoxedVector *voxelsKey in _waitingForVoxels)
+    {
+        NSMutableSet<GSBoxedVector *> *waiting = _waitingForVoxels[voxelsKey];
+        [waiting minusSet:[NSSet setWithArray:cancelled]];
+        if (waiting.count == 0) {
+            [orphanedVoxels addObject:voxelsKey];
+        }
+    }
+    [_waitingForVoxels removeObjectsForKeys:[orphanedVoxels allObjects]];
+
+    [_lock unlock];
+
+    [_scheduler cancelJobsPassingTest:^BOOL(vector_float3 minP, GSTerrainChunkStage stage) {
+        if (stage == GSTerrainChunkStageVoxels) {
+            return [orphanedVoxels containsObject:[GSBoxedVector boxedVectorWithVector:minP]];
+        } else {
+            return predicate(minP);
+        }
+    }];
+}
+
+- (void)waitUntilIdle
+{
+    // Jobs may retry requests, and retries may schedule jobs, so wait until neither has anything left to do.
+    do {
+        dispatch_group_wait(_groupForRetries, DISPATCH_TIME_FOREVER);
+        [_scheduler waitUntilIdle];
+    } while(dispatch_group_wait(_groupForRetries, DISPATCH_TIME_NOW) != 0);
+}
+
+- (void)shutdown
+{
+    [_lock lock];
+    [_requests removeAllObjects];
+    [_waitingForVoxels removeAllObjects];
+    [_lock unlock];
+
+    [_scheduler shutdown];
+    dispatch_group_wait(_groupForRetries, DISPATCH_TIME_FOREVER);
+}
+
+/* Schedules the next stage for the requested chunk, according to what is already present in the chunk store. */
+- (void)advanceRequestForKey:(nonnull GSBoxedVector *)key
+{
+    [_lock lock];
+    GSTerrainChunkPipelineRequest *request = _requests[key];
+    vector_float3 minP = request.minP;
+    NSUInteger levelOfDetail = request.levelOfDetail;
+    BOOL visible = request.visible;
+    float distance = request.distance;
+    BOOL prefetch = request.prefetch;
+    [_lock unlock];
+
+    if (!request) {
+        return; // cancelled, or finished
+    }
+
+    GSChunkVAO *vao = [_chunkStore tryToGetVaoAtPoint:minP];
+    if (vao && vao.levelOfDetail == levelOfDetail) {
+        [self finishRequestForKey:key];
+        return;
+    }
+
+    GSTerrainChunkStage next;
+    GSChunkPresence geometry = [_chunkStore presenceOfGeometryAtPoint:minP];
+    GSChunkPresence sunlight = [_chunkStore presenceOfSunlightAtPoint:minP];
+
+    if (geometry == GSChunkPresent || (levelOfDetail > 0 && sunlight == GSChunkPresent)) {
+        next = GSTerrainChunkStageUpload;
+    } else if ((levelOfDetail == 0 && geometry == GSChunkBusy) || sunlight == GSChunkBusy) {
+        // Someone else is producing or changing the chunk right now. Look again once they're done, rather than
+        // schedule a job which would wait on them.
+        [self retryRequestForKey:key];
+        return;
+    } else if (sunlight == GSChunkPresent) {
+        next = GSTerrainChunkStageGeometry;
+    } else {
+        // Voxels are generated a whole tile at a time, so there is one job for each tile with missing voxels. Jobs
+        // for separate chunks of the same tile would each generate the entire tile.
+        NSMutableArray<GSBoxedVector *> *missing = [NSMutableArray new];
+        NSMutableSet<GSBoxedVector *> *missingTiles = [NSMutableSet new];
+        __block BOOL busy = NO;
+        [_chunkStore enumerateVoxelDependenciesOfSunlightAtPoint:minP usingBlock:^(vector_float3 voxelsP) {
+            GSChunkPresence voxels = [_chunkStore presenceOfVoxelsAtPoint:voxelsP];
+            if (voxels == GSChunkBusy) {
+                busy = YES;
+            } else if (voxels == GSChunkAbsent) {
+                vector_float3 tileMinP = [_chunkStore minCornerOfVoxelTileAtPoint:voxelsP];
+                [missing addObject:[GSBoxedVector boxedVectorWithVector:voxelsP]];
+                [missingTiles addObject:[GSBoxedVector boxedVectorWithVector:tileMinP]];
+            }
+        }];
+
+        if (busy) {
+            [self retryRequestForKey:key];
+            return;
+        }
+
+        if (missing.count > 0) {
+            [_lock lock];
+            request.scheduledStage = GSTerrainChunkStageVoxels;
+            request.scheduledPoints = [missingTiles allObjects];
+            for(GSBoxedVector *voxelsKey in missingTiles)
+            {
+                NSMutableSet<GSBoxedVector *> *waiting = _waitingForVoxels[voxelsKey];
+                if (!waiting) {
+                    waiting = [NSMutableSet new];
+                    _waitingForVoxels[voxelsKey] = waiting;
+                }
+                [waiting addObject:key];
+            }
+            [_lock unlock];
+
+            for(GSBoxedVector *voxelsKey in missingTiles)
+            {
+                [_scheduler scheduleChunkAtPoint:[voxelsKey vectorValue]
+                                           stage:GSTerrainChunkStageVoxels
+                                   levelOfDetail:0
+                                         visible:visible
+                                        distance:distance];
+            }
+
+            // A voxel job may have finished between checking for its output and registering to wait on it. Look
+            // again, so the request can't stall.
+            for(GSBoxedVector *voxelsKey in missing)
+            {
+                if ([_chunkStore presenceOfVoxelsAtPoint:[voxelsKey vectorValue]] != GSChunkPresent) {
+                    return;
+                }
+            }
+
+            // All the voxels are present, so nothing will wake this request. Take it off the waiting lists, or the
+            // entries made for voxel jobs which had already finished would never be removed.
+            [_lock lock];
+            for(GSBoxedVector *voxelsKey in missingTiles)
+            {
+                NSMutableSet<GSBoxedVector *> *waiting = _waitingForVoxels[voxelsKey];
+                [waiting removeObject:key];
+                if (waiting && waiting.count == 0) {
+                    [_waitingForVoxels removeObjectForKey:voxelsKey];
+                }
+            }
+            [_lock unlock];
+        }
+
+        next = GSTerrainChunkStageSunlight;
+    }
+
+    if (prefetch && next == GSTerrainChunkStageUpload) {
+        // The chunk is ready for when it becomes visible.
+        [self finishRequestForKey:key];
+        return;
+    }
+
+    [_lock lock];
+    request.scheduledStage = next;
+    request.scheduledPoints = @[key];
+    [_lock unlock];
+
+    [_scheduler scheduleChunkAtPoint:minP
+                               stage:next
+                       levelOfDetail:(next == GSTerrainChunkStageUpload) ? levelOfDetail : 0
+                             visible:visible
+                            distance:distance];
+}
+
+/* Advances the request again after a short delay. This is for when someone else holds the lock on the chunk's data,
+ * so that the request neither produces the data again nor ties up a worker waiting on the lock.
+ */
+- (void)retryRequestForKey:(nonnull GSBoxedVector *)key
+{
+    __weak GSTerrainChunkPipeline *weakSelf = self;
+    dispatch_group_t group = _groupForRetries;
+
+    dispatch_group_enter(group);
+    dispatch_after(dispatch_time(DISPATCH_TIME_NOW, GSTerrainChunkPipelineRetryDelay),
+                   dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^{
+        [weakSelf advanceRequestForKey:key];
+        dispatch_group_leave(group);
+    });
+}
+
+- (void)finishRequestForKey:(nonnull GSBoxedVector *)key
+{
+    [_lock lock];
+    [_requests removeObjectForKey:key];
+    [_lock unlock];
+}
+
+/* Called on a worker thread to run one stage for one chunk, whose inputs are expected to be present. */
+- (void)runStage:(GSTerrainChunkStage)stage atPoint:(vector_float3)minP levelOfDetail:(NSUInteger)levelOfDetail
+{
+    GSBoxedVector *key = [GSBoxedVector boxedVectorWithVector:minP];
+
+    switch(stage)
+    {
+        case GSTerrainChunkStageVoxels:
+        {
+            [_chunkStore chunkVoxelsForTileAtPoint:minP];
+
+            [_lock lock];
+            NSSet<GSBoxedVector *> *waiting = _waitingForVoxels[key];
+            [_waitingForVoxels removeObjectForKey:key];
+            [_lock unlock];
+
+            for(GSBoxedVector *waitingKey in waiting)
+            {
+                [self advanceRequestForKey:waitingKey];
+            }
+            break;
+        }
+
+        case GSTerrainChunkStageSunlight:
+            (void)[_chunkStore chunkSunlightAtPoint:minP];
+            [self advanceRequestForKey:key];
+            break;
+
+        case GSTerrainChunkStageGeometry:
+            (void)[_chunkStore chunkGeometryAtPoint:minP];
+            [self advanceRequestForKey:key];
+            break;
+
+        case GSTerrainChunkStageUpload:
+            // This fails if someone else holds the VAO slot. Either way, the request is finished. If the VAO is
+            // still missing then it will be requested again the next time the active region looks for it.
+            (void)[_chunkStore nonBlockingVaoAtPoint:key levelOfDetail:levelOfDetail createIfMissing:YES];
+            [self finishRequestForKey:key];
+            break;
+
+        default:
+            assert(!"unreachable");
+            break;
+    }
+}
+
+@end
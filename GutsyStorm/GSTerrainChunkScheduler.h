@@ -0,0 +1,89 @@
+//
+//  GSTerrainChunkScheduler.h
+//  GutsyStorm
+//
+//  Created by agent on 10/18/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <simd/vector.h>
+
+
+/* The stages through which a chunk passes on its way to being drawn. Each stage reads the output of the ones before. */
+typedef enum
+{
+    GSTerrainChunkStageVoxels = 0,
+    GSTerrainChunkStageSunlight,
+    GSTerrainChunkStageGeometry,
+    GSTerrainChunkStageUpload,
+    GSNumTerrainChunkStages
+} GSTerrainChunkStage;
+
+
+/* Runs the specified stage for the chunk with the specified min corner, at the specified level of detail. */
+typedef void (^GSTerrainChunkJob)(vector_float3 minP, GSTerrainChunkStage stage, NSUInteger levelOfDetail);
+
+
+/* Schedules stages of chunk generation on a pool of worker threads, in priority order.
+ *
+ * Jobs for chunks in the camera frustum come before those outside it, and nearer chunks come before farther ones. For
+ * chunks at the same distance, later stages come first so that chunks which have been started are finished. Each
+ * stage of each chunk has at most one pending job. Scheduling a job which is already pending updates it in place, and
+ * scheduling a job which is running at the same level of detail runs it again once it finishes, since its inputs may
+ * have changed after it read them. Pending jobs may be cancelled, such as when their chunks leave the active region.
+ *
+ * All workers take jobs from the same queue, so no worker is idle while any job is pending.
+ */
+@interface GSTerrainChunkScheduler : NSObject
+
+/* The number of jobs which have been scheduled and have not yet started. */
+@property (nonatomic, readonly) NSUInteger numberOfPendingJobs;
+
+/* The number of jobs which are running right now. */
+@property (nonatomic, readonly) NSUInteger numberOfRunningJobs;
+
+- (nonnull instancetype)init NS_UNAVAILABLE;
+
+/* Initialize the scheduler.
+ *
+ * Parameters:
+ * name -- Used to name the queue on which the workers run.
+ * maxConcurrentJobs -- The maximum number of worker threads.
+ * job -- Called on a worker thread to run each scheduled job.
+ */
+- (nonnull instancetype)initWithName:(nonnull NSString *)name
+                   maxConcurrentJobs:(NSUInteger)maxConcurrentJobs
+                                 job:(nonnull GSTerrainChunkJob)job NS_DESIGNATED_INITIALIZER;
+
+/* The number of jobs for the specified stage which have been scheduled and have not yet started. */
+- (NSUInteger)numberOfPendingJobsForStage:(GSTerrainChunkStage)stage;
+
+/* Schedule the specified stage for the chunk which contains the specified point. */
+- (void)scheduleChunkAtPoint:(vector_float3)p
+                       stage:(GSTerrainChunkStage)stage
+               levelOfDetail:(NSUInteger)levelOfDetail
+                     visible:(BOOL)visible
+                    distance:(float)distance;
+
+/* Update the priority of the pending job for the specified stage of the chunk which contains the specified point, such
+ * as when the camera has moved. Has no effect if no such job is pending, and never schedules one.
+ */
+- (void)reprioritizeChunkAtPoint:(vector_float3)p
+                           stage:(GSTerrainChunkStage)stage
+                         visible:(BOOL)visible
+                        distance:(float)distance;
+
+/* Cancel each pending job for which the predicate returns YES. Jobs which have already started run to completion. */
+- (void)cancelJobsPassingTest:(BOOL (^ _Nonnull)(vector_float3 minP, GSTerrainChunkStage stage))predicate;
+
+/* Cancel all pending jobs. */
+- (void)cancelAllJobs;
+
+/* Block until there are no pending or running jobs. */
+- (void)waitUntilIdle;
+
+/* Cancel all pending jobs, wait for running jobs to complete, and refuse to schedule any more. */
+- (void)shutdown;
+
+@end
@@ -0,0 +1,422 @@
+//
+//  GSTerrainChunkScheduler.m
+//  GutsyStorm
+//
+//  Created by agent on 10/18/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#import "GSTerrainChunkScheduler.h"
+#import "GSBoxedVector.h"
+#import "GSVoxel.h" // for GSMinCornerForChunkAtPoint
+
+
+/* A request to generate a chunk, which sits in the scheduler's heap until a worker takes it. */
+@interface GSTerrainChunkRequest : NSObject
+
+@property (nonatomic) vector_float3 minP;
+@property (nonatomic) GSTerrainChunkStage stage;
+@property (nonatomic) NSUInteger levelOfDetail;
+@property (nonatomic) BOOL visible;
+@property (nonatomic) float distance;
+@property (nonatomic, nonnull) GSBoxedVector *key;
+
+/* The index of the request in the heap. */
+@property (nonatomic) NSUInteger heapIndex;
+
+/* Set while the request is running if the same job is scheduled again, so that it runs again once it finishes. */
+@property (nonatomic) BOOL rerun;
+
+@end
+
+@implementation GSTerrainChunkRequest
+@end
+
+
+/* Returns YES if request `a' should run before request `b'. */
+static BOOL requestPrecedes(GSTerrainChunkRequest *a, GSTerrainChunkRequest *b)
+{
+    if (a.visible != b.visible) {
+        return a.visible;
+    }
+
+    if (a.distance != b.distance) {
+        return a.distance < b.distance;
+    }
+
+    return a.stage > b.stage;
+}
+
+
+@implementation GSTerrainChunkScheduler
+{
+    GSTerrainChunkJob _job;
+    NSUInteger _maxConcurrentJobs;
+    dispatch_queue_t _queue;
+    dispatch_group_t _group;
+
+    /* Protects all of the following. */
+    NSLock *_lock;
+
+    /* Binary min-heap of pending requests, ordered by requestPrecedes(). */
+    NSMutableArray<GSTerrainChunkRequest *> *_heap;
+
+    /* For each stage, maps the min corner of a chunk to its pending request. */
+    NSArray<NSMutableDictionary<GSBoxedVector *, GSTerrainChunkRequest *> *> *_pending;
+
+    /* For each stage, maps the min corner of a chunk to its requests which are running, by level of detail. A chunk may
+     * be in progress at two levels of detail at once.
+     */
+    NSArray<NSMutableDictionary<GSBoxedVector *,
+                                NSMutableDictionary<NSNumber *, GSTerrainChunkRequest *> *> *> *_running;
+    NSUInteger _numRunning;
+
+    NSUInteger _numWorkers;
+    BOOL _shutdown;
+}
+
+- (nonnull instancetype)initWithName:(nonnull NSString *)name
+                   maxConcurrentJobs:(NSUInteger)maxConcurrentJobs
+                                 job:(nonnull GSTerrainChunkJob)job
+{
+    NSParameterAssert(name);
+    NSParameterAssert(maxConcurrentJobs > 0);
+    NSParameterAssert(job);
+
+    if (self = [super init]) {
+        _job = [job copy];
+        _maxConcurrentJobs = maxConcurrentJobs;
+        _queue = dispatch_queue_create([name UTF8String], DISPATCH_QUEUE_CONCURRENT);
+        _group = dispatch_group_create();
+        _lock = [NSLock new];
+        _lock.name = [name stringByAppendingString:@".lock"];
+        _heap = [NSMutableArray new];
+
+        NSMutableArray *pending = [NSMutableArray new], *running = [NSMutableArray new];
+        for(GSTerrainChunkStage stage = 0; stage < GSNumTerrainChunkStages; ++stage)
+        {
+            [pending addObject:[NSMutableDictionary new]];
+            [running addObject:[NSMutableDictionary new]];
+        }
+        _pending = pending;
+        _running = running;
+
+        _numRunning = 0;
+        _numWorkers = 0;
+        _shutdown = NO;
+    }
+
+    return self;
+}
+
+- (NSUInteger)numberOfPendingJobs
+{
+    [_lock lock];
+    NSUInteger count = _heap.count;
+    [_lock unlock];
+    return count;
+}
+
+- (NSUInteger)numberOfRunningJobs
+{
+    [_lock lock];
+    NSUInteger count = _numRunning;
+    [_lock unlock];
+    return count;
+}
+
+- (NSUInteger)numberOfPendingJobsForStage:(GSTerrainChunkStage)stage
+{
+    NSParameterAssert(stage < GSNumTerrainChunkStages);
+
+    [_lock lock];
+    NSUInteger count = _pending[stage].count;
+    [_lock unlock];
+    return count;
+}
+
+#pragma mark Heap
+
+- (void)swapRequestAtIndex:(NSUInteger)i withRequestAtIndex:(NSUInteger)j
+{
+    [_heap exchangeObjectAtIndex:i withObjectAtIndex:j];
+    _heap[i].heapIndex = i;
+    _heap[j].heapIndex = j;
+}
+
+- (void)siftUp:(NSUInteger)i
+{
+    while(i > 0)
+    {
+        NSUInteger parent = (i - 1) / 2;
+
+        if (!requestPrecedes(_heap[i], _heap[parent])) {
+            break;
+        }
+
+        [self swapRequestAtIndex:i withRequestAtIndex:parent];
+        i = parent;
+    }
+}
+
+- (void)siftDown:(NSUInteger)i
+{
+    const NSUInteger count = _heap.count;
+
+    while(YES)
+    {
+        NSUInteger left = 2*i + 1, right = 2*i + 2, best = i;
+
+        if (left < count && requestPrecedes(_heap[left], _heap[best])) {
+            best = left;
+        }
+
+        if (right < count && requestPrecedes(_heap[right], _heap[best])) {
+            best = right;
+        }
+
+        if (best == i) {
+            break;
+        }
+
+        [self swapRequestAtIndex:i withRequestAtIndex:best];
+        i = best;
+    }
+}
+
+- (void)insertRequest:(nonnull GSTerrainChunkRequest *)request
+{
+    request.heapIndex = _heap.count;
+    [_heap addObject:request];
+    _pending[request.stage][request.key] = request;
+    [self siftUp:request.heapIndex];
+}
+
+- (void)removeRequestAtIndex:(NSUInteger)i
+{
+    GSTerrainChunkRequest *request = _heap[i];
+    NSUInteger last = _heap.count - 1;
+
+    if (i != last) {
+        [self swapRequestAtIndex:i withRequestAtIndex:last];
+    }
+
+    [_heap removeLastObject];
+    [_pending[request.stage] removeObjectForKey:request.key];
+
+    if (i < _heap.count) {
+        [self siftUp:i];
+        [self siftDown:_heap[i].heapIndex];
+    }
+}
+
+#pragma mark Scheduling
+
+- (void)scheduleChunkAtPoint:(vector_float3)p
+                       stage:(GSTerrainChunkStage)stage
+               levelOfDetail:(NSUInteger)levelOfDetail
+                     visible:(BOOL)visible
+                    distance:(float)distance
+{
+    NSParameterAssert(stage < GSNumTerrainChunkStages);
+
+    vector_float3 minP = GSMinCornerForChunkAtPoint(p);
+    GSBoxedVector *key = [GSBoxedVector boxedVectorWithVector:minP];
+
+    [_lock lock];
+
+    if (_shutdown) {
+        [_lock unlock];
+        return;
+    }
+
+    GSTerrainChunkRequest *running = _running[stage][key][@(levelOfDetail)];
+    GSTerrainChunkRequest *request = _pending[stage][key];
+
+    if (running) {
+        // The job is running right now, and may have read its inputs before whatever prompted this. Rather than run it
+        // alongside itself, run it again once it finishes. Any pending request for it is stale.
+        running.rerun = YES;
+        running.visible = visible;
+        running.distance = distance;
+        if (request) {
+            [self removeRequestAtIndex:request.heapIndex];
+        }
+    } else if (request) {
+        request.levelOfDetail = levelOfDetail;
+        request.visible = visible;
+        request.distance = distance;
+        [self siftUp:request.heapIndex];
+        [self siftDown:request.heapIndex];
+    } else {
+        request = [GSTerrainChunkRequest new];
+        request.minP = minP;
+        request.stage = stage;
+        request.levelOfDetail = levelOfDetail;
+        request.visible = visible;
+        request.distance = distance;
+        request.key = key;
+        [self insertRequest:request];
+    }
+
+    BOOL spawnWorker = (_heap.count > 0) && (_numWorkers < _maxConcurrentJobs);
+    if (spawnWorker) {
+        ++_numWorkers;
+    }
+
+    [_lock unlock];
+
+    if (spawnWorker) {
+        dispatch_group_async(_group, _queue, ^{
+            [self workerLoop];
+        });
+    }
+}
+
+- (void)reprioritizeChunkAtPoint:(vector_float3)p
+                           stage:(GSTerrainChunkStage)stage
+                         visible:(BOOL)visible
+                        distance:(float)distance
+{
+    NSParameterAssert(stage < GSNumTerrainChunkStages);
+
+    GSBoxedVector *key = [GSBoxedVector boxedVectorWithVector:GSMinCornerForChunkAtPoint(p)];
+
+    [_lock lock];
+    GSTerrainChunkRequest *request = _pending[stage][key];
+    if (request) {
+        request.visible = visible;
+        request.distance = distance;
+        [self siftUp:request.heapIndex];
+        [self siftDown:request.heapIndex];
+    }
+    [_lock unlock];
+}
+
+- (void)cancelJobsPassingTest:(BOOL (^ _Nonnull)(vector_float3 minP, GSTerrainChunkStage stage))predicate
+{
+    NSParameterAssert(predicate);
+
+    [_lock lock];
+
+    // Removing a request reorders the heap, so find them all before removing any.
+    NSMutableArray<GSTerrainChunkRequest *> *cancelled = [NSMutableArray new];
+    for(GSTerrainChunkRequest *request in _heap)
+    {
+        if (predicate(request.minP, request.stage)) {
+            [cancelled addObject:request];
+        }
+    }
+
+    for(GSTerrainChunkRequest *request in cancelled)
+    {
+        [self removeRequestAtIndex:request.heapIndex];
+    }
+
+    [self cancelRerunsPassingTest:predicate];
+
+    [_lock unlock];
+}
+
+/* Running jobs can't be cancelled, but any runs which are due after them can be. */
+- (void)cancelRerunsPassingTest:(BOOL (^ _Nonnull)(vector_float3 minP, GSTerrainChunkStage stage))predicate
+{
+    for(NSDictionary<GSBoxedVector *, NSDictionary<NSNumber *, GSTerrainChunkRequest *> *> *running in _running)
+    {
+        for(GSBoxedVector *key in running)
+        {
+            for(GSTerrainChunkRequest *request in [running[key] objectEnumerator])
+            {
+                if (request.rerun && predicate(request.minP, request.stage)) {
+                    request.rerun = NO;
+                }
+            }
+        }
+    }
+}
+
+- (void)removeAllRequests
+{
+    [_heap removeAllObjects];
+
+    for(NSMutableDictionary *pending in _pending)
+    {
+        [pending removeAllObjects];
+    }
+
+    [self cancelRerunsPassingTest:^BOOL(vector_float3 minP, GSTerrainChunkStage stage) {
+        return YES;
+    }];
+}
+
+- (void)cancelAllJobs
+{
+    [_lock lock];
+    [self removeAllRequests];
+    [_lock unlock];
+}
+
+- (void)waitUntilIdle
+{
+    dispatch_group_wait(_group, DISPATCH_TIME_FOREVER);
+}
+
+- (void)shutdown
+{
+    [_lock lock];
+    _shutdown = YES;
+    [self removeAllRequests];
+    [_lock unlock];
+
+    [self waitUntilIdle];
+}
+
+/* Each worker takes the highest priority request until there are none left, and then exits. */
+- (void)workerLoop
+{
+    while(YES)
+    {
+        [_lock lock];
+
+        if (_heap.count == 0) {
+            --_numWorkers;
+            [_lock unlock];
+            return;
+        }
+
+        GSTerrainChunkRequest *request = _heap[0];
+        [self removeRequestAtIndex:0];
+
+        NSMutableDictionary<NSNumber *, GSTerrainChunkRequest *> *running = _running[request.stage][request.key];
+        if (!running) {
+            running = [NSMutableDictionary new];
+            _running[request.stage][request.key] = running;
+        }
+        running[@(request.levelOfDetail)] = request;
+        ++_numRunning;
+
+        [_lock unlock];
+
+        @autoreleasepool {
+            _job(request.minP, request.stage, request.levelOfDetail);
+        }
+
+        [_lock lock];
+
+        [running removeObjectForKey:@(request.levelOfDetail)];
+        if (running.count == 0) {
+            [_running[request.stage] removeObjectForKey:request.key];
+        }
+        --_numRunning;
+
+        // A request which was scheduled for the chunk since is more recent, and takes the place of the rerun.
+        if (request.rerun && !_pending[request.stage][request.key]) {
+            request.rerun = NO;
+            [self insertRequest:request];
+        }
+
+        [_lock unlock];
+    }
+}
+
+@end
@@ -22,6 +22,14 @@
 @class GSChunkVoxelData;
 
 
+/* Whether the chunk store holds the data for a chunk. */
+typedef enum {
+    GSChunkAbsent = 0, // The data is not present.
+    GSChunkPresent,    // The data is present.
+    GSChunkBusy        // Someone holds the lock on the data, such as while producing it, so it's not known yet.
+} GSChunkPresence;
+
+
 @interface GSTerrainChunkStore : NSObject
 
 @property (nonatomic, nonnull, readonly) GSGrid *gridVAO;
@@ -29,19 +37,51 @@
 @property (nonatomic, nonnull, readonly) GSGrid *gridSunlightData;
 @property (nonatomic, nonnull, readonly) GSGrid *gridVoxelData;
 
+/* Folder in which chunks are cached, or nil if they aren't. This is a folder within the one which the chunk store was
+ * initialized with, named for the generator's quality, so chunks generated at another quality are never loaded.
+ */
+@property (nonatomic, nullable, readonly) NSURL *cacheFolder;
+
 // Prevents all loading from the terrain cache folder during certain operations such as when applying the journal.
 @property (nonatomic, readwrite) BOOL enableLoadingFromCacheFolder;
 
+/* The camera and OpenGL context may be nil when the chunk store is used without drawing anything, such as when
+ * pregenerating terrain. VAOs cannot be created without an OpenGL context.
+ * Chunks are cached in a folder within `url'. See `cacheFolder'.
+ */
 - (nonnull instancetype)initWithJournal:(nonnull GSTerrainJournal *)journal
                             cacheFolder:(nullable NSURL *)url
-                                 camera:(nonnull GSCamera *)camera
-                              glContext:(nonnull NSOpenGLContext *)glContext
+                                 camera:(nullable GSCamera *)camera
+                              glContext:(nullable NSOpenGLContext *)glContext
                               generator:(nonnull GSTerrainGenerator *)generator;
 
 - (nonnull GSChunkGeometryData *)chunkGeometryAtPoint:(vector_float3)p;
 - (nonnull GSChunkSunlightData *)chunkSunlightAtPoint:(vector_float3)p;
 - (nonnull GSChunkVoxelData *)chunkVoxelsAtPoint:(vector_float3)p;
 
+/* Voxels are generated for square tiles of chunk columns at once. Returns the min corner of the tile containing the
+ * specified point.
+ */
+- (vector_float3)minCornerOfVoxelTileAtPoint:(vector_float3)p;
+
+/* Makes sure that the voxels are present for every chunk in the tile containing the specified point. Chunks which
+ * can't be loaded from the cache folder are generated together in one pass. This blocks until it is done.
+ */
+- (void)chunkVoxelsForTileAtPoint:(vector_float3)p;
+
+/* Returns whether the chunk store currently holds the data for the chunk at the specified point. These never block,
+ * and return GSChunkBusy if the answer would require waiting on a lock, such as while the data is being generated.
+ */
+- (GSChunkPresence)presenceOfVoxelsAtPoint:(vector_float3)p;
+- (GSChunkPresence)presenceOfSunlightAtPoint:(vector_float3)p;
+- (GSChunkPresence)presenceOfGeometryAtPoint:(vector_float3)p;
+
+/* Calls `block' with the min corner of each voxel chunk which is read to produce sunlight for the chunk at the
+ * specified point. Once all of these are present, producing the sunlight will not generate any voxels.
+ */
+- (void)enumerateVoxelDependenciesOfSunlightAtPoint:(vector_float3)p
+                                         usingBlock:(void (^ _Nonnull)(vector_float3 voxelsP))block;
+
 /* Try to get the Vertex Array Object for the specified point in space.
  * Returns nil when it's not possible to get the VAO without blocking on a lock.
  */
@@ -53,10 +93,18 @@
  */
 - (nullable GSChunkVAO *)nonBlockingVaoAtPoint:(nonnull GSBoxedVector *)p createIfMissing:(BOOL)createIfMissing;
 
+/* Like -nonBlockingVaoAtPoint:createIfMissing:, except that the VAO is also replaced if it was created at a different
+ * level of detail. The slot holds only one VAO at a time, whatever level of detail was last requested.
+ */
+- (nullable GSChunkVAO *)nonBlockingVaoAtPoint:(nonnull GSBoxedVector *)p
+                                 levelOfDetail:(NSUInteger)levelOfDetail
+                               createIfMissing:(BOOL)createIfMissing;
+
 - (nonnull GSChunkVoxelData *)newVoxelChunkAtPoint:(vector_float3)pos;
 - (nonnull GSChunkSunlightData *)newSunlightChunkAtPoint:(vector_float3)pos;
 - (nonnull GSChunkGeometryData *)newGeometryChunkAtPoint:(vector_float3)pos;
 - (nonnull GSChunkVAO *)newVAOChunkAtPoint:(vector_float3)pos;
+- (nonnull GSChunkVAO *)newVAOChunkAtPoint:(vector_float3)pos levelOfDetail:(NSUInteger)levelOfDetail;
 
 /* Notify the chunk store object that the system has come under memory pressure. */
 - (void)memoryPressure:(dispatch_source_memorypressure_flags_t)status;
@@ -13,26 +13,201 @@
 #import "GSChunkGeometryData.h"
 #import "GSChunkSunlightData.h"
 #import "GSChunkVoxelData.h"
+#import "GSSunlightRegion.h"
+#import "GSTerrainTile.h"
+#import "GSTerrainGenerator.h"
+#import "GSTerrainLightBuffer.h"
 #import "GSGrid.h"
 #import "GSGridSlot.h"
 
 
+/* Sunlight is generated for square tiles of chunk columns at once. This is the length of a side of a tile, in chunks.
+ * Larger tiles waste less work on the margins but take longer to produce the first chunk.
+ */
+static const long GSSunlightRegionSize = 4;
+
+/* Voxels are generated for square tiles of chunk columns at once. This is the length of a side of a tile, in chunks. */
+static const long GSTerrainTileSize = 4;
+
+
+/* Returns the min corner of the square tile of chunk columns, `size' chunks on a side, which contains the point. */
+static inline vector_float3 GSMinCornerOfTileAtPoint(vector_float3 p, long size)
+{
+    const long tileSizeX = size * CHUNK_SIZE_X;
+    const long tileSizeZ = size * CHUNK_SIZE_Z;
+    return (vector_float3){
+        floorf(p.x / tileSizeX) * tileSizeX,
+        0,
+        floorf(p.z / tileSizeZ) * tileSizeZ
+    };
+}
+
+
 @implementation GSTerrainChunkStore
 {
     dispatch_group_t _groupForSaving;
     dispatch_queue_t _queueForSaving;
     BOOL _chunkStoreHasBeenShutdown;
     GSCamera *_camera;
-    NSURL *_folder;
     GSShader *_terrainShader;
     NSOpenGLContext *_glContext;
     GSTerrainJournal *_journal;
     GSTerrainGenerator *_generator;
 }
 
+@synthesize cacheFolder = _folder;
+
+/* Returns the folder within `parent' in which to cache chunks generated at the specified quality, creating it if
+ * necessary. Returns nil if the folder cannot be created.
+ */
++ (nullable NSURL *)newCacheFolderWithinFolder:(nonnull NSURL *)parent quality:(GSTerrainGenerationQuality)quality
+{
+    NSURL *folder = [parent URLByAppendingPathComponent:GSTerrainGenerationQualityName(quality) isDirectory:YES];
+
+    NSError *error = nil;
+    if (![[NSFileManager defaultManager] createDirectoryAtURL:folder
+                                  withIntermediateDirectories:YES
+                                                   attributes:nil
+                                                        error:&error]) {
+        NSLog(@"Failed to create terrain cache folder %@: %@", folder, error);
+        return nil;
+    }
+
+    return folder;
+}
+
+/* Returns YES if voxels for the chunk at the specified point can be loaded from the cache folder. */
+- (BOOL)canLoadVoxelChunkAtPoint:(vector_float3)minCorner
+{
+    if (!(_folder && _enableLoadingFromCacheFolder)) {
+        return NO;
+    }
+
+    NSString *fileName = [GSChunkVoxelData fileNameForVoxelDataFromMinP:minCorner];
+    NSURL *url = [NSURL URLWithString:fileName relativeToURL:_folder];
+    return [GSChunkVoxelData canLoadVoxelDataFromURL:url];
+}
+
+- (nonnull GSChunkVoxelData *)newVoxelChunkWithTile:(nonnull GSTerrainTile *)tile atPoint:(vector_float3)minCorner
+{
+    return [[GSChunkVoxelData alloc] initWithMinP:minCorner
+                                           folder:_folder
+                                   groupForSaving:_groupForSaving
+                                   queueForSaving:_queueForSaving
+                                          journal:_journal
+                                             tile:tile
+                                     allowLoading:_enableLoadingFromCacheFolder];
+}
+
+/* Stores items in the empty slots of `grid' for the other chunks in the tile, `size' chunks on a side, whose min corner
+ * is `tileMinP'. The chunk at `minCorner' is skipped because the caller already holds the lock on its slot, and so are
+ * chunks whose slots are busy. `newItem' returns the item for a chunk, or nil to leave the slot empty such as when
+ * the chunk can be loaded from the cache instead.
+ */
+- (void)fillSlotsInGrid:(nonnull GSGrid *)grid
+              tileMinP:(vector_float3)tileMinP
+                  size:(long)size
+         exceptAtPoint:(vector_float3)minCorner
+               newItem:(NSObject<GSGridItem> * _Nullable (^ _Nonnull)(vector_float3 p))newItem
+{
+    for(long x = 0; x < size; ++x)
+    {
+        for(long z = 0; z < size; ++z)
+        {
+            vector_float3 p = tileMinP + (vector_float3){x * CHUNK_SIZE_X, 0, z * CHUNK_SIZE_Z};
+
+            if (vector_equal(p, minCorner)) {
+                continue; // The caller already holds the lock on this slot.
+            }
+
+            // Never block here. The caller holds a slot lock and we must not wait on anyone else's.
+            GSGridSlot *slot = [grid slotAtPoint:p blocking:NO];
+
+            if (!(slot && [slot.lock tryLockForWriting])) {
+                continue;
+            }
+
+            if (!slot.item) {
+                slot.item = newItem(p);
+            }
+
+            [slot.lock unlockForWriting];
+        }
+    }
+}
+
+/* Generates the whole tile of chunk columns which contains the specified point in one pass. Voxel chunks are stored
+ * for the other chunks in the tile, except for those which are already present, which can be loaded from the cache,
+ * or whose slots are busy. Returns the voxel chunk for the specified point, which the caller must store.
+ */
+- (nonnull GSChunkVoxelData *)newVoxelChunkWithTileAroundPoint:(vector_float3)minCorner
+{
+    vector_float3 tileMinP = [self minCornerOfVoxelTileAtPoint:minCorner];
+
+    GSTerrainTile *tile = [[GSTerrainTile alloc] initWithMinP:tileMinP
+                                                      chunksX:GSTerrainTileSize
+                                                      chunksZ:GSTerrainTileSize
+                                                    generator:_generator];
+
+    [self fillSlotsInGrid:_gridVoxelData
+                 tileMinP:tileMinP
+                     size:GSTerrainTileSize
+            exceptAtPoint:minCorner
+                  newItem:^GSChunkVoxelData *(vector_float3 p) {
+                      return [self canLoadVoxelChunkAtPoint:p] ? nil : [self newVoxelChunkWithTile:tile atPoint:p];
+                  }];
+
+    return [self newVoxelChunkWithTile:tile atPoint:minCorner];
+}
+
+- (vector_float3)minCornerOfVoxelTileAtPoint:(vector_float3)p
+{
+    return GSMinCornerOfTileAtPoint(p, GSTerrainTileSize);
+}
+
+- (void)chunkVoxelsForTileAtPoint:(vector_float3)p
+{
+    assert(!_chunkStoreHasBeenShutdown);
+
+    vector_float3 tileMinP = [self minCornerOfVoxelTileAtPoint:p];
+    GSTerrainTile *tile = nil; // Generated the first time a chunk needs it.
+
+    // Only one slot is locked at a time, so this can safely block.
+    for(long x = 0; x < GSTerrainTileSize; ++x)
+    {
+        for(long z = 0; z < GSTerrainTileSize; ++z)
+        {
+            vector_float3 chunkP = tileMinP + (vector_float3){x * CHUNK_SIZE_X, 0, z * CHUNK_SIZE_Z};
+            GSGridSlot *slot = [_gridVoxelData slotAtPoint:chunkP];
+
+            [slot.lock lockForWriting];
+            if (!slot.item) {
+                if ([self canLoadVoxelChunkAtPoint:chunkP]) {
+                    slot.item = [self newVoxelChunkAtPoint:chunkP];
+                } else {
+                    if (!tile) {
+                        tile = [[GSTerrainTile alloc] initWithMinP:tileMinP
+                                                           chunksX:GSTerrainTileSize
+                                                           chunksZ:GSTerrainTileSize
+                                                         generator:_generator];
+                    }
+                    slot.item = [self newVoxelChunkWithTile:tile atPoint:chunkP];
+                }
+            }
+            [slot.lock unlockForWriting];
+        }
+    }
+}
+
 - (nonnull GSChunkVoxelData *)newVoxelChunkAtPoint:(vector_float3)pos
 {
     vector_float3 minCorner = GSMinCornerForChunkAtPoint(pos);
+
+    // Generating a chunk from scratch is cheaper when it is done for many adjacent chunks at once.
+    if (![self canLoadVoxelChunkAtPoint:minCorner]) {
+        return [self newVoxelChunkWithTileAroundPoint:minCorner];
+    }
+
     return [[GSChunkVoxelData alloc] initWithMinP:minCorner
                                            folder:_folder
                                    groupForSaving:_groupForSaving
@@ -42,10 +217,68 @@
                                      allowLoading:_enableLoadingFromCacheFolder];
 }
 
+/* Returns YES if sunlight for the chunk at the specified point can be loaded from the cache folder. */
+- (BOOL)canLoadSunlightChunkAtPoint:(vector_float3)minCorner
+{
+    if (!(_folder && _enableLoadingFromCacheFolder)) {
+        return NO;
+    }
+
+    NSString *fileName = [GSChunkSunlightData fileNameForSunlightDataFromMinP:minCorner];
+    NSURL *url = [NSURL URLWithString:fileName relativeToURL:_folder];
+    return [GSChunkSunlightData canLoadSunlightDataFromURL:url];
+}
+
+- (nonnull GSChunkSunlightData *)newSunlightChunkWithRegion:(nonnull GSSunlightRegion *)region
+                                                    atPoint:(vector_float3)minCorner
+{
+    return [[GSChunkSunlightData alloc] initWithMinP:minCorner
+                                              folder:_folder
+                                      groupForSaving:_groupForSaving
+                                      queueForSaving:_queueForSaving
+                                            sunlight:[region lightBufferForChannel:LIGHT_CHANNEL_SUN
+                                                                      chunkAtPoint:minCorner]
+                                          torchlight:[region lightBufferForChannel:LIGHT_CHANNEL_TORCH
+                                                                      chunkAtPoint:minCorner]
+                                        neighborhood:[region neighborhoodForChunkAtPoint:minCorner]];
+}
+
+/* Lights the whole tile of chunk columns which contains the specified point in one pass. Sunlight chunks are stored
+ * for the other chunks in the tile, except for those which are already present, which can be loaded from the cache,
+ * or whose slots are busy. Returns the sunlight chunk for the specified point, which the caller must store.
+ */
+- (nonnull GSChunkSunlightData *)newSunlightChunkWithRegionAroundPoint:(vector_float3)minCorner
+{
+    vector_float3 regionMinP = GSMinCornerOfTileAtPoint(minCorner, GSSunlightRegionSize);
+
+    GSSunlightRegion *region = [[GSSunlightRegion alloc] initWithMinP:regionMinP
+                                                              chunksX:GSSunlightRegionSize
+                                                              chunksZ:GSSunlightRegionSize
+                                                        voxelsAtPoint:^GSChunkVoxelData *(vector_float3 p) {
+                                                            return [self chunkVoxelsAtPoint:p];
+                                                        }];
+
+    [self fillSlotsInGrid:_gridSunlightData
+                 tileMinP:regionMinP
+                     size:GSSunlightRegionSize
+            exceptAtPoint:minCorner
+                  newItem:^GSChunkSunlightData *(vector_float3 p) {
+                      return [self canLoadSunlightChunkAtPoint:p] ? nil
+                                                                  : [self newSunlightChunkWithRegion:region atPoint:p];
+                  }];
+
+    return [self newSunlightChunkWithRegion:region atPoint:minCorner];
+}
+
 - (nonnull GSChunkSunlightData *)newSunlightChunkAtPoint:(vector_float3)pos
 {
     vector_float3 minCorner = GSMinCornerForChunkAtPoint(pos);
 
+    // Lighting a chunk from scratch is much cheaper when it is done for many adjacent chunks at once.
+    if (![self canLoadSunlightChunkAtPoint:minCorner]) {
+        return [self newSunlightChunkWithRegionAroundPoint:minCorner];
+    }
+
     GSVoxelNeighborhood *neighborhood = [[GSVoxelNeighborhood alloc] init];
 
     for(GSVoxelNeighborIndex i = 0; i < CHUNK_NUM_NEIGHBORS; ++i)
@@ -77,20 +310,39 @@
 
 - (nonnull GSChunkVAO *)newVAOChunkAtPoint:(vector_float3)pos
 {
+    return [self newVAOChunkAtPoint:pos levelOfDetail:0];
+}
+
+- (nonnull GSChunkVAO *)newVAOChunkAtPoint:(vector_float3)pos levelOfDetail:(NSUInteger)levelOfDetail
+{
+    assert(_glContext);
+
     vector_float3 minCorner = GSMinCornerForChunkAtPoint(pos);
-    GSChunkGeometryData *geometry = [self chunkGeometryAtPoint:minCorner];
+    GSChunkGeometryData *geometry;
+
+    if (levelOfDetail == 0) {
+        geometry = [self chunkGeometryAtPoint:minCorner];
+    } else {
+        // Coarse geometry is only needed long enough to upload it, so it isn't kept in the geometry grid.
+        GSChunkSunlightData *sunlight = [self chunkSunlightAtPoint:minCorner];
+        geometry = [[GSChunkGeometryData alloc] initWithMinP:minCorner
+                                                    sunlight:sunlight
+                                               levelOfDetail:levelOfDetail];
+    }
+
     return [[GSChunkVAO alloc] initWithChunkGeometry:geometry
                                            glContext:_glContext];
 }
 
 - (nonnull instancetype)initWithJournal:(nonnull GSTerrainJournal *)journal
                             cacheFolder:(nullable NSURL *)url
-                                 camera:(nonnull GSCamera *)camera
-                              glContext:(nonnull NSOpenGLContext *)glContext
+                                 camera:(nullable GSCamera *)camera
+                              glContext:(nullable NSOpenGLContext *)glContext
                               generator:(nonnull GSTerrainGenerator *)generator
 {
     if (self = [super init]) {
-        _folder = url;
+        // Chunks generated at different qualities don't line up, so they must never be loaded from each other's cache.
+        _folder = url ? [[self class] newCacheFolderWithinFolder:url quality:generator.quality] : nil;
         _groupForSaving = dispatch_group_create();
         _chunkStoreHasBeenShutdown = NO;
         _camera = camera;
@@ -167,6 +419,13 @@
 }
 
 - (nullable GSChunkVAO *)nonBlockingVaoAtPoint:(GSBoxedVector *)pos createIfMissing:(BOOL)createIfMissing
+{
+    return [self nonBlockingVaoAtPoint:pos levelOfDetail:0 createIfMissing:createIfMissing];
+}
+
+- (nullable GSChunkVAO *)nonBlockingVaoAtPoint:(nonnull GSBoxedVector *)pos
+                                 levelOfDetail:(NSUInteger)levelOfDetail
+                               createIfMissing:(BOOL)createIfMissing
 {
     if (_chunkStoreHasBeenShutdown) {
         return nil;
@@ -181,8 +440,8 @@
     
     GSChunkVAO *vao = (GSChunkVAO *)slot.item;
     
-    if (!vao) {
-        vao = [self newVAOChunkAtPoint:p];
+    if (!vao || (vao.levelOfDetail != levelOfDetail)) {
+        vao = [self newVAOChunkAtPoint:p levelOfDetail:levelOfDetail];
         slot.item = vao;
     }
     
@@ -249,6 +508,68 @@
     return voxels;
 }
 
+- (GSChunkPresence)presenceOfItemInGrid:(nonnull GSGrid *)grid atPoint:(vector_float3)p
+{
+    if (_chunkStoreHasBeenShutdown) {
+        return GSChunkAbsent;
+    }
+
+    GSGridSlot *slot = [grid slotAtPoint:p blocking:NO];
+
+    if (!(slot && [slot.lock tryLockForReading])) {
+        return GSChunkBusy;
+    }
+
+    GSChunkPresence presence = slot.item ? GSChunkPresent : GSChunkAbsent;
+    [slot.lock unlockForReading];
+
+    return presence;
+}
+
+- (GSChunkPresence)presenceOfVoxelsAtPoint:(vector_float3)p
+{
+    return [self presenceOfItemInGrid:_gridVoxelData atPoint:p];
+}
+
+- (GSChunkPresence)presenceOfSunlightAtPoint:(vector_float3)p
+{
+    return [self presenceOfItemInGrid:_gridSunlightData atPoint:p];
+}
+
+- (GSChunkPresence)presenceOfGeometryAtPoint:(vector_float3)p
+{
+    return [self presenceOfItemInGrid:_gridGeometryData atPoint:p];
+}
+
+- (void)enumerateVoxelDependenciesOfSunlightAtPoint:(vector_float3)p
+                                         usingBlock:(void (^ _Nonnull)(vector_float3 voxelsP))block
+{
+    NSParameterAssert(block);
+
+    vector_float3 minCorner = GSMinCornerForChunkAtPoint(p);
+    vector_float3 mins, maxs;
+
+    if ([self canLoadSunlightChunkAtPoint:minCorner]) {
+        // Loading sunlight reads only the neighborhood of the chunk.
+        mins = minCorner - (vector_float3){CHUNK_SIZE_X, 0, CHUNK_SIZE_Z};
+        maxs = minCorner + (vector_float3){CHUNK_SIZE_X, 0, CHUNK_SIZE_Z};
+    } else {
+        // Lighting a region reads the whole region plus a border one chunk wide.
+        // See -newSunlightChunkWithRegionAroundPoint:
+        vector_float3 regionMinP = GSMinCornerOfTileAtPoint(minCorner, GSSunlightRegionSize);
+        mins = regionMinP - (vector_float3){CHUNK_SIZE_X, 0, CHUNK_SIZE_Z};
+        maxs = regionMinP + GSSunlightRegionSize * (vector_float3){CHUNK_SIZE_X, 0, CHUNK_SIZE_Z};
+    }
+
+    for(float x = mins.x; x <= maxs.x; x += CHUNK_SIZE_X)
+    {
+        for(float z = mins.z; z <= maxs.z; z += CHUNK_SIZE_Z)
+        {
+            block((vector_float3){x, 0, z});
+        }
+    }
+}
+
 - (void)memoryPressure:(dispatch_source_memorypressure_flags_t)status
 {
     if (_chunkStoreHasBeenShutdown) {
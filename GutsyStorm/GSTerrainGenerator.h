@@ -11,11 +11,40 @@
 #import "GSAABB.h"
 
 
+/* Trades the accuracy of generated terrain for speed. Chunks generated at different qualities may not line up, so
+ * each quality is cached in a folder of its own. See GSTerrainGenerationQualityName().
+ */
+typedef enum {
+    /* Evaluates the terrain's density function exactly at every voxel. */
+    GSTerrainGenerationQualityExact = 0,
+
+    /* Samples the turbulence of the rolling hills on a coarse lattice, every 4x8x4 voxels, and trilinearly
+     * interpolates between lattice points. This takes about fifty times fewer noise evaluations per chunk. Roughly
+     * one in every few hundred voxels comes out differently than with exact evaluation, all near the surface.
+     */
+    GSTerrainGenerationQualityInterpolated
+} GSTerrainGenerationQuality;
+
+
+/* Returns a short name for the quality, which names the folder that chunks generated at that quality are cached in. */
+NSString * _Nonnull GSTerrainGenerationQualityName(GSTerrainGenerationQuality quality);
+
+
 @interface GSTerrainGenerator : NSObject
 
+@property (nonatomic, readonly) GSTerrainGenerationQuality quality;
+
 - (nonnull instancetype)init NS_UNAVAILABLE;
 
-- (nonnull instancetype)initWithRandomSeed:(NSInteger)seed NS_DESIGNATED_INITIALIZER;
+- (nonnull instancetype)initWithRandomSeed:(NSInteger)seed;
+
+- (nonnull instancetype)initWithRandomSeed:(NSInteger)seed
+                                   quality:(GSTerrainGenerationQuality)quality NS_DESIGNATED_INITIALIZER;
+
+/* Get the range of world heights over which the surface of the rolling hills may lie. Below this range the hills are
+ * solid ground, and above it they are air.
+ */
++ (void)getHillsSurfaceMinY:(nonnull float *)minY maxY:(nonnull float *)maxY;
 
 - (void)generateWithDestination:(nonnull GSVoxel *)voxels
                           count:(NSUInteger)count
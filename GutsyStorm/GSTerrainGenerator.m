@@ -12,14 +12,58 @@
 #import "GSVectorUtils.h"
 
 
+// Spacing of the lattice on which GSTerrainGenerationQualityInterpolated samples the hills' turbulence.
+static const vector_long3 GSTurbulenceLatticeSpacing = {4, 8, 4};
+
+
+// The hills' turbulence sampled on a coarse lattice which is aligned to the world, so neighboring chunks agree.
+typedef struct {
+    vector_long3 origin;     // World position of the first lattice point.
+    vector_long3 count;      // Number of lattice points along each axis. At least two along each.
+    float * _Nonnull values; // Turbulence at each lattice point, with y varying fastest, then z, then x.
+    float * _Nonnull column; // Scratch space for one column of lattice points, interpolated in x and z.
+} GSTurbulenceLattice;
+
+
+/* The mean height of the rolling hills. */
+static const float GSTerrainHillsHeight = 40.0f;
+
+
 static float groundGradient(float terrainHeight, vector_float3 p);
-static void generateTerrainVoxel(GSNoise * _Nonnull noiseSource0, GSNoise * _Nonnull noiseSource1,
-                                 float terrainHeight, vector_float3 p, GSVoxel * _Nonnull outVoxel);
+static inline long clampColumnIndex(float index, long lo, long hi);
+static void computeTurbulence(GSNoise * _Nonnull noiseSource0, GSNoise * _Nonnull noiseSource1,
+                              float terrainHeight, vector_float3 base, long count, long step,
+                              vector_float3 * _Nonnull points, float * _Nonnull turbulence);
+static void createTurbulenceLattice(GSTurbulenceLattice * _Nonnull lattice,
+                                    GSNoise * _Nonnull noiseSource0, GSNoise * _Nonnull noiseSource1,
+                                    float terrainHeight, vector_long3 worldMin, vector_long3 worldMax);
+static void destroyTurbulenceLattice(GSTurbulenceLattice * _Nonnull lattice);
+static void interpolateTurbulence(GSTurbulenceLattice * _Nonnull lattice, vector_long3 base, long count,
+                                  float * _Nonnull turbulence);
+static void generateTerrainColumn(GSNoise * _Nonnull noiseSource0, uint32_t seed,
+                                  float terrainHeight, vector_float3 base, long height,
+                                  long solidEnd, long hillsEnd, const float * _Nonnull turbulence,
+                                  GSVoxel * _Nonnull column, vector_float3 * _Nonnull points,
+                                  float * _Nonnull noise, long * _Nonnull indices);
+
+NSString * _Nonnull GSTerrainGenerationQualityName(GSTerrainGenerationQuality quality)
+{
+    switch(quality)
+    {
+        case GSTerrainGenerationQualityExact:        return @"exact";
+        case GSTerrainGenerationQualityInterpolated: return @"interpolated";
+    }
+
+    [NSException raise:NSInvalidArgumentException format:@"Unknown terrain generation quality: %d", quality];
+    return @"";
+}
+
 
 @implementation GSTerrainGenerator
 {
     GSNoise *_noiseSource0;
     GSNoise *_noiseSource1;
+    uint32_t _seed;
 }
 
 - (nonnull instancetype)init
@@ -28,14 +72,33 @@ static void generateTerrainVoxel(GSNoise * _Nonnull noiseSource0, GSNoise * _Non
 }
 
 - (nonnull instancetype)initWithRandomSeed:(NSInteger)seed
+{
+    return [self initWithRandomSeed:seed quality:GSTerrainGenerationQualityExact];
+}
+
+- (nonnull instancetype)initWithRandomSeed:(NSInteger)seed quality:(GSTerrainGenerationQuality)quality
 {
     if (self = [super init]) {
         _noiseSource0 = [[GSNoise alloc] initWithSeed:seed];
         _noiseSource1 = [[GSNoise alloc] initWithSeed:seed+1];
+        _seed = (uint32_t)seed;
+        _quality = quality;
     }
     return self;
 }
 
++ (void)getHillsSurfaceMinY:(nonnull float *)minY maxY:(nonnull float *)maxY
+{
+    NSParameterAssert(minY);
+    NSParameterAssert(maxY);
+
+    // The ground can only change at heights where the turbulence could carry the gradient across zero. A margin of one
+    // voxel guards against rounding at the edges.
+    const float turbScaleY = GSTerrainHillsHeight / 2.0;
+    *minY = GSTerrainHillsHeight/2 - 1 - turbScaleY*GSNoiseMaxValue;
+    *maxY = GSTerrainHillsHeight/2 + 1 - turbScaleY*GSNoiseMinValue;
+}
+
 - (void)generateWithDestination:(nonnull GSVoxel *)voxels
                           count:(NSUInteger)count
                          region:(nonnull GSIntAABB *)box
@@ -44,16 +107,64 @@ static void generateTerrainVoxel(GSNoise * _Nonnull noiseSource0, GSNoise * _Non
     NSParameterAssert(voxels);
     NSParameterAssert(box);
     
-    const static float terrainHeight = 40.0f;
+    const float terrainHeight = GSTerrainHillsHeight;
+    const long height = box->maxs.y - box->mins.y;
     vector_long3 clp;
-    
-    // First, generate voxels for a region of terrain.
-    FOR_BOX(clp, *box)
+
+    // The ground can only change at the surface of the hills, or near the floating mountain. Noise is evaluated only
+    // for the voxels in those ranges of each column. Below them everything is ground, and above them everything is air.
+    const float baseY = box->mins.y + offsetToWorld.y;
+    float hillsMinY, hillsMaxY;
+    [GSTerrainGenerator getHillsSurfaceMinY:&hillsMinY maxY:&hillsMaxY];
+    long solidEnd = clampColumnIndex(ceilf(hillsMinY - baseY), 0, height);
+    long hillsEnd = clampColumnIndex(floorf(hillsMaxY - baseY) + 1, solidEnd, height);
+
+    // Scratch space for one column of voxels at a time.
+    vector_float3 *points = malloc(height * sizeof(vector_float3));
+    float *noise = malloc(height * sizeof(float));
+    float *turbulence = malloc(height * sizeof(float));
+    long *indices = malloc(height * sizeof(long));
+
+    if (!(points && noise && turbulence && indices)) {
+        [NSException raise:NSMallocException format:@"Out of memory allocating scratch space for terrain generation."];
+    }
+
+    vector_long3 offset = vector_long(offsetToWorld);
+    vector_long3 worldMin = offset + (vector_long3){box->mins.x, box->mins.y + solidEnd, box->mins.z};
+    vector_long3 worldMax = offset + (vector_long3){box->maxs.x, box->mins.y + hillsEnd, box->maxs.z};
+    BOOL interpolate = (_quality == GSTerrainGenerationQualityInterpolated) && (hillsEnd > solidEnd);
+    GSTurbulenceLattice lattice;
+
+    if (interpolate) {
+        createTurbulenceLattice(&lattice, _noiseSource0, _noiseSource1, terrainHeight, worldMin, worldMax);
+    }
+
+    // Generate voxels for a region of terrain, one column at a time, so noise is evaluated in large batches.
+    FOR_Y_COLUMN_IN_BOX(clp, *box)
     {
-        vector_float3 worldPosition = vector_make(clp.x, clp.y, clp.z) + offsetToWorld;
-        GSVoxel *voxel = &voxels[INDEX_BOX(clp, *box)];
-        generateTerrainVoxel(_noiseSource0, _noiseSource1, terrainHeight, worldPosition, voxel);
+        vector_float3 base = vector_make(clp.x, clp.y, clp.z) + offsetToWorld;
+        GSVoxel *column = &voxels[INDEX_BOX(clp, *box)];
+
+        if (interpolate) {
+            interpolateTurbulence(&lattice, vector_long(base + vector_make(0, solidEnd, 0)), hillsEnd - solidEnd,
+                                  turbulence);
+        } else {
+            computeTurbulence(_noiseSource0, _noiseSource1, terrainHeight, base + vector_make(0, solidEnd, 0),
+                              hillsEnd - solidEnd, 1, points, turbulence);
+        }
+
+        generateTerrainColumn(_noiseSource0, _seed, terrainHeight, base, height, solidEnd, hillsEnd, turbulence,
+                              column, points, noise, indices);
+    }
+
+    if (interpolate) {
+        destroyTurbulenceLattice(&lattice);
     }
+
+    free(points);
+    free(noise);
+    free(turbulence);
+    free(indices);
 }
 
 @end
@@ -73,25 +184,182 @@ static float groundGradient(float terrainHeight, vector_float3 p)
     }
 }
 
-// Generates a voxel for the specified point in space. Returns that voxel in `outVoxel'.
-static void generateTerrainVoxel(GSNoise * _Nonnull noiseSource0, GSNoise * _Nonnull noiseSource1,
-                                 float terrainHeight, vector_float3 p, GSVoxel * _Nonnull outVoxel)
+// Returns well-mixed random bits which depend only on the seed and the position of a voxel in the world. Unlike rand(),
+// there's no shared state, so generation threads never contend and a chunk comes out the same in any order.
+// It's only integer arithmetic, so loops over a column of voxels vectorize.
+static inline uint32_t hashVoxelPosition(uint32_t seed, int32_t x, int32_t y, int32_t z)
 {
-    BOOL groundLayer = NO;
-    BOOL floatingMountain = NO;
-    
-    assert(outVoxel);
+    uint32_t h = seed ^ ((uint32_t)x * 0x8da6b343u) ^ ((uint32_t)y * 0xd8163841u) ^ ((uint32_t)z * 0xcb1ab31fu);
+
+    // Finalizer from MurmurHash3
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+
+    return h;
+}
+
+// Clamps a voxel index within a column, computed from world-space heights, to the range [lo, hi].
+static inline long clampColumnIndex(float index, long lo, long hi)
+{
+    return (index < lo) ? lo : ((index > hi) ? hi : (long)index);
+}
+
+// Computes the turbulence of the normal rolling hills at `count' points, `step' voxels apart, going up from the point
+// `base' in space. Returns the turbulence in `turbulence'. The caller provides scratch space in `points'.
+static void computeTurbulence(GSNoise * _Nonnull noiseSource0, GSNoise * _Nonnull noiseSource1,
+                              float terrainHeight, vector_float3 base, long count, long step,
+                              vector_float3 * _Nonnull points, float * _Nonnull turbulence)
+{
+    const float freqScale = 0.025;
+    float turbScaleX = 2.0;
+    float turbScaleY = terrainHeight / 2.0;
+
+    for(long i = 0; i < count; ++i)
+    {
+        points[i] = (base + vector_make(0, i*step, 0)) * freqScale;
+    }
+
+    [noiseSource0 noiseWithFourOctavesAtPoints:points results:turbulence count:count];
+
+    for(long i = 0; i < count; ++i)
+    {
+        vector_float3 p = base + vector_make(0, i*step, 0);
+        float yFreq = turbScaleX * ((turbulence[i]+1) / 2.0);
+        points[i] = vector_make(p.x*freqScale, p.y*yFreq*freqScale, p.z*freqScale);
+    }
+
+    [noiseSource1 noiseAtPoints:points results:turbulence count:count];
+
+    for(long i = 0; i < count; ++i)
+    {
+        turbulence[i] *= turbScaleY;
+    }
+}
+
+// Rounds `a' down to a multiple of `b', which is positive.
+static inline long floorToMultiple(long a, long b)
+{
+    return (a >= 0) ? (a / b) * b : -(((-a + b - 1) / b) * b);
+}
+
+// Samples the turbulence on a lattice covering the points from `worldMin' up to, but not including, `worldMax'.
+static void createTurbulenceLattice(GSTurbulenceLattice * _Nonnull lattice,
+                                    GSNoise * _Nonnull noiseSource0, GSNoise * _Nonnull noiseSource1,
+                                    float terrainHeight, vector_long3 worldMin, vector_long3 worldMax)
+{
+    const vector_long3 spacing = GSTurbulenceLatticeSpacing;
+
+    lattice->origin = (vector_long3){
+        floorToMultiple(worldMin.x, spacing.x),
+        floorToMultiple(worldMin.y, spacing.y),
+        floorToMultiple(worldMin.z, spacing.z)
+    };
+
+    // Lattice points must enclose the last voxel, and there must be two of them to interpolate between.
+    vector_long3 extent = worldMax - (vector_long3){1, 1, 1} - lattice->origin;
+    lattice->count = (extent + spacing - (vector_long3){1, 1, 1}) / spacing + (vector_long3){1, 1, 1};
+    lattice->count = (vector_long3){MAX(2, lattice->count.x), MAX(2, lattice->count.y), MAX(2, lattice->count.z)};
+
+    const vector_long3 count = lattice->count;
+    lattice->values = malloc(count.x * count.y * count.z * sizeof(float));
+    lattice->column = malloc(count.y * sizeof(float));
+    vector_float3 *points = malloc(count.y * sizeof(vector_float3));
+
+    if (!(lattice->values && lattice->column && points)) {
+        [NSException raise:NSMallocException format:@"Out of memory allocating the turbulence lattice."];
+    }
+
+    for(long x = 0; x < count.x; ++x)
+    {
+        for(long z = 0; z < count.z; ++z)
+        {
+            vector_long3 base = lattice->origin + (vector_long3){x, 0, z} * spacing;
+            computeTurbulence(noiseSource0, noiseSource1, terrainHeight, vector_float(base), count.y, spacing.y,
+                              points, &lattice->values[(x*count.z + z) * count.y]);
+        }
+    }
+
+    free(points);
+}
+
+static void destroyTurbulenceLattice(GSTurbulenceLattice * _Nonnull lattice)
+{
+    free(lattice->values);
+    free(lattice->column);
+}
+
+// Finds the lattice cell containing `p' along one axis, and the position within that cell from zero to one.
+static inline long latticeCell(long p, long origin, long spacing, long count, float * _Nonnull fraction)
+{
+    long i = MIN((p - origin) / spacing, count - 2);
+    *fraction = (float)(p - origin - i*spacing) / spacing;
+    return i;
+}
+
+// Trilinearly interpolates the turbulence at `count' voxels going up from `base', which is in world space.
+static void interpolateTurbulence(GSTurbulenceLattice * _Nonnull lattice, vector_long3 base, long count,
+                                  float * _Nonnull turbulence)
+{
+    const vector_long3 spacing = GSTurbulenceLatticeSpacing;
+    const vector_long3 n = lattice->count;
+    float fx, fz;
+    long x = latticeCell(base.x, lattice->origin.x, spacing.x, n.x, &fx);
+    long z = latticeCell(base.z, lattice->origin.z, spacing.z, n.z, &fz);
+
+    // Interpolate in x and z once per lattice point in the column, then in y once per voxel.
+    const float *v00 = &lattice->values[((x+0)*n.z + (z+0)) * n.y];
+    const float *v01 = &lattice->values[((x+0)*n.z + (z+1)) * n.y];
+    const float *v10 = &lattice->values[((x+1)*n.z + (z+0)) * n.y];
+    const float *v11 = &lattice->values[((x+1)*n.z + (z+1)) * n.y];
+
+    for(long j = 0; j < n.y; ++j)
+    {
+        float lo = v00[j] + (v10[j] - v00[j]) * fx;
+        float hi = v01[j] + (v11[j] - v01[j]) * fx;
+        lattice->column[j] = lo + (hi - lo) * fz;
+    }
+
+    for(long i = 0; i < count; ++i)
+    {
+        float fy;
+        long j = latticeCell(base.y + i, lattice->origin.y, spacing.y, n.y, &fy);
+        turbulence[i] = lattice->column[j] + (lattice->column[j+1] - lattice->column[j]) * fy;
+    }
+}
+
+// Generates a column of `height' voxels, going up from the point `base' in space. Returns the voxels in `column'.
+// Everything below `solidEnd' is ground. Between `solidEnd' and `hillsEnd' the hills' turbulence must be provided in
+// `turbulence'. The caller provides scratch space for noise inputs and outputs, and for indices, with room for the
+// column.
+static void generateTerrainColumn(GSNoise * _Nonnull noiseSource0, uint32_t seed,
+                                  float terrainHeight, vector_float3 base, long height,
+                                  long solidEnd, long hillsEnd, const float * _Nonnull turbulence,
+                                  GSVoxel * _Nonnull column, vector_float3 * _Nonnull points,
+                                  float * _Nonnull noise, long * _Nonnull indices)
+{
+    assert(column);
+    assert(turbulence);
+    assert(points);
+    assert(noise);
+    assert(indices);
+
+    for(long y = 0; y < solidEnd; ++y)
+    {
+        column[y].opaque = YES;
+    }
     
     // Normal rolling hills
+    for(long y = solidEnd; y < hillsEnd; ++y)
     {
-        const float freqScale = 0.025;
-        float n = [noiseSource0 noiseAtPointWithFourOctaves:(p * freqScale)];
-        float turbScaleX = 2.0;
-        float turbScaleY = terrainHeight / 2.0;
-        float yFreq = turbScaleX * ((n+1) / 2.0);
-        float t = turbScaleY * [noiseSource1 noiseAtPoint:vector_make(p.x*freqScale, p.y*yFreq*freqScale, p.z*freqScale)];
-        groundLayer = groundGradient(terrainHeight, vector_make(p.x, p.y + t, p.z)) <= 0;
+        vector_float3 p = base + vector_make(0, y, 0);
+        float t = turbulence[y - solidEnd];
+        column[y].opaque = groundGradient(terrainHeight, vector_make(p.x, p.y + t, p.z)) <= 0;
     }
+
+    long top = hillsEnd;
     
     // Giant floating mountain
     {
@@ -100,39 +368,88 @@ static void generateTerrainVoxel(GSNoise * _Nonnull noiseSource0, GSNoise * _Non
          */
         
         vector_float3 mountainCenter = vector_make(50, 50, 80);
-        vector_float3 toMountainCenter = mountainCenter - p;
-        float distance = vector_length(toMountainCenter);
         float radius = 30.0;
         
         // Apply turbulence to the surface of the mountain.
         float freqScale = 0.70;
         float turbScale = 15.0;
-        
-        // Avoid generating noise when too far away from the center to matter.
-        if(distance > 2.0*radius) {
-            floatingMountain = NO;
-        } else {
-            // Convert the point into spherical coordinates relative to the center of the mountain.
-            float azimuthalAngle = acosf(toMountainCenter.z / distance);
-            float polarAngle = atan2f(toMountainCenter.y, toMountainCenter.x);
-            
-            float t = turbScale * [noiseSource0 noiseAtPointWithFourOctaves:vector_make(azimuthalAngle * freqScale,
-                                                                                        polarAngle * freqScale,
-                                                                                        0.0)];
+
+        // Avoid generating noise when too far away from the center to matter. Only part of the column can be close
+        // enough, if any. Gather the voxels there, and evaluate noise for all of them in one batch.
+        float dx = mountainCenter.x - base.x, dz = mountainCenter.z - base.z;
+        float halfHeightSquared = 4.0*radius*radius - (dx*dx + dz*dz);
+        long mountainBegin = 0, mountainEnd = 0;
+
+        if(halfHeightSquared >= 0) {
+            float halfHeight = sqrtf(halfHeightSquared);
+            mountainBegin = clampColumnIndex(floorf(mountainCenter.y - halfHeight - 1 - base.y), solidEnd, height);
+            mountainEnd = clampColumnIndex(ceilf(mountainCenter.y + halfHeight + 1 - base.y) + 1,
+                                           mountainBegin, height);
+        }
+
+        for(long y = hillsEnd; y < mountainEnd; ++y)
+        {
+            column[y].opaque = NO;
+        }
+
+        top = MAX(top, mountainEnd);
+        long count = 0;
+
+        for(long y = mountainBegin; y < mountainEnd; ++y)
+        {
+            vector_float3 toMountainCenter = mountainCenter - (base + vector_make(0, y, 0));
+            float distance = vector_length(toMountainCenter);
+
+            if(distance <= 2.0*radius) {
+                // Convert the point into spherical coordinates relative to the center of the mountain.
+                float azimuthalAngle = acosf(toMountainCenter.z / distance);
+                float polarAngle = atan2f(toMountainCenter.y, toMountainCenter.x);
+                points[count] = vector_make(azimuthalAngle * freqScale, polarAngle * freqScale, 0.0);
+                indices[count] = y;
+                ++count;
+            }
+        }
+
+        [noiseSource0 noiseWithFourOctavesAtPoints:points results:noise count:count];
+
+        for(long i = 0; i < count; ++i)
+        {
+            long y = indices[i];
+            vector_float3 p = base + vector_make(0, y, 0);
+            float distance = vector_length(mountainCenter - p);
+            float t = turbScale * noise[i];
+            float r = radius;
             
             // Flatten the top.
             if(p.y > mountainCenter.y) {
-                radius -= (p.y - mountainCenter.y) * 3;
+                r -= (p.y - mountainCenter.y) * 3;
             }
             
-            floatingMountain = (distance+t) < radius;
+            if((distance+t) < r) {
+                column[y].opaque = YES;
+            }
         }
     }
-    
-    outVoxel->outside = NO; // calculated later
-    outVoxel->torch = NO;
-    outVoxel->opaque = groundLayer || floatingMountain;
-    outVoxel->type = (groundLayer || floatingMountain) ? VOXEL_TYPE_GROUND : VOXEL_TYPE_EMPTY;
-    outVoxel->texSide = ((rand()%99) <= 30) ? VOXEL_TEX_DIRT_0 : VOXEL_TEX_DIRT_1;
-    outVoxel->texTop = ((rand()%99) <= 10) ? VOXEL_TEX_GRASS_0 : VOXEL_TEX_GRASS_1;
-}
\ No newline at end of file
+
+    const int32_t x = base.x, z = base.z;
+
+    for(long y = 0; y < top; ++y)
+    {
+        // The low and high halves of the hash choose the two textures independently.
+        // Assign the whole voxel so no stale bits from the destination buffer survive.
+        uint32_t random = hashVoxelPosition(seed, x, (int32_t)(base.y + y), z);
+        BOOL ground = column[y].opaque;
+        column[y] = (GSVoxel){
+            .outside = NO, // calculated later
+            .torch = NO,
+            .opaque = ground,
+            .type = ground ? VOXEL_TYPE_GROUND : VOXEL_TYPE_EMPTY,
+            .texSide = (((random & 0xffff) % 99) <= 30) ? VOXEL_TEX_DIRT_0 : VOXEL_TEX_DIRT_1,
+            .texTop = (((random >> 16) % 99) <= 10) ? VOXEL_TEX_GRASS_0 : VOXEL_TEX_GRASS_1
+        };
+    }
+
+    // Everything above is air. An all-zero voxel is an empty voxel.
+    _Static_assert(VOXEL_TYPE_EMPTY == 0, "An empty voxel must be all zeros to fill the column with memset.");
+    memset(&column[top], 0, (height - top) * sizeof(GSVoxel));
+}
@@ -12,14 +12,69 @@
 #import "GSTerrainVertex.h"
 
 
+/* Type of the elements of a terrain index buffer. */
+typedef GLuint GSTerrainIndex;
+
+
+/* Sides of a chunk, in the order in which skirts along them are stored. */
+typedef enum {
+    GSChunkSideNegX,
+    GSChunkSidePosX,
+    GSChunkSideNegZ,
+    GSChunkSidePosZ,
+    GSNumChunkSides
+} GSChunkSide;
+
+
+/* Indexed triangle list. Every three indices make one triangle.
+ * Vertices added with GSTerrainGeometryAddVertex() are welded as they are added, so each distinct vertex is stored
+ * only once. Meshers which know where vertices are shared may instead manage indices themselves.
+ */
 typedef struct
 {
     GSTerrainVertex * _Nullable vertices;
     size_t capacity;
     size_t count;
+
+    GSTerrainIndex * _Nullable indices;
+    size_t indexCapacity;
+    size_t indexCount;
+
+    /* Number of indices at the end of the triangle list which make up the skirt along each side of the chunk. The
+     * skirts are stored in the order of GSChunkSide, after every other triangle.
+     */
+    size_t skirtIndexCount[GSNumChunkSides];
+
+    /* Open-addressed hash table which maps a vertex to its index, plus one. Zero marks an empty bucket.
+     * Only needed while the geometry is being built. Released by GSTerrainGeometryFinish().
+     */
+    GSTerrainIndex * _Nullable weldTable;
+    size_t weldCapacity;
 } GSTerrainGeometry;
 
 
 GSTerrainGeometry * _Nonnull GSTerrainGeometryCreate(void);
+
+/* Creates empty geometry with room reserved for the specified number of vertices and indices. A good estimate lets
+ * the mesher write straight into the arrays without ever growing them.
+ */
+GSTerrainGeometry * _Nonnull GSTerrainGeometryCreateWithCapacity(size_t vertexCapacity, size_t indexCapacity);
+
 void GSTerrainGeometryDestroy(GSTerrainGeometry * _Nullable geometry);
+
+/* Adds the vertex to the end of the triangle list. If an identical vertex was added before then its index is reused
+ * instead of storing the vertex again.
+ */
 void GSTerrainGeometryAddVertex(GSTerrainGeometry * _Nonnull geometry, GSTerrainVertex * _Nonnull vertex);
+
+/* Appends the vertex without looking for an identical one, and returns its index. No triangle refers to the vertex
+ * until its index is added with GSTerrainGeometryAddIndex().
+ */
+GSTerrainIndex GSTerrainGeometryAppendVertex(GSTerrainGeometry * _Nonnull geometry,
+                                             const GSTerrainVertex * _Nonnull vertex);
+
+/* Adds the index of a vertex which was added earlier to the end of the triangle list. */
+void GSTerrainGeometryAddIndex(GSTerrainGeometry * _Nonnull geometry, GSTerrainIndex index);
+
+/* Releases memory used only while building the geometry. No more vertices may be added afterward. */
+void GSTerrainGeometryFinish(GSTerrainGeometry * _Nonnull geometry);
@@ -10,18 +10,41 @@
 
 
 GSTerrainGeometry * _Nonnull GSTerrainGeometryCreate(void)
+{
+    return GSTerrainGeometryCreateWithCapacity(1, 3);
+}
+
+
+GSTerrainGeometry * _Nonnull GSTerrainGeometryCreateWithCapacity(size_t vertexCapacity, size_t indexCapacity)
 {
     GSTerrainGeometry *geometry = malloc(sizeof(GSTerrainGeometry));
     if(!geometry) {
         [NSException raise:NSMallocException format:@"Out of memory while allocating `geometry'"];
     }
     
-    geometry->capacity = 1;
+    geometry->capacity = vertexCapacity;
     geometry->count = 0;
-    geometry->vertices = malloc(sizeof(GSTerrainVertex) * geometry->capacity);
-    if(!geometry->vertices) {
-        [NSException raise:NSMallocException format:@"Out of memory while allocating `geometry->vertices'"];
+    geometry->vertices = NULL;
+    if (vertexCapacity > 0) {
+        geometry->vertices = malloc(sizeof(GSTerrainVertex) * geometry->capacity);
+        if(!geometry->vertices) {
+            [NSException raise:NSMallocException format:@"Out of memory while allocating `geometry->vertices'"];
+        }
+    }
+
+    geometry->indexCapacity = indexCapacity;
+    geometry->indexCount = 0;
+    memset(geometry->skirtIndexCount, 0, sizeof(geometry->skirtIndexCount));
+    geometry->indices = NULL;
+    if (indexCapacity > 0) {
+        geometry->indices = malloc(sizeof(GSTerrainIndex) * geometry->indexCapacity);
+        if(!geometry->indices) {
+            [NSException raise:NSMallocException format:@"Out of memory while allocating `geometry->indices'"];
+        }
     }
+
+    geometry->weldCapacity = 0;
+    geometry->weldTable = NULL;
     
     return geometry;
 }
@@ -31,17 +54,82 @@ void GSTerrainGeometryDestroy(GSTerrainGeometry * _Nullable geometry)
 {
     if (geometry) {
         free(geometry->vertices);
+        free(geometry->indices);
+        free(geometry->weldTable);
         free(geometry);
     }
 }
 
 
-void GSTerrainGeometryAddVertex(GSTerrainGeometry * _Nonnull geometry, GSTerrainVertex * _Nonnull vertex)
+static inline uint32_t GSTerrainVertexHash(const GSTerrainVertex * _Nonnull vertex)
+{
+    // Vertices are exactly three words long and the padding is always zero, so hash the raw words.
+    uint32_t words[3];
+    memcpy(words, vertex, sizeof(words));
+
+    uint32_t h = (words[0] * 0x9E3779B1u) ^ (words[1] * 0x85EBCA77u) ^ (words[2] * 0xC2B2AE3Du);
+    h ^= h >> 15;
+    h *= 0x2C1B3C6Du;
+    h ^= h >> 13;
+    return h;
+}
+
+
+/* Returns the bucket in the weld table which holds the vertex, or the empty bucket where it would be inserted. */
+static inline size_t GSTerrainGeometryFindBucket(GSTerrainGeometry * _Nonnull geometry,
+                                                 const GSTerrainVertex * _Nonnull vertex)
+{
+    size_t mask = geometry->weldCapacity - 1;
+    size_t bucket = GSTerrainVertexHash(vertex) & mask;
+
+    while(geometry->weldTable[bucket] != 0)
+    {
+        GSTerrainIndex index = geometry->weldTable[bucket] - 1;
+        if (0 == memcmp(&geometry->vertices[index], vertex, sizeof(GSTerrainVertex))) {
+            break;
+        }
+        bucket = (bucket + 1) & mask;
+    }
+
+    return bucket;
+}
+
+
+static void GSTerrainGeometryGrowWeldTable(GSTerrainGeometry * _Nonnull geometry)
+{
+    free(geometry->weldTable);
+
+    if (geometry->weldCapacity == 0) {
+        // Size the table for the reserved vertex capacity so that it need not be rebuilt while the arrays fill up.
+        geometry->weldCapacity = 256;
+        while(geometry->weldCapacity < 2 * geometry->capacity)
+        {
+            geometry->weldCapacity *= 2;
+        }
+    } else {
+        geometry->weldCapacity *= 2;
+    }
+
+    geometry->weldTable = calloc(geometry->weldCapacity, sizeof(GSTerrainIndex));
+    if(!geometry->weldTable) {
+        [NSException raise:NSMallocException format:@"Out of memory while enlarging geometry->weldTable."];
+    }
+
+    for(size_t i = 0; i < geometry->count; ++i)
+    {
+        size_t bucket = GSTerrainGeometryFindBucket(geometry, &geometry->vertices[i]);
+        geometry->weldTable[bucket] = (GSTerrainIndex)(i + 1);
+    }
+}
+
+
+GSTerrainIndex GSTerrainGeometryAppendVertex(GSTerrainGeometry * _Nonnull geometry,
+                                             const GSTerrainVertex * _Nonnull vertex)
 {
     assert(geometry);
     assert(vertex);
     assert(geometry->count <= geometry->capacity);
-    
+
     if ((geometry->count == geometry->capacity) || (geometry->capacity == 0)) {
         geometry->capacity = (geometry->capacity == 0) ? 1 : (geometry->capacity * 2);
         geometry->vertices = reallocf(geometry->vertices, geometry->capacity * sizeof(GSTerrainVertex));
@@ -51,5 +139,54 @@ void GSTerrainGeometryAddVertex(GSTerrainGeometry * _Nonnull geometry, GSTerrain
     }
 
     geometry->vertices[geometry->count] = *vertex;
-    geometry->count++;
-}
\ No newline at end of file
+    return (GSTerrainIndex)(geometry->count++);
+}
+
+
+void GSTerrainGeometryAddIndex(GSTerrainGeometry * _Nonnull geometry, GSTerrainIndex index)
+{
+    assert(geometry);
+    assert(index < geometry->count);
+    assert(geometry->indexCount <= geometry->indexCapacity);
+
+    if ((geometry->indexCount == geometry->indexCapacity) || (geometry->indexCapacity == 0)) {
+        geometry->indexCapacity = (geometry->indexCapacity == 0) ? 3 : (geometry->indexCapacity * 2);
+        geometry->indices = reallocf(geometry->indices, geometry->indexCapacity * sizeof(GSTerrainIndex));
+        if(!geometry->indices) {
+            [NSException raise:NSMallocException format:@"Out of memory while enlarging geometry->indices."];
+        }
+    }
+
+    geometry->indices[geometry->indexCount] = index;
+    geometry->indexCount++;
+}
+
+
+void GSTerrainGeometryAddVertex(GSTerrainGeometry * _Nonnull geometry, GSTerrainVertex * _Nonnull vertex)
+{
+    assert(geometry);
+    assert(vertex);
+
+    // Keep the weld table no more than half full so that probe sequences stay short.
+    if (2 * (geometry->count + 1) > geometry->weldCapacity) {
+        GSTerrainGeometryGrowWeldTable(geometry);
+    }
+
+    size_t bucket = GSTerrainGeometryFindBucket(geometry, vertex);
+
+    if (geometry->weldTable[bucket] == 0) {
+        geometry->weldTable[bucket] = GSTerrainGeometryAppendVertex(geometry, vertex) + 1;
+    }
+
+    GSTerrainGeometryAddIndex(geometry, geometry->weldTable[bucket] - 1);
+}
+
+
+void GSTerrainGeometryFinish(GSTerrainGeometry * _Nonnull geometry)
+{
+    assert(geometry);
+
+    free(geometry->weldTable);
+    geometry->weldTable = NULL;
+    geometry->weldCapacity = 0;
+}
@@ -9,8 +9,23 @@
 #import <Foundation/Foundation.h>
 #import "GSTerrainGeometryGeneratorInternal.h"
 
+
+typedef enum {
+    /* Emit one quad for each exposed face of each block. */
+    GSBlockMeshingPerFace,
+
+    /* Merge coplanar faces with the same texture and light into maximal rectangles, one slice at a time. */
+    GSBlockMeshingGreedy
+} GSBlockMeshingMode;
+
+
+/* Generates geometry for the wall blocks in `ibounds'. With a `step' greater than one, the blocks are meshed as
+ * though each were `step' voxels across, sampling the voxel at the min corner of each.
+ */
 void GSTerrainGeometryBlockGen(GSTerrainGeometry * _Nonnull geometry,
                                GSVoxel * _Nonnull voxels,
                                GSIntAABB voxelBox,
                                vector_float3 chunkMinP,
-                               GSIntAABB ibounds);
\ No newline at end of file
+                               GSIntAABB ibounds,
+                               long step,
+                               GSBlockMeshingMode mode);
@@ -50,42 +50,56 @@ static const vector_float2 cornerSelect[4] = {
 
 
 static void addQuad(GSTerrainGeometry * _Nonnull geometry,
+                    vector_float3 chunkMinP,
                     vector_float3 vertices[4],
                     vector_float2 texCoords[4],
-                    int tex)
+                    int tex,
+                    uint8_t luminance)
 {
-    // TODO: apply lighting to the quad's vertices
-    vector_uchar4 colors[4] = {
-        {255, 255, 255, 255},
-        {255, 255, 255, 255},
-        {255, 255, 255, 255},
-        {255, 255, 255, 255}
-    };
-
     int vertexIndices[6] = {0, 1, 3, 1, 2, 3};
     for(int i = 0; i < 6; ++i)
     {
         int idx = vertexIndices[i];
-        vector_float3 pos = vertices[idx];
-        vector_float2 texCoord = texCoords[idx];
-        vector_uchar4 color = colors[idx];
+        GSTerrainVertex v = GSTerrainVertexMake(vertices[idx] - chunkMinP, texCoords[idx], tex, luminance);
+        GSTerrainGeometryAddVertex(geometry, &v);
+    }
+}
 
-        GSTerrainVertex v = {
-            .position = {pos.x, pos.y, pos.z},
-            .color = {color.x, color.y, color.z, color.w},
-            .texCoord = {texCoord.x, texCoord.y, tex}
-        };
 
-        GSTerrainGeometryAddVertex(geometry, &v);
+/* Adds a quad covering a rectangle of `w' by `h' faces, where `w' runs along the face tangent and `h' along the face
+ * bitangent. `center' is the center of the box of blocks whose faces are covered, and `d' is the depth of that box
+ * along the normal. Texture coordinates span one unit per block so that the texture repeats across the rectangle
+ * exactly as it would across individual faces.
+ */
+static void addRect(GSTerrainGeometry * _Nonnull geometry,
+                    vector_float3 chunkMinP,
+                    GSCubeFace face,
+                    vector_float3 center,
+                    long w, long h, long d,
+                    int tex,
+                    uint8_t luminance)
+{
+    vector_float3 n = normals[face] * (d * L);
+    vector_float3 t = tangents[face] * (w * L);
+    vector_float3 b = bitangents[face] * (h * L);
+    vector_float3 vertices[4];
+    vector_float2 texCoords[4];
+
+    for(int f = 0; f < 4; ++f)
+    {
+        vertices[f] = center + n + t * cornerSelect[f].x + b * cornerSelect[f].y;
+        texCoords[f] = (vector_float2){(cornerSelect[f].x + 1) * w * L, 1 + (1 - cornerSelect[f].y) * h * L};
     }
+
+    addQuad(geometry, chunkMinP, vertices, texCoords, tex, luminance);
 }
 
 
-static inline int getAdjacentVoxelType(GSCubeFace dir, vector_float3 pos, vector_float3 chunkMinP,
+static inline int getAdjacentVoxelType(GSCubeFace dir, vector_float3 pos, long step, vector_float3 chunkMinP,
                                        GSVoxel * _Nonnull voxels, GSIntAABB voxelBox)
 {
     int adjacentVoxelType;
-    vector_long3 chunkLocalPos = vector_long(pos + normals[dir] - chunkMinP);
+    vector_long3 chunkLocalPos = vector_long(pos + normals[dir]*step - chunkMinP);
 
     if (chunkLocalPos.y < CHUNK_SIZE_Y && chunkLocalPos.y >= 0) {
         adjacentVoxelType = voxels[INDEX_BOX(chunkLocalPos, voxelBox)].type;
@@ -115,45 +129,169 @@ static inline int getTextureIndex(GSVoxelTexture tex)
     }
 }
 
-void GSTerrainGeometryBlockGen(GSTerrainGeometry * _Nonnull geometry,
-                               GSVoxel * _Nonnull voxels,
-                               GSIntAABB voxelBox,
-                               vector_float3 chunkMinP,
-                               GSIntAABB ibounds)
+/* Returns the index of the axis along which the unit vector points. */
+static inline int axisOf(vector_float3 v)
 {
-    assert(geometry);
-    assert(voxels);
-    
-    vector_float3 pos;
-    GSFloatAABB bounds = { .mins = vector_float(ibounds.mins), .maxs = vector_float(ibounds.maxs) };
+    return (v.x != 0) ? 0 : ((v.y != 0) ? 1 : 2);
+}
 
-    FOR_BOX(pos, bounds)
+/* Returns a nonzero key describing the appearance of the specified face of the block, or zero if the face is hidden.
+ * Faces may be merged only when their keys are equal. At coarser levels of detail, a block `step' voxels across takes
+ * its type from the voxel at its min corner.
+ */
+static inline uint32_t getFaceKey(GSCubeFace face, vector_float3 pos, long step, vector_float3 chunkMinP,
+                                  GSVoxel * _Nonnull voxels, GSIntAABB voxelBox)
+{
+    GSVoxel voxel = voxels[INDEX_BOX(vector_long(pos - chunkMinP), voxelBox)];
+
+    if ((voxel.type != VOXEL_TYPE_WALL) ||
+        (getAdjacentVoxelType(face, pos, step, chunkMinP, voxels, voxelBox) == VOXEL_TYPE_WALL)) {
+        return 0;
+    }
+
+    // TODO: apply lighting to the block faces
+    uint32_t luminance = 255;
+    uint32_t tex = getTextureIndex(VOXEL_TEX_STONE_0);
+
+    return (1u << 16) | (luminance << 8) | tex;
+}
+
+static void blockGenPerFace(GSTerrainGeometry * _Nonnull geometry,
+                            GSVoxel * _Nonnull voxels,
+                            GSIntAABB voxelBox,
+                            vector_float3 chunkMinP,
+                            GSIntAABB ibounds,
+                            long step)
+{
+    vector_long3 p;
+
+    FOR_BOX(p, ibounds)
     {
-        GSVoxel centerVoxel = voxels[INDEX_BOX(vector_long(pos - chunkMinP), voxelBox)];
-        
-        if (centerVoxel.type != VOXEL_TYPE_WALL) {
+        if (((p.x - ibounds.mins.x) % step) || ((p.y - ibounds.mins.y) % step) || ((p.z - ibounds.mins.z) % step)) {
             continue;
         }
-        
-        for(int i = 0; i < NUM_CUBE_FACES; ++i)
+
+        vector_float3 pos = vector_float(p);
+
+        for(GSCubeFace face = 0; face < NUM_CUBE_FACES; ++face)
+        {
+            uint32_t key = getFaceKey(face, pos, step, chunkMinP, voxels, voxelBox);
+
+            if (key) {
+                vector_float3 center = pos + LLL * (step - 1);
+                addRect(geometry, chunkMinP, face, center, step, step, step, key & 0xff, (key >> 8) & 0xff);
+            }
+        }
+    }
+}
+
+static void blockGenGreedy(GSTerrainGeometry * _Nonnull geometry,
+                           GSVoxel * _Nonnull voxels,
+                           GSIntAABB voxelBox,
+                           vector_float3 chunkMinP,
+                           GSIntAABB ibounds,
+                           long step)
+{
+    // Dimensions of the sub-chunk in blocks, which are `step' voxels across.
+    vector_long3 dim = (ibounds.maxs - ibounds.mins) / step;
+
+    for(GSCubeFace face = 0; face < NUM_CUBE_FACES; ++face)
+    {
+        // Each slice is a plane of faces perpendicular to the normal. `u' runs along the tangent axis and `v' along
+        // the bitangent axis, both in the direction of increasing world coordinates.
+        int axisN = axisOf(normals[face]), axisU = axisOf(tangents[face]), axisV = axisOf(bitangents[face]);
+        long dimU = dim[axisU], dimV = dim[axisV];
+        uint32_t mask[dimU * dimV];
+
+        for(long s = ibounds.mins[axisN]; s < ibounds.maxs[axisN]; s += step)
         {
-            if (getAdjacentVoxelType(i, pos, chunkMinP, voxels, voxelBox) == VOXEL_TYPE_WALL) {
-                continue;
+            vector_float3 pos;
+            pos[axisN] = s;
+
+            for(long v = 0; v < dimV; ++v)
+            {
+                for(long u = 0; u < dimU; ++u)
+                {
+                    pos[axisU] = ibounds.mins[axisU] + u*step;
+                    pos[axisV] = ibounds.mins[axisV] + v*step;
+                    mask[v*dimU + u] = getFaceKey(face, pos, step, chunkMinP, voxels, voxelBox);
+                }
             }
-            
-            vector_float3 n = normals[i];
-            vector_float3 t = tangents[i];
-            vector_float3 b = bitangents[i];
-            vector_float3 vertices[4];
-            vector_float2 texCoords[4];
-            
-            for(int f = 0; f < 4; ++f)
+
+            for(long v = 0; v < dimV; ++v)
             {
-                vertices[f] = pos + L*(n + t * cornerSelect[f].x + b * cornerSelect[f].y);
-                texCoords[f] = (vector_float2){cornerSelect[f].x*0.5f+0.5f, 1-cornerSelect[f].y*0.5f+0.5f};
+                for(long u = 0; u < dimU; ++u)
+                {
+                    uint32_t key = mask[v*dimU + u];
+
+                    if (!key) {
+                        continue;
+                    }
+
+                    // Grow the rectangle along `u' as far as possible, and then along `v' for as long as each whole
+                    // row matches.
+                    long w = 1, h = 1;
+
+                    while((u + w < dimU) && (mask[v*dimU + u + w] == key))
+                    {
+                        ++w;
+                    }
+
+                    for(BOOL rowMatches = YES; rowMatches && (v + h < dimV); )
+                    {
+                        for(long k = 0; k < w; ++k)
+                        {
+                            if (mask[(v + h)*dimU + u + k] != key) {
+                                rowMatches = NO;
+                                break;
+                            }
+                        }
+
+                        if (rowMatches) {
+                            ++h;
+                        }
+                    }
+
+                    for(long j = 0; j < h; ++j)
+                    {
+                        for(long k = 0; k < w; ++k)
+                        {
+                            mask[(v + j)*dimU + u + k] = 0;
+                        }
+                    }
+
+                    vector_float3 center;
+                    center[axisN] = s + (step - 1) * L;
+                    center[axisU] = ibounds.mins[axisU] + u*step + (w*step - 1) * L;
+                    center[axisV] = ibounds.mins[axisV] + v*step + (h*step - 1) * L;
+
+                    addRect(geometry, chunkMinP, face, center, w*step, h*step, step, key & 0xff, (key >> 8) & 0xff);
+                }
             }
-            
-            addQuad(geometry, vertices, texCoords, getTextureIndex(VOXEL_TEX_STONE_0));
         }
     }
 }
+
+void GSTerrainGeometryBlockGen(GSTerrainGeometry * _Nonnull geometry,
+                               GSVoxel * _Nonnull voxels,
+                               GSIntAABB voxelBox,
+                               vector_float3 chunkMinP,
+                               GSIntAABB ibounds,
+                               long step,
+                               GSBlockMeshingMode mode)
+{
+    assert(geometry);
+    assert(voxels);
+    assert(step > 0);
+
+    switch(mode)
+    {
+        case GSBlockMeshingPerFace:
+            blockGenPerFace(geometry, voxels, voxelBox, chunkMinP, ibounds, step);
+            break;
+
+        case GSBlockMeshingGreedy:
+            blockGenGreedy(geometry, voxels, voxelBox, chunkMinP, ibounds, step);
+            break;
+    }
+}
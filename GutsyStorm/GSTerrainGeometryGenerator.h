@@ -20,14 +20,69 @@
 #define GSNumGeometrySubChunks (16)
 
 
+/* Distant chunks are meshed at coarser levels of detail. Level `n' samples every 2^n-th voxel along each axis, so each
+ * level has roughly a quarter of the triangles of the level before it.
+ */
+#define GSNumLevelsOfDetail (4)
+
+static inline long GSTerrainGeometryStepForLevelOfDetail(NSUInteger levelOfDetail)
+{
+    return 1L << levelOfDetail;
+}
+
+/* Returns the level of detail for a chunk whose center is at the specified horizontal distance from the camera. */
+NSUInteger GSTerrainGeometryLevelOfDetailForDistance(float distance);
+
+
+/* Summarizes the contents of one geometry sub-chunk of a chunk of voxels. Meshing uses these summaries to skip
+ * sub-chunks which cannot produce any geometry, without examining the voxels themselves.
+ */
+typedef enum {
+    GSSubchunkNoGround      = (1 << 0), // No voxel in the sub-chunk is ground, i.e. all are empty or wall.
+    GSSubchunkAllGround     = (1 << 1), // Every voxel in the sub-chunk is ground.
+    GSSubchunkHasWall       = (1 << 2), // At least one voxel in the sub-chunk is a wall.
+    GSSubchunkBaseNoGround  = (1 << 3), // No voxel in the bottom layer of the sub-chunk is ground.
+    GSSubchunkBaseAllGround = (1 << 4), // Every voxel in the bottom layer of the sub-chunk is ground.
+} GSSubchunkOccupancy;
+
+
+/* Chunks whose occupancy summaries are needed to decide whether a sub-chunk of the center chunk can be skipped.
+ * Marching cubes cells along the +X and +Z sides of a chunk have corners in these neighboring chunks.
+ */
+typedef enum {
+    GSMeshingNeighborCenter,
+    GSMeshingNeighborPosX,
+    GSMeshingNeighborPosZ,
+    GSMeshingNeighborPosXPosZ,
+    GSNumMeshingNeighbors
+} GSMeshingNeighbor;
+
+
 GSFloatAABB GSTerrainGeometrySubchunkBoxFloat(vector_float3 minP, NSUInteger i);
 GSIntAABB GSTerrainGeometrySubchunkBoxInt(vector_float3 minP, NSUInteger i);
 
 
+/* Computes the occupancy summary of each sub-chunk of one chunk. `chunkMin' is the min corner of the chunk within
+ * `voxelBox'.
+ */
+void GSTerrainGeometryComputeOccupancy(const GSVoxel * _Nonnull voxels,
+                                       GSIntAABB voxelBox,
+                                       vector_long3 chunkMin,
+                                       GSSubchunkOccupancy occupancy[_Nonnull GSNumGeometrySubChunks]);
+
+
+/* Returns YES if sub-chunk `i' of the center chunk would produce no geometry, and so doesn't need to be generated.
+ * `occupancy' holds the summaries of the chunks listed in GSMeshingNeighbor.
+ */
+BOOL GSTerrainGeometryCanSkipSubchunk(const GSSubchunkOccupancy * _Nonnull const * _Nonnull occupancy,
+                                      NSUInteger i);
+
+
 void GSTerrainGeometryGenerate(GSTerrainGeometry * _Nonnull geometry,
                                GSVoxel * _Nonnull voxels,
                                GSIntAABB voxelBox,
-                               GSTerrainBufferElement * _Nonnull light,
+                               const uint8_t * _Nonnull const * _Nonnull light,
                                GSIntAABB * _Nonnull lightBox,
                                vector_float3 chunkMinP,
-                               NSUInteger subchunkIndex);
+                               NSUInteger subchunkIndex,
+                               NSUInteger levelOfDetail);
@@ -10,10 +10,34 @@
 #import "GSTerrainGeometryMarchingCubes.h"
 #import "GSTerrainGeometryBlockGen.h"
 #import "GSVoxel.h" // for CHUNK_SIZE_Y
+#import "GSBox.h"
 
 
 _Static_assert(CHUNK_SIZE_Y % GSNumGeometrySubChunks == 0,
                "Chunk size must be evenly divisible by the number of geometry sub-chunks");
+_Static_assert((CHUNK_SIZE_Y / GSNumGeometrySubChunks) % (1 << (GSNumLevelsOfDetail-1)) == 0 &&
+               CHUNK_SIZE_X % (1 << (GSNumLevelsOfDetail-1)) == 0 &&
+               CHUNK_SIZE_Z % (1 << (GSNumLevelsOfDetail-1)) == 0,
+               "Sub-chunks must be evenly divisible into cells at the coarsest level of detail");
+
+
+/* Horizontal distance from the camera at which each level of detail begins. Nearby chunks are drawn at full detail,
+ * and each ring beyond that halves the sampling rate.
+ */
+static const float GSLevelOfDetailDistances[GSNumLevelsOfDetail] = {0, 64, 128, 192};
+
+
+NSUInteger GSTerrainGeometryLevelOfDetailForDistance(float distance)
+{
+    NSUInteger levelOfDetail = 0;
+
+    while((levelOfDetail + 1 < GSNumLevelsOfDetail) && (distance >= GSLevelOfDetailDistances[levelOfDetail + 1]))
+    {
+        ++levelOfDetail;
+    }
+
+    return levelOfDetail;
+}
 
 
 GSFloatAABB GSTerrainGeometrySubchunkBoxFloat(vector_float3 minP, NSUInteger i)
@@ -32,15 +56,192 @@ GSIntAABB GSTerrainGeometrySubchunkBoxInt(vector_float3 minP, NSUInteger i)
 }
 
 
+void GSTerrainGeometryComputeOccupancy(const GSVoxel * _Nonnull voxels,
+                                       GSIntAABB voxelBox,
+                                       vector_long3 chunkMin,
+                                       GSSubchunkOccupancy occupancy[_Nonnull GSNumGeometrySubChunks])
+{
+    assert(voxels);
+    assert(occupancy);
+
+    const long subchunkHeight = CHUNK_SIZE_Y / GSNumGeometrySubChunks;
+
+    for(NSUInteger i = 0; i < GSNumGeometrySubChunks; ++i)
+    {
+        BOOL anyGround = NO, allGround = YES, anyWall = NO, baseAnyGround = NO, baseAllGround = YES;
+        GSIntAABB box = {
+            .mins = chunkMin + (vector_long3){0, i * subchunkHeight, 0},
+            .maxs = chunkMin + (vector_long3){CHUNK_SIZE_X, (i+1) * subchunkHeight, CHUNK_SIZE_Z}
+        };
+
+        vector_long3 p;
+        FOR_Y_COLUMN_IN_BOX(p, box)
+        {
+            // Columns are contiguous in memory so walk each one directly.
+            const GSVoxel *column = &voxels[INDEX_BOX(p, voxelBox)];
+
+            for(long y = 0; y < subchunkHeight; ++y)
+            {
+                BOOL ground = (column[y].type == VOXEL_TYPE_GROUND);
+                anyGround |= ground;
+                allGround &= ground;
+                anyWall |= (column[y].type == VOXEL_TYPE_WALL);
+            }
+
+            BOOL baseGround = (column[0].type == VOXEL_TYPE_GROUND);
+            baseAnyGround |= baseGround;
+            baseAllGround &= baseGround;
+        }
+
+        occupancy[i] = (anyGround     ? 0 : GSSubchunkNoGround) |
+                       (allGround     ? GSSubchunkAllGround : 0) |
+                       (anyWall       ? GSSubchunkHasWall : 0) |
+                       (baseAnyGround ? 0 : GSSubchunkBaseNoGround) |
+                       (baseAllGround ? GSSubchunkBaseAllGround : 0);
+    }
+}
+
+
+BOOL GSTerrainGeometryCanSkipSubchunk(const GSSubchunkOccupancy * _Nonnull const * _Nonnull occupancy,
+                                      NSUInteger i)
+{
+    assert(occupancy);
+    assert(i < GSNumGeometrySubChunks);
+
+    // Only walls in the chunk itself produce block geometry.
+    if (occupancy[GSMeshingNeighborCenter][i] & GSSubchunkHasWall) {
+        return NO;
+    }
+
+    // Marching cubes produces nothing when every cell corner is on the same side of the surface. The corners span the
+    // sub-chunk in each of the neighbors, plus the bottom layer of the sub-chunk above. Above the world is empty.
+    BOOL top = (i + 1 == GSNumGeometrySubChunks);
+    BOOL uniformlyEmpty = YES, uniformlyGround = !top;
+
+    for(GSMeshingNeighbor n = 0; n < GSNumMeshingNeighbors; ++n)
+    {
+        GSSubchunkOccupancy current = occupancy[n][i];
+        GSSubchunkOccupancy above = top ? GSSubchunkBaseNoGround : occupancy[n][i+1];
+
+        uniformlyEmpty &= (current & GSSubchunkNoGround) && (above & GSSubchunkBaseNoGround);
+        uniformlyGround &= (current & GSSubchunkAllGround) && (above & GSSubchunkBaseAllGround);
+    }
+
+    return uniformlyEmpty || uniformlyGround;
+}
+
+
+/* Returns the index of a copy of the vertex at `index', lowered by `drop'. Copies are made once and recorded in
+ * `dropped', so that adjacent skirts share their bottom vertices.
+ */
+static GSTerrainIndex droppedVertex(GSTerrainGeometry * _Nonnull geometry,
+                                    GSTerrainIndex * _Nonnull dropped,
+                                    GSTerrainIndex index,
+                                    GLshort drop)
+{
+    if (dropped[index] == 0) {
+        GSTerrainVertex v = geometry->vertices[index];
+        v.position[1] = MAX(0, v.position[1] - drop);
+        dropped[index] = GSTerrainGeometryAppendVertex(geometry, &v) + 1;
+    }
+
+    return dropped[index] - 1;
+}
+
+
+/* Returns YES if the edge from `a' to `b' lies on the specified side of the chunk. */
+static inline BOOL edgeIsOnSide(const GLshort * _Nonnull a, const GLshort * _Nonnull b, GSChunkSide side)
+{
+    switch(side)
+    {
+        case GSChunkSideNegX: return (a[0] == b[0]) && (a[0] == 0);
+        case GSChunkSidePosX: return (a[0] == b[0]) && (a[0] == CHUNK_SIZE_X * GS_TERRAIN_VERTEX_POSITION_SCALE);
+        case GSChunkSideNegZ: return (a[2] == b[2]) && (a[2] == 0);
+        case GSChunkSidePosZ: return (a[2] == b[2]) && (a[2] == CHUNK_SIZE_Z * GS_TERRAIN_VERTEX_POSITION_SCALE);
+        default: assert(!"invalid side"); return NO;
+    }
+}
+
+
+/* Hangs a skirt of `depth' voxels below each edge of the triangles in [firstIndex, lastIndex) which lies on a side of
+ * the chunk. Where neighboring chunks are drawn at different levels of detail, the two surfaces meet the shared side at
+ * slightly different heights. Either surface may be the higher one, so both chunks need skirts there and the crack is
+ * filled by whichever is on top. The crack may be seen from either chunk, so skirts are two-sided.
+ *
+ * Skirts are only needed along sides which border a chunk at another level of detail, and that isn't known until the
+ * chunk is drawn. So the skirts are appended one side at a time, after all other geometry, and their lengths are
+ * recorded in `skirtIndexCount' so that each side can be drawn or left out on its own.
+ */
+static void addSkirts(GSTerrainGeometry * _Nonnull geometry, size_t firstIndex, size_t lastIndex, long depth)
+{
+    const GLshort drop = depth * GS_TERRAIN_VERTEX_POSITION_SCALE;
+    GSTerrainIndex *dropped = NULL;
+
+    for(GSChunkSide side = 0; side < GSNumChunkSides; ++side)
+    {
+        const size_t firstSkirtIndex = geometry->indexCount;
+
+        for(size_t i = firstIndex; i < lastIndex; i += 3)
+        {
+            for(size_t j = 0; j < 3; ++j)
+            {
+                GSTerrainIndex ia = geometry->indices[i + j];
+                GSTerrainIndex ib = geometry->indices[i + (j+1)%3];
+
+                if (!edgeIsOnSide(geometry->vertices[ia].position, geometry->vertices[ib].position, side)) {
+                    continue;
+                }
+
+                if (!dropped) {
+                    // Skirts only hang from vertices which were already there, so this never needs to grow.
+                    dropped = calloc(geometry->count, sizeof(GSTerrainIndex));
+                    if (!dropped) {
+                        [NSException raise:NSMallocException format:@"Out of memory allocating `dropped'."];
+                    }
+                }
+
+                GSTerrainIndex ic = droppedVertex(geometry, dropped, ib, drop);
+                GSTerrainIndex id = droppedVertex(geometry, dropped, ia, drop);
+
+                const GSTerrainIndex quad[12] = {ia, ib, ic, ia, ic, id, ia, ic, ib, ia, id, ic};
+                for(size_t k = 0; k < 12; ++k)
+                {
+                    GSTerrainGeometryAddIndex(geometry, quad[k]);
+                }
+            }
+        }
+
+        geometry->skirtIndexCount[side] = geometry->indexCount - firstSkirtIndex;
+    }
+
+    free(dropped);
+}
+
+
 void GSTerrainGeometryGenerate(GSTerrainGeometry * _Nonnull geometry,
                                GSVoxel * _Nonnull voxels,
                                GSIntAABB voxelBox,
-                               GSTerrainBufferElement * _Nonnull light,
+                               const uint8_t * _Nonnull const * _Nonnull light,
                                GSIntAABB * _Nonnull lightBox,
                                vector_float3 chunkMinP,
-                               NSUInteger subchunkIndex)
+                               NSUInteger subchunkIndex,
+                               NSUInteger levelOfDetail)
 {
+    assert(levelOfDetail < GSNumLevelsOfDetail);
+
     GSIntAABB ibounds = GSTerrainGeometrySubchunkBoxInt(chunkMinP, subchunkIndex);
-    GSTerrainGeometryMarchingCubes(geometry, voxels, voxelBox, light, lightBox, chunkMinP, ibounds);
-    GSTerrainGeometryBlockGen(geometry, voxels, voxelBox, chunkMinP, ibounds);
+    long step = GSTerrainGeometryStepForLevelOfDetail(levelOfDetail);
+    size_t firstIndex = geometry->indexCount;
+
+    GSTerrainGeometryMarchingCubes(geometry, voxels, voxelBox, light, lightBox, chunkMinP, ibounds, step);
+    size_t lastIndex = geometry->indexCount;
+
+    GSTerrainGeometryBlockGen(geometry, voxels, voxelBox, chunkMinP, ibounds, step, GSBlockMeshingGreedy);
+
+    // Neighboring chunks are never more than one level apart, so the coarser of the two surfaces at a shared side is at
+    // most one level coarser than this one. They may differ by up to about one coarse cell, plus the slope across it.
+    NSUInteger coarserLevelOfDetail = MIN(levelOfDetail + 1, GSNumLevelsOfDetail - 1);
+    addSkirts(geometry, firstIndex, lastIndex, 2*GSTerrainGeometryStepForLevelOfDetail(coarserLevelOfDetail));
+
+    GSTerrainGeometryFinish(geometry);
 }
@@ -9,10 +9,24 @@
 #import <Foundation/Foundation.h>
 #import "GSTerrainGeometryGeneratorInternal.h"
 
+/* Extracts the surface of the ground voxels in `ibounds'. Cell corners are `step' voxels apart, so a step greater than
+ * one samples the voxels more coarsely and yields a proportionally simpler mesh.
+ */
 void GSTerrainGeometryMarchingCubes(GSTerrainGeometry * _Nonnull geometry,
                                     GSVoxel * _Nonnull voxels,
                                     GSIntAABB voxelBox,
-                                    GSTerrainBufferElement * _Nonnull light,
+                                    const uint8_t * _Nonnull const * _Nonnull light,
                                     GSIntAABB * _Nonnull lightBox,
                                     vector_float3 chunkMinP,
-                                    GSIntAABB ibounds);
\ No newline at end of file
+                                    GSIntAABB ibounds,
+                                    long step);
+
+
+/* Counts the cells in `ibounds' which the surface passes through. This uses the same packed ground masks which
+ * GSTerrainGeometryMarchingCubes() uses to find those cells, and is exposed so that the kernel can be benchmarked.
+ */
+size_t GSTerrainGeometryMarchingCubesCountSurfaceCells(const GSVoxel * _Nonnull voxels,
+                                                       GSIntAABB voxelBox,
+                                                       vector_float3 chunkMinP,
+                                                       GSIntAABB ibounds,
+                                                       long step);
@@ -8,6 +8,7 @@
 
 #import "GSTerrainGeometryMarchingCubes.h"
 #import "GSVectorUtils.h"
+#import "GSTerrainLightBuffer.h"
 
 
 typedef struct {
@@ -17,10 +18,30 @@ typedef struct {
     
     vector_float3 worldPos;
     const GSVoxel *voxel;
-    int light;
+    int light[NUM_LIGHT_CHANNELS];
+
+    /* Bit set for each of the 26 neighboring voxels which is opaque. See NEIGHBOR_BIT(). */
+    uint32_t occluders;
+
+    /* Index, plus one, of the vertex already emitted on each lattice edge leaving this corner along +x, +y, and +z.
+     * Zero if there is none yet. See GSCubeCorner.
+     */
+    GSTerrainIndex * _Nonnull edges;
+
+    /* Texture projection of the vertex on each of those edges. See GSCubeCorner. */
+    uint8_t * _Nonnull edgeProjections;
 } GSCubeVertex;
 
 
+/* Plane onto which a face's texture coordinates are projected, named by the axis along which they are projected. */
+typedef enum
+{
+    TEX_PROJECT_X, // (z, y)
+    TEX_PROJECT_Y, // (x, z)
+    TEX_PROJECT_Z  // (x, y)
+} GSTexProjection;
+
+
 typedef struct {
     size_t v1, v2;
 } GSPair;
@@ -42,73 +63,260 @@ static inline float clampf(float value, float min, float max)
 }
 
 
-static vector_uchar4 vertexColor(GSCubeVertex v1, GSCubeVertex v2,
-                                 vector_float3 worldPos,
-                                 vector_float3 chunkMinP,
-                                 vector_float3 normal,
-                                 GSVoxel * _Nonnull voxels,
-                                 GSIntAABB * _Nonnull voxelBox)
+/* Bit in an occluder mask for the neighbor at the offset (dx, dy, dz). The bit for (0, 0, 0) is never set. */
+#define NEIGHBOR_BIT(dx, dy, dz) (((dx)+1)*9 + ((dy)+1)*3 + ((dz)+1))
+
+/* Vertex normals are quantized so that their largest component is NORMAL_QUANTA. */
+#define NORMAL_QUANTA (8)
+#define NORMAL_QUANTA_DIM (2*NORMAL_QUANTA + 1)
+
+
+/* Ambient occlusion weights for one quantized vertex normal. */
+typedef struct {
+    /* Bit set for each neighbor which lies in front of the face and so contributes to its occlusion. */
+    uint32_t facing;
+
+    /* Weight of each neighbor, by the angle between the normal and the direction to the neighbor. */
+    float weight[27];
+
+    /* Reciprocal of the sum of weights of the facing neighbors. */
+    float invTotal;
+} GSOcclusionWeights;
+
+
+/* Returns the table of occlusion weights indexed by quantized normal. The table is computed once, on first use. */
+static const GSOcclusionWeights * _Nonnull occlusionWeightsTable(void)
 {
-    float count = 0;
-    float escaped = 0;
-    
-    // Cast rays from the vertex to neighboring cells and count what proportion of the rays escape.
-    // Modify each neighbor's contribution to the occlusion factor by the angle between the ray and the face normal.
-    // These contributions are computed once per face.
-    for(float dx = -1; dx <= 1; dx += 1.0f)
+    static dispatch_once_t onceToken;
+    static GSOcclusionWeights *table;
+
+    dispatch_once(&onceToken, ^{
+        const size_t count = NORMAL_QUANTA_DIM * NORMAL_QUANTA_DIM * NORMAL_QUANTA_DIM;
+        table = calloc(count, sizeof(GSOcclusionWeights));
+        if (!table) {
+            [NSException raise:NSMallocException format:@"Out of memory allocating the occlusion weights table."];
+        }
+
+        for(int qx = -NORMAL_QUANTA; qx <= NORMAL_QUANTA; ++qx)
+        {
+            for(int qy = -NORMAL_QUANTA; qy <= NORMAL_QUANTA; ++qy)
+            {
+                for(int qz = -NORMAL_QUANTA; qz <= NORMAL_QUANTA; ++qz)
+                {
+                    size_t idx = ((qx+NORMAL_QUANTA)*NORMAL_QUANTA_DIM + (qy+NORMAL_QUANTA))*NORMAL_QUANTA_DIM +
+                                 (qz+NORMAL_QUANTA);
+                    GSOcclusionWeights *entry = &table[idx];
+
+                    if (qx == 0 && qy == 0 && qz == 0) {
+                        continue;
+                    }
+
+                    vector_float3 normal = vector_normalize((vector_float3){qx, qy, qz});
+                    float total = 0;
+
+                    for(int dx = -1; dx <= 1; ++dx)
+                    {
+                        for(int dy = -1; dy <= 1; ++dy)
+                        {
+                            for(int dz = -1; dz <= 1; ++dz)
+                            {
+                                if (dx == 0 && dy == 0 && dz == 0) {
+                                    continue;
+                                }
+
+                                vector_float3 lightDir = {dx, dy, dz};
+                                float contribution = vector_dot(normal, lightDir) / vector_length(lightDir);
+
+                                if (contribution > 0) {
+                                    entry->facing |= 1u << NEIGHBOR_BIT(dx, dy, dz);
+                                    entry->weight[NEIGHBOR_BIT(dx, dy, dz)] = contribution;
+                                    total += contribution;
+                                }
+                            }
+                        }
+                    }
+
+                    entry->invTotal = 1.0f / total;
+                }
+            }
+        }
+    });
+
+    return table;
+}
+
+
+/* Returns the occlusion weights for the vertex normal, which need not be normalized. */
+static inline const GSOcclusionWeights * _Nonnull occlusionWeightsForNormal(vector_float3 normal)
+{
+    vector_float3 magnitude = vector_abs(normal);
+    float scale = NORMAL_QUANTA / MAX(magnitude.x, MAX(magnitude.y, magnitude.z));
+    int qx = (int)roundf(normal.x * scale);
+    int qy = (int)roundf(normal.y * scale);
+    int qz = (int)roundf(normal.z * scale);
+
+    assert(qx >= -NORMAL_QUANTA && qx <= NORMAL_QUANTA);
+    assert(qy >= -NORMAL_QUANTA && qy <= NORMAL_QUANTA);
+    assert(qz >= -NORMAL_QUANTA && qz <= NORMAL_QUANTA);
+    assert(qx != 0 || qy != 0 || qz != 0);
+
+    size_t idx = ((qx+NORMAL_QUANTA)*NORMAL_QUANTA_DIM + (qy+NORMAL_QUANTA))*NORMAL_QUANTA_DIM + (qz+NORMAL_QUANTA);
+    return &occlusionWeightsTable()[idx];
+}
+
+
+/* Returns the mask of opaque voxels among the 26 neighbors of the specified voxel, where neighbors are `step' voxels
+ * apart. Voxels above or below the world are never opaque.
+ */
+static uint32_t occludersAroundVoxel(vector_long3 chunkLocalPos, long step,
+                                     GSVoxel * _Nonnull voxels, GSIntAABB voxelBox)
+{
+    uint32_t occluders = 0;
+
+    for(long dx = -1; dx <= 1; ++dx)
     {
-        for(float dy = -1; dy <= 1; dy += 1.0f)
+        for(long dz = -1; dz <= 1; ++dz)
         {
-            for(float dz = -1; dz <= 1; dz += 1.0f)
+            for(long dy = -1; dy <= 1; ++dy)
             {
-                vector_float3 lightDir = {dx, dy, dz};
-                
-                float contribution = vector_dot(normal, lightDir) / vector_length(lightDir);
-                
-                if (contribution > 0) {
-                    // Did this ray escape the cell?
-                    vector_long3 aoSamplePoint = vector_long(worldPos - chunkMinP + lightDir);
-                    BOOL escape = !voxels[INDEX_BOX(aoSamplePoint, *voxelBox)].opaque;
-                    
-                    escaped += escape ? contribution : 0;
-                    count += contribution;
+                vector_long3 q = chunkLocalPos + (vector_long3){dx, dy, dz} * step;
+
+                if ((dx == 0 && dy == 0 && dz == 0) || q.y < 0 || q.y >= CHUNK_SIZE_Y) {
+                    continue;
+                }
+
+                if (voxels[INDEX_BOX(q, voxelBox)].opaque) {
+                    occluders |= 1u << NEIGHBOR_BIT(dx, dy, dz);
                 }
             }
         }
     }
-    
-    float ambientOcclusion = (float)escaped / count;
-    float lightValue = MAX(v1.light, v2.light) / (float)CHUNK_LIGHTING_MAX;
+
+    return occluders;
+}
+
+
+/* Returns the direction pointing away from the opaque voxels in the occluder mask. The result is not normalized, and
+ * is zero when the occluders are balanced on all sides.
+ */
+static inline vector_float3 directionAwayFromOccluders(uint32_t occluders)
+{
+    vector_float3 direction = {0, 0, 0};
+
+    while(occluders)
+    {
+        int bit = __builtin_ctz(occluders);
+        direction -= (vector_float3){bit / 9 - 1, (bit / 3) % 3 - 1, bit % 3 - 1};
+        occluders &= occluders - 1;
+    }
+
+    return direction;
+}
+
+
+/* Returns the normal of the surface where it crosses the lattice edge from `lower' to `upper', estimated from the
+ * opaque voxels around both ends of the edge. This depends only on the edge, so every face which shares the vertex
+ * agrees on it.
+ */
+static inline vector_float3 vertexNormal(GSCubeVertex lower, GSCubeVertex upper)
+{
+    vector_float3 normal = directionAwayFromOccluders(lower.occluders) + directionAwayFromOccluders(upper.occluders);
+
+    if (vector_equal(normal, (vector_float3){0, 0, 0})) {
+        // Fall back to the direction from the ground end of the edge to the empty end.
+        normal = (lower.voxel->type == VOXEL_TYPE_GROUND) ? (upper.worldPos - lower.worldPos)
+                                                          : (lower.worldPos - upper.worldPos);
+    }
+
+    return normal;
+}
+
+
+static uint8_t vertexLuminance(GSCubeVertex lower, GSCubeVertex upper, vector_float3 normal)
+{
+    // Neighbors of the lower of the edge's two cube vertices are the ones surrounding the vertex on the edge.
+    // Each opaque neighbor in front of the surface blocks a share of the ambient light, in proportion to its weight.
+    const GSOcclusionWeights *weights = occlusionWeightsForNormal(normal);
+    uint32_t occluders = lower.occluders & weights->facing;
+
+    float occluded = 0;
+    while(occluders)
+    {
+        int bit = __builtin_ctz(occluders);
+        occluded += weights->weight[bit];
+        occluders &= occluders - 1;
+    }
+
+    float ambientOcclusion = 1.0f - occluded * weights->invTotal;
+
+    // Light channels are stored and propagated separately, and only combined here.
+    int light = 0;
+    for(GSLightChannel channel = 0; channel < NUM_LIGHT_CHANNELS; ++channel)
+    {
+        light = MAX(light, MAX(lower.light[channel], upper.light[channel]));
+    }
+
+    float lightValue = light / (float)CHUNK_LIGHTING_MAX;
     uint8_t luminance = (uint8_t)clampf(204.0f * (lightValue * ambientOcclusion) + 51.0f, 0.0f, 255.0f);
-    return (vector_uchar4){luminance, luminance, luminance, 1};
+    return luminance;
 }
 
 
-static inline void emitVertex(GSTerrainGeometry * _Nonnull geometry,
-                              vector_float3 worldPos, vector_float3 cellRelativeVertexPos,
-                              vector_uchar4 c, int tex, vector_float3 n)
+/* Returns the projection for a face with the specified normal, which is along the dominant axis of the normal. */
+static inline GSTexProjection projectionForFaceNormal(vector_float3 normal)
 {
-    vector_float3 texCoord;
-    
-    if (n.y == 0) {
-        if (n.x != 0) {
-            texCoord = (vector_float3){cellRelativeVertexPos.z, cellRelativeVertexPos.y, 0};
-        } else {
-            texCoord = (vector_float3){cellRelativeVertexPos.x, cellRelativeVertexPos.y, 0};
-        }
-    } else if (n.y > 0) {
-        texCoord = (vector_float3){cellRelativeVertexPos.x, cellRelativeVertexPos.z, 0};
+    vector_float3 magnitude = vector_abs(normal);
+
+    if (magnitude.y >= magnitude.x && magnitude.y >= magnitude.z) {
+        return TEX_PROJECT_Y;
+    } else if (magnitude.x >= magnitude.z) {
+        return TEX_PROJECT_X;
     } else {
-        texCoord = (vector_float3){cellRelativeVertexPos.x, cellRelativeVertexPos.z, 0};
+        return TEX_PROJECT_Z;
     }
-    
-    GSTerrainVertex v = {
-        .position = {worldPos.x, worldPos.y, worldPos.z},
-        .color = {c.x, c.y, c.z, c.w},
-        .texCoord = {texCoord.x, texCoord.y, tex}
-    };
-    
-    GSTerrainGeometryAddVertex(geometry, &v);
+}
+
+
+/* Adds the vertex where the surface crosses the lattice edge between `v1' and `v2' to the triangle list. The position
+ * and luminance depend only on the edge, so every cell sharing the edge shares one vertex. The texture layer and the
+ * projection of texture coordinates are chosen per face, so that all three vertices of a face agree on them. A vertex
+ * is only shared by faces which agree on both. Texture coordinates are the vertex position relative to `texOrigin'.
+ */
+static inline void emitEdgeVertex(GSTerrainGeometry * _Nonnull geometry,
+                                  GSCubeVertex v1, GSCubeVertex v2,
+                                  vector_float3 chunkMinP, vector_float3 texOrigin,
+                                  int tex, GSTexProjection projection)
+{
+    // Edges are identified by their lower end and the axis along which they run.
+    BOOL v1IsLower = (v1.worldPos.x + v1.worldPos.y + v1.worldPos.z) < (v2.worldPos.x + v2.worldPos.y + v2.worldPos.z);
+    GSCubeVertex lower = v1IsLower ? v1 : v2;
+    GSCubeVertex upper = v1IsLower ? v2 : v1;
+    vector_float3 delta = upper.worldPos - lower.worldPos;
+    size_t axis = (delta.x != 0) ? 0 : ((delta.y != 0) ? 1 : 2);
+    GSTerrainIndex *cached = &lower.edges[axis];
+    uint8_t *cachedProjection = &lower.edgeProjections[axis];
+
+    if ((*cached == 0) ||
+        (geometry->vertices[*cached - 1].texCoord[2] != tex) ||
+        (*cachedProjection != projection)) {
+        vector_float3 worldPos = vector_mix(lower.worldPos, upper.worldPos, (vector_float3){0.5, 0.5, 0.5});
+        vector_float3 t = worldPos - texOrigin;
+        vector_float2 texCoord;
+
+        switch(projection)
+        {
+            case TEX_PROJECT_X: texCoord = (vector_float2){t.z, t.y}; break;
+            case TEX_PROJECT_Y: texCoord = (vector_float2){t.x, t.z}; break;
+            case TEX_PROJECT_Z: texCoord = (vector_float2){t.x, t.y}; break;
+        }
+
+        uint8_t luminance = vertexLuminance(lower, upper, vertexNormal(lower, upper));
+        GSTerrainVertex v = GSTerrainVertexMake(worldPos - chunkMinP, texCoord, tex, luminance);
+        *cached = GSTerrainGeometryAppendVertex(geometry, &v) + 1;
+        *cachedProjection = projection;
+    }
+
+    GSTerrainGeometryAddIndex(geometry, *cached - 1);
 }
 
 
@@ -138,46 +346,29 @@ static inline GSCubeFace determineDirectionFromFaceNormal(vector_float3 normal)
 
 static void addTri(GSTerrainGeometry * _Nonnull geometry,
                    vector_float3 chunkMinP,
-                   GSVoxel * _Nonnull voxels,
-                   GSIntAABB * _Nonnull voxelBox,
+                   vector_float3 texOrigin,
                    GSCubeVertex v1[3],
                    GSCubeVertex v2[3],
                    int texForFace[NUM_CUBE_FACES])
 {
-    vector_float3 worldPos[3];
     vector_float3 cellRelativeVertexPos[3];
-    vector_uchar4 c[3];
-    GSVoxel faceVoxel[3];
     
     for(int i = 0; i < 3; ++i)
     {
-        worldPos[i] = vector_mix(v1[i].worldPos, v2[i].worldPos, (vector_float3){0.5, 0.5, 0.5});
-        
         cellRelativeVertexPos[i] = vector_mix(v1[i].cellRelativeVertexPos, v2[i].cellRelativeVertexPos,
                                               (vector_float3){0.5, 0.5, 0.5});
     }
     
-    // One normal for the entire face.
+    // Select a texture from `texForFace', and the plane to project it onto, by examining the face normal.
     vector_float3 normal = vector_normalize(vector_cross(cellRelativeVertexPos[1]-cellRelativeVertexPos[0],
                                                          cellRelativeVertexPos[2]-cellRelativeVertexPos[0]));
-    
-    // Select a texture from `texForFace' by examining the normal.
     GSCubeFace dir = determineDirectionFromFaceNormal(normal);
     int tex = texForFace[dir];
+    GSTexProjection projection = projectionForFaceNormal(normal);
     
     for(int i = 0; i < 3; ++i)
     {
-        c[i] = vertexColor(v1[i], v2[i], worldPos[i], chunkMinP, normal, voxels, voxelBox);
-    }
-    
-    for(int i = 0; i < 3; ++i)
-    {
-        faceVoxel[i] = (v1[i].voxel->type != VOXEL_TYPE_GROUND) ? *v2[i].voxel : *v1[i].voxel;
-    }
-    
-    for(int i = 0; i < 3; ++i)
-    {
-        emitVertex(geometry, worldPos[i], cellRelativeVertexPos[i], c[i], tex, normal);
+        emitEdgeVertex(geometry, v1[i], v2[i], chunkMinP, texOrigin, tex, projection);
     }
 }
 
@@ -238,39 +429,28 @@ static inline void determineTexForFace(GSCubeVertex cube[NUM_CUBE_VERTS], int te
 }
 
 
+// Based on Paul Bourke's Marching Cubes algorithm at <http://paulbourke.net/geometry/polygonise/>.
+// The edge and tri tables come directly from the sample code in the article.
+
+static const unsigned edgeTable[256] = {
+#include "edgetable.def"
+};
+
+static const int triTable[256][16] = {
+#include "tritable.def"
+};
+
+
+/* `index' is the index into the tables, with a bit set for each vertex of the cube which is inside the surface. */
 static void polygonizeGridCell(GSTerrainGeometry * _Nonnull geometry,
+                               unsigned index,
                                GSCubeVertex cube[NUM_CUBE_VERTS],
                                vector_float3 chunkMinP,
-                               GSVoxel * _Nonnull voxels,
-                               GSIntAABB * _Nonnull voxelBox)
+                               vector_float3 texOrigin)
 {
-    // Based on Paul Bourke's Marching Cubes algorithm at <http://paulbourke.net/geometry/polygonise/>.
-    // The edge and tri tables come directly from the sample code in the article.
-    
     assert(geometry);
-    
-    static const unsigned edgeTable[256] = {
-#include "edgetable.def"
-    };
-    
-    static const int triTable[256][16] = {
-#include "tritable.def"
-    };
-    
-    // Build an index to look into the tables. Examine each of the eight neighboring cells and set a bit in the index
-    // to '0' or '1' depending on whether the neighboring voxel is empty or not-empty.
-    unsigned index = 0;
-    for(size_t i = 0; i < NUM_CUBE_VERTS; ++i)
-    {
-        if (cube[i].voxel->type == VOXEL_TYPE_GROUND) {
-            index |= (1 << i);
-        }
-    }
-    
-    // If all neighbors are empty then there's nothing to do. Bail out early.
-    if (edgeTable[index] == 0) {
-        return;
-    }
+    assert(index < 256);
+    assert(edgeTable[index] != 0);
     
     // For each intersection between the surface and the cube, record the indices of the two cube vertices on either
     // side of the intersection. We interpolate the vertices later, when emitting triangles.
@@ -307,73 +487,304 @@ static void polygonizeGridCell(GSTerrainGeometry * _Nonnull geometry,
             v2[j] = cube[pairs[j].v2];
         }
         
-        addTri(geometry, chunkMinP, voxels, voxelBox, v1, v2, texForFace);
+        addTri(geometry, chunkMinP, texOrigin, v1, v2, texForFace);
     }
 }
 
 
-static inline GSCubeVertex getCubeVertex(vector_float3 chunkMinP,
-                                         GSVoxel * _Nonnull voxels,
-                                         GSIntAABB voxelBox,
-                                         GSTerrainBufferElement * _Nonnull light,
-                                         GSIntAABB * _Nonnull lightBox,
-                                         vector_float3 cellPos,
-                                         vector_float3 cellRelativeVertexPos)
+/* Cells in a sub-chunk along the y and z axes, at full detail. Coarser lattices use a prefix of the same storage. */
+#define MC_CELLS_Y (CHUNK_SIZE_Y / GSNumGeometrySubChunks)
+#define MC_CELLS_Z (CHUNK_SIZE_Z)
+
+
+/* Data for one point on the lattice of cell corners. Each lattice point is shared by up to eight cells.
+ * Corners are only needed for cells which the surface passes through, so they're evaluated lazily.
+ */
+typedef struct {
+    BOOL evaluated;
+    const GSVoxel * _Nonnull voxel;
+    int light[NUM_LIGHT_CHANNELS];
+    uint32_t occluders;
+
+    /* Index, plus one, of the vertex on each lattice edge leaving this corner along +x, +y, and +z. Cells which share
+     * an edge share its vertex, so this is the cache which welds the mesh. Zero if no vertex has been emitted yet.
+     */
+    GSTerrainIndex edges[3];
+
+    /* The GSTexProjection of the vertex cached on each edge. Faces projected differently can't share the vertex. */
+    uint8_t edgeProjections[3];
+} GSCubeCorner;
+
+
+_Static_assert(MC_CELLS_Y + 1 <= 32, "A column of lattice points must fit in a 32-bit ground mask.");
+
+
+/* One slab of lattice points perpendicular to the x-axis, ordered with y varying fastest to match voxel memory.
+ * `groundRows' packs the ground occupancy of each column of lattice points along y: bit `y' of row `z' is set when
+ * that lattice point is ground. Cells are classified from these masks a whole column at a time.
+ */
+typedef struct {
+    GSCubeCorner corners[(MC_CELLS_Z+1) * (MC_CELLS_Y+1)];
+    uint32_t groundRows[MC_CELLS_Z+1];
+} GSCornerSlab;
+
+
+/* Offsets of the cube vertices relative to the center of the cell. */
+static const vector_float3 cubeVertexOffsets[NUM_CUBE_VERTS] = {
+    {-L, -L, +L},
+    {+L, -L, +L},
+    {+L, -L, -L},
+    {-L, -L, -L},
+    {-L, +L, +L},
+    {+L, +L, +L},
+    {+L, +L, -L},
+    {-L, +L, -L}
+};
+
+
+static inline size_t slabCornerIndex(long y, long z)
 {
-    vector_float3 worldPos = cellPos + cellRelativeVertexPos;
-    vector_long3 chunkLocalPos = vector_long(worldPos - chunkMinP);
-    if (chunkLocalPos.y >= CHUNK_SIZE_Y) {
-        return (GSCubeVertex){
-            .cellRelativeVertexPos = cellRelativeVertexPos + LLL,
-            .worldPos = worldPos,
-            .voxel = &gEmpty,
-            .light = CHUNK_LIGHTING_MAX
-        };
-    } else {
-        return (GSCubeVertex){
-            .cellRelativeVertexPos = cellRelativeVertexPos + LLL,
-            .worldPos = worldPos,
-            .voxel = &voxels[INDEX_BOX(chunkLocalPos, voxelBox)],
-            .light = light[INDEX_BOX(chunkLocalPos, *lightBox)],
-        };
+    return z * (MC_CELLS_Y+1) + y;
+}
+
+
+/* Packs the ground occupancy of the column of lattice points at `x' and `z', which are in world space. Lattice points
+ * are `step' voxels apart. Voxel columns are contiguous in memory, so this walks each one directly.
+ */
+static inline uint32_t groundRow(long x, long z, GSIntAABB ibounds, long step, vector_long3 chunkMinLong,
+                                 const GSVoxel * _Nonnull voxels, GSIntAABB voxelBox)
+{
+    const long cellsY = MC_CELLS_Y / step;
+    vector_long3 base = (vector_long3){x, ibounds.mins.y, z} - chunkMinLong;
+    const GSVoxel *column = &voxels[INDEX_BOX(base, voxelBox)];
+
+    // Above the world is always empty, so the lattice point on top of the highest sub-chunk is never ground.
+    long count = MIN(cellsY, (CHUNK_SIZE_Y - 1 - base.y) / step) + 1;
+
+    uint32_t row = 0;
+    for(long y = 0; y < count; ++y)
+    {
+        row |= (uint32_t)(column[y*step].type == VOXEL_TYPE_GROUND) << y;
     }
+
+    return row;
+}
+
+
+/* Returns a mask with bit `y' set for each cell in the column which the surface passes through, given the ground rows
+ * at the cell column's four edges. A cell spans lattice points `y' and `y+1', and the surface passes through it
+ * unless all eight of its corners agree.
+ */
+static inline uint32_t surfaceCells(uint32_t l0, uint32_t l1, uint32_t h0, uint32_t h1, long cellsY)
+{
+    uint32_t any = l0 | l1 | h0 | h1;
+    uint32_t all = l0 & l1 & h0 & h1;
+    return (any | (any >> 1)) & ~(all & (all >> 1)) & ((1u << cellsY) - 1);
+}
+
+
+/* Gathers the case index of the cell at `y' from the ground rows. `l0' and `l1' are the low x side of the cell at the
+ * low and high z sides. Likewise, `h0' and `h1' are the high x side. Bit order matches cubeVertexOffsets.
+ */
+static inline unsigned caseIndex(uint32_t l0, uint32_t l1, uint32_t h0, uint32_t h1, long y)
+{
+    unsigned lower = (((l1 >> y) & 1) << 0) | (((h1 >> y) & 1) << 1) | (((h0 >> y) & 1) << 2) | (((l0 >> y) & 1) << 3);
+    unsigned upper = (((l1 >> (y+1)) & 1) << 0) | (((h1 >> (y+1)) & 1) << 1) |
+                     (((h0 >> (y+1)) & 1) << 2) | (((l0 >> (y+1)) & 1) << 3);
+    return lower | (upper << 4);
+}
+
+
+/* Packs the ground rows for lattice points at x-coordinate `x', and marks the slab's corners as not yet evaluated.
+ * The +x edges of the slab's corners only become usable once it's the low x side of a row of cells, and nothing is
+ * emitted on them before then, so clearing every edge here is enough to keep the edge cache valid as slabs roll.
+ */
+static void fillCornerSlab(GSCornerSlab * _Nonnull slab,
+                           long x,
+                           GSIntAABB ibounds,
+                           long step,
+                           vector_long3 chunkMinLong,
+                           const GSVoxel * _Nonnull voxels,
+                           GSIntAABB voxelBox)
+{
+    const long cellsY = MC_CELLS_Y / step, cellsZ = MC_CELLS_Z / step;
+
+    for(long z = 0; z <= cellsZ; ++z)
+    {
+        slab->groundRows[z] = groundRow(x, ibounds.mins.z + z*step, ibounds, step, chunkMinLong, voxels, voxelBox);
+
+        for(long y = 0; y <= cellsY; ++y)
+        {
+            GSCubeCorner *corner = &slab->corners[slabCornerIndex(y, z)];
+            corner->evaluated = NO;
+            corner->edges[0] = corner->edges[1] = corner->edges[2] = 0;
+        }
+    }
+}
+
+
+/* Evaluates the lattice point at `latticePos', in world space, unless it was evaluated already. */
+static inline GSCubeCorner * _Nonnull evaluateCorner(GSCornerSlab * _Nonnull slab,
+                                                     long y, long z,
+                                                     vector_long3 latticePos,
+                                                     long step,
+                                                     vector_long3 chunkMinLong,
+                                                     GSVoxel * _Nonnull voxels,
+                                                     GSIntAABB voxelBox,
+                                                     const uint8_t * _Nonnull const * _Nonnull light,
+                                                     GSIntAABB * _Nonnull lightBox)
+{
+    GSCubeCorner *corner = &slab->corners[slabCornerIndex(y, z)];
+
+    if (!corner->evaluated) {
+        vector_long3 chunkLocalPos = latticePos - chunkMinLong;
+
+        if (chunkLocalPos.y >= CHUNK_SIZE_Y) {
+            corner->voxel = &gEmpty;
+            corner->light[LIGHT_CHANNEL_SUN] = CHUNK_LIGHTING_MAX;
+            corner->light[LIGHT_CHANNEL_TORCH] = 0;
+        } else {
+            size_t lightIdx = INDEX_BOX(chunkLocalPos, *lightBox);
+            corner->voxel = &voxels[INDEX_BOX(chunkLocalPos, voxelBox)];
+            corner->light[LIGHT_CHANNEL_SUN] = GSLightBufferGet(light[LIGHT_CHANNEL_SUN], lightIdx);
+            corner->light[LIGHT_CHANNEL_TORCH] = GSLightBufferGet(light[LIGHT_CHANNEL_TORCH], lightIdx);
+        }
+
+        corner->occluders = occludersAroundVoxel(chunkLocalPos, step, voxels, voxelBox);
+        corner->evaluated = YES;
+    }
+
+    return corner;
 }
 
 
 void GSTerrainGeometryMarchingCubes(GSTerrainGeometry * _Nonnull geometry,
                                     GSVoxel * _Nonnull voxels,
                                     GSIntAABB voxelBox,
-                                    GSTerrainBufferElement * _Nonnull light,
+                                    const uint8_t * _Nonnull const * _Nonnull light,
                                     GSIntAABB * _Nonnull lightBox,
                                     vector_float3 chunkMinP,
-                                    GSIntAABB ibounds)
+                                    GSIntAABB ibounds,
+                                    long step)
 {
     assert(geometry);
     assert(voxels);
     assert(light);
     assert(lightBox);
-    
-    // Offset to align with the grid cells used by marching cubes.
-    GSFloatAABB marchingCubesBounds = {
-        .mins = vector_float(ibounds.mins) + LLL,
-        .maxs = vector_float(ibounds.maxs) + LLL
-    };
-    
+    assert(ibounds.maxs.y - ibounds.mins.y == MC_CELLS_Y);
+    assert(ibounds.maxs.z - ibounds.mins.z == MC_CELLS_Z);
+    assert(step > 0 && (MC_CELLS_Y % step) == 0 && (MC_CELLS_Z % step) == 0);
+
     // Marching Cubes isosurface extraction for GROUND blocks.
-    vector_float3 pos;
-    FOR_BOX(pos, marchingCubesBounds)
+    // Cells are offset by LLL from the voxel grid, so the corners of the cells lie on voxel centers. Lattice points
+    // are handled in two rolling slabs, the low and high x sides of the current row of cells. Cells are classified
+    // from packed ground masks a column at a time, and only those the surface passes through go on to polygonization.
+    // At coarser levels of detail each cell spans `step' voxels and its corners sample every `step'-th voxel. The
+    // lattice still includes the chunk's boundary planes, so neighboring chunks agree on the boundary samples.
+    // Vertices are cached on the lattice edges in the slabs, so each one is emitted once and then shared by all the
+    // cells around its edge.
+    vector_long3 chunkMinLong = vector_long(chunkMinP);
+
+    // Texture coordinates are taken relative to the bottom of the sub-chunk so they stay within range of a byte. The
+    // offset is a whole number of tiles so the texture still lines up across sub-chunks.
+    vector_float3 texOrigin = {chunkMinP.x, ibounds.mins.y, chunkMinP.z};
+    const long cellsY = MC_CELLS_Y / step, cellsZ = MC_CELLS_Z / step;
+    GSCornerSlab slabs[2];
+    GSCornerSlab *lo = &slabs[0], *hi = &slabs[1];
+
+    fillCornerSlab(lo, ibounds.mins.x, ibounds, step, chunkMinLong, voxels, voxelBox);
+
+    for(long x = ibounds.mins.x; x < ibounds.maxs.x; x += step)
     {
-        GSCubeVertex cube[NUM_CUBE_VERTS] = {
-            getCubeVertex(chunkMinP, voxels, voxelBox, light, lightBox, pos, vector_make(-L, -L, +L)),
-            getCubeVertex(chunkMinP, voxels, voxelBox, light, lightBox, pos, vector_make(+L, -L, +L)),
-            getCubeVertex(chunkMinP, voxels, voxelBox, light, lightBox, pos, vector_make(+L, -L, -L)),
-            getCubeVertex(chunkMinP, voxels, voxelBox, light, lightBox, pos, vector_make(-L, -L, -L)),
-            getCubeVertex(chunkMinP, voxels, voxelBox, light, lightBox, pos, vector_make(-L, +L, +L)),
-            getCubeVertex(chunkMinP, voxels, voxelBox, light, lightBox, pos, vector_make(+L, +L, +L)),
-            getCubeVertex(chunkMinP, voxels, voxelBox, light, lightBox, pos, vector_make(+L, +L, -L)),
-            getCubeVertex(chunkMinP, voxels, voxelBox, light, lightBox, pos, vector_make(-L, +L, -L))
-        };
-        
-        polygonizeGridCell(geometry, cube, chunkMinP, voxels, &voxelBox);
+        fillCornerSlab(hi, x+step, ibounds, step, chunkMinLong, voxels, voxelBox);
+
+        for(long z = 0; z < cellsZ; ++z)
+        {
+            uint32_t l0 = lo->groundRows[z], l1 = lo->groundRows[z+1];
+            uint32_t h0 = hi->groundRows[z], h1 = hi->groundRows[z+1];
+            uint32_t surface = surfaceCells(l0, l1, h0, h1, cellsY);
+
+            while(surface)
+            {
+                long y = __builtin_ctz(surface);
+                surface &= surface - 1;
+
+                unsigned index = caseIndex(l0, l1, h0, h1, y);
+                assert(edgeTable[index] != 0);
+
+                vector_long3 cellMin = {x, ibounds.mins.y + y*step, ibounds.mins.z + z*step};
+                vector_float3 cellPos = vector_float(cellMin) + LLL*step;
+                GSCubeVertex cube[NUM_CUBE_VERTS];
+
+                for(size_t i = 0; i < NUM_CUBE_VERTS; ++i)
+                {
+                    vector_float3 offset = cubeVertexOffsets[i];
+                    long dx = offset.x > 0, dy = offset.y > 0, dz = offset.z > 0;
+                    vector_long3 latticePos = cellMin + (vector_long3){dx, dy, dz} * step;
+                    GSCubeCorner *corner = evaluateCorner(dx ? hi : lo, y + dy, z + dz, latticePos, step,
+                                                          chunkMinLong, voxels, voxelBox, light, lightBox);
+
+                    cube[i] = (GSCubeVertex){
+                        .cellRelativeVertexPos = offset + LLL,
+                        .worldPos = cellPos + offset*step,
+                        .voxel = corner->voxel,
+                        .light = {
+                            [LIGHT_CHANNEL_SUN] = corner->light[LIGHT_CHANNEL_SUN],
+                            [LIGHT_CHANNEL_TORCH] = corner->light[LIGHT_CHANNEL_TORCH]
+                        },
+                        .occluders = corner->occluders,
+                        .edges = corner->edges,
+                        .edgeProjections = corner->edgeProjections
+                    };
+                }
+
+                polygonizeGridCell(geometry, index, cube, chunkMinP, texOrigin);
+            }
+        }
+
+        GSCornerSlab *tmp = lo;
+        lo = hi;
+        hi = tmp;
     }
-}
\ No newline at end of file
+}
+
+
+size_t GSTerrainGeometryMarchingCubesCountSurfaceCells(const GSVoxel * _Nonnull voxels,
+                                                       GSIntAABB voxelBox,
+                                                       vector_float3 chunkMinP,
+                                                       GSIntAABB ibounds,
+                                                       long step)
+{
+    assert(voxels);
+    assert(step > 0 && (MC_CELLS_Y % step) == 0 && (MC_CELLS_Z % step) == 0);
+
+    vector_long3 chunkMinLong = vector_long(chunkMinP);
+    const long cellsZ = MC_CELLS_Z / step, cellsY = MC_CELLS_Y / step;
+    uint32_t rows[2][MC_CELLS_Z+1];
+    uint32_t *lo = rows[0], *hi = rows[1];
+    size_t count = 0;
+
+    for(long z = 0; z <= cellsZ; ++z)
+    {
+        lo[z] = groundRow(ibounds.mins.x, ibounds.mins.z + z*step, ibounds, step, chunkMinLong, voxels, voxelBox);
+    }
+
+    for(long x = ibounds.mins.x; x < ibounds.maxs.x; x += step)
+    {
+        for(long z = 0; z <= cellsZ; ++z)
+        {
+            hi[z] = groundRow(x+step, ibounds.mins.z + z*step, ibounds, step, chunkMinLong, voxels, voxelBox);
+        }
+
+        for(long z = 0; z < cellsZ; ++z)
+        {
+            count += __builtin_popcount(surfaceCells(lo[z], lo[z+1], hi[z], hi[z+1], cellsY));
+        }
+
+        uint32_t *tmp = lo;
+        lo = hi;
+        hi = tmp;
+    }
+
+    return count;
+}
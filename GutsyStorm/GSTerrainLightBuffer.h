@@ -0,0 +1,77 @@
+//
+//  GSTerrainLightBuffer.h
+//  GutsyStorm
+//
+//  Created by agent on 10/18/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import "GSIntegerVector3.h"
+#import "GSTerrainBuffer.h"
+
+
+_Static_assert(CHUNK_LIGHTING_MAX <= 0xf, "Light levels must fit in four bits to be stored in a GSTerrainLightBuffer.");
+
+
+/* Returns the number of bytes required to store `count' packed light levels. */
+static inline size_t GSLightBufferPackedLength(size_t count)
+{
+    return (count + 1) / 2;
+}
+
+static inline size_t LIGHT_BUFFER_SIZE_IN_BYTES(vector_long3 dimensions)
+{
+    return GSLightBufferPackedLength(dimensions.x * dimensions.y * dimensions.z);
+}
+
+/* Returns the light level at index `idx' of the packed buffer. Elements at even indices are in the low nibble. */
+static inline GSTerrainBufferElement GSLightBufferGet(const uint8_t * _Nonnull packed, size_t idx)
+{
+    return (packed[idx >> 1] >> ((idx & 1) << 2)) & 0xf;
+}
+
+/* Stores the light level `value' at index `idx' of the packed buffer. */
+static inline void GSLightBufferSet(uint8_t * _Nonnull packed, size_t idx, GSTerrainBufferElement value)
+{
+    assert(value <= 0xf);
+    unsigned shift = (idx & 1) << 2;
+    packed[idx >> 1] = (packed[idx >> 1] & ~(0xf << shift)) | (value << shift);
+}
+
+/* Packs `count' light levels from `src' into `packed', starting at element index `start' of the packed buffer. */
+void GSLightBufferPack(uint8_t * _Nonnull packed, size_t start,
+                       const GSTerrainBufferElement * _Nonnull src, size_t count);
+
+/* Unpacks `count' light levels into `dst', starting at element index `start' of the packed buffer. */
+void GSLightBufferUnpack(GSTerrainBufferElement * _Nonnull dst,
+                         const uint8_t * _Nonnull packed, size_t start, size_t count);
+
+
+/* Represents a three-dimensional grid of light levels, packed two to a byte.
+ * Light levels are stored in the same order as the elements of a GSTerrainBuffer of the same dimensions.
+ */
+@interface GSTerrainLightBuffer : NSObject <NSCopying>
+
+@property (nonatomic, readonly) vector_long3 offsetFromChunkLocalSpace;
+@property (nonatomic, readonly) vector_long3 dimensions;
+
+/* Initialize a light buffer of the specified dimensions, packing the light levels at `data'. */
+- (nonnull instancetype)initWithDimensions:(vector_long3)dim
+                               packingData:(const GSTerrainBufferElement * _Nonnull)data;
+
+/* Initialize a light buffer with the dimensions and light levels of the specified terrain buffer. */
+- (nonnull instancetype)initWithTerrainBuffer:(nonnull GSTerrainBuffer *)buffer;
+
+/* Initialize a light buffer of the specified dimensions with a copy of already packed light levels. */
+- (nonnull instancetype)initWithDimensions:(vector_long3)dim
+                            copyPackedData:(const uint8_t * _Nonnull)data;
+
+/* Returns the light level for the specified point in chunk-local space.
+ * Always returns 0 for points which have no corresponding mapping in the buffer.
+ */
+- (GSTerrainBufferElement)valueAtPosition:(vector_long3)chunkLocalP;
+
+- (nonnull const uint8_t *)packedData;
+
+@end
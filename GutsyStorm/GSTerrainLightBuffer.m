@@ -0,0 +1,149 @@
+//
+//  GSTerrainLightBuffer.m
+//  GutsyStorm
+//
+//  Created by agent on 10/18/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#import "GSTerrainLightBuffer.h"
+#import "GSBox.h"
+
+
+void GSLightBufferPack(uint8_t * _Nonnull packed, size_t start,
+                       const GSTerrainBufferElement * _Nonnull src, size_t count)
+{
+    assert(packed);
+    assert(src);
+
+    size_t i = 0;
+
+    // Handle a leading element in the high nibble so the rest of the loop can work on whole bytes.
+    if ((start & 1) && (count > 0)) {
+        GSLightBufferSet(packed, start, src[0]);
+        i = 1;
+    }
+
+    for(; i + 1 < count; i += 2)
+    {
+        assert(src[i] <= 0xf && src[i+1] <= 0xf);
+        packed[(start + i) >> 1] = (uint8_t)(src[i] | (src[i+1] << 4));
+    }
+
+    if (i < count) {
+        GSLightBufferSet(packed, start + i, src[i]);
+    }
+}
+
+void GSLightBufferUnpack(GSTerrainBufferElement * _Nonnull dst,
+                         const uint8_t * _Nonnull packed, size_t start, size_t count)
+{
+    assert(dst);
+    assert(packed);
+
+    size_t i = 0;
+
+    if ((start & 1) && (count > 0)) {
+        dst[0] = GSLightBufferGet(packed, start);
+        i = 1;
+    }
+
+    for(; i + 1 < count; i += 2)
+    {
+        uint8_t byte = packed[(start + i) >> 1];
+        dst[i] = byte & 0xf;
+        dst[i+1] = byte >> 4;
+    }
+
+    if (i < count) {
+        dst[i] = GSLightBufferGet(packed, start + i);
+    }
+}
+
+
+@implementation GSTerrainLightBuffer
+{
+    uint8_t *_data;
+}
+
+- (nonnull instancetype)initWithDimensions:(vector_long3)dim
+{
+    NSParameterAssert(dim.x >= CHUNK_SIZE_X && dim.x >= 0);
+    NSParameterAssert(dim.y >= CHUNK_SIZE_Y && dim.y >= 0);
+    NSParameterAssert(dim.z >= CHUNK_SIZE_Z && dim.z >= 0);
+
+    if (self = [super init]) {
+        _dimensions = dim;
+        _offsetFromChunkLocalSpace = (dim - GSChunkSizeIntVec3) / 2;
+        _data = calloc(LIGHT_BUFFER_SIZE_IN_BYTES(dim), 1);
+        if (!_data) {
+            [NSException raise:NSMallocException format:@"Out of memory allocating buffer for GSTerrainLightBuffer."];
+        }
+    }
+
+    return self;
+}
+
+- (nonnull instancetype)initWithDimensions:(vector_long3)dim
+                               packingData:(const GSTerrainBufferElement * _Nonnull)data
+{
+    NSParameterAssert(data);
+
+    if (self = [self initWithDimensions:dim]) {
+        GSLightBufferPack(_data, 0, data, dim.x * dim.y * dim.z);
+    }
+
+    return self;
+}
+
+- (nonnull instancetype)initWithTerrainBuffer:(nonnull GSTerrainBuffer *)buffer
+{
+    NSParameterAssert(buffer);
+    return [self initWithDimensions:buffer.dimensions packingData:[buffer data]];
+}
+
+- (nonnull instancetype)initWithDimensions:(vector_long3)dim
+                            copyPackedData:(const uint8_t * _Nonnull)data
+{
+    NSParameterAssert(data);
+
+    if (self = [self initWithDimensions:dim]) {
+        memcpy(_data, data, LIGHT_BUFFER_SIZE_IN_BYTES(dim));
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    free(_data);
+}
+
+- (nonnull instancetype)copyWithZone:(nullable NSZone *)zone
+{
+    return self; // GSTerrainLightBuffer is immutable. Return self rather than perform a deep copy.
+}
+
+- (GSTerrainBufferElement)valueAtPosition:(vector_long3)chunkLocalPos
+{
+    assert(_data);
+
+    GSIntAABB selfBox = { GSZeroIntVec3, _dimensions };
+    vector_long3 p = chunkLocalPos + _offsetFromChunkLocalSpace;
+
+    if(p.x >= selfBox.mins.x && p.x < selfBox.maxs.x &&
+       p.y >= selfBox.mins.y && p.y < selfBox.maxs.y &&
+       p.z >= selfBox.mins.z && p.z < selfBox.maxs.z) {
+        return GSLightBufferGet(_data, INDEX_BOX(p, selfBox));
+    } else {
+        return 0;
+    }
+}
+
+- (nonnull const uint8_t *)packedData
+{
+    assert(_data);
+    return _data;
+}
+
+@end
@@ -138,26 +138,32 @@ static void updateVoxels(GSTerrainChunkStore * _Nonnull chunkStore,
     GSStopwatchTraceStep(@"Updated voxels.");
 }
 
-static void calculateNeighborhoodSunlight(vector_float3 editPos,
-                                          GSNeighborhood<GSGridSlot *> * _Nonnull sunSlots,
-                                          GSChunkVoxelData * _Nonnull voxels1,
-                                          GSChunkVoxelData * _Nonnull voxels2,
-                                          GSIntAABB * _Nullable affectedRegion,
-                                          GSTerrainBuffer **outNeighborhoodSunlight)
+/* Recalculates light in the neighborhood for each light channel which the edit can affect. Channels which are unchanged
+ * by the edit are returned as nil. Returns NO if there is no sunlight chunk to update.
+ */
+static BOOL calculateNeighborhoodLight(vector_float3 editPos,
+                                       GSNeighborhood<GSGridSlot *> * _Nonnull sunSlots,
+                                       GSChunkVoxelData * _Nonnull voxels1,
+                                       GSChunkVoxelData * _Nonnull voxels2,
+                                       GSIntAABB * _Nonnull outAffectedRegion,
+                                       GSTerrainBuffer * _Nullable * _Nonnull outNeighborhoodSunlight,
+                                       GSTerrainBuffer * _Nullable * _Nonnull outNeighborhoodTorchlight)
 {
+    assert(outAffectedRegion);
     assert(outNeighborhoodSunlight);
+    assert(outNeighborhoodTorchlight);
     assert(voxels1);
     assert(voxels2);
 
-    GSTerrainBuffer *nSunlight = nil;
+    *outNeighborhoodSunlight = nil;
+    *outNeighborhoodTorchlight = nil;
     
     GSGridSlot *sunSlot = [sunSlots neighborAtIndex:CHUNK_NEIGHBOR_CENTER];
     GSChunkSunlightData *sunlight = (GSChunkSunlightData *)sunSlot.item;
     
     if (!sunlight) {
         GSStopwatchTraceStep(@"Skipping sunlight update.");
-        *outNeighborhoodSunlight = nil;
-        return;
+        return NO;
     }
     
     GSSunlightNeighborhood *sunNeighborhood = [[GSSunlightNeighborhood alloc] init];
@@ -177,15 +183,45 @@ static void calculateNeighborhoodSunlight(vector_float3 editPos,
     vector_long3 editPosClp = vector_long(editPos - voxels1.minP);
     GSVoxel originalVoxel = [voxels1 voxelAtLocalPosition:editPosClp];
     GSVoxel modifiedVoxel = [voxels2 voxelAtLocalPosition:editPosClp];
-    BOOL removingLight = (!originalVoxel.opaque && modifiedVoxel.opaque) ||
-                         (originalVoxel.torch && !modifiedVoxel.torch);
+    BOOL wasEmpty = (originalVoxel.type == VOXEL_TYPE_EMPTY), isEmpty = (modifiedVoxel.type == VOXEL_TYPE_EMPTY);
+    BOOL blockingLight = !originalVoxel.opaque && modifiedVoxel.opaque;
+    BOOL opacityChanged = originalVoxel.opaque != modifiedVoxel.opaque;
+
+    // The edited voxel's neighbors always need their geometry rebuilt, even when no light changes at all.
+    GSIntAABB affectedRegion = {
+        .mins = editPosClp - GSMakeIntegerVector3(1, 1, 1),
+        .maxs = editPosClp + GSMakeIntegerVector3(1, 1, 1)
+    };
+    affectedRegion.mins.y = MAX(affectedRegion.mins.y, 0);
+    affectedRegion.maxs.y = MIN(affectedRegion.maxs.y, CHUNK_SIZE_Y-1);
+
+    // Sunlight sources depend on opacity and on the `outside' flag, which changes when a column's highest non-empty
+    // voxel changes.
+    if (opacityChanged || (wasEmpty != isEmpty)) {
+        GSIntAABB sunAffectedRegion;
+        BOOL removingLight = blockingLight || (wasEmpty && !isEmpty);
+        *outNeighborhoodSunlight = [sunNeighborhood newLightBufferForChannel:LIGHT_CHANNEL_SUN
+                                                             withEditAtPoint:editPos
+                                                               removingLight:removingLight
+                                                              affectedRegion:&sunAffectedRegion];
+        affectedRegion = GSIntAABBUnion(affectedRegion, sunAffectedRegion);
+        GSStopwatchTraceStep(@"Updated sunlight for the neighborhood.");
+    }
 
-    nSunlight = [sunNeighborhood newSunlightBufferWithEditAtPoint:editPos
-                                                    removingLight:removingLight
-                                                   affectedRegion:affectedRegion];
-    
-    GSStopwatchTraceStep(@"Updated sunlight for the neighborhood.");
-    *outNeighborhoodSunlight = nSunlight;
+    // Placing or removing a torch does not touch sunlight at all. Only the torchlight channel is updated.
+    if (opacityChanged || (originalVoxel.torch != modifiedVoxel.torch)) {
+        GSIntAABB torchAffectedRegion;
+        BOOL removingLight = blockingLight || (originalVoxel.torch && !modifiedVoxel.torch);
+        *outNeighborhoodTorchlight = [sunNeighborhood newLightBufferForChannel:LIGHT_CHANNEL_TORCH
+                                                               withEditAtPoint:editPos
+                                                                 removingLight:removingLight
+                                                                affectedRegion:&torchAffectedRegion];
+        affectedRegion = GSIntAABBUnion(affectedRegion, torchAffectedRegion);
+        GSStopwatchTraceStep(@"Updated torchlight for the neighborhood.");
+    }
+
+    *outAffectedRegion = affectedRegion;
+    return YES;
 }
 
 static void invalidateDependentChunks(GSNeighborhood<GSGridSlot *> * _Nonnull sunSlots,
@@ -214,7 +250,8 @@ static void rebuildDependentChunks(GSVoxelNeighborIndex i,
                                    vector_float3 editPos,
                                    GSChunkVoxelData * _Nonnull voxels1,
                                    GSChunkVoxelData * _Nonnull voxels2,
-                                   GSTerrainBuffer * _Nonnull nSunlight,
+                                   GSTerrainBuffer * _Nullable nSunlight,
+                                   GSTerrainBuffer * _Nullable nTorchlight,
                                    GSIntAABB affectedRegion,
                                    GSNeighborhood<GSGridSlot *> * _Nonnull sunSlots,
                                    GSNeighborhood<GSGridSlot *> * _Nonnull geoSlots,
@@ -222,7 +259,6 @@ static void rebuildDependentChunks(GSVoxelNeighborIndex i,
 {
     assert(voxels1);
     assert(voxels2);
-    assert(nSunlight);
     assert(sunSlots);
     assert(geoSlots);
     assert(vaoSlots);
@@ -262,8 +298,12 @@ static void rebuildDependentChunks(GSVoxelNeighborIndex i,
                 .maxs = minP + border + GSChunkSizeIntVec3
             };
             
+            // Channels which were not recalculated are carried over from the original sunlight chunk.
             GSTerrainBuffer *sunlight = [nSunlight copySubBufferFromSubrange:&subrange];
-            sunlight2 = [sunlight1 copyReplacingSunlightData:sunlight neighborhood:neighborhood];
+            GSTerrainBuffer *torchlight = [nTorchlight copySubBufferFromSubrange:&subrange];
+            sunlight2 = [sunlight1 copyReplacingSunlightData:sunlight
+                                              torchlightData:torchlight
+                                                neighborhood:neighborhood];
         }
         
         sunSlot.item = sunlight2;
@@ -279,7 +319,13 @@ static void rebuildDependentChunks(GSVoxelNeighborIndex i,
             [geo1 invalidate];
 
             if(sunlight2) {
-                geo2 = [geo1 copyWithSunlight:sunlight2 invalidatedRegion:affectedRegion];
+                // The affected region is relative to the center chunk, but the geometry expects its own local space.
+                vector_long3 offset = vector_long([GSNeighborhood offsetForNeighborIndex:i]);
+                GSIntAABB invalidatedRegion = {
+                    .mins = affectedRegion.mins - offset,
+                    .maxs = affectedRegion.maxs - offset
+                };
+                geo2 = [geo1 copyWithSunlight:sunlight2 invalidatedRegion:invalidatedRegion];
             }
         }
         
@@ -355,19 +401,21 @@ static void rebuildDependentChunks(GSVoxelNeighborIndex i,
     GSChunkVoxelData *voxels2 = nil;
     updateVoxels(_chunkStore, _block, _op, _pos, voxSlots, &voxels1, &voxels2);
 
-    // Update sunlight for the neighborhood.
+    // Update light for the neighborhood.
     GSIntAABB affectedRegion;
-    GSTerrainBuffer *nSunlight;
-    calculateNeighborhoodSunlight(_pos, sunSlots, voxels1, voxels2, &affectedRegion, &nSunlight);
+    GSTerrainBuffer *nSunlight, *nTorchlight;
+    BOOL haveLight = calculateNeighborhoodLight(_pos, sunSlots, voxels1, voxels2,
+                                                &affectedRegion, &nSunlight, &nTorchlight);
     
-    if (!nSunlight) {
+    if (!haveLight) {
         // We don't have sunlight, so we simply invalidate all the items held by these slots.
         invalidateDependentChunks(sunSlots, geoSlots, vaoSlots);
     } else {
         // Rebuild the chain of dependent chunks using the updated voxels and sunlight.
         for(GSVoxelNeighborIndex i = 0; i < CHUNK_NUM_NEIGHBORS; ++i)
         {
-            rebuildDependentChunks(i, _pos, voxels1, voxels2, nSunlight, affectedRegion, sunSlots, geoSlots, vaoSlots);
+            rebuildDependentChunks(i, _pos, voxels1, voxels2, nSunlight, nTorchlight, affectedRegion,
+                                   sunSlots, geoSlots, vaoSlots);
         }
     }
 
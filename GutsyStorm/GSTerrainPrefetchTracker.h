@@ -0,0 +1,60 @@
+//
+//  GSTerrainPrefetchTracker.h
+//  GutsyStorm
+//
+//  Created by agent on 10/18/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+
+
+@class GSBoxedVector;
+
+
+/* Measures how well the chunks prefetched ahead of the camera match the chunks which come into view.
+ *
+ * A prediction is a hit if the chunk comes into view before the horizon elapses, and a miss if it does not.
+ */
+@interface GSTerrainPrefetchTracker : NSObject
+
+/* The number of predicted chunks which came into view in time. */
+@property (nonatomic, readonly) NSUInteger hits;
+
+/* The number of predicted chunks which did not come into view in time. */
+@property (nonatomic, readonly) NSUInteger misses;
+
+/* The number of chunks which came into view, whether or not they were predicted. */
+@property (nonatomic, readonly) NSUInteger arrivals;
+
+/* The fraction of resolved predictions which were hits, or zero if there are none yet. */
+@property (nonatomic, readonly) double hitRate;
+
+/* The fraction of chunks coming into view which had been predicted, or zero if there are none yet. */
+@property (nonatomic, readonly) double coverage;
+
+- (nonnull instancetype)init NS_UNAVAILABLE;
+
+/* Initialize the tracker.
+ *
+ * Parameters:
+ * horizon -- Time, in seconds, after which a predicted chunk which has not come into view is counted as a miss.
+ */
+- (nonnull instancetype)initWithHorizon:(double)horizon NS_DESIGNATED_INITIALIZER;
+
+/* Record the chunks in view, and the chunks predicted to come into view, at the specified time.
+ *
+ * Parameters:
+ * visible -- Min corners of the chunks which are in the camera frustum now.
+ * predicted -- Min corners of the chunks which are predicted to come into view. Those which are already in view, or
+ *              which are already predicted, are ignored.
+ * time -- Time, in seconds, of this update. Must not decrease from one update to the next.
+ */
+- (void)updateWithVisibleChunks:(nonnull NSSet<GSBoxedVector *> *)visible
+                predictedChunks:(nonnull NSSet<GSBoxedVector *> *)predicted
+                           time:(double)time;
+
+/* Forget all outstanding predictions and reset the counters. */
+- (void)reset;
+
+@end
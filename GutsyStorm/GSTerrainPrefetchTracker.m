@@ -0,0 +1,156 @@
+//
+//  GSTerrainPrefetchTracker.m
+//  GutsyStorm
+//
+//  Created by agent on 10/18/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#import "GSTerrainPrefetchTracker.h"
+#import "GSBoxedVector.h"
+
+
+@implementation GSTerrainPrefetchTracker
+{
+    double _horizon;
+
+    /* Protects all of the following. */
+    NSLock *_lock;
+
+    /* Maps the min corner of each outstanding predicted chunk to the time at which it was predicted. */
+    NSMutableDictionary<GSBoxedVector *, NSNumber *> *_outstanding;
+
+    /* The chunks which were visible at the last update, or nil before the first. */
+    NSSet<GSBoxedVector *> *_previousVisible;
+
+    NSUInteger _hits, _misses, _arrivals;
+}
+
+- (nonnull instancetype)initWithHorizon:(double)horizon
+{
+    NSParameterAssert(horizon > 0);
+
+    if (self = [super init]) {
+        _horizon = horizon;
+        _lock = [NSLock new];
+        _lock.name = @"GSTerrainPrefetchTracker.lock";
+        _outstanding = [NSMutableDictionary new];
+        _previousVisible = nil;
+        _hits = _misses = _arrivals = 0;
+    }
+
+    return self;
+}
+
+- (nonnull NSString *)description
+{
+    [_lock lock];
+    NSUInteger outstanding = _outstanding.count;
+    [_lock unlock];
+
+    return [NSString stringWithFormat:@"%@: hit rate=%.1f%% (%lu hits, %lu misses), coverage=%.1f%%, outstanding=%lu",
+            [super description], self.hitRate * 100.0, (unsigned long)self.hits, (unsigned long)self.misses,
+            self.coverage * 100.0, (unsigned long)outstanding];
+}
+
+- (NSUInteger)hits
+{
+    [_lock lock];
+    NSUInteger hits = _hits;
+    [_lock unlock];
+    return hits;
+}
+
+- (NSUInteger)misses
+{
+    [_lock lock];
+    NSUInteger misses = _misses;
+    [_lock unlock];
+    return misses;
+}
+
+- (NSUInteger)arrivals
+{
+    [_lock lock];
+    NSUInteger arrivals = _arrivals;
+    [_lock unlock];
+    return arrivals;
+}
+
+- (double)hitRate
+{
+    [_lock lock];
+    NSUInteger resolved = _hits + _misses;
+    double hitRate = (resolved > 0) ? (double)_hits / resolved : 0.0;
+    [_lock unlock];
+    return hitRate;
+}
+
+- (double)coverage
+{
+    [_lock lock];
+    double coverage = (_arrivals > 0) ? (double)_hits / _arrivals : 0.0;
+    [_lock unlock];
+    return coverage;
+}
+
+- (void)updateWithVisibleChunks:(nonnull NSSet<GSBoxedVector *> *)visible
+                predictedChunks:(nonnull NSSet<GSBoxedVector *> *)predicted
+                           time:(double)time
+{
+    NSParameterAssert(visible);
+    NSParameterAssert(predicted);
+
+    [_lock lock];
+
+    // Everything is new at the first update, which says nothing about the predictions.
+    if (_previousVisible) {
+        for(GSBoxedVector *corner in visible)
+        {
+            if ([_previousVisible containsObject:corner]) {
+                continue;
+            }
+
+            ++_arrivals;
+
+            if (_outstanding[corner]) {
+                ++_hits;
+                [_outstanding removeObjectForKey:corner];
+            }
+        }
+    }
+
+    NSMutableArray<GSBoxedVector *> *expired = [NSMutableArray new];
+    [_outstanding enumerateKeysAndObjectsUsingBlock:^(GSBoxedVector *corner, NSNumber *predictedAt, BOOL *stop) {
+        if (time - [predictedAt doubleValue] > _horizon) {
+            [expired addObject:corner];
+        }
+    }];
+    [_outstanding removeObjectsForKeys:expired];
+    _misses += expired.count;
+
+    // A chunk keeps the time of its first prediction, so one which is predicted over and over again, and never comes
+    // into view, still counts as a miss.
+    NSNumber *now = @(time);
+    for(GSBoxedVector *corner in predicted)
+    {
+        if (![visible containsObject:corner] && !_outstanding[corner]) {
+            _outstanding[corner] = now;
+        }
+    }
+
+    _previousVisible = [visible copy];
+
+    [_lock unlock];
+}
+
+- (void)reset
+{
+    [_lock lock];
+    [_outstanding removeAllObjects];
+    _previousVisible = nil;
+    _hits = _misses = _arrivals = 0;
+    [_lock unlock];
+}
+
+@end
@@ -0,0 +1,46 @@
+//
+//  GSTerrainTile.h
+//  GutsyStorm
+//
+//  Created by agent on 10/18/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#import <Foundation/Foundation.h>
+#import <simd/vector.h>
+#import "GSVoxel.h"
+
+
+@class GSTerrainGenerator;
+
+
+/* Generates voxels for a rectangular tile of adjacent chunk columns in a single pass.
+ *
+ * Generating chunks one at a time means paying the generator's fixed costs for every chunk, such as setting up
+ * scratch space and lattices of noise samples. A tile generates each of its voxels exactly once and then slices out
+ * the voxels for each chunk. The voxels for a chunk are identical to those which would be generated for it alone.
+ */
+@interface GSTerrainTile : NSObject
+
+/* The min corner of the chunk at the min corner of the tile. */
+@property (nonatomic, readonly) vector_float3 minP;
+
+/* The size of the tile in chunks. */
+@property (nonatomic, readonly) long chunksX;
+@property (nonatomic, readonly) long chunksZ;
+
+- (nonnull instancetype)init NS_UNAVAILABLE;
+
+/* Initialize and generate the voxels of the tile. */
+- (nonnull instancetype)initWithMinP:(vector_float3)minP
+                             chunksX:(long)chunksX
+                             chunksZ:(long)chunksZ
+                           generator:(nonnull GSTerrainGenerator *)generator NS_DESIGNATED_INITIALIZER;
+
+/* Returns YES if the chunk which contains the specified point lies within the tile. */
+- (BOOL)containsPoint:(vector_float3)p;
+
+/* Copies the voxels of the chunk which contains the specified point to `voxels', which has room for one chunk. */
+- (void)copyVoxelsForChunkAtPoint:(vector_float3)p destination:(nonnull GSVoxel *)voxels;
+
+@end
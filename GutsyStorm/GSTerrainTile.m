@@ -0,0 +1,87 @@
+//
+//  GSTerrainTile.m
+//  GutsyStorm
+//
+//  Created by agent on 10/18/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#import "GSTerrainTile.h"
+#import "GSTerrainGenerator.h"
+#import "GSIntegerVector3.h"
+#import "GSVectorUtils.h"
+#import "GSBox.h"
+
+
+@implementation GSTerrainTile
+{
+    /* Voxels for the whole tile. The box is relative to the min corner of the tile. */
+    GSVoxel *_voxels;
+    GSIntAABB _box;
+}
+
+- (nonnull instancetype)init
+{
+    @throw nil;
+}
+
+- (nonnull instancetype)initWithMinP:(vector_float3)minP
+                             chunksX:(long)chunksX
+                             chunksZ:(long)chunksZ
+                           generator:(nonnull GSTerrainGenerator *)generator
+{
+    NSParameterAssert(chunksX > 0 && chunksZ > 0);
+    NSParameterAssert(generator);
+    NSParameterAssert(vector_equal(GSMinCornerForChunkAtPoint(minP), minP));
+
+    if (self = [super init]) {
+        _minP = minP;
+        _chunksX = chunksX;
+        _chunksZ = chunksZ;
+        _box = (GSIntAABB){
+            .mins = GSZeroIntVec3,
+            .maxs = GSMakeIntegerVector3(chunksX * CHUNK_SIZE_X, CHUNK_SIZE_Y, chunksZ * CHUNK_SIZE_Z)
+        };
+
+        vector_long3 dim = _box.maxs - _box.mins;
+        const size_t count = dim.x * dim.y * dim.z;
+        _voxels = malloc(count * sizeof(GSVoxel));
+
+        if (!_voxels) {
+            [NSException raise:NSMallocException format:@"Out of memory allocating voxels for a terrain tile."];
+        }
+
+        [generator generateWithDestination:_voxels count:count region:&_box offsetToWorld:minP];
+    }
+
+    return self;
+}
+
+- (void)dealloc
+{
+    free(_voxels);
+}
+
+- (BOOL)containsPoint:(vector_float3)p
+{
+    vector_float3 offset = GSMinCornerForChunkAtPoint(p) - _minP;
+    return offset.x >= 0 && offset.x < _chunksX * CHUNK_SIZE_X && offset.z >= 0 && offset.z < _chunksZ * CHUNK_SIZE_Z;
+}
+
+- (void)copyVoxelsForChunkAtPoint:(vector_float3)p destination:(nonnull GSVoxel *)voxels
+{
+    NSParameterAssert([self containsPoint:p]);
+    NSParameterAssert(voxels);
+
+    vector_long3 offset = vector_long(GSMinCornerForChunkAtPoint(p) - _minP);
+    GSIntAABB chunkBox = { .mins = GSZeroIntVec3, .maxs = GSChunkSizeIntVec3 };
+    vector_long3 q;
+
+    // Columns are contiguous in both the tile and the chunk.
+    FOR_Y_COLUMN_IN_BOX(q, chunkBox)
+    {
+        memcpy(&voxels[INDEX_BOX(q, chunkBox)], &_voxels[INDEX_BOX(q + offset, _box)], CHUNK_SIZE_Y * sizeof(GSVoxel));
+    }
+}
+
+@end
@@ -7,10 +7,67 @@
 //
 
 #import <Foundation/Foundation.h>
+#import <simd/vector.h>
 
+
+/* Terrain vertex positions always lie on a half-voxel grid, so they are stored in fixed-point with this many steps
+ * per voxel. Ditto for texture coordinates, which are always multiples of one half.
+ */
+#define GS_TERRAIN_VERTEX_POSITION_SCALE (2)
+#define GS_TERRAIN_VERTEX_TEXCOORD_SCALE (2)
+
+
+/* Generic vertex attribute indices used by the terrain shader. These are bound before the shader is linked.
+ * Index zero is avoided because some implementations alias it with gl_Vertex.
+ */
+typedef enum
+{
+    GSTerrainVertexAttribTexCoord = 1,
+    GSTerrainVertexAttribLuminance = 2,
+    GSTerrainVertexAttribChunkOffset = 3
+} GSTerrainVertexAttrib;
+
+
+/* Compact terrain vertex. Positions are relative to the min corner of the chunk which owns the vertex. The chunk
+ * offset is supplied separately for each draw call.
+ */
 typedef struct
 {
-    GLfloat position[3];
-    GLubyte color[4];
-    GLfloat texCoord[3];
+    /* Chunk-relative position in units of 1/GS_TERRAIN_VERTEX_POSITION_SCALE voxels. */
+    GLshort position[3];
+
+    /* Texture coordinates in units of 1/GS_TERRAIN_VERTEX_TEXCOORD_SCALE tiles, and the texture array layer. */
+    GLubyte texCoord[3];
+
+    /* Terrain vertices are always grey so the color is stored as a single luminance value. */
+    GLubyte luminance;
+
+    /* Pads the vertex so that vertex positions in a buffer are always aligned on four byte boundaries. */
+    GLubyte padding[2];
 } GSTerrainVertex;
+
+_Static_assert(sizeof(GSTerrainVertex) == 12, "GSTerrainVertex is expected to be exactly twelve bytes.");
+
+
+static inline GSTerrainVertex GSTerrainVertexMake(vector_float3 chunkLocalPos,
+                                                  vector_float2 texCoord,
+                                                  int tex,
+                                                  uint8_t luminance)
+{
+    vector_float3 p = chunkLocalPos * GS_TERRAIN_VERTEX_POSITION_SCALE;
+    vector_float2 t = texCoord * GS_TERRAIN_VERTEX_TEXCOORD_SCALE;
+
+    assert(p.x == roundf(p.x) && p.y == roundf(p.y) && p.z == roundf(p.z));
+    assert(t.x == roundf(t.x) && t.y == roundf(t.y));
+    assert(t.x >= 0 && t.x <= UINT8_MAX && t.y >= 0 && t.y <= UINT8_MAX);
+    assert(tex >= 0 && tex <= UINT8_MAX);
+
+    GSTerrainVertex v = {
+        .position = {(GLshort)p.x, (GLshort)p.y, (GLshort)p.z},
+        .texCoord = {(GLubyte)t.x, (GLubyte)t.y, (GLubyte)tex},
+        .luminance = luminance,
+        .padding = {0, 0}
+    };
+
+    return v;
+}
@@ -17,6 +17,16 @@
 _Static_assert((CHUNK_LIGHTING_MAX <= (CHUNK_SIZE_X - 1)) && (CHUNK_LIGHTING_MAX <= (CHUNK_SIZE_Z - 1)),
                "Lots of logic here assumes that lighting changes will never affect more than one chunk and it's neighbors.");
 
+/* Light is tracked in independent channels which are only combined when generating terrain geometry.
+ * Sunlight comes from voxels which are exposed to the sky. Torchlight comes from torches.
+ */
+typedef enum
+{
+    LIGHT_CHANNEL_SUN=0,
+    LIGHT_CHANNEL_TORCH,
+    NUM_LIGHT_CHANNELS
+} GSLightChannel;
+
 /* The voxel type affects the mesh which is used when drawing it.
  * According to GSVoxel, there can only be 8 types.
  */
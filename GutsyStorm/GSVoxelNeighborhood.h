@@ -33,4 +33,7 @@
 /* Generate and return sunlight data for the center chunk of the voxel neighborhood. */
 - (nonnull GSTerrainBuffer *)newSunlightBuffer;
 
+/* Generate and return light data in the specified channel for the center chunk of the voxel neighborhood. */
+- (nonnull GSTerrainBuffer *)newLightBufferForChannel:(GSLightChannel)channel;
+
 @end
@@ -135,6 +135,12 @@
 
 /* Generate and return sunlight data for the entire voxel neighborhood. */
 - (nonnull GSTerrainBuffer *)newSunlightBuffer
+{
+    return [self newLightBufferForChannel:LIGHT_CHANNEL_SUN];
+}
+
+/* Generate and return light data in the specified channel for the entire voxel neighborhood. */
+- (nonnull GSTerrainBuffer *)newLightBufferForChannel:(GSLightChannel)channel
 {
     GSIntAABB voxelBox = { .mins = GSCombinedMinP, .maxs = GSCombinedMaxP };
     vector_long3 oneBorder = {1, 0, 1};
@@ -158,21 +164,28 @@
     GSTerrainBufferElement *sunlight = [GSTerrainBuffer allocateBufferWithLength:nSunLen];
     bzero(sunlight, nSunLen); // Initially, set every element in the buffer to zero.
     
-    GSSunlightSeed(voxels, voxelCount, voxelBox,
-                   sunlight, nSunCount, nSunBox,
-                   nSunBox);
-    
-    // Every block above the elevation of the highest opaque block will be fully and directly lit.
-    // We can take advantage of this to avoid a lot of work.
-    vector_long3 maxBoxPoint = nSunBox.maxs;
-    maxBoxPoint.y = GSFindElevationOfHighestOpaqueBlock(voxels, voxelCount, voxelBox);
-    GSIntAABB blurBox = { .mins = nSunBox.mins, .maxs = maxBoxPoint };
-    
-    GSSunlightBlur(voxels, voxelCount, voxelBox,
-                   sunlight, nSunCount, nSunBox,
-                   blurBox,
-                   GSZeroIntVec3, // Pass zero because we don't care.
-                   NULL);
+    size_t numSources = GSSunlightSeed(channel,
+                                       voxels, voxelCount, voxelBox,
+                                       sunlight, nSunCount, nSunBox,
+                                       nSunBox);
+    
+    GSIntAABB blurBox = nSunBox;
+
+    if (channel == LIGHT_CHANNEL_SUN) {
+        // Every block above the elevation of the highest opaque block will be fully and directly lit.
+        // We can take advantage of this to avoid a lot of work.
+        blurBox.maxs.y = GSFindElevationOfHighestOpaqueBlock(voxels, voxelCount, voxelBox);
+    }
+    
+    // Most neighborhoods contain no torches at all, and then there is no light to spread.
+    if (numSources > 0) {
+        GSSunlightBlur(channel,
+                       voxels, voxelCount, voxelBox,
+                       sunlight, nSunCount, nSunBox,
+                       blurBox,
+                       GSZeroIntVec3, // Pass zero because we don't care.
+                       NULL);
+    }
     
     free(voxels);
     
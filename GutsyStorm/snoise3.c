@@ -218,3 +218,119 @@ float FeepingCreature_noise3(vector_float3 p, struct NoiseContext * _Nonnull nc)
     vres *= vfactors;
     return 0.5f + 16 * sum4(vres);
 }
+
+
+#define ALIGN16 __attribute__ ((aligned (16)))
+
+/* Gradient vectors indexed by the values of mperm. These match the gradients which FeepingCreature_noise3() selects
+ * component-wise, so the dot product with a zero term added gives bit-identical results.
+ */
+static const float gradX[12] = {1, -1,  1, -1, 1, -1,  1, -1, 0,  0,  0,  0};
+static const float gradY[12] = {1,  1, -1, -1, 0,  0,  0,  0, 1, -1,  1, -1};
+static const float gradZ[12] = {0,  0,  0,  0, 1,  1, -1, -1, 1,  1, -1, -1};
+
+static v4si floor4(v4sf v) {
+    return (v4si) _mm_sub_epi32(_mm_cvttps_epi32(v), _mm_srli_epi32(_mm_castps_si128(v), 31));
+}
+
+/* Contribution of one simplex corner for each of four points, given the offsets from the corner and the gradients. */
+static v4sf corner4(v4sf x, v4sf y, v4sf z, const int gi[4]) {
+    v4sf gx = vec4f(gradX[gi[0]], gradX[gi[1]], gradX[gi[2]], gradX[gi[3]]);
+    v4sf gy = vec4f(gradY[gi[0]], gradY[gi[1]], gradY[gi[2]], gradY[gi[3]]);
+    v4sf gz = vec4f(gradZ[gi[0]], gradZ[gi[1]], gradZ[gi[2]], gradZ[gi[3]]);
+    v4sf t = vec1_4f(0.6f) - (x*x + y*y + z*z);
+    v4sf live = _mm_cmpge_ps(t, vec1_4f(0));
+    v4sf res = _mm_and_ps(live, gx*x + gy*y + gz*z);
+    t = _mm_and_ps(live, t);
+    t *= t;
+    t *= t;
+    return res * t;
+}
+
+/* Evaluates FeepingCreature_noise3() at four points at once. The points are passed as separate x, y, and z vectors.
+ * Only the permutation table lookups are done one lane at a time.
+ */
+static v4sf noise3x4(v4sf x, v4sf y, v4sf z, struct NoiseContext * _Nonnull nc) {
+    v4sf s = (x + y + z) / vec1_4f(3);
+    v4si i = floor4(x + s), j = floor4(y + s), k = floor4(z + s);
+    v4sf t = _mm_cvtepi32_ps((__m128i) (i + j + k)) / vec1_4f(6.0f);
+    v4sf x0 = x - _mm_cvtepi32_ps((__m128i) i) + t;
+    v4sf y0 = y - _mm_cvtepi32_ps((__m128i) j) + t;
+    v4sf z0 = z - _mm_cvtepi32_ps((__m128i) k) + t;
+
+    // Select the middle two corners of the simplex from the ordering of the offsets, as in the scalar version.
+    v4si mask = ((v4si) _mm_cmplt_ps(x0, y0) & 1) |
+                ((v4si) _mm_cmplt_ps(x0, z0) & 2) |
+                ((v4si) _mm_cmplt_ps(y0, z0) & 4);
+    int ci[4] ALIGN16, cj[4] ALIGN16, ck[4] ALIGN16, m[4] ALIGN16;
+    *(v4si*) &ci = i;
+    *(v4si*) &cj = j;
+    *(v4si*) &ck = k;
+    *(v4si*) &m = mask;
+
+    float o1[3][4] ALIGN16, o2[3][4] ALIGN16;
+    int gi[4][4];
+    LET(mperm, nc->mperm);
+    LET(perm, nc->perm);
+    for (int l = 0; l < 4; ++l) {
+        int (*o)[4] = nc->offsets[m[l]];
+        for (int a = 0; a < 3; ++a) {
+            o1[a][l] = o[0][a];
+            o2[a][l] = o[1][a];
+        }
+        gi[0][l] = mperm[(perm[(perm[(ck[l]        )&0xff]+cj[l]        )&0xff]+ci[l]        )&0xff];
+        gi[1][l] = mperm[(perm[(perm[(ck[l]+o[0][2])&0xff]+cj[l]+o[0][1])&0xff]+ci[l]+o[0][0])&0xff];
+        gi[2][l] = mperm[(perm[(perm[(ck[l]+o[1][2])&0xff]+cj[l]+o[1][1])&0xff]+ci[l]+o[1][0])&0xff];
+        gi[3][l] = mperm[(perm[(perm[(ck[l]+1      )&0xff]+cj[l]+1      )&0xff]+ci[l]+1      )&0xff];
+    }
+
+    v4sf sum = corner4(x0, y0, z0, gi[0]);
+    sum += corner4(x0 + vec1_4f(1.0f/6.0f) - *(v4sf*) &o1[0],
+                   y0 + vec1_4f(1.0f/6.0f) - *(v4sf*) &o1[1],
+                   z0 + vec1_4f(1.0f/6.0f) - *(v4sf*) &o1[2], gi[1]);
+    sum += corner4(x0 + vec1_4f(2.0f/6.0f) - *(v4sf*) &o2[0],
+                   y0 + vec1_4f(2.0f/6.0f) - *(v4sf*) &o2[1],
+                   z0 + vec1_4f(2.0f/6.0f) - *(v4sf*) &o2[2], gi[2]);
+    sum += corner4(x0 + vec1_4f(-1.0f + 3.0f/6.0f),
+                   y0 + vec1_4f(-1.0f + 3.0f/6.0f),
+                   z0 + vec1_4f(-1.0f + 3.0f/6.0f), gi[3]);
+    return vec1_4f(0.5f) + vec1_4f(16) * sum;
+}
+
+void FeepingCreature_noise3_octaves_batch(const vector_float3 * _Nonnull points, float * _Nonnull results,
+                                          size_t count, unsigned numOctaves, float amplitude,
+                                          struct NoiseContext * _Nonnull nc)
+{
+    for (size_t base = 0; base < count; base += 4) {
+        float x[4] ALIGN16, y[4] ALIGN16, z[4] ALIGN16;
+        size_t n = (count - base < 4) ? (count - base) : 4;
+
+        // Pad a short final batch by repeating its last point.
+        for (size_t l = 0; l < 4; ++l) {
+            vector_float3 p = points[base + ((l < n) ? l : (n - 1))];
+            x[l] = p.x;
+            y[l] = p.y;
+            z[l] = p.z;
+        }
+
+        v4sf vx = *(v4sf*) &x, vy = *(v4sf*) &y, vz = *(v4sf*) &z;
+        v4sf acc = vec1_4f(0), frequency = vec1_4f(1), a = vec1_4f(amplitude);
+        for (unsigned octave = 0; octave < numOctaves; ++octave) {
+            acc += noise3x4(vx * frequency, vy * frequency, vz * frequency, nc) * a;
+            frequency *= vec1_4f(2);
+            a *= vec1_4f(0.5f);
+        }
+
+        float f[4] ALIGN16;
+        *(v4sf*) &f = acc;
+        for (size_t l = 0; l < n; ++l) {
+            results[base + l] = f[l];
+        }
+    }
+}
+
+void FeepingCreature_noise3_batch(const vector_float3 * _Nonnull points, float * _Nonnull results, size_t count,
+                                  struct NoiseContext * _Nonnull nc)
+{
+    FeepingCreature_noise3_octaves_batch(points, results, count, 1, 1.0f, nc);
+}
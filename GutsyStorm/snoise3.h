@@ -10,3 +10,14 @@ struct NoiseContext;
 float FeepingCreature_noise3(vector_float3 p, struct NoiseContext * _Nonnull nc);
 struct NoiseContext * _Nullable FeepingCreature_CreateNoiseContext(unsigned * _Nonnull pseed);
 void FeepingCreature_DestroyNoiseContext(struct NoiseContext * _Nonnull nc);
+
+/* Evaluates noise at `count' points, four points at a time, writing one result per point to `results'. */
+void FeepingCreature_noise3_batch(const vector_float3 * _Nonnull points, float * _Nonnull results, size_t count,
+                                  struct NoiseContext * _Nonnull nc);
+
+/* Sums `numOctaves' octaves of noise at each of `count' points. Each octave doubles the frequency and halves the
+ * amplitude, starting from `amplitude'. Octaves are fused so each batch of points is loaded only once.
+ */
+void FeepingCreature_noise3_octaves_batch(const vector_float3 * _Nonnull points, float * _Nonnull results,
+                                          size_t count, unsigned numOctaves, float amplitude,
+                                          struct NoiseContext * _Nonnull nc);
@@ -0,0 +1,225 @@
+//
+//  main.m
+//  GutsyStormPregen
+//
+//  Created by agent on 10/18/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+//  Generates voxels, sunlight, and geometry for a region of chunk columns and writes them to a terrain cache folder,
+//  without a window or an OpenGL context. The cache folder can then be shipped alongside the journal so that the game
+//  doesn't have to generate that terrain itself.
+//
+//  Options are read from the command-line as user defaults:
+//
+//      GutsyStormPregen -journal <path> -cacheFolder <path> [-seed <n>]
+//                       -minX <chunk> -minZ <chunk> -maxX <chunk> -maxZ <chunk>
+//                       [-InterpolatedTerrainGeneration YES]
+//
+//  The region is given in chunk column coordinates, from min (inclusive) to max (exclusive). If the journal does not
+//  exist then a new one is created with the given seed and written to the journal path. If the seed is given for an
+//  existing journal then it must match the journal's seed.
+//
+//  Chunks are written to a folder within the cache folder which is named for the generation quality, as the game
+//  expects. Pregenerate with the same -InterpolatedTerrainGeneration setting the game will use.
+//
+
+#import <Foundation/Foundation.h>
+#import "GSVoxel.h"
+#import "GSStopwatch.h"
+#import "GSTerrainJournal.h"
+#import "GSTerrainGenerator.h"
+#import "GSTerrainChunkStore.h"
+#import "GSTerrainApplyJournalOperation.h"
+#import "GSGrid.h"
+
+
+/* Chunks are generated in square batches of chunk columns, one batch per task. This matches the size of the tiles in
+ * which the chunk store generates voxels and sunlight, so each tile is generated once, by the task which uses it.
+ */
+static const long GSPregenBatchSize = 4;
+
+/* The grids retain every chunk until evicted. Keep about this many chunks in each grid per batch being processed, which
+ * is enough for a batch and its neighbors. Chunks evicted before they're needed again are loaded from the cache folder.
+ */
+static const long GSPregenChunksPerBatch = 4 * GSPregenBatchSize * GSPregenBatchSize;
+
+
+static void printUsage(void)
+{
+    fprintf(stderr, "usage: GutsyStormPregen -journal <path> -cacheFolder <path> [-seed <n>]\n"
+                    "                        -minX <chunk> -minZ <chunk> -maxX <chunk> -maxZ <chunk>\n"
+                    "                        [-InterpolatedTerrainGeneration YES]\n");
+}
+
+
+static long floorDiv(long a, long b)
+{
+    return (a >= 0) ? (a / b) : -((b - 1 - a) / b);
+}
+
+
+static GSTerrainJournal * _Nullable fetchJournal(NSURL * _Nonnull url, NSNumber * _Nullable seed)
+{
+    GSTerrainJournal *journal = nil;
+
+    if ([[NSFileManager defaultManager] fileExistsAtPath:[url path]]) {
+        journal = [NSKeyedUnarchiver unarchiveObjectWithFile:[url path]];
+
+        if (!journal) {
+            NSLog(@"Failed to read the terrain journal at %@", url);
+            return nil;
+        }
+
+        if (seed && (journal.randomSeed != [seed integerValue])) {
+            NSLog(@"The seed %@ does not match the journal's seed %ld", seed, (long)journal.randomSeed);
+            return nil;
+        }
+    } else {
+        NSLog(@"Creating new journal at %@", url);
+        journal = [[GSTerrainJournal alloc] init];
+
+        if (seed) {
+            journal.randomSeed = [seed integerValue];
+        }
+
+        // The cache folder is only meaningful alongside the journal which produced it, so save the journal now.
+        if (![NSKeyedArchiver archiveRootObject:journal toFile:[url path]]) {
+            NSLog(@"Failed to save the terrain journal to %@", url);
+            return nil;
+        }
+    }
+
+    journal.url = url;
+
+    return journal;
+}
+
+
+int main(int argc, const char *argv[])
+{
+    @autoreleasepool {
+        NSUserDefaults *defaults = [NSUserDefaults standardUserDefaults];
+        NSString *journalPath = [defaults stringForKey:@"journal"];
+        NSString *cachePath = [defaults stringForKey:@"cacheFolder"];
+        NSArray<NSString *> *regionKeys = @[@"minX", @"minZ", @"maxX", @"maxZ"];
+
+        BOOL missingRegion = NO;
+        for(NSString *key in regionKeys)
+        {
+            missingRegion |= ([defaults objectForKey:key] == nil);
+        }
+
+        if (!journalPath || !cachePath || missingRegion) {
+            printUsage();
+            return EXIT_FAILURE;
+        }
+
+        const long minX = [defaults integerForKey:@"minX"], minZ = [defaults integerForKey:@"minZ"];
+        const long maxX = [defaults integerForKey:@"maxX"], maxZ = [defaults integerForKey:@"maxZ"];
+
+        if (minX >= maxX || minZ >= maxZ) {
+            fprintf(stderr, "The region is empty.\n");
+            return EXIT_FAILURE;
+        }
+
+        NSNumber *seed = [defaults objectForKey:@"seed"] ? @([defaults integerForKey:@"seed"]) : nil;
+        GSTerrainJournal *journal = fetchJournal([NSURL fileURLWithPath:journalPath], seed);
+        if (!journal) {
+            return EXIT_FAILURE;
+        }
+
+        NSError *error = nil;
+        if (![[NSFileManager defaultManager] createDirectoryAtPath:cachePath
+                                       withIntermediateDirectories:YES
+                                                        attributes:nil
+                                                             error:&error]) {
+            NSLog(@"Failed to create terrain cache folder %@: %@", cachePath, error);
+            return EXIT_FAILURE;
+        }
+        NSURL *cacheFolder = [[NSURL alloc] initFileURLWithPath:cachePath isDirectory:YES];
+
+        BOOL interpolated = [defaults boolForKey:@"InterpolatedTerrainGeneration"];
+        GSTerrainGenerator *generator = [[GSTerrainGenerator alloc]
+                                         initWithRandomSeed:journal.randomSeed
+                                         quality:(interpolated ? GSTerrainGenerationQualityInterpolated
+                                                               : GSTerrainGenerationQualityExact)];
+
+        GSTerrainChunkStore *chunkStore = [[GSTerrainChunkStore alloc] initWithJournal:journal
+                                                                           cacheFolder:cacheFolder
+                                                                                camera:nil
+                                                                             glContext:nil
+                                                                             generator:generator];
+
+        // As in GSTerrain, the journal is replayed over an empty cache folder so the edits are reflected in it. Chunks
+        // are cached in a folder for the generation quality, within the one given on the command line.
+        if (!chunkStore.cacheFolder) {
+            return EXIT_FAILURE;
+        }
+        NSArray *cacheContents = [[NSFileManager defaultManager] contentsOfDirectoryAtPath:[chunkStore.cacheFolder path]
+                                                                                     error:NULL];
+        if (cacheContents.count == 0 && journal.journalEntries.count > 0) {
+            NSLog(@"Applying %lu journal entries.", (unsigned long)journal.journalEntries.count);
+            [[[GSTerrainApplyJournalOperation alloc] initWithJournal:journal chunkStore:chunkStore] main];
+        }
+
+        // Batches are aligned to the chunk store's tiles, so those on the edges may be partly outside the region.
+        const long batchMinX = floorDiv(minX, GSPregenBatchSize), batchMaxX = floorDiv(maxX - 1, GSPregenBatchSize);
+        const long batchMinZ = floorDiv(minZ, GSPregenBatchSize), batchMaxZ = floorDiv(maxZ - 1, GSPregenBatchSize);
+        const long batchesX = batchMaxX - batchMinX + 1, batchesZ = batchMaxZ - batchMinZ + 1;
+        const size_t numBatches = batchesX * batchesZ;
+        const long totalChunks = (maxX - minX) * (maxZ - minZ);
+        const long voxelsPerChunk = CHUNK_SIZE_X * CHUNK_SIZE_Y * CHUNK_SIZE_Z;
+
+        const NSInteger countLimit = GSPregenChunksPerBatch * [[NSProcessInfo processInfo] activeProcessorCount];
+        chunkStore.gridVoxelData.countLimit = countLimit;
+        chunkStore.gridSunlightData.countLimit = countLimit;
+        chunkStore.gridGeometryData.countLimit = countLimit;
+
+        printf("Generating %ld chunks in %zu batches for seed %ld.\n",
+               totalChunks, numBatches, (long)journal.randomSeed);
+
+        dispatch_queue_t progressQueue = dispatch_queue_create("GutsyStormPregen.progress", DISPATCH_QUEUE_SERIAL);
+        __block long chunksDone = 0;
+        uint64_t startAbs = GSStopwatchStart();
+
+        dispatch_apply(numBatches, dispatch_get_global_queue(DISPATCH_QUEUE_PRIORITY_DEFAULT, 0), ^(size_t i) {
+            @autoreleasepool {
+                const long x0 = MAX(minX, (batchMinX + (long)i % batchesX) * GSPregenBatchSize);
+                const long z0 = MAX(minZ, (batchMinZ + (long)i / batchesX) * GSPregenBatchSize);
+                const long x1 = MIN(maxX, (batchMinX + (long)i % batchesX + 1) * GSPregenBatchSize);
+                const long z1 = MIN(maxZ, (batchMinZ + (long)i / batchesX + 1) * GSPregenBatchSize);
+
+                // Geometry depends on sunlight, which depends on voxels, so this produces all three for each chunk.
+                for(long x = x0; x < x1; ++x)
+                {
+                    for(long z = z0; z < z1; ++z)
+                    {
+                        [chunkStore chunkGeometryAtPoint:(vector_float3){x * CHUNK_SIZE_X, 0, z * CHUNK_SIZE_Z}];
+                    }
+                }
+
+                const long count = (x1 - x0) * (z1 - z0);
+                dispatch_async(progressQueue, ^{
+                    chunksDone += count;
+                    double seconds = GSStopwatchEnd(startAbs) / (double)NSEC_PER_SEC;
+                    double chunksPerSecond = chunksDone / seconds;
+                    printf("\r%ld/%ld chunks (%.1f%%), %.1f chunks/s, %.2f Mvoxels/s",
+                           chunksDone, totalChunks, 100.0 * chunksDone / totalChunks,
+                           chunksPerSecond, chunksPerSecond * voxelsPerChunk / 1e6);
+                    fflush(stdout);
+                });
+            }
+        });
+
+        dispatch_sync(progressQueue, ^{});
+        printf("\n");
+
+        [chunkStore shutdown];
+
+        double seconds = GSStopwatchEnd(startAbs) / (double)NSEC_PER_SEC;
+        printf("Generated %ld chunks in %.2f s (%.1f chunks/s, %.2f Mvoxels/s).\n",
+               totalChunks, seconds, totalChunks / seconds, totalChunks * voxelsPerChunk / seconds / 1e6);
+    }
+
+    return EXIT_SUCCESS;
+}
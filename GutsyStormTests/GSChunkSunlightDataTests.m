@@ -12,7 +12,11 @@
 #import "GSChunkSunlightData.h"
 #import "GSVoxelNeighborhood.h"
 #import "GSTerrainBuffer.h"
+#import "GSTerrainLightBuffer.h"
+#import "GSSunlightRegion.h"
+#import "GSSunlightNeighborhood.h"
 #import "GSTerrainGenerator.h"
+#import "GSSunlightUtils.h"
 #import "GSBox.h"
 #import "GSVectorUtils.h"
 
@@ -27,27 +31,79 @@
                          region:(nonnull GSIntAABB *)box
                   offsetToWorld:(vector_float3)offsetToWorld
 {
+    BOOL centerChunk = (offsetToWorld.x == 0 && offsetToWorld.y == 0 && offsetToWorld.z == 0);
+    BOOL eastChunk = (offsetToWorld.x == CHUNK_SIZE_X && offsetToWorld.y == 0 && offsetToWorld.z == 0);
     vector_long3 clp;
     FOR_BOX(clp, *box)
     {
         BOOL isEmpty = YES;
         
         if (clp.y == 32) {
-            BOOL centerChunk = (offsetToWorld.x == 0 && offsetToWorld.y == 0 && offsetToWorld.z == 0);
             isEmpty = (centerChunk && clp.x == 7 && clp.z == 7);
         } else if (clp.y == 0 || clp.y == 10) {
             isEmpty = NO;
         }
+
+        // One torch lies in the center chunk and another lies close enough to light it from the east.
+        BOOL isTorch = (clp.y == 11) && ((centerChunk && clp.x == 3 && clp.z == 3) ||
+                                         (eastChunk && clp.x == 2 && clp.z == 7));
         
         NSUInteger idx = INDEX_BOX(clp, *box);
         voxels[idx].type = isEmpty ? VOXEL_TYPE_EMPTY : VOXEL_TYPE_GROUND;
         voxels[idx].opaque = isEmpty ? 0 : 1;
+        voxels[idx].torch = isTorch ? 1 : 0;
     }
 }
 
 @end
 
 
+/* The per-level sweep which GSSunlightBlur replaced, kept as a reference for its results. For each light level from
+ * CHUNK_LIGHTING_MAX down to 1, every voxel adjacent to a voxel at that level is raised to the next lower level.
+ */
+static void referenceLightSweep(GSLightChannel channel,
+                                GSVoxel * _Nonnull voxels, size_t voxelCount, GSIntAABB voxelBox,
+                                GSTerrainBufferElement * _Nonnull light, size_t lightCount, GSIntAABB lightBox,
+                                GSIntAABB blurBox)
+{
+    for(int lightLevel = CHUNK_LIGHTING_MAX; lightLevel >= 1; --lightLevel)
+    {
+        vector_long3 p;
+        FOR_BOX(p, blurBox)
+        {
+            size_t voxelIdx = INDEX_BOX(p, voxelBox);
+            assert(voxelIdx < voxelCount);
+            GSVoxel voxel = voxels[voxelIdx];
+
+            if(voxel.opaque || GSLightIsSource(voxel, channel)) {
+                continue;
+            }
+
+            BOOL adj = NO;
+
+            for(GSVoxelFace i=0; i<FACE_NUM_FACES && !adj; ++i)
+            {
+                vector_long3 a = p + GSOffsetForVoxelFace[i];
+
+                if(a.x < lightBox.mins.x || a.x >= lightBox.maxs.x ||
+                   a.z < lightBox.mins.z || a.z >= lightBox.maxs.z ||
+                   a.y < lightBox.mins.y || a.y >= lightBox.maxs.y) {
+                    continue;
+                }
+
+                adj = !voxels[INDEX_BOX(a, voxelBox)].opaque && (light[INDEX_BOX(a, lightBox)] == lightLevel);
+            }
+
+            if(adj) {
+                size_t lightIdx = INDEX_BOX(p, lightBox);
+                assert(lightIdx < lightCount);
+                light[lightIdx] = MAX(light[lightIdx], lightLevel - 1);
+            }
+        }
+    }
+}
+
+
 @interface GSChunkSunlightDataTests : XCTestCase
 
 @end
@@ -94,6 +150,20 @@
                                             allowLoading:NO];
 }
 
+- (nonnull GSVoxelNeighborhood *)newVoxelNeighborhoodAtPoint:(vector_float3)center
+                voxelsAtPoint:(GSChunkVoxelData * _Nonnull (^ _Nonnull)(vector_float3 p))voxelsAtPoint
+{
+    GSVoxelNeighborhood *neighborhood = [[GSVoxelNeighborhood alloc] init];
+
+    for(GSVoxelNeighborIndex i = 0; i < CHUNK_NUM_NEIGHBORS; ++i)
+    {
+        vector_float3 p = center + [GSNeighborhood offsetForNeighborIndex:i];
+        [neighborhood setNeighborAtIndex:i neighbor:voxelsAtPoint(GSMinCornerForChunkAtPoint(p))];
+    }
+
+    return neighborhood;
+}
+
 - (NSMutableString *)stringSliceOf:(nonnull GSChunkSunlightData *)chunk atY:(int)y
 {
     GSTerrainBufferElement v;
@@ -278,4 +348,298 @@
     XCTAssertEqualObjects(slice, expectedSlice30);
 }
 
+- (void)testRegionMatchesNeighborhood
+{
+    // Light for a chunk must be the same whether it was lit by itself or as part of a larger region.
+    GSTerrainGenerator *generator = [[GSChunkSunlightDataTests_TerrainGenerator alloc] initWithRandomSeed:0];
+    GSSunlightRegion *region;
+    region = [[GSSunlightRegion alloc] initWithMinP:vector_make(0, 0, 0)
+                                            chunksX:2
+                                            chunksZ:1
+                                      voxelsAtPoint:^GSChunkVoxelData *(vector_float3 p) {
+                                          return [[GSChunkVoxelData alloc] initWithMinP:p
+                                                                                 folder:nil
+                                                                         groupForSaving:groupForSaving
+                                                                         queueForSaving:queueForSaving
+                                                                                journal:journal
+                                                                              generator:generator
+                                                                           allowLoading:NO];
+                                      }];
+
+    XCTAssertEqual([sunChunk.torchlight valueAtPosition:GSMakeIntegerVector3(3, 11, 3)], CHUNK_LIGHTING_MAX);
+    XCTAssertEqual([sunChunk.torchlight valueAtPosition:GSMakeIntegerVector3(15, 11, 7)], CHUNK_LIGHTING_MAX - 3);
+
+    vector_long3 border = {1, 0, 1};
+    GSIntAABB lightBox = { .mins = -border, .maxs = border + GSChunkSizeIntVec3 };
+
+    for(GSLightChannel channel = 0; channel < NUM_LIGHT_CHANNELS; ++channel)
+    {
+        GSTerrainLightBuffer *light = [region lightBufferForChannel:channel chunkAtPoint:vector_make(0, 0, 0)];
+        GSTerrainLightBuffer *expected = [sunChunk lightBufferForChannel:channel];
+        vector_long3 p;
+
+        FOR_BOX(p, lightBox)
+        {
+            XCTAssertEqual([light valueAtPosition:p], [expected valueAtPosition:p], @"channel %d", (int)channel);
+        }
+    }
+}
+
+- (void)testCanLoadRejectsStaleFiles
+{
+    // A light file from an older version must not be reported as loadable, else it would be loaded and then rejected
+    // instead of being regenerated along with the rest of its tile.
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    NSURL *folder = [NSURL fileURLWithPath:path isDirectory:YES];
+    [[NSFileManager defaultManager] createDirectoryAtURL:folder
+                             withIntermediateDirectories:YES
+                                              attributes:nil
+                                                   error:nil];
+
+    NSString *fileName = [GSChunkSunlightData fileNameForSunlightDataFromMinP:vector_make(0, 0, 0)];
+    NSURL *url = [NSURL URLWithString:fileName relativeToURL:folder];
+    XCTAssertFalse([GSChunkSunlightData canLoadSunlightDataFromURL:url]);
+
+    (void)[[GSChunkSunlightData alloc] initWithMinP:vector_make(0, 0, 0)
+                                             folder:folder
+                                     groupForSaving:groupForSaving
+                                     queueForSaving:queueForSaving
+                                       neighborhood:sunChunk.neighborhood
+                                       allowLoading:NO];
+    dispatch_group_wait(groupForSaving, DISPATCH_TIME_FOREVER);
+    XCTAssertTrue([GSChunkSunlightData canLoadSunlightDataFromURL:url]);
+
+    // The version follows the magic number in the header.
+    NSFileHandle *file = [NSFileHandle fileHandleForUpdatingURL:url error:nil];
+    uint32_t staleVersion = 1;
+    [file seekToFileOffset:sizeof(uint32_t)];
+    [file writeData:[NSData dataWithBytes:&staleVersion length:sizeof(staleVersion)]];
+    [file closeFile];
+    XCTAssertFalse([GSChunkSunlightData canLoadSunlightDataFromURL:url]);
+
+    [[NSFileManager defaultManager] removeItemAtURL:folder error:nil];
+}
+
+- (void)testBlurMatchesReferenceSweep
+{
+    // The flood fill in GSSunlightBlur must produce exactly the same light as the per-level sweep it replaced.
+    GSTerrainGenerator *generator = [[GSTerrainGenerator alloc] initWithRandomSeed:1];
+    GSVoxelNeighborhood *neighborhood;
+    neighborhood = [self newVoxelNeighborhoodAtPoint:vector_make(0, 0, 0)
+                                       voxelsAtPoint:^GSChunkVoxelData *(vector_float3 p) {
+                                           return [[GSChunkVoxelData alloc] initWithMinP:p
+                                                                                  folder:nil
+                                                                          groupForSaving:groupForSaving
+                                                                          queueForSaving:queueForSaving
+                                                                                 journal:journal
+                                                                               generator:generator
+                                                                            allowLoading:NO];
+                                       }];
+
+    size_t voxelCount = 0;
+    GSVoxel *voxels = [neighborhood newVoxelBufferReturningCount:&voxelCount];
+    GSIntAABB voxelBox = { .mins = GSCombinedMinP, .maxs = GSCombinedMaxP };
+
+    // Scatter torches through the air and caves below the highest hills.
+    float minY, maxY;
+    [GSTerrainGenerator getHillsSurfaceMinY:&minY maxY:&maxY];
+    size_t numTorches = 0;
+    vector_long3 p;
+    FOR_BOX(p, voxelBox)
+    {
+        size_t idx = INDEX_BOX(p, voxelBox);
+        long hash = (p.x - voxelBox.mins.x) * 7 + p.y * 13 + (p.z - voxelBox.mins.z) * 31;
+        if (!voxels[idx].opaque && p.y < maxY && (hash % 89) == 0) {
+            voxels[idx].torch = 1;
+            ++numTorches;
+        }
+    }
+    XCTAssertGreaterThan(numTorches, 0);
+
+    vector_long3 border = {CHUNK_LIGHTING_MAX + 1, 0, CHUNK_LIGHTING_MAX + 1};
+    GSIntAABB lightBox = { .mins = GSZeroIntVec3 - border, .maxs = GSChunkSizeIntVec3 + border };
+    vector_long3 lightDim = lightBox.maxs - lightBox.mins;
+    size_t lightCount = lightDim.x * lightDim.y * lightDim.z;
+    size_t lightLen = lightCount * sizeof(GSTerrainBufferElement);
+    GSTerrainBufferElement *expected = malloc(lightLen);
+    GSTerrainBufferElement *actual = malloc(lightLen);
+    assert(expected && actual);
+
+    for(GSLightChannel channel = 0; channel < NUM_LIGHT_CHANNELS; ++channel)
+    {
+        bzero(expected, lightLen);
+        bzero(actual, lightLen);
+
+        GSSunlightSeed(channel, voxels, voxelCount, voxelBox, expected, lightCount, lightBox, lightBox);
+        GSSunlightSeed(channel, voxels, voxelCount, voxelBox, actual, lightCount, lightBox, lightBox);
+
+        referenceLightSweep(channel, voxels, voxelCount, voxelBox, expected, lightCount, lightBox, lightBox);
+        GSSunlightBlur(channel,
+                       voxels, voxelCount, voxelBox,
+                       actual, lightCount, lightBox,
+                       lightBox,
+                       GSZeroIntVec3,
+                       NULL);
+
+        XCTAssertEqual(memcmp(expected, actual, lightLen), 0, @"channel %d", (int)channel);
+    }
+
+    free(expected);
+    free(actual);
+    free(voxels);
+}
+
+- (void)testIncrementalEditsMatchRecompute
+{
+    // Light updated incrementally after each edit must match light recomputed from scratch for the same voxels.
+    GSTerrainGenerator *generator = [[GSTerrainGenerator alloc] initWithRandomSeed:1];
+    NSMutableDictionary<NSString *, GSChunkVoxelData *> *chunks = [[NSMutableDictionary alloc] init];
+    NSString * (^keyForPoint)(vector_float3) = ^NSString *(vector_float3 p) {
+        return [NSString stringWithFormat:@"%d,%d", (int)p.x, (int)p.z];
+    };
+    GSChunkVoxelData * (^voxelsAtPoint)(vector_float3) = ^GSChunkVoxelData *(vector_float3 p) {
+        GSChunkVoxelData *voxels = chunks[keyForPoint(p)];
+        if (!voxels) {
+            voxels = [[GSChunkVoxelData alloc] initWithMinP:p
+                                                     folder:nil
+                                             groupForSaving:groupForSaving
+                                             queueForSaving:queueForSaving
+                                                    journal:journal
+                                                  generator:generator
+                                               allowLoading:NO];
+            chunks[keyForPoint(p)] = voxels;
+        }
+        return voxels;
+    };
+
+    vector_float3 centerP = vector_make(0, 0, 0);
+    long surfaceY = CHUNK_SIZE_Y - 1;
+    while (surfaceY > 0 && ![voxelsAtPoint(centerP) voxelAtLocalPosition:GSMakeIntegerVector3(7, surfaceY, 7)].opaque)
+    {
+        --surfaceY;
+    }
+
+    GSVoxel ground = {0};
+    ground.type = VOXEL_TYPE_GROUND;
+    ground.opaque = 1;
+
+    GSVoxel air = {0};
+    air.type = VOXEL_TYPE_EMPTY;
+
+    GSVoxel torch = {0};
+    torch.torch = YES;
+
+    GSVoxel noTorch;
+    memset(&noTorch, ~0, sizeof(GSVoxel));
+    noTorch.torch = NO;
+
+    // Place a torch on the ground, cover it with a block and uncover it, take it away, then shade the column beneath
+    // an overhanging block and remove the overhang again.
+    const struct {
+        long y;
+        GSVoxel block;
+        GSVoxelBitwiseOp op;
+    } edits[] = {
+        { surfaceY + 1, torch, BitwiseOr },
+        { surfaceY + 2, ground, Set },
+        { surfaceY + 2, air, Set },
+        { surfaceY + 1, noTorch, BitwiseAnd },
+        { surfaceY + 5, ground, Set },
+        { surfaceY + 5, air, Set },
+    };
+
+    GSIntAABB chunkBox = { GSZeroIntVec3, GSChunkSizeIntVec3 };
+
+    for(size_t e = 0; e < sizeof(edits) / sizeof(edits[0]); ++e)
+    {
+        vector_float3 editPos = vector_make(7, edits[e].y, 7);
+
+        // Light for the whole neighborhood before the edit is in equilibrium with the voxels.
+        GSSunlightNeighborhood *sunNeighborhood = [[GSSunlightNeighborhood alloc] init];
+        for(GSVoxelNeighborIndex i = 0; i < CHUNK_NUM_NEIGHBORS; ++i)
+        {
+            vector_float3 minP = centerP + [GSNeighborhood offsetForNeighborIndex:i];
+            GSVoxelNeighborhood *neighborhood = [self newVoxelNeighborhoodAtPoint:minP voxelsAtPoint:voxelsAtPoint];
+            GSChunkSunlightData *sun = [[GSChunkSunlightData alloc] initWithMinP:minP
+                                                                          folder:nil
+                                                                  groupForSaving:groupForSaving
+                                                                  queueForSaving:queueForSaving
+                                                                    neighborhood:neighborhood
+                                                                    allowLoading:NO];
+            [sunNeighborhood setNeighborAtIndex:i neighbor:sun];
+        }
+
+        GSChunkVoxelData *voxels1 = voxelsAtPoint(centerP);
+        GSChunkVoxelData *voxels2 = [voxels1 copyWithEditAtPoint:editPos block:edits[e].block operation:edits[e].op];
+        chunks[keyForPoint(centerP)] = voxels2;
+        sunNeighborhood.voxelNeighborhood = [self newVoxelNeighborhoodAtPoint:centerP voxelsAtPoint:voxelsAtPoint];
+
+        // Select the update mode for each channel the same way GSTerrainModifyBlockOperation does.
+        vector_long3 editPosClp = vector_long(editPos);
+        GSVoxel originalVoxel = [voxels1 voxelAtLocalPosition:editPosClp];
+        GSVoxel modifiedVoxel = [voxels2 voxelAtLocalPosition:editPosClp];
+        BOOL blockingLight = !originalVoxel.opaque && modifiedVoxel.opaque;
+        BOOL wasEmpty = (originalVoxel.type == VOXEL_TYPE_EMPTY), isEmpty = (modifiedVoxel.type == VOXEL_TYPE_EMPTY);
+        BOOL removingLight[NUM_LIGHT_CHANNELS];
+        removingLight[LIGHT_CHANNEL_SUN] = blockingLight || (wasEmpty && !isEmpty);
+        removingLight[LIGHT_CHANNEL_TORCH] = blockingLight || (originalVoxel.torch && !modifiedVoxel.torch);
+
+        for(GSLightChannel channel = 0; channel < NUM_LIGHT_CHANNELS; ++channel)
+        {
+            GSTerrainBuffer *incremental = [sunNeighborhood newLightBufferForChannel:channel
+                                                                     withEditAtPoint:editPos
+                                                                       removingLight:removingLight[channel]
+                                                                      affectedRegion:NULL];
+
+            size_t mismatches = 0;
+            for(GSVoxelNeighborIndex i = 0; i < CHUNK_NUM_NEIGHBORS; ++i)
+            {
+                vector_float3 offset = [GSNeighborhood offsetForNeighborIndex:i];
+                GSVoxelNeighborhood *neighborhood = [self newVoxelNeighborhoodAtPoint:centerP + offset
+                                                                         voxelsAtPoint:voxelsAtPoint];
+                GSTerrainBuffer *recomputed = [neighborhood newLightBufferForChannel:channel];
+
+                vector_long3 p;
+                FOR_BOX(p, chunkBox)
+                {
+                    if ([recomputed valueAtPosition:p] != [incremental valueAtPosition:p + vector_long(offset)]) {
+                        ++mismatches;
+                    }
+                }
+            }
+
+            XCTAssertEqual(mismatches, 0, @"edit %zu, channel %d", e, (int)channel);
+        }
+    }
+}
+
+- (void)testLightBufferPacking
+{
+    // Pack and unpack runs of light levels which start and end on both even and odd indices.
+    GSTerrainBufferElement src[33], dst[33];
+    uint8_t packed[GSLightBufferPackedLength(40)];
+    bzero(packed, sizeof(packed));
+
+    for(size_t i = 0; i < 33; ++i)
+    {
+        src[i] = i % (CHUNK_LIGHTING_MAX + 1);
+    }
+
+    GSLightBufferPack(packed, 3, src, 33);
+
+    for(size_t i = 0; i < 33; ++i)
+    {
+        XCTAssertEqual(GSLightBufferGet(packed, 3 + i), src[i]);
+    }
+
+    XCTAssertEqual(GSLightBufferGet(packed, 2), 0);
+    XCTAssertEqual(GSLightBufferGet(packed, 36), 0);
+
+    GSLightBufferUnpack(dst, packed, 3, 33);
+    XCTAssertEqual(memcmp(src, dst, sizeof(src)), 0);
+
+    GSLightBufferUnpack(dst, packed, 4, 10);
+    XCTAssertEqual(memcmp(src + 1, dst, 10 * sizeof(GSTerrainBufferElement)), 0);
+}
+
 @end
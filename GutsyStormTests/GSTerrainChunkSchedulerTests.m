@@ -0,0 +1,275 @@
+//
+//  GSTerrainChunkSchedulerTests.m
+//  GutsyStorm
+//
+//  Created by agent on 10/18/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "GSTerrainChunkScheduler.h"
+#import "GSBoxedVector.h"
+#import "GSVoxel.h"
+
+
+@interface GSTerrainChunkSchedulerTests : XCTestCase
+
+@end
+
+@implementation GSTerrainChunkSchedulerTests
+{
+    GSTerrainChunkScheduler *_scheduler;
+    NSMutableArray<GSBoxedVector *> *_completed;
+    NSMutableArray<NSNumber *> *_completedStages;
+    NSLock *_lockCompleted;
+    dispatch_semaphore_t _started, _gate;
+}
+
+- (void)setUp
+{
+    [super setUp];
+
+    _completed = [NSMutableArray new];
+    _completedStages = [NSMutableArray new];
+    _lockCompleted = [NSLock new];
+
+    // The first job blocks until the test opens the gate, so the test can fill the queue while the worker is busy.
+    _started = dispatch_semaphore_create(0);
+    _gate = dispatch_semaphore_create(0);
+    __block BOOL first = YES;
+
+    _scheduler = [[GSTerrainChunkScheduler alloc] initWithName:@"GSTerrainChunkSchedulerTests"
+                                              maxConcurrentJobs:1
+                                                            job:^(vector_float3 minP,
+                                                                  GSTerrainChunkStage stage,
+                                                                  NSUInteger levelOfDetail) {
+        if (first) {
+            first = NO;
+            dispatch_semaphore_signal(_started);
+            dispatch_semaphore_wait(_gate, DISPATCH_TIME_FOREVER);
+        }
+
+        [_lockCompleted lock];
+        [_completed addObject:[GSBoxedVector boxedVectorWithVector:minP]];
+        [_completedStages addObject:@(stage)];
+        [_lockCompleted unlock];
+    }];
+}
+
+- (void)tearDown
+{
+    [_scheduler shutdown];
+    _scheduler = nil;
+    [super tearDown];
+}
+
+- (vector_float3)chunkAtIndex:(long)i
+{
+    return (vector_float3){i * CHUNK_SIZE_X, 0, 0};
+}
+
+- (void)scheduleChunkAtIndex:(long)i stage:(GSTerrainChunkStage)stage visible:(BOOL)visible distance:(float)distance
+{
+    [_scheduler scheduleChunkAtPoint:[self chunkAtIndex:i]
+                               stage:stage
+                       levelOfDetail:0
+                             visible:visible
+                            distance:distance];
+}
+
+- (void)scheduleChunkAtIndex:(long)i visible:(BOOL)visible distance:(float)distance
+{
+    [self scheduleChunkAtIndex:i stage:GSTerrainChunkStageVoxels visible:visible distance:distance];
+}
+
+/* Schedules the first chunk, and waits until the worker is busy with it. */
+- (void)occupyWorker
+{
+    [self scheduleChunkAtIndex:0 visible:YES distance:0];
+    dispatch_semaphore_wait(_started, DISPATCH_TIME_FOREVER);
+}
+
+- (NSArray<GSBoxedVector *> *)chunksAtIndices:(NSArray<NSNumber *> *)indices
+{
+    NSMutableArray<GSBoxedVector *> *chunks = [NSMutableArray new];
+    for(NSNumber *i in indices)
+    {
+        [chunks addObject:[GSBoxedVector boxedVectorWithVector:[self chunkAtIndex:[i longValue]]]];
+    }
+    return chunks;
+}
+
+- (void)testJobsRunInPriorityOrder
+{
+    [self occupyWorker];
+
+    [self scheduleChunkAtIndex:1 visible:YES distance:30];
+    [self scheduleChunkAtIndex:2 visible:NO distance:1];
+    [self scheduleChunkAtIndex:3 visible:YES distance:10];
+    [self scheduleChunkAtIndex:4 visible:NO distance:5];
+    [self scheduleChunkAtIndex:5 visible:YES distance:20];
+    XCTAssertEqual(_scheduler.numberOfPendingJobs, 5);
+
+    dispatch_semaphore_signal(_gate);
+    [_scheduler waitUntilIdle];
+
+    XCTAssertEqualObjects(_completed, [self chunksAtIndices:@[@0, @3, @5, @1, @2, @4]]);
+}
+
+- (void)testDuplicateJobsAreMerged
+{
+    [self occupyWorker];
+
+    [self scheduleChunkAtIndex:1 visible:YES distance:10];
+    [self scheduleChunkAtIndex:2 visible:YES distance:20];
+    [self scheduleChunkAtIndex:1 visible:YES distance:30];
+    [self scheduleChunkAtIndex:2 visible:YES distance:5];
+    XCTAssertEqual(_scheduler.numberOfPendingJobs, 2);
+
+    // Scheduling a chunk which is being generated right now doesn't run it alongside itself. It runs again afterward.
+    [self scheduleChunkAtIndex:0 visible:YES distance:0];
+    XCTAssertEqual(_scheduler.numberOfPendingJobs, 2);
+
+    dispatch_semaphore_signal(_gate);
+    [_scheduler waitUntilIdle];
+
+    XCTAssertEqualObjects(_completed, [self chunksAtIndices:@[@0, @0, @2, @1]]);
+}
+
+- (void)testCancelledRerunDoesNotRun
+{
+    [self occupyWorker];
+
+    [self scheduleChunkAtIndex:0 visible:YES distance:0];
+    [self scheduleChunkAtIndex:1 visible:YES distance:10];
+    [_scheduler cancelJobsPassingTest:^BOOL(vector_float3 minP, GSTerrainChunkStage stage) {
+        return minP.x == 0;
+    }];
+
+    dispatch_semaphore_signal(_gate);
+    [_scheduler waitUntilIdle];
+
+    XCTAssertEqualObjects(_completed, [self chunksAtIndices:@[@0, @1]]);
+}
+
+- (void)testLevelsOfDetailRunSeparately
+{
+    dispatch_semaphore_t started = dispatch_semaphore_create(0), gate = dispatch_semaphore_create(0);
+    NSMutableArray<NSNumber *> *levels = [NSMutableArray new];
+    NSLock *lockLevels = [NSLock new];
+
+    // The first two jobs block until the gate opens, so both levels of detail are running at once.
+    GSTerrainChunkJob job = ^(vector_float3 minP, GSTerrainChunkStage stage, NSUInteger levelOfDetail) {
+        [lockLevels lock];
+        [levels addObject:@(levelOfDetail)];
+        BOOL blocks = (levels.count <= 2);
+        [lockLevels unlock];
+
+        if (blocks) {
+            dispatch_semaphore_signal(started);
+            dispatch_semaphore_wait(gate, DISPATCH_TIME_FOREVER);
+        }
+    };
+    GSTerrainChunkScheduler *scheduler = [[GSTerrainChunkScheduler alloc] initWithName:@"GSTerrainChunkSchedulerTests"
+                                                                     maxConcurrentJobs:2
+                                                                                   job:job];
+
+    vector_float3 p = [self chunkAtIndex:1];
+    for(NSUInteger levelOfDetail = 0; levelOfDetail < 2; ++levelOfDetail)
+    {
+        [scheduler scheduleChunkAtPoint:p
+                                  stage:GSTerrainChunkStageUpload
+                          levelOfDetail:levelOfDetail
+                                visible:YES
+                               distance:0];
+        dispatch_semaphore_wait(started, DISPATCH_TIME_FOREVER);
+    }
+    XCTAssertEqual(scheduler.numberOfRunningJobs, 2);
+
+    // The first level of detail is still running, even though another one started for the same chunk since.
+    [scheduler scheduleChunkAtPoint:p stage:GSTerrainChunkStageUpload levelOfDetail:0 visible:YES distance:0];
+    XCTAssertEqual(scheduler.numberOfPendingJobs, 0);
+
+    dispatch_semaphore_signal(gate);
+    dispatch_semaphore_signal(gate);
+    [scheduler waitUntilIdle];
+
+    XCTAssertEqualObjects(levels, (@[@0, @1, @0]));
+    [scheduler shutdown];
+}
+
+- (void)testReprioritization
+{
+    [self occupyWorker];
+
+    [self scheduleChunkAtIndex:1 visible:YES distance:10];
+    [self scheduleChunkAtIndex:2 visible:NO distance:20];
+
+    // The camera moved, so the second chunk is now visible and nearer.
+    [_scheduler reprioritizeChunkAtPoint:[self chunkAtIndex:2]
+                                   stage:GSTerrainChunkStageVoxels
+                                 visible:YES
+                                distance:5];
+
+    // Reprioritizing a chunk which has no pending job doesn't schedule one.
+    [_scheduler reprioritizeChunkAtPoint:[self chunkAtIndex:3]
+                                   stage:GSTerrainChunkStageVoxels
+                                 visible:YES
+                                distance:1];
+    XCTAssertEqual(_scheduler.numberOfPendingJobs, 2);
+
+    dispatch_semaphore_signal(_gate);
+    [_scheduler waitUntilIdle];
+
+    XCTAssertEqualObjects(_completed, [self chunksAtIndices:@[@0, @2, @1]]);
+}
+
+- (void)testCancellation
+{
+    [self occupyWorker];
+
+    for(long i = 1; i < 10; ++i)
+    {
+        [self scheduleChunkAtIndex:i visible:YES distance:i];
+    }
+
+    // Cancel the odd chunks.
+    [_scheduler cancelJobsPassingTest:^BOOL(vector_float3 minP, GSTerrainChunkStage stage) {
+        return ((long)minP.x / CHUNK_SIZE_X) % 2 == 1;
+    }];
+    XCTAssertEqual(_scheduler.numberOfPendingJobs, 4);
+
+    dispatch_semaphore_signal(_gate);
+    [_scheduler waitUntilIdle];
+
+    XCTAssertEqualObjects(_completed, [self chunksAtIndices:@[@0, @2, @4, @6, @8]]);
+}
+
+- (void)testLaterStagesComeFirst
+{
+    [self occupyWorker];
+
+    // Each stage of a chunk is a separate job.
+    [self scheduleChunkAtIndex:1 stage:GSTerrainChunkStageVoxels visible:YES distance:10];
+    [self scheduleChunkAtIndex:1 stage:GSTerrainChunkStageUpload visible:YES distance:10];
+    [self scheduleChunkAtIndex:1 stage:GSTerrainChunkStageSunlight visible:YES distance:10];
+    [self scheduleChunkAtIndex:2 stage:GSTerrainChunkStageGeometry visible:YES distance:5];
+    XCTAssertEqual(_scheduler.numberOfPendingJobs, 4);
+    XCTAssertEqual([_scheduler numberOfPendingJobsForStage:GSTerrainChunkStageVoxels], 1);
+    XCTAssertEqual([_scheduler numberOfPendingJobsForStage:GSTerrainChunkStageSunlight], 1);
+    XCTAssertEqual([_scheduler numberOfPendingJobsForStage:GSTerrainChunkStageGeometry], 1);
+    XCTAssertEqual([_scheduler numberOfPendingJobsForStage:GSTerrainChunkStageUpload], 1);
+
+    dispatch_semaphore_signal(_gate);
+    [_scheduler waitUntilIdle];
+
+    XCTAssertEqualObjects(_completed, [self chunksAtIndices:@[@0, @2, @1, @1, @1]]);
+    NSArray<NSNumber *> *expectedStages = @[@(GSTerrainChunkStageVoxels),
+                                            @(GSTerrainChunkStageGeometry),
+                                            @(GSTerrainChunkStageUpload),
+                                            @(GSTerrainChunkStageSunlight),
+                                            @(GSTerrainChunkStageVoxels)];
+    XCTAssertEqualObjects(_completedStages, expectedStages);
+}
+
+@end
@@ -0,0 +1,284 @@
+//
+//  GSTerrainGeneratorTests.m
+//  GutsyStorm
+//
+//  Created by agent on 10/18/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "GSTerrainGenerator.h"
+#import "GSTerrainTile.h"
+#import "GSNoise.h"
+#import "GSVectorUtils.h"
+#import "GSIntegerVector3.h"
+#import "GSBox.h"
+#import "GSTerrainJournal.h"
+#import "GSTerrainChunkStore.h"
+
+
+#define NUM_POINTS (100003)
+
+
+@interface GSTerrainGeneratorTests : XCTestCase
+
+@end
+
+@implementation GSTerrainGeneratorTests
+{
+    vector_float3 *_points;
+    float *_results;
+}
+
+- (void)setUp
+{
+    [super setUp];
+
+    // Points scattered over a few hundred voxels in each direction, with a count which isn't a multiple of the batch.
+    _points = malloc(NUM_POINTS * sizeof(vector_float3));
+    _results = malloc(NUM_POINTS * sizeof(float));
+    unsigned seed = 1;
+    for(size_t i = 0; i < NUM_POINTS; ++i)
+    {
+        _points[i] = vector_make(rand_r(&seed) % 600 - 300, rand_r(&seed) % 256, rand_r(&seed) % 600 - 300) * 0.025f;
+    }
+}
+
+- (void)tearDown
+{
+    free(_points);
+    free(_results);
+    [super tearDown];
+}
+
+- (void)testBatchNoiseMatchesScalar
+{
+    GSNoise *noise = [[GSNoise alloc] initWithSeed:1];
+
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    [noise noiseAtPoints:_points results:_results count:NUM_POINTS];
+    CFAbsoluteTime batchTime = CFAbsoluteTimeGetCurrent() - startTime;
+
+    startTime = CFAbsoluteTimeGetCurrent();
+    for(size_t i = 0; i < NUM_POINTS; ++i)
+    {
+        XCTAssertEqualWithAccuracy(_results[i], [noise noiseAtPoint:_points[i]], 1e-6);
+    }
+    CFAbsoluteTime scalarTime = CFAbsoluteTimeGetCurrent() - startTime;
+
+    NSLog(@"Noise: scalar %.1f points/s, batch %.1f points/s",
+          NUM_POINTS / scalarTime, NUM_POINTS / batchTime);
+
+    [noise noiseWithFourOctavesAtPoints:_points results:_results count:NUM_POINTS];
+    for(size_t i = 0; i < NUM_POINTS; ++i)
+    {
+        XCTAssertEqualWithAccuracy(_results[i], [noise noiseAtPointWithFourOctaves:_points[i]], 1e-6);
+    }
+
+    [noise noiseAtPoints:_points numOctaves:3 results:_results count:NUM_POINTS];
+    for(size_t i = 0; i < NUM_POINTS; ++i)
+    {
+        XCTAssertEqualWithAccuracy(_results[i], [noise noiseAtPoint:_points[i] numOctaves:3], 1e-6);
+    }
+}
+
+- (void)testGenerationThroughput
+{
+    GSTerrainGenerator *generator = [[GSTerrainGenerator alloc] initWithRandomSeed:1];
+    GSIntAABB box = { .mins = GSZeroIntVec3, .maxs = GSChunkSizeIntVec3 };
+    vector_long3 dim = box.maxs - box.mins;
+    NSUInteger count = dim.x * dim.y * dim.z;
+    GSVoxel *voxels = malloc(count * sizeof(GSVoxel));
+    const NSUInteger numChunks = 8;
+
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+    for(NSUInteger i = 0; i < numChunks; ++i)
+    {
+        // The first chunk includes the floating mountain.
+        vector_float3 offsetToWorld = vector_make(CHUNK_SIZE_X * (i + 2), 0, CHUNK_SIZE_Z * 5);
+        [generator generateWithDestination:voxels count:count region:&box offsetToWorld:offsetToWorld];
+    }
+    CFAbsoluteTime elapsed = CFAbsoluteTimeGetCurrent() - startTime;
+
+    NSLog(@"Terrain generation: %.1f voxels/s", numChunks * count / elapsed);
+
+    // The top of the world is far above the hills and the mountain.
+    XCTAssertEqual(voxels[INDEX_BOX(box.maxs - GSMakeIntegerVector3(1, 1, 1), box)].type, VOXEL_TYPE_EMPTY);
+
+    free(voxels);
+}
+
+- (void)testInterpolatedGeneration
+{
+    // Generate chunks with a border around them, so that lattice cells straddling the edges of the region are covered.
+    GSIntAABB box = {
+        .mins = GSZeroIntVec3 - GSMakeIntegerVector3(2, 0, 2),
+        .maxs = GSChunkSizeIntVec3 + GSMakeIntegerVector3(2, 0, 2)
+    };
+    vector_long3 dim = box.maxs - box.mins;
+    NSUInteger count = dim.x * dim.y * dim.z;
+    GSVoxel *exact = malloc(count * sizeof(GSVoxel));
+    GSVoxel *interpolated = malloc(count * sizeof(GSVoxel));
+    GSTerrainGenerator *exactGenerator = [[GSTerrainGenerator alloc] initWithRandomSeed:1];
+    GSTerrainGenerator *fastGenerator = [[GSTerrainGenerator alloc]
+                                         initWithRandomSeed:1
+                                         quality:GSTerrainGenerationQualityInterpolated];
+    const NSUInteger numChunks = 8;
+    CFAbsoluteTime exactTime = 0, interpolatedTime = 0;
+    NSUInteger numDifferent = 0, numDifferentOutsideBand = 0, numInBand = 0;
+
+    // Interpolation only changes the turbulence of the hills, so only voxels in this band of each column may differ.
+    float hillsMinY, hillsMaxY;
+    [GSTerrainGenerator getHillsSurfaceMinY:&hillsMinY maxY:&hillsMaxY];
+    long bandBegin = MAX(box.mins.y, (long)ceilf(hillsMinY)), bandEnd = MIN(box.maxs.y, (long)floorf(hillsMaxY) + 1);
+    XCTAssertLessThan(bandBegin, bandEnd);
+
+    for(NSUInteger i = 0; i < numChunks; ++i)
+    {
+        vector_float3 offsetToWorld = vector_make(CHUNK_SIZE_X * (i + 2), 0, CHUNK_SIZE_Z * (5 - (long)i));
+
+        CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+        [exactGenerator generateWithDestination:exact count:count region:&box offsetToWorld:offsetToWorld];
+        exactTime += CFAbsoluteTimeGetCurrent() - startTime;
+
+        startTime = CFAbsoluteTimeGetCurrent();
+        [fastGenerator generateWithDestination:interpolated count:count region:&box offsetToWorld:offsetToWorld];
+        interpolatedTime += CFAbsoluteTimeGetCurrent() - startTime;
+
+        vector_long3 p;
+        FOR_BOX(p, box)
+        {
+            long j = INDEX_BOX(p, box);
+            BOOL different = (exact[j].type != interpolated[j].type);
+
+            if (p.y >= bandBegin && p.y < bandEnd) {
+                ++numInBand;
+                numDifferent += different;
+            } else {
+                numDifferentOutsideBand += different;
+            }
+        }
+    }
+
+    double fractionDifferent = (double)numDifferent / numInBand;
+    NSLog(@"Interpolated generation: %.1f voxels/s exact, %.1f voxels/s interpolated, %.3f%% of voxels differ "
+          @"within the surface of the hills",
+          numChunks * count / exactTime, numChunks * count / interpolatedTime, 100.0 * fractionDifferent);
+
+    XCTAssertEqual(numDifferentOutsideBand, 0);
+    XCTAssertLessThan(fractionDifferent, 0.004);
+
+    free(exact);
+    free(interpolated);
+}
+
+- (void)testTileMatchesChunks
+{
+    GSIntAABB box = { .mins = GSZeroIntVec3, .maxs = GSChunkSizeIntVec3 };
+    vector_long3 dim = box.maxs - box.mins;
+    NSUInteger count = dim.x * dim.y * dim.z;
+    GSVoxel *expected = malloc(count * sizeof(GSVoxel));
+    GSVoxel *actual = malloc(count * sizeof(GSVoxel));
+    const long tileSize = 4;
+    vector_float3 tileMinP = vector_make(0, 0, CHUNK_SIZE_Z * 4);
+
+    for(GSTerrainGenerationQuality quality = GSTerrainGenerationQualityExact;
+        quality <= GSTerrainGenerationQualityInterpolated;
+        ++quality)
+    {
+        GSTerrainGenerator *generator = [[GSTerrainGenerator alloc] initWithRandomSeed:1 quality:quality];
+
+        CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+        GSTerrainTile *tile = [[GSTerrainTile alloc] initWithMinP:tileMinP
+                                                          chunksX:tileSize
+                                                          chunksZ:tileSize
+                                                        generator:generator];
+        CFAbsoluteTime tileTime = CFAbsoluteTimeGetCurrent() - startTime, chunkTime = 0;
+
+        // Each chunk sliced out of the tile must be identical to the chunk generated by itself.
+        for(long x = 0; x < tileSize; ++x)
+        {
+            for(long z = 0; z < tileSize; ++z)
+            {
+                vector_float3 minP = tileMinP + vector_make(x * CHUNK_SIZE_X, 0, z * CHUNK_SIZE_Z);
+
+                startTime = CFAbsoluteTimeGetCurrent();
+                [generator generateWithDestination:expected count:count region:&box offsetToWorld:minP];
+                chunkTime += CFAbsoluteTimeGetCurrent() - startTime;
+
+                [tile copyVoxelsForChunkAtPoint:minP destination:actual];
+                XCTAssertEqual(memcmp(expected, actual, count * sizeof(GSVoxel)), 0);
+            }
+        }
+
+        NSLog(@"Tile generation with quality %d: %.2f ms for the tile, %.2f ms for its chunks one at a time",
+              quality, 1000.0 * tileTime, 1000.0 * chunkTime);
+    }
+
+    free(expected);
+    free(actual);
+}
+
+- (void)testGenerationIsReproducible
+{
+    GSIntAABB box = { .mins = GSZeroIntVec3, .maxs = GSChunkSizeIntVec3 };
+    vector_long3 dim = box.maxs - box.mins;
+    NSUInteger count = dim.x * dim.y * dim.z;
+    GSVoxel *voxels[2] = { malloc(count * sizeof(GSVoxel)), malloc(count * sizeof(GSVoxel)) };
+    vector_float3 offsetToWorld = vector_make(CHUNK_SIZE_X * 2, 0, CHUNK_SIZE_Z * 5);
+    memset(voxels[0], 0x00, count * sizeof(GSVoxel));
+    memset(voxels[1], 0xff, count * sizeof(GSVoxel));
+
+    // Separate generators, with other chunks generated in between, must still produce byte-identical chunks.
+    for(NSUInteger i = 0; i < 2; ++i)
+    {
+        GSTerrainGenerator *generator = [[GSTerrainGenerator alloc] initWithRandomSeed:1];
+        if (i > 0) {
+            [generator generateWithDestination:voxels[i]
+                                         count:count
+                                        region:&box
+                                 offsetToWorld:vector_make(0, 0, CHUNK_SIZE_Z)];
+        }
+        [generator generateWithDestination:voxels[i] count:count region:&box offsetToWorld:offsetToWorld];
+    }
+
+    XCTAssertEqual(memcmp(voxels[0], voxels[1], count * sizeof(GSVoxel)), 0);
+
+    free(voxels[0]);
+    free(voxels[1]);
+}
+
+- (void)testQualitiesAreCachedSeparately
+{
+    NSString *path = [NSTemporaryDirectory() stringByAppendingPathComponent:[[NSUUID UUID] UUIDString]];
+    NSURL *parent = [NSURL fileURLWithPath:path isDirectory:YES];
+    GSTerrainJournal *journal = [[GSTerrainJournal alloc] init];
+    NSURL *folders[2];
+
+    const GSTerrainGenerationQuality qualities[2] = {
+        GSTerrainGenerationQualityExact,
+        GSTerrainGenerationQualityInterpolated
+    };
+
+    for(NSUInteger i = 0; i < 2; ++i)
+    {
+        GSTerrainGenerator *generator = [[GSTerrainGenerator alloc] initWithRandomSeed:1 quality:qualities[i]];
+        GSTerrainChunkStore *chunkStore = [[GSTerrainChunkStore alloc] initWithJournal:journal
+                                                                           cacheFolder:parent
+                                                                                camera:nil
+                                                                             glContext:nil
+                                                                             generator:generator];
+        folders[i] = chunkStore.cacheFolder;
+        XCTAssertNotNil(folders[i]);
+        XCTAssertTrue([folders[i] checkResourceIsReachableAndReturnError:NULL]);
+        XCTAssertEqualObjects([[folders[i] URLByDeletingLastPathComponent] path], [parent path]);
+        [chunkStore shutdown];
+    }
+
+    // Chunks generated at one quality must never be loaded by a chunk store which generates at the other.
+    XCTAssertNotEqualObjects([folders[0] path], [folders[1] path]);
+
+    [[NSFileManager defaultManager] removeItemAtURL:parent error:NULL];
+}
+
+@end
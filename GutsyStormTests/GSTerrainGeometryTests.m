@@ -0,0 +1,786 @@
+//
+//  GSTerrainGeometryTests.m
+//  GutsyStorm
+//
+//  Created by agent on 10/18/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "GSTerrainGeometryBlockGen.h"
+#import "GSTerrainGeometryMarchingCubes.h"
+#import "GSTerrainGeometryGenerator.h"
+#import "GSTerrainLightBuffer.h"
+#import "GSTerrainGenerator.h"
+#import "GSIntegerVector3.h"
+#import "GSBox.h"
+
+
+/* The terrain vertex format used before GSTerrainVertex, kept only to measure the savings of the compact format. */
+typedef struct
+{
+    GLfloat position[3];
+    GLubyte color[4];
+    GLfloat texCoord[3];
+} GSFloatTerrainVertex;
+
+
+/* Resolution at which the seam between two chunks is sampled, in samples per voxel. */
+#define SEAM_SAMPLES_PER_VOXEL (4)
+#define SEAM_SAMPLES_Z (CHUNK_SIZE_Z * SEAM_SAMPLES_PER_VOXEL)
+#define SEAM_SAMPLES_Y (CHUNK_SIZE_Y * SEAM_SAMPLES_PER_VOXEL)
+
+
+static inline float cross2(vector_float2 u, vector_float2 v)
+{
+    return u.x * v.y - u.y * v.x;
+}
+
+
+static BOOL triangleContainsPoint(vector_float2 a, vector_float2 b, vector_float2 c, vector_float2 p)
+{
+    float d1 = cross2(b - a, p - a), d2 = cross2(c - b, p - b), d3 = cross2(a - c, p - c);
+    BOOL anyNegative = (d1 < 0) || (d2 < 0) || (d3 < 0);
+    BOOL anyPositive = (d1 > 0) || (d2 > 0) || (d3 > 0);
+    return !(anyNegative && anyPositive);
+}
+
+
+/* Returns the index of the first index of the skirt along the side, and the number of indices in it. */
+static size_t skirtRange(const GSTerrainGeometry * _Nonnull geometry, GSChunkSide side, size_t * _Nonnull outCount)
+{
+    size_t first = geometry->indexCount;
+    for(GSChunkSide s = 0; s < GSNumChunkSides; ++s)
+    {
+        first -= geometry->skirtIndexCount[s];
+    }
+    for(GSChunkSide s = 0; s < side; ++s)
+    {
+        first += geometry->skirtIndexCount[s];
+    }
+
+    *outCount = geometry->skirtIndexCount[side];
+    return first;
+}
+
+
+/* Samples the parts of `geometry' which touch the plane x = `planeX', in chunk-local voxels, drawn as it would be with
+ * only the skirt along `side'. For each sample along z, `heights' is raised to the height of the highest surface edge
+ * lying in the plane. Samples in the plane which are covered by triangles lying in the plane, such as skirts, are
+ * marked in `covered', indexed by z and then y.
+ */
+static void sampleSeam(const GSTerrainGeometry * _Nonnull geometry, float planeX, GSChunkSide side,
+                       float heights[SEAM_SAMPLES_Z], BOOL * _Nonnull covered)
+{
+    const float S = SEAM_SAMPLES_PER_VOXEL;
+    size_t numSkirtIndices = 0, numFirstSkirtIndices = 0;
+    const size_t firstSkirtIndex = skirtRange(geometry, side, &numSkirtIndices);
+    const size_t numSurfaceIndices = skirtRange(geometry, 0, &numFirstSkirtIndices);
+
+    for(size_t i = 0; i < geometry->indexCount; i += 3)
+    {
+        if (i >= numSurfaceIndices && (i < firstSkirtIndex || i >= firstSkirtIndex + numSkirtIndices)) {
+            continue; // The skirts along the other sides are not drawn.
+        }
+
+        vector_float2 inPlane[3];
+        size_t numInPlane = 0;
+
+        for(size_t k = 0; k < 3; ++k)
+        {
+            const GLshort *pos = geometry->vertices[geometry->indices[i+k]].position;
+            if ((float)pos[0] / GS_TERRAIN_VERTEX_POSITION_SCALE == planeX) {
+                inPlane[numInPlane++] = (vector_float2){pos[2], pos[1]} / GS_TERRAIN_VERTEX_POSITION_SCALE;
+            }
+        }
+
+        if (numInPlane == 3) {
+            vector_float2 mins = vector_min(inPlane[0], vector_min(inPlane[1], inPlane[2]));
+            vector_float2 maxs = vector_max(inPlane[0], vector_max(inPlane[1], inPlane[2]));
+
+            for(long sz = MAX(0, (long)floorf(mins.x * S)); sz < MIN(SEAM_SAMPLES_Z, (long)ceilf(maxs.x * S)); ++sz)
+            {
+                for(long sy = MAX(0, (long)floorf(mins.y * S)); sy < MIN(SEAM_SAMPLES_Y, (long)ceilf(maxs.y * S)); ++sy)
+                {
+                    vector_float2 q = (vector_float2){sz + 0.5f, sy + 0.5f} / S;
+                    if (triangleContainsPoint(inPlane[0], inPlane[1], inPlane[2], q)) {
+                        covered[sz * SEAM_SAMPLES_Y + sy] = YES;
+                    }
+                }
+            }
+        } else if (numInPlane == 2 && inPlane[0].x != inPlane[1].x) {
+            vector_float2 a = inPlane[0], b = inPlane[1];
+            long first = MAX(0, (long)floorf(MIN(a.x, b.x) * S));
+            long last = MIN(SEAM_SAMPLES_Z, (long)ceilf(MAX(a.x, b.x) * S));
+
+            for(long sz = first; sz < last; ++sz)
+            {
+                float z = (sz + 0.5f) / S;
+                heights[sz] = MAX(heights[sz], a.y + (b.y - a.y) * (z - a.x) / (b.x - a.x));
+            }
+        }
+    }
+}
+
+
+/* The ambient occlusion which marching cubes used before its vertices were welded, kept as a reference for shading.
+ * Rays are cast from the vertex to each of its 26 neighbors, weighted by their angle to the face normal, and count as
+ * escaping if the neighbor isn't opaque. Returns the luminance of the vertex in full sunlight.
+ */
+static uint8_t referenceFaceLuminance(vector_float3 pos, vector_float3 faceNormal,
+                                      const GSVoxel * _Nonnull voxels, GSIntAABB voxelBox)
+{
+    float count = 0, escaped = 0;
+
+    for(float dx = -1; dx <= 1; dx += 1.0f)
+    {
+        for(float dy = -1; dy <= 1; dy += 1.0f)
+        {
+            for(float dz = -1; dz <= 1; dz += 1.0f)
+            {
+                vector_float3 lightDir = {dx, dy, dz};
+                float contribution = vector_dot(faceNormal, lightDir) / vector_length(lightDir);
+
+                if (contribution > 0) {
+                    vector_float3 q = pos + lightDir;
+                    vector_long3 sample = {floorf(q.x), floorf(q.y), floorf(q.z)};
+                    BOOL outsideWorld = (sample.y < 0) || (sample.y >= CHUNK_SIZE_Y);
+                    BOOL escape = outsideWorld || !voxels[INDEX_BOX(sample, voxelBox)].opaque;
+                    escaped += escape ? contribution : 0;
+                    count += contribution;
+                }
+            }
+        }
+    }
+
+    return (uint8_t)MIN(MAX(204.0f * (escaped / count) + 51.0f, 0.0f), 255.0f);
+}
+
+
+@interface GSTerrainGeometryTests : XCTestCase
+
+@end
+
+@implementation GSTerrainGeometryTests
+{
+    GSVoxel *_voxels;
+    GSIntAABB _voxelBox;
+    uint8_t *_lightBuffers[NUM_LIGHT_CHANNELS];
+    GSIntAABB _lightBox;
+}
+
+- (void)setUp
+{
+    [super setUp];
+
+    _voxelBox = (GSIntAABB){ .mins = GSCombinedMinP, .maxs = GSCombinedMaxP };
+    vector_long3 dim = _voxelBox.maxs - _voxelBox.mins;
+    _voxels = calloc(dim.x * dim.y * dim.z, sizeof(GSVoxel));
+
+    _lightBox = (GSIntAABB){
+        .mins = GSZeroIntVec3 - GSMakeIntegerVector3(1, 0, 1),
+        .maxs = GSChunkSizeIntVec3 + GSMakeIntegerVector3(1, 0, 1)
+    };
+    for(GSLightChannel channel = 0; channel < NUM_LIGHT_CHANNELS; ++channel)
+    {
+        _lightBuffers[channel] = calloc(1, LIGHT_BUFFER_SIZE_IN_BYTES(_lightBox.maxs - _lightBox.mins));
+    }
+
+    // A stress scene of player-built structures: a row of hollow houses with doorways, a field of pillars, and a
+    // large solid block which straddles the chunk boundary.
+    vector_long3 p;
+    FOR_BOX(p, _voxelBox)
+    {
+        BOOL house = (p.y >= 40) && (p.y < 52) && (p.z >= 2) && (p.z < 12) && (p.x % 8 != 7) &&
+                     ((p.x % 8 == 0) || (p.x % 8 == 6) || (p.z == 2) || (p.z == 11) || (p.y == 51)) &&
+                     !((p.z == 2) && (p.x % 8 == 3) && (p.y < 43));
+        BOOL pillar = (p.y >= 40) && (p.y < 70) && (p.z >= 13) && (p.x % 3 == 0) && (p.z % 3 == 0);
+        BOOL block = (p.y >= 80) && (p.y < 100) && (p.x >= -5) && (p.x < 21) && (p.z >= -5) && (p.z < 9);
+
+        // Rolling hills of ground beneath the structures.
+        BOOL ground = p.y < 30 + 4*sinf(p.x * 0.3f) + 4*cosf(p.z * 0.2f);
+
+        GSVoxel *voxel = &_voxels[INDEX_BOX(p, _voxelBox)];
+
+        if (house || pillar || block) {
+            voxel->type = VOXEL_TYPE_WALL;
+            voxel->opaque = 1;
+        } else if (ground) {
+            voxel->type = VOXEL_TYPE_GROUND;
+            voxel->opaque = 1;
+        }
+    }
+}
+
+- (void)tearDown
+{
+    free(_voxels);
+    for(GSLightChannel channel = 0; channel < NUM_LIGHT_CHANNELS; ++channel)
+    {
+        free(_lightBuffers[channel]);
+    }
+    [super tearDown];
+}
+
+/* Replace the stress scene with generated terrain around the chunk at `minP', in full sunlight. */
+- (void)generateTerrainAtPoint:(vector_float3)minP
+{
+    GSTerrainGenerator *generator = [[GSTerrainGenerator alloc] initWithRandomSeed:1];
+    vector_long3 dim = _voxelBox.maxs - _voxelBox.mins;
+    [generator generateWithDestination:_voxels count:dim.x * dim.y * dim.z region:&_voxelBox offsetToWorld:minP];
+
+    memset(_lightBuffers[LIGHT_CHANNEL_SUN], CHUNK_LIGHTING_MAX | (CHUNK_LIGHTING_MAX << 4),
+           LIGHT_BUFFER_SIZE_IN_BYTES(_lightBox.maxs - _lightBox.mins));
+}
+
+/* Samples the seam on the side x = `planeX' of the chunk in the current voxels, meshed at the level of detail. */
+- (void)sampleSeamAtLevelOfDetail:(NSUInteger)levelOfDetail
+                           planeX:(float)planeX
+                             side:(GSChunkSide)side
+                          heights:(nonnull float *)heights
+                          covered:(nonnull BOOL *)covered
+{
+    const uint8_t *light[NUM_LIGHT_CHANNELS] = {
+        [LIGHT_CHANNEL_SUN] = _lightBuffers[LIGHT_CHANNEL_SUN],
+        [LIGHT_CHANNEL_TORCH] = _lightBuffers[LIGHT_CHANNEL_TORCH]
+    };
+
+    for(size_t k = 0; k < SEAM_SAMPLES_Z; ++k)
+    {
+        heights[k] = -INFINITY;
+    }
+
+    for(NSUInteger i = 0; i < GSNumGeometrySubChunks; ++i)
+    {
+        GSTerrainGeometry *geometry = GSTerrainGeometryCreate();
+        GSTerrainGeometryGenerate(geometry, _voxels, _voxelBox, light, &_lightBox,
+                                  vector_make(0, 0, 0), i, levelOfDetail);
+        sampleSeam(geometry, planeX, side, heights, covered);
+        GSTerrainGeometryDestroy(geometry);
+    }
+}
+
+/* Meshes two adjacent chunks of generated terrain, the first at the finer level of detail and the second at the next
+ * coarser level, and checks that every gap between their surfaces along the shared side is covered by a skirt. Each
+ * chunk is sampled with only the skirt along the shared side, as it would be drawn.
+ */
+- (void)checkSeamBelowLevelOfDetail:(NSUInteger)fineLevelOfDetail
+{
+    const vector_float3 fineMinP = vector_make(CHUNK_SIZE_X * 7, 0, CHUNK_SIZE_Z * 3);
+    const vector_float3 coarseMinP = fineMinP + vector_make(CHUNK_SIZE_X, 0, 0);
+    float fineHeights[SEAM_SAMPLES_Z], coarseHeights[SEAM_SAMPLES_Z];
+    BOOL *fineCovered = calloc(SEAM_SAMPLES_Z * SEAM_SAMPLES_Y, sizeof(BOOL));
+    BOOL *coarseCovered = calloc(SEAM_SAMPLES_Z * SEAM_SAMPLES_Y, sizeof(BOOL));
+
+    [self generateTerrainAtPoint:fineMinP];
+    [self sampleSeamAtLevelOfDetail:fineLevelOfDetail
+                             planeX:CHUNK_SIZE_X
+                               side:GSChunkSidePosX
+                            heights:fineHeights
+                            covered:fineCovered];
+
+    [self generateTerrainAtPoint:coarseMinP];
+    [self sampleSeamAtLevelOfDetail:fineLevelOfDetail+1
+                             planeX:0
+                               side:GSChunkSideNegX
+                            heights:coarseHeights
+                            covered:coarseCovered];
+
+    size_t numGapSamples = 0, numUncovered = 0, numCoveredOnlyByFine = 0;
+    float widestGap = 0;
+
+    for(long sz = 0; sz < SEAM_SAMPLES_Z; ++sz)
+    {
+        if (isinf(fineHeights[sz]) || isinf(coarseHeights[sz])) {
+            continue;
+        }
+
+        float lo = MIN(fineHeights[sz], coarseHeights[sz]);
+        float hi = MAX(fineHeights[sz], coarseHeights[sz]);
+        widestGap = MAX(widestGap, hi - lo);
+
+        for(long sy = (long)ceilf(lo * SEAM_SAMPLES_PER_VOXEL - 0.5f); sy < SEAM_SAMPLES_Y; ++sy)
+        {
+            float y = (sy + 0.5f) / SEAM_SAMPLES_PER_VOXEL;
+            if (y >= hi) {
+                break;
+            }
+
+            BOOL fine = fineCovered[sz * SEAM_SAMPLES_Y + sy], coarse = coarseCovered[sz * SEAM_SAMPLES_Y + sy];
+            numGapSamples++;
+            numUncovered += !(fine || coarse);
+            numCoveredOnlyByFine += (fine && !coarse);
+        }
+    }
+
+    NSLog(@"Seam between levels of detail %lu and %lu: widest gap %.2f voxels, %zu gap samples, %zu covered only by "
+          @"the finer chunk's skirts, %zu uncovered", (unsigned long)fineLevelOfDetail,
+          (unsigned long)fineLevelOfDetail+1, widestGap, numGapSamples, numCoveredOnlyByFine, numUncovered);
+
+    XCTAssertEqual(numUncovered, 0);
+
+    free(fineCovered);
+    free(coarseCovered);
+}
+
+/* Generate block geometry for every sub-chunk of the center chunk and return the total area of the triangles. */
+- (double)generateBlocksWithMode:(GSBlockMeshingMode)mode
+                    numVertices:(nonnull size_t *)outNumVertices
+                     numIndices:(nonnull size_t *)outNumIndices
+{
+    double area = 0;
+    size_t numVertices = 0, numIndices = 0;
+    CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+
+    for(NSUInteger i = 0; i < GSNumGeometrySubChunks; ++i)
+    {
+        GSTerrainGeometry *geometry = GSTerrainGeometryCreate();
+        GSIntAABB ibounds = GSTerrainGeometrySubchunkBoxInt(vector_make(0, 0, 0), i);
+        GSTerrainGeometryBlockGen(geometry, _voxels, _voxelBox, vector_make(0, 0, 0), ibounds, 1, mode);
+        GSTerrainGeometryFinish(geometry);
+
+        for(size_t j = 0; j < geometry->indexCount; j += 3)
+        {
+            vector_float3 tri[3];
+            for(size_t k = 0; k < 3; ++k)
+            {
+                const GLshort *pos = geometry->vertices[geometry->indices[j+k]].position;
+                tri[k] = (vector_float3){pos[0], pos[1], pos[2]} / GS_TERRAIN_VERTEX_POSITION_SCALE;
+            }
+            area += 0.5 * vector_length(vector_cross(tri[1] - tri[0], tri[2] - tri[0]));
+        }
+
+        numVertices += geometry->count;
+        numIndices += geometry->indexCount;
+        GSTerrainGeometryDestroy(geometry);
+    }
+
+    NSLog(@"Block meshing mode %d: %zu vertices, %zu indices, %.2f ms",
+          mode, numVertices, numIndices, 1000.0 * (CFAbsoluteTimeGetCurrent() - startTime));
+
+    *outNumVertices = numVertices;
+    *outNumIndices = numIndices;
+    return area;
+}
+
+- (void)testGreedyBlockMeshing
+{
+    size_t perFaceVertices = 0, perFaceIndices = 0, greedyVertices = 0, greedyIndices = 0;
+    double perFaceArea = [self generateBlocksWithMode:GSBlockMeshingPerFace
+                                          numVertices:&perFaceVertices
+                                           numIndices:&perFaceIndices];
+    double greedyArea = [self generateBlocksWithMode:GSBlockMeshingGreedy
+                                         numVertices:&greedyVertices
+                                          numIndices:&greedyIndices];
+
+    // Merging faces must cover exactly the same surface with fewer triangles.
+    XCTAssertGreaterThan(perFaceArea, 0);
+    XCTAssertEqualWithAccuracy(perFaceArea, greedyArea, 1e-6);
+    XCTAssertLessThan(greedyVertices, perFaceVertices);
+    XCTAssertLessThan(greedyIndices, perFaceIndices);
+}
+
+- (void)testMarchingCubesPerformance
+{
+    const uint8_t *light[NUM_LIGHT_CHANNELS] = {
+        [LIGHT_CHANNEL_SUN] = _lightBuffers[LIGHT_CHANNEL_SUN],
+        [LIGHT_CHANNEL_TORCH] = _lightBuffers[LIGHT_CHANNEL_TORCH]
+    };
+    GSIntAABB lightBox = _lightBox;
+
+    [self measureBlock:^{
+        for(NSUInteger i = 0; i < GSNumGeometrySubChunks; ++i)
+        {
+            GSTerrainGeometry *geometry = GSTerrainGeometryCreate();
+            GSIntAABB ibounds = GSTerrainGeometrySubchunkBoxInt(vector_make(0, 0, 0), i);
+            GSTerrainGeometryMarchingCubes(geometry, _voxels, _voxelBox, light, &lightBox,
+                                           vector_make(0, 0, 0), ibounds, 1);
+            GSTerrainGeometryDestroy(geometry);
+        }
+    }];
+}
+
+- (void)testWeldedTerrainMeshes
+{
+    const uint8_t *light[NUM_LIGHT_CHANNELS] = {
+        [LIGHT_CHANNEL_SUN] = _lightBuffers[LIGHT_CHANNEL_SUN],
+        [LIGHT_CHANNEL_TORCH] = _lightBuffers[LIGHT_CHANNEL_TORCH]
+    };
+    const NSUInteger numChunks = 4;
+    size_t numVertices = 0, numIndices = 0;
+
+    for(NSUInteger c = 0; c < numChunks; ++c)
+    {
+        [self generateTerrainAtPoint:vector_make(CHUNK_SIZE_X * (c + 7), 0, CHUNK_SIZE_Z * 3)];
+
+        for(NSUInteger i = 0; i < GSNumGeometrySubChunks; ++i)
+        {
+            GSTerrainGeometry *geometry = GSTerrainGeometryCreate();
+            GSTerrainGeometryGenerate(geometry, _voxels, _voxelBox, light, &_lightBox, vector_make(0, 0, 0), i, 0);
+            numVertices += geometry->count;
+            numIndices += geometry->indexCount;
+            GSTerrainGeometryDestroy(geometry);
+        }
+    }
+
+    // Without welding every index would be a vertex of its own, and there would be no index buffer. The geometry file
+    // holds exactly these arrays after a fixed-size header.
+    size_t unweldedBytes = numIndices * sizeof(GSTerrainVertex);
+    size_t weldedBytes = numVertices * sizeof(GSTerrainVertex) + numIndices * sizeof(GSTerrainIndex);
+
+    NSLog(@"Terrain meshes per chunk: %zu vertices and %zu bytes unwelded, %zu vertices and %zu bytes welded",
+          numIndices / numChunks, unweldedBytes / numChunks, numVertices / numChunks, weldedBytes / numChunks);
+
+    // The index buffer must more than pay for itself.
+    XCTAssertGreaterThan(numVertices, 0);
+    XCTAssertLessThan(numVertices * 2, numIndices);
+    XCTAssertLessThan(weldedBytes, unweldedBytes);
+}
+
+- (void)testWeldedShadingMatchesFaceShading
+{
+    // A welded vertex is shaded once, using a normal estimated from the occluders around its edge, where it used to be
+    // shaded for each face using that face's normal. Compare the two on the stress scene in full sunlight, so that
+    // luminance depends only on ambient occlusion. They differ most at creases, where the face normals of the faces
+    // around a vertex disagree. On average they must agree to within 8 of the 204 levels of shading, and nine in ten
+    // samples to within 16.
+    memset(_lightBuffers[LIGHT_CHANNEL_SUN], CHUNK_LIGHTING_MAX | (CHUNK_LIGHTING_MAX << 4),
+           LIGHT_BUFFER_SIZE_IN_BYTES(_lightBox.maxs - _lightBox.mins));
+
+    const uint8_t *light[NUM_LIGHT_CHANNELS] = {
+        [LIGHT_CHANNEL_SUN] = _lightBuffers[LIGHT_CHANNEL_SUN],
+        [LIGHT_CHANNEL_TORCH] = _lightBuffers[LIGHT_CHANNEL_TORCH]
+    };
+    size_t numSamples = 0, numWithinTolerance = 0, largestDifference = 0;
+    double totalDifference = 0;
+
+    for(NSUInteger i = 0; i < GSNumGeometrySubChunks; ++i)
+    {
+        GSTerrainGeometry *geometry = GSTerrainGeometryCreate();
+        GSIntAABB ibounds = GSTerrainGeometrySubchunkBoxInt(vector_make(0, 0, 0), i);
+        GSTerrainGeometryMarchingCubes(geometry, _voxels, _voxelBox, light, &_lightBox,
+                                       vector_make(0, 0, 0), ibounds, 1);
+
+        for(size_t j = 0; j < geometry->indexCount; j += 3)
+        {
+            const GSTerrainVertex *v[3];
+            vector_float3 pos[3];
+
+            for(size_t k = 0; k < 3; ++k)
+            {
+                v[k] = &geometry->vertices[geometry->indices[j+k]];
+                pos[k] = (vector_float3){v[k]->position[0], v[k]->position[1], v[k]->position[2]} /
+                         GS_TERRAIN_VERTEX_POSITION_SCALE;
+            }
+
+            vector_float3 faceNormal = vector_normalize(vector_cross(pos[1] - pos[0], pos[2] - pos[0]));
+
+            for(size_t k = 0; k < 3; ++k)
+            {
+                uint8_t expected = referenceFaceLuminance(pos[k], faceNormal, _voxels, _voxelBox);
+                size_t difference = abs((int)v[k]->luminance - (int)expected);
+                totalDifference += difference;
+                largestDifference = MAX(largestDifference, difference);
+                numWithinTolerance += (difference <= 16);
+                numSamples++;
+            }
+        }
+
+        GSTerrainGeometryDestroy(geometry);
+    }
+
+    NSLog(@"Welded shading vs. per-face shading: %zu samples, mean difference %.2f, largest %zu, %.1f%% within 16",
+          numSamples, totalDifference / numSamples, largestDifference, 100.0 * numWithinTolerance / numSamples);
+
+    XCTAssertGreaterThan(numSamples, 0);
+    XCTAssertLessThanOrEqual(totalDifference / numSamples, 8.0);
+    XCTAssertGreaterThanOrEqual(numWithinTolerance * 10, numSamples * 9);
+}
+
+- (void)testCompactVertexFormat
+{
+    const uint8_t *light[NUM_LIGHT_CHANNELS] = {
+        [LIGHT_CHANNEL_SUN] = _lightBuffers[LIGHT_CHANNEL_SUN],
+        [LIGHT_CHANNEL_TORCH] = _lightBuffers[LIGHT_CHANNEL_TORCH]
+    };
+    const NSUInteger numChunks = 4;
+    size_t floatBytes = 0, compactBytes = 0;
+
+    for(NSUInteger c = 0; c < numChunks; ++c)
+    {
+        [self generateTerrainAtPoint:vector_make(CHUNK_SIZE_X * (c + 7), 0, CHUNK_SIZE_Z * 3)];
+
+        for(NSUInteger i = 0; i < GSNumGeometrySubChunks; ++i)
+        {
+            GSTerrainGeometry *geometry = GSTerrainGeometryCreate();
+            GSTerrainGeometryGenerate(geometry, _voxels, _voxelBox, light, &_lightBox, vector_make(0, 0, 0), i, 0);
+
+            // The old format had no index buffer, so expand the triangle list into one float vertex per index.
+            GSFloatTerrainVertex *floatVertices = malloc(MAX(1, geometry->indexCount) * sizeof(GSFloatTerrainVertex));
+
+            for(size_t j = 0; j < geometry->indexCount; ++j)
+            {
+                const GSTerrainVertex *v = &geometry->vertices[geometry->indices[j]];
+                GSFloatTerrainVertex *f = &floatVertices[j];
+
+                for(size_t k = 0; k < 3; ++k)
+                {
+                    f->position[k] = (GLfloat)v->position[k] / GS_TERRAIN_VERTEX_POSITION_SCALE;
+                }
+                f->color[0] = f->color[1] = f->color[2] = v->luminance;
+                f->color[3] = 255;
+                f->texCoord[0] = (GLfloat)v->texCoord[0] / GS_TERRAIN_VERTEX_TEXCOORD_SCALE;
+                f->texCoord[1] = (GLfloat)v->texCoord[1] / GS_TERRAIN_VERTEX_TEXCOORD_SCALE;
+                f->texCoord[2] = v->texCoord[2];
+
+                // Every position converts back to exactly the same fixed-point value.
+                vector_float3 p = {f->position[0], f->position[1], f->position[2]};
+                GSTerrainVertex roundTrip = GSTerrainVertexMake(p, (vector_float2){f->texCoord[0], f->texCoord[1]},
+                                                                (int)f->texCoord[2], f->color[0]);
+                XCTAssertEqual(memcmp(&roundTrip, v, sizeof(GSTerrainVertex)), 0);
+            }
+
+            floatBytes += geometry->indexCount * sizeof(GSFloatTerrainVertex);
+            compactBytes += geometry->count * sizeof(GSTerrainVertex) + geometry->indexCount * sizeof(GSTerrainIndex);
+
+            free(floatVertices);
+            GSTerrainGeometryDestroy(geometry);
+        }
+    }
+
+    NSLog(@"Terrain geometry per chunk: %zu bytes as float vertices, %zu bytes as compact vertices and indices "
+          @"(%.0f%%)", floatBytes / numChunks, compactBytes / numChunks, 100.0 * compactBytes / floatBytes);
+
+    XCTAssertGreaterThan(compactBytes, 0);
+    XCTAssertLessThan(compactBytes * 2, floatBytes);
+}
+
+/* Count the cells of the sub-chunk which the surface passes through by looking up all eight corners of every cell. */
+- (size_t)countSurfaceCellsNaivelyInBox:(GSIntAABB)ibounds step:(long)step
+{
+    size_t count = 0;
+
+    for(long x = ibounds.mins.x; x < ibounds.maxs.x; x += step)
+    {
+        for(long y = ibounds.mins.y; y < ibounds.maxs.y; y += step)
+        {
+            for(long z = ibounds.mins.z; z < ibounds.maxs.z; z += step)
+            {
+                unsigned numGround = 0;
+
+                for(unsigned i = 0; i < 8; ++i)
+                {
+                    vector_long3 corner = {x + (i & 1) * step, y + ((i >> 1) & 1) * step, z + ((i >> 2) & 1) * step};
+                    if (corner.y < CHUNK_SIZE_Y) {
+                        numGround += (_voxels[INDEX_BOX(corner, _voxelBox)].type == VOXEL_TYPE_GROUND);
+                    }
+                }
+
+                count += (numGround != 0) && (numGround != 8);
+            }
+        }
+    }
+
+    return count;
+}
+
+- (void)testSurfaceCellClassification
+{
+    const int iterations = 20;
+
+    for(long step = 1; step <= GSTerrainGeometryStepForLevelOfDetail(GSNumLevelsOfDetail - 1); step *= 2)
+    {
+        size_t naiveCount = 0, packedCount = 0;
+        CFAbsoluteTime naiveTime = 0, packedTime = 0;
+
+        for(int iteration = 0; iteration < iterations; ++iteration)
+        {
+            naiveCount = packedCount = 0;
+
+            for(NSUInteger i = 0; i < GSNumGeometrySubChunks; ++i)
+            {
+                GSIntAABB ibounds = GSTerrainGeometrySubchunkBoxInt(vector_make(0, 0, 0), i);
+
+                CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+                naiveCount += [self countSurfaceCellsNaivelyInBox:ibounds step:step];
+                naiveTime += CFAbsoluteTimeGetCurrent() - startTime;
+
+                startTime = CFAbsoluteTimeGetCurrent();
+                packedCount += GSTerrainGeometryMarchingCubesCountSurfaceCells(_voxels, _voxelBox,
+                                                                              vector_make(0, 0, 0), ibounds, step);
+                packedTime += CFAbsoluteTimeGetCurrent() - startTime;
+            }
+        }
+
+        NSLog(@"Surface cells at step %ld: %zu cells, naive %.3f ms, packed %.3f ms",
+              step, packedCount, 1000.0 * naiveTime / iterations, 1000.0 * packedTime / iterations);
+
+        // The packed ground masks must select exactly the cells which the per-corner lookups select.
+        XCTAssertGreaterThan(naiveCount, 0);
+        XCTAssertEqual(naiveCount, packedCount);
+    }
+}
+
+- (void)testSkippedSubchunksHaveNoGeometry
+{
+    const uint8_t *light[NUM_LIGHT_CHANNELS] = {
+        [LIGHT_CHANNEL_SUN] = _lightBuffers[LIGHT_CHANNEL_SUN],
+        [LIGHT_CHANNEL_TORCH] = _lightBuffers[LIGHT_CHANNEL_TORCH]
+    };
+
+    const vector_long3 chunkMins[GSNumMeshingNeighbors] = {
+        [GSMeshingNeighborCenter] = {0, 0, 0},
+        [GSMeshingNeighborPosX] = {CHUNK_SIZE_X, 0, 0},
+        [GSMeshingNeighborPosZ] = {0, 0, CHUNK_SIZE_Z},
+        [GSMeshingNeighborPosXPosZ] = {CHUNK_SIZE_X, 0, CHUNK_SIZE_Z}
+    };
+    GSSubchunkOccupancy occupancy[GSNumMeshingNeighbors][GSNumGeometrySubChunks];
+    const GSSubchunkOccupancy *occupancyPtrs[GSNumMeshingNeighbors];
+
+    for(GSMeshingNeighbor n = 0; n < GSNumMeshingNeighbors; ++n)
+    {
+        GSTerrainGeometryComputeOccupancy(_voxels, _voxelBox, chunkMins[n], occupancy[n]);
+        occupancyPtrs[n] = occupancy[n];
+    }
+
+    NSUInteger numSkipped = 0;
+    CFTimeInterval skippedTime = 0, totalTime = 0;
+
+    for(NSUInteger i = 0; i < GSNumGeometrySubChunks; ++i)
+    {
+        BOOL skip = GSTerrainGeometryCanSkipSubchunk(occupancyPtrs, i);
+
+        CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+        GSTerrainGeometry *geometry = GSTerrainGeometryCreate();
+        GSTerrainGeometryGenerate(geometry, _voxels, _voxelBox, light, &_lightBox, vector_make(0, 0, 0), i, 0);
+        CFTimeInterval elapsed = CFAbsoluteTimeGetCurrent() - startTime;
+
+        totalTime += elapsed;
+
+        if (skip) {
+            XCTAssertEqual(geometry->indexCount, 0);
+            numSkipped++;
+            skippedTime += elapsed;
+        }
+
+        GSTerrainGeometryDestroy(geometry);
+    }
+
+    // The scene has both solid ground at the bottom and empty air at the top, so each kind of skip is exercised.
+    XCTAssertTrue(GSTerrainGeometryCanSkipSubchunk(occupancyPtrs, 0));
+    XCTAssertTrue(GSTerrainGeometryCanSkipSubchunk(occupancyPtrs, GSNumGeometrySubChunks-1));
+
+    NSLog(@"Skipped %lu of %d sub-chunks, saving %.2f of %.2f ms of meshing.",
+          (unsigned long)numSkipped, GSNumGeometrySubChunks, 1000.0 * skippedTime, 1000.0 * totalTime);
+}
+
+- (void)testSkirtsAreGroupedBySide
+{
+    const uint8_t *light[NUM_LIGHT_CHANNELS] = {
+        [LIGHT_CHANNEL_SUN] = _lightBuffers[LIGHT_CHANNEL_SUN],
+        [LIGHT_CHANNEL_TORCH] = _lightBuffers[LIGHT_CHANNEL_TORCH]
+    };
+    const GLshort sideX = CHUNK_SIZE_X * GS_TERRAIN_VERTEX_POSITION_SCALE;
+    const GLshort sideZ = CHUNK_SIZE_Z * GS_TERRAIN_VERTEX_POSITION_SCALE;
+    size_t numSkirtIndices[GSNumChunkSides] = {0};
+
+    for(NSUInteger i = 0; i < GSNumGeometrySubChunks; ++i)
+    {
+        GSTerrainGeometry *geometry = GSTerrainGeometryCreate();
+        GSTerrainGeometryGenerate(geometry, _voxels, _voxelBox, light, &_lightBox, vector_make(0, 0, 0), i, 1);
+
+        for(GSChunkSide side = 0; side < GSNumChunkSides; ++side)
+        {
+            size_t count = 0;
+            size_t first = skirtRange(geometry, side, &count);
+            XCTAssertEqual(count % 12, 0); // Each skirt quad is two triangles on each face.
+            numSkirtIndices[side] += count;
+
+            for(size_t j = first; j < first + count; ++j)
+            {
+                const GLshort *pos = geometry->vertices[geometry->indices[j]].position;
+                switch(side)
+                {
+                    case GSChunkSideNegX: XCTAssertEqual(pos[0], 0); break;
+                    case GSChunkSidePosX: XCTAssertEqual(pos[0], sideX); break;
+                    case GSChunkSideNegZ: XCTAssertEqual(pos[2], 0); break;
+                    case GSChunkSidePosZ: XCTAssertEqual(pos[2], sideZ); break;
+                    default: XCTFail(@"invalid side");
+                }
+            }
+        }
+
+        GSTerrainGeometryDestroy(geometry);
+    }
+
+    // The terrain crosses every side of the chunk.
+    for(GSChunkSide side = 0; side < GSNumChunkSides; ++side)
+    {
+        XCTAssertGreaterThan(numSkirtIndices[side], 0);
+    }
+}
+
+- (void)testLevelsOfDetail
+{
+    const uint8_t *light[NUM_LIGHT_CHANNELS] = {
+        [LIGHT_CHANNEL_SUN] = _lightBuffers[LIGHT_CHANNEL_SUN],
+        [LIGHT_CHANNEL_TORCH] = _lightBuffers[LIGHT_CHANNEL_TORCH]
+    };
+
+    size_t numVertices[GSNumLevelsOfDetail] = {0};
+    CFTimeInterval elapsed[GSNumLevelsOfDetail] = {0};
+
+    for(NSUInteger lod = 0; lod < GSNumLevelsOfDetail; ++lod)
+    {
+        CFAbsoluteTime startTime = CFAbsoluteTimeGetCurrent();
+
+        for(NSUInteger i = 0; i < GSNumGeometrySubChunks; ++i)
+        {
+            GSTerrainGeometry *geometry = GSTerrainGeometryCreate();
+            GSTerrainGeometryGenerate(geometry, _voxels, _voxelBox, light, &_lightBox, vector_make(0, 0, 0), i, lod);
+
+            numVertices[lod] += geometry->count;
+            GSTerrainGeometryDestroy(geometry);
+        }
+
+        elapsed[lod] = CFAbsoluteTimeGetCurrent() - startTime;
+        NSLog(@"Level of detail %lu: %zu vertices, %.2f ms",
+              (unsigned long)lod, numVertices[lod], 1000.0 * elapsed[lod]);
+    }
+
+    for(NSUInteger lod = 1; lod < GSNumLevelsOfDetail; ++lod)
+    {
+        XCTAssertLessThan(numVertices[lod], numVertices[lod-1]);
+    }
+
+    // Estimate the cost of the whole active region at the default extent, supposing every chunk were like this one.
+    const long extent = 256;
+    size_t fullDetailVertices = 0, lodVertices = 0;
+    CFTimeInterval fullDetailTime = 0, lodTime = 0;
+
+    for(long x = -extent; x < extent; x += CHUNK_SIZE_X)
+    {
+        for(long z = -extent; z < extent; z += CHUNK_SIZE_Z)
+        {
+            vector_float2 center = {x + CHUNK_SIZE_X/2, z + CHUNK_SIZE_Z/2};
+            NSUInteger lod = GSTerrainGeometryLevelOfDetailForDistance(vector_length(center));
+            fullDetailVertices += numVertices[0];
+            fullDetailTime += elapsed[0];
+            lodVertices += numVertices[lod];
+            lodTime += elapsed[lod];
+        }
+    }
+
+    NSLog(@"Active region: %zu vertices and %.0f ms at full detail, %zu vertices and %.0f ms with levels of detail",
+          fullDetailVertices, 1000.0 * fullDetailTime, lodVertices, 1000.0 * lodTime);
+
+    XCTAssertLessThan(lodVertices, fullDetailVertices / 2);
+
+    // Check the seams headlessly, on generated terrain, at each boundary between levels of detail.
+    for(NSUInteger lod = 0; lod + 1 < GSNumLevelsOfDetail; ++lod)
+    {
+        [self checkSeamBelowLevelOfDetail:lod];
+    }
+}
+
+@end
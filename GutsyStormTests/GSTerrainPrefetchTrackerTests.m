@@ -0,0 +1,94 @@
+//
+//  GSTerrainPrefetchTrackerTests.m
+//  GutsyStorm
+//
+//  Created by agent on 10/18/26.
+//  Copyright © 2026 agent. All rights reserved.
+//
+
+#import <XCTest/XCTest.h>
+#import "GSTerrainPrefetchTracker.h"
+#import "GSBoxedVector.h"
+#import "GSVoxel.h"
+
+
+@interface GSTerrainPrefetchTrackerTests : XCTestCase
+
+@end
+
+@implementation GSTerrainPrefetchTrackerTests
+{
+    GSTerrainPrefetchTracker *_tracker;
+}
+
+- (void)setUp
+{
+    [super setUp];
+    _tracker = [[GSTerrainPrefetchTracker alloc] initWithHorizon:1.0];
+}
+
+- (void)tearDown
+{
+    _tracker = nil;
+    [super tearDown];
+}
+
+- (nonnull NSSet<GSBoxedVector *> *)chunksAtIndices:(nonnull NSArray<NSNumber *> *)indices
+{
+    NSMutableSet<GSBoxedVector *> *chunks = [NSMutableSet new];
+    for(NSNumber *i in indices)
+    {
+        vector_float3 minP = {[i longValue] * CHUNK_SIZE_X, 0, 0};
+        [chunks addObject:[GSBoxedVector boxedVectorWithVector:minP]];
+    }
+    return chunks;
+}
+
+- (void)updateWithVisible:(nonnull NSArray<NSNumber *> *)visible
+                predicted:(nonnull NSArray<NSNumber *> *)predicted
+                     time:(double)time
+{
+    [_tracker updateWithVisibleChunks:[self chunksAtIndices:visible]
+                      predictedChunks:[self chunksAtIndices:predicted]
+                                 time:time];
+}
+
+- (void)testNoPredictions
+{
+    [self updateWithVisible:@[@0, @1] predicted:@[] time:0.0];
+    [self updateWithVisible:@[@1, @2] predicted:@[] time:0.5];
+    XCTAssertEqual(_tracker.hits, 0);
+    XCTAssertEqual(_tracker.misses, 0);
+    XCTAssertEqual(_tracker.arrivals, 1);
+    XCTAssertEqual(_tracker.hitRate, 0.0);
+    XCTAssertEqual(_tracker.coverage, 0.0);
+}
+
+- (void)testHitsAndMisses
+{
+    // Chunks 0 and 1 are in view at first, so only the predictions of 2, 3, and 4 count.
+    [self updateWithVisible:@[@0, @1] predicted:@[@1, @2, @3, @4] time:0.0];
+
+    // Chunk 2 comes into view in time, as does chunk 5, which was not predicted.
+    [self updateWithVisible:@[@1, @2, @5] predicted:@[@3, @4] time:0.5];
+    XCTAssertEqual(_tracker.hits, 1);
+    XCTAssertEqual(_tracker.misses, 0);
+    XCTAssertEqual(_tracker.arrivals, 2);
+
+    // Chunk 3 comes into view too late, after its prediction was counted as a miss. Predicting chunk 4 again and again
+    // does not keep it from being counted as a miss.
+    [self updateWithVisible:@[@2, @5] predicted:@[@4] time:1.5];
+    [self updateWithVisible:@[@2, @3, @5] predicted:@[] time:1.6];
+    XCTAssertEqual(_tracker.hits, 1);
+    XCTAssertEqual(_tracker.misses, 2);
+    XCTAssertEqual(_tracker.arrivals, 3);
+    XCTAssertEqualWithAccuracy(_tracker.hitRate, 1.0 / 3.0, 1e-9);
+    XCTAssertEqualWithAccuracy(_tracker.coverage, 1.0 / 3.0, 1e-9);
+
+    [_tracker reset];
+    XCTAssertEqual(_tracker.hits, 0);
+    XCTAssertEqual(_tracker.misses, 0);
+    XCTAssertEqual(_tracker.arrivals, 0);
+}
+
+@end